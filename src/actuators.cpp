@@ -0,0 +1,353 @@
+/**
+ * Подсистема устройств: насос, вентилятор, форточка, освещение
+ * Единственный владелец выводов - задача устройств; обработчики только ставят команды в очередь
+ */
+#include "actuators.h"
+#include <ESP32Servo.h>
+#include <esp_timer.h>
+#include "led.h"
+
+// GPIO выводы
+static const int pumpPin = 17;    // Насос
+static const int windPin = 16;    // Вентилятор
+static const int windowPin = 19;  // Сервопривод форточки
+static const int lightPin = 18;   // Освещение
+
+// Признак пакета в очереди: значения лежат в batchSlot
+#define ACTUATOR_BATCH_ID 0xFF
+
+/**
+ * Команда в очереди
+ */
+struct ActuatorCommand {
+    uint8_t id;           // ActuatorId или ACTUATOR_BATCH_ID
+    int32_t value;
+    uint32_t enqueuedAt;  // Время постановки в очередь, мкс
+};
+
+/**
+ * Пакет, ожидающий применения; одновременно обрабатывается один пакет
+ * Номер и признак claimed меняются под actuatorLock: пакет либо забран задачей устройств
+ * и будет применен, либо отменен ожидающим до того, как задача его увидит
+ */
+struct ActuatorBatchSlot {
+    int32_t sequence;     // Номер пакета: команда в очереди с другим номером устарела или отменена
+    bool claimed;         // Задача устройств начала применение пакета
+    ActuatorBatch batch;
+    int64_t expectedVersion;
+    ActuatorBatchResult result;
+    ActuatorState state;  // Состояние после применения
+};
+
+static Servo servoWindow;          // Сервопривод форточки
+static QueueHandle_t commandQueue = NULL;
+static ActuatorState state = {};
+static ActuatorStats stats = {};
+static ActuatorBatchSlot batchSlot;
+static SemaphoreHandle_t batchLock = NULL;  // Один пакет за раз
+static SemaphoreHandle_t batchDone = NULL;  // Пакет применен задачей устройств
+// Снимок и счетчики читаются обработчиками запросов и основным циклом
+static portMUX_TYPE actuatorLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Применение команды к выводам и к новому состоянию (вызывается только задачей устройств)
+ * Форточка здесь получает только цель, движение выполняется по шагам
+ * @param id Устройство
+ * @param value Значение
+ * @param next Новое состояние
+ */
+static void Apply(uint8_t id, int32_t value, ActuatorState &next) {
+    switch (id) {
+        case ACTUATOR_PUMP:
+            next.pump = value != 0;
+            digitalWrite(pumpPin, next.pump ? HIGH : LOW);
+            Serial.println(next.pump ? "Насос ВКЛ" : "Насос ВЫКЛ");
+            break;
+        case ACTUATOR_WIND:
+            next.wind = value != 0;
+            digitalWrite(windPin, next.wind ? HIGH : LOW);
+            Serial.println(next.wind ? "Вентилятор ВКЛ" : "Вентилятор ВЫКЛ");
+            break;
+        case ACTUATOR_WINDOW:
+            next.windowTarget = constrain(value, 0, ACTUATOR_WINDOW_OPEN_ANGLE);
+            Serial.print("Форточка: ");
+            Serial.println(next.windowTarget);
+            break;
+        case ACTUATOR_LIGHT:
+            next.light = value != 0;
+            digitalWrite(lightPin, next.light ? HIGH : LOW); // Обычное освещение
+            next.brightness = next.light ? 100 : 0;          // RGB-лента на полную яркость или выключена
+            LedSetBrightness(next.light ? 255 : 0);
+            Serial.println(next.light ? "Свет ВКЛ" : "Свет ВЫКЛ");
+            break;
+        case ACTUATOR_BRIGHTNESS:
+            next.brightness = constrain(value, 0, 100);
+            LedSetBrightness(map(next.brightness, 0, 100, 0, 255));
+            Serial.print("Яркость: ");
+            Serial.println(next.brightness);
+            break;
+        case ACTUATOR_COLOR:
+            next.color = CRGB((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF);
+            LedSetColor(next.color);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Публикация нового состояния с увеличением версии
+ * @param next Новое состояние
+ * @param applied Количество примененных команд
+ * @param enqueuedAt Время постановки в очередь последней команды, мкс
+ */
+static void Publish(ActuatorState &next, uint32_t applied, uint32_t enqueuedAt) {
+    uint32_t latency = (uint32_t)esp_timer_get_time() - enqueuedAt;
+    portENTER_CRITICAL(&actuatorLock);
+    next.version = state.version + 1;
+    next.windowAngle = state.windowAngle; // Положение форточки ведет только StepWindow
+    state = next;
+    stats.applied += applied;
+    stats.lastLatencyUs = latency;
+    if (latency > stats.maxLatencyUs) {
+        stats.maxLatencyUs = latency;
+    }
+    portEXIT_CRITICAL(&actuatorLock);
+}
+
+/**
+ * Одиночные команды, накопившиеся в очереди: последняя команда каждого устройства
+ * Команды применяются в порядке поступления: включение освещения задает яркость ленты,
+ * поэтому "свет ВКЛ, яркость 40" и "яркость 40, свет ВКЛ" дают разную яркость
+ */
+struct ActuatorPending {
+    ActuatorCommand command[ACTUATOR_COUNT];
+    uint8_t order[ACTUATOR_COUNT];  // Устройства в порядке поступления их последних команд
+    uint8_t count;
+};
+
+/**
+ * Добавление команды в накопленные; прежняя команда тому же устройству заменяется
+ * @return true, если команда заменила прежнюю
+ */
+static bool AddPending(ActuatorPending &pending, const ActuatorCommand &command) {
+    bool replaced = false;
+    for (uint8_t i = 0; i < pending.count; i++) {
+        if (pending.order[i] == command.id) {
+            memmove(&pending.order[i], &pending.order[i + 1], pending.count - i - 1);
+            pending.count--;
+            replaced = true;
+            break;
+        }
+    }
+    pending.command[command.id] = command;
+    pending.order[pending.count++] = command.id;
+    return replaced;
+}
+
+/**
+ * Применение накопленных одиночных команд: одна публикация на серию
+ */
+static void ApplyPending(ActuatorPending &pending) {
+    if (pending.count == 0) {
+        return;
+    }
+    ActuatorState next;
+    ActuatorsGetState(next);
+    for (uint8_t i = 0; i < pending.count; i++) {
+        const ActuatorCommand &command = pending.command[pending.order[i]];
+        Apply(command.id, command.value, next);
+    }
+    Publish(next, pending.count, pending.command[pending.order[pending.count - 1]].enqueuedAt);
+    pending.count = 0;
+}
+
+/**
+ * Применение пакета из batchSlot с проверкой версии
+ * @param command Команда пакета из очереди
+ */
+static void ApplyBatch(const ActuatorCommand &command) {
+    portENTER_CRITICAL(&actuatorLock);
+    bool current = command.value == batchSlot.sequence && !batchSlot.claimed;
+    batchSlot.claimed = batchSlot.claimed || current;
+    portEXIT_CRITICAL(&actuatorLock);
+    if (!current) {
+        return; // Пакет отменен по истечении ожидания
+    }
+    ActuatorState next;
+    ActuatorsGetState(next);
+    if (batchSlot.expectedVersion >= 0 && batchSlot.expectedVersion != next.version) {
+        batchSlot.result = ACTUATOR_BATCH_CONFLICT;
+    } else {
+        uint32_t applied = 0;
+        for (int i = 0; i < ACTUATOR_COUNT; i++) {
+            if (batchSlot.batch.set[i]) {
+                Apply(i, batchSlot.batch.value[i], next);
+                applied++;
+            }
+        }
+        Publish(next, applied, command.enqueuedAt);
+        batchSlot.result = ACTUATOR_BATCH_APPLIED;
+    }
+    ActuatorsGetState(batchSlot.state);
+    xSemaphoreGive(batchDone);
+}
+
+/**
+ * Очередной шаг сервопривода к целевому углу
+ * @return true, если форточка еще движется
+ */
+static bool StepWindow() {
+    portENTER_CRITICAL(&actuatorLock);
+    int angle = state.windowAngle;
+    int target = state.windowTarget;
+    portEXIT_CRITICAL(&actuatorLock);
+    if (angle == target) {
+        return false;
+    }
+
+    angle = angle < target ? min(angle + ACTUATOR_SERVO_STEP, target) : max(angle - ACTUATOR_SERVO_STEP, target);
+    servoWindow.write(angle);
+
+    portENTER_CRITICAL(&actuatorLock);
+    state.windowAngle = angle;
+    portEXIT_CRITICAL(&actuatorLock);
+    return angle != target;
+}
+
+/**
+ * Задача устройств
+ * Забирает из очереди все накопившиеся команды, оставляет последнюю для каждого устройства
+ * и применяет их в порядке поступления; пакет применяется на своем месте в очереди,
+ * после команд, поставленных раньше.
+ * Пока форточка движется, задача просыпается для очередного шага
+ */
+static void ActuatorTask(void *) {
+    ActuatorPending pending;
+    pending.count = 0;
+    bool moving = false;
+
+    for (;;) {
+        ActuatorCommand command;
+        TickType_t wait = moving ? pdMS_TO_TICKS(ACTUATOR_SERVO_STEP_MS) : portMAX_DELAY;
+        if (xQueueReceive(commandQueue, &command, wait) == pdTRUE) {
+            uint32_t coalesced = 0;
+            do {
+                if (command.id == ACTUATOR_BATCH_ID) {
+                    ApplyPending(pending);
+                    ApplyBatch(command);
+                } else if (command.id < ACTUATOR_COUNT) {
+                    coalesced += AddPending(pending, command) ? 1 : 0;
+                }
+            } while (xQueueReceive(commandQueue, &command, 0) == pdTRUE);
+
+            portENTER_CRITICAL(&actuatorLock);
+            stats.coalesced += coalesced;
+            portEXIT_CRITICAL(&actuatorLock);
+
+            ApplyPending(pending);
+        }
+        moving = StepWindow();
+    }
+}
+
+void ActuatorsBegin(const ActuatorState &initial) {
+    state = initial;
+    state.windowTarget = constrain(initial.windowTarget, 0, ACTUATOR_WINDOW_OPEN_ANGLE);
+    state.windowAngle = state.windowTarget;
+    state.version = 0;
+
+    // Уровень записывается до перевода вывода в выход, чтобы реле не щелкнули при старте
+    digitalWrite(pumpPin, state.pump ? HIGH : LOW);
+    digitalWrite(windPin, state.wind ? HIGH : LOW);
+    digitalWrite(lightPin, state.light ? HIGH : LOW);
+    pinMode(pumpPin, OUTPUT);
+    pinMode(windPin, OUTPUT);
+    pinMode(lightPin, OUTPUT);
+
+    // Сервопривод форточки в начальном положении
+    servoWindow.attach(windowPin);
+    servoWindow.write(state.windowAngle);
+
+    commandQueue = xQueueCreate(ACTUATOR_QUEUE_LENGTH, sizeof(ActuatorCommand));
+    batchLock = xSemaphoreCreateMutex();
+    batchDone = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(ActuatorTask, "actuators", 3072, NULL, 2, NULL, ACTUATOR_TASK_CORE);
+}
+
+bool ActuatorSet(ActuatorId id, int32_t value) {
+    ActuatorCommand command = {(uint8_t)id, value, (uint32_t)esp_timer_get_time()};
+    bool queued = commandQueue != NULL && xQueueSend(commandQueue, &command, 0) == pdTRUE;
+    uint32_t depth = commandQueue != NULL ? uxQueueMessagesWaiting(commandQueue) : 0;
+
+    portENTER_CRITICAL(&actuatorLock);
+    if (queued) {
+        stats.enqueued++;
+    } else {
+        stats.dropped++;
+    }
+    if (depth > stats.maxDepth) {
+        stats.maxDepth = depth;
+    }
+    portEXIT_CRITICAL(&actuatorLock);
+    return queued;
+}
+
+ActuatorBatchResult ActuatorApplyBatch(const ActuatorBatch &batch, int64_t expectedVersion, ActuatorState &result) {
+    // Пакеты приходят из задачи веб-сервера: занятый слот не ждем
+    if (batchLock == NULL || xSemaphoreTake(batchLock, 0) != pdTRUE) {
+        ActuatorsGetState(result);
+        return ACTUATOR_BATCH_BUSY;
+    }
+
+    portENTER_CRITICAL(&actuatorLock);
+    batchSlot.sequence++;
+    batchSlot.claimed = false;
+    portEXIT_CRITICAL(&actuatorLock);
+    batchSlot.batch = batch;
+    batchSlot.expectedVersion = expectedVersion;
+
+    ActuatorCommand command = {ACTUATOR_BATCH_ID, batchSlot.sequence, (uint32_t)esp_timer_get_time()};
+    bool done = xQueueSend(commandQueue, &command, 0) == pdTRUE &&
+                xSemaphoreTake(batchDone, pdMS_TO_TICKS(ACTUATOR_BATCH_TIMEOUT_MS)) == pdTRUE;
+    if (!done) {
+        // Отмена до ответа: пакет, еще не забранный задачей, уже не применится никогда.
+        // Забранный пакет применяется без ожиданий, его результат приходит сразу
+        portENTER_CRITICAL(&actuatorLock);
+        bool claimed = batchSlot.claimed;
+        batchSlot.sequence++;
+        portEXIT_CRITICAL(&actuatorLock);
+        done = claimed && xSemaphoreTake(batchDone, portMAX_DELAY) == pdTRUE;
+    }
+
+    ActuatorBatchResult outcome = ACTUATOR_BATCH_BUSY;
+    if (done) {
+        outcome = batchSlot.result;
+        result = batchSlot.state;
+    } else {
+        ActuatorsGetState(result);
+    }
+
+    portENTER_CRITICAL(&actuatorLock);
+    if (outcome == ACTUATOR_BATCH_BUSY) {
+        stats.dropped++;
+    } else {
+        stats.enqueued++;
+    }
+    portEXIT_CRITICAL(&actuatorLock);
+
+    xSemaphoreGive(batchLock);
+    return outcome;
+}
+
+void ActuatorsGetState(ActuatorState &out) {
+    portENTER_CRITICAL(&actuatorLock);
+    out = state;
+    portEXIT_CRITICAL(&actuatorLock);
+}
+
+void ActuatorsGetStats(ActuatorStats &out) {
+    portENTER_CRITICAL(&actuatorLock);
+    out = stats;
+    portEXIT_CRITICAL(&actuatorLock);
+}
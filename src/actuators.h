@@ -0,0 +1,122 @@
+#ifndef ACTUATORS_H
+#define ACTUATORS_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+// Параметры подсистемы устройств (можно переопределить через build_flags)
+#ifndef ACTUATOR_QUEUE_LENGTH
+#define ACTUATOR_QUEUE_LENGTH 32      // Команд в очереди
+#endif
+#ifndef ACTUATOR_SERVO_STEP
+#define ACTUATOR_SERVO_STEP 3         // Шаг движения сервопривода, градусы
+#endif
+#ifndef ACTUATOR_SERVO_STEP_MS
+#define ACTUATOR_SERVO_STEP_MS 20     // Пауза между шагами сервопривода, мс
+#endif
+#ifndef ACTUATOR_TASK_CORE
+#define ACTUATOR_TASK_CORE 1
+#endif
+#ifndef ACTUATOR_BATCH_TIMEOUT_MS
+#define ACTUATOR_BATCH_TIMEOUT_MS 50  // Ожидание применения пакета команд задачей веб-сервера, мс
+#endif
+
+// Угол полностью открытой форточки
+#define ACTUATOR_WINDOW_OPEN_ANGLE 90
+
+// Устройства и их параметры
+enum ActuatorId {
+    ACTUATOR_PUMP,        // Насос: 0/1
+    ACTUATOR_WIND,        // Вентилятор: 0/1
+    ACTUATOR_WINDOW,      // Форточка: угол, градусы
+    ACTUATOR_LIGHT,       // Освещение: 0/1
+    ACTUATOR_BRIGHTNESS,  // Яркость RGB-ленты, %
+    ACTUATOR_COLOR,       // Цвет RGB-ленты, 0xRRGGBB
+    ACTUATOR_COUNT
+};
+
+/**
+ * Согласованный снимок состояния устройств
+ */
+struct ActuatorState {
+    bool pump;            // Насос включен
+    bool wind;            // Вентилятор включен
+    uint8_t windowAngle;  // Текущий угол форточки (во время движения отличается от цели)
+    uint8_t windowTarget; // Целевой угол форточки
+    bool light;           // Освещение включено
+    uint8_t brightness;   // Яркость RGB-ленты, %
+    CRGB color;           // Цвет RGB-ленты
+    uint32_t version;     // Номер изменения заданного состояния (движение форточки его не меняет)
+};
+
+/**
+ * Пакет команд, применяемый целиком
+ */
+struct ActuatorBatch {
+    bool set[ACTUATOR_COUNT];      // Устройство входит в пакет
+    int32_t value[ACTUATOR_COUNT]; // Значения в единицах ActuatorSet
+};
+
+// Результат применения пакета
+enum ActuatorBatchResult {
+    ACTUATOR_BATCH_APPLIED,   // Пакет применен
+    ACTUATOR_BATCH_CONFLICT,  // Версия состояния не совпала, ничего не изменено
+    ACTUATOR_BATCH_BUSY       // Очередь заполнена или задача не ответила вовремя: пакет отменен, ничего не изменено
+};
+
+/**
+ * Счетчики очереди команд
+ */
+struct ActuatorStats {
+    uint32_t enqueued;      // Принятых команд
+    uint32_t dropped;       // Отброшенных команд (очередь заполнена)
+    uint32_t coalesced;     // Команд, замененных более новой командой тому же устройству
+    uint32_t applied;       // Примененных команд
+    uint32_t maxDepth;      // Наибольшая длина очереди
+    uint32_t lastLatencyUs; // Задержка от постановки в очередь до применения последней команды, мкс
+    uint32_t maxLatencyUs;  // Наибольшая задержка, мкс
+};
+
+/**
+ * Настройка выводов и сервопривода, запуск задачи устройств
+ * Выводы сразу получают начальные уровни, сервопривод - начальный угол,
+ * поэтому после перезапуска устройства не переключаются
+ * @param initial Начальное состояние (поля pump, wind, windowTarget, light, brightness, color)
+ */
+void ActuatorsBegin(const ActuatorState &initial);
+
+/**
+ * Постановка команды в очередь; обработчик возвращается сразу, команда применяется задачей устройств
+ * Из серии команд одному устройству, накопившихся в очереди, применяется только последняя;
+ * команды разных устройств применяются в порядке поступления
+ * @param id Устройство
+ * @param value Значение
+ * @return false, если очередь заполнена
+ */
+bool ActuatorSet(ActuatorId id, int32_t value);
+
+/**
+ * Атомарное применение пакета команд с ожиданием результата
+ * Все устройства пакета применяются подряд задачей устройств в порядке ActuatorId (яркость
+ * пакета - после включения освещения), версия состояния увеличивается один раз:
+ * клиенты не увидят частично примененный пакет
+ * Ожидание не дольше ACTUATOR_BATCH_TIMEOUT_MS; по его истечении пакет отменяется до возврата,
+ * поэтому ACTUATOR_BATCH_BUSY означает, что пакет не применен и не будет применен позже
+ * @param batch Пакет команд
+ * @param expectedVersion Ожидаемая версия состояния (условное изменение), -1 - без проверки
+ * @param result Состояние после применения (или текущее при конфликте)
+ * @return Результат применения
+ */
+ActuatorBatchResult ActuatorApplyBatch(const ActuatorBatch &batch, int64_t expectedVersion, ActuatorState &result);
+
+/**
+ * Получение снимка состояния устройств
+ */
+void ActuatorsGetState(ActuatorState &state);
+
+/**
+ * Получение счетчиков очереди
+ */
+void ActuatorsGetStats(ActuatorStats &stats);
+
+#endif
@@ -0,0 +1,200 @@
+/**
+ * Драйвер BME280: принудительный режим, пакетное чтение, целочисленная компенсация
+ * Формулы компенсации - из документации производителя (BST-BME280-DS002)
+ */
+#include "bme280.h"
+#include <Wire.h>
+
+// Регистры
+#define BME280_REG_CALIB_TP 0x88  // dig_T1..dig_P9, 24 байта (+ dig_H1 в 0xA1)
+#define BME280_REG_CALIB_H1 0xA1
+#define BME280_REG_CHIP_ID  0xD0
+#define BME280_REG_CALIB_H  0xE1  // dig_H2..dig_H6, 7 байт
+#define BME280_REG_CTRL_HUM 0xF2
+#define BME280_REG_CTRL     0xF4
+#define BME280_REG_CONFIG   0xF5
+#define BME280_REG_DATA     0xF7  // press[3], temp[3], hum[2]
+
+#define BME280_CHIP_ID 0x60
+#define BME280_MODE_FORCED 0x01
+
+/**
+ * Калибровочные коэффициенты из памяти датчика
+ */
+struct Bme280Calibration {
+    uint16_t t1;
+    int16_t t2, t3;
+    uint16_t p1;
+    int16_t p2, p3, p4, p5, p6, p7, p8, p9;
+    uint8_t h1;
+    int16_t h2;
+    uint8_t h3;
+    int16_t h4, h5;
+    int8_t h6;
+};
+
+static uint8_t bmeAddress = 0x77;
+static Bme280Calibration calibration;
+static Bme280Settings current;
+
+static const Bme280Settings profiles[BME280_PROFILE_COUNT] = {
+    {BME280_X1, BME280_X1, BME280_X1, BME280_FILTER_OFF},
+    {BME280_X1, BME280_SKIP, BME280_X1, BME280_FILTER_OFF},
+    {BME280_X2, BME280_X16, BME280_X1, BME280_FILTER_16},
+};
+static const char* const profileNames[BME280_PROFILE_COUNT] = {"weather", "humidity", "indoor"};
+
+/**
+ * Запись одного регистра
+ */
+static bool WriteRegister(uint8_t reg, uint8_t value) {
+    Wire.beginTransmission(bmeAddress);
+    Wire.write(reg);
+    Wire.write(value);
+    return Wire.endTransmission() == 0;
+}
+
+/**
+ * Чтение нескольких подряд идущих регистров одной транзакцией
+ */
+static bool ReadRegisters(uint8_t reg, uint8_t *data, uint8_t length) {
+    Wire.beginTransmission(bmeAddress);
+    Wire.write(reg);
+    if (Wire.endTransmission(false) != 0) {
+        return false;
+    }
+    if (Wire.requestFrom(bmeAddress, length) != length) {
+        return false;
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        data[i] = Wire.read();
+    }
+    return true;
+}
+
+Bme280Settings Bme280ProfileSettings(Bme280Profile profile) {
+    return profiles[profile];
+}
+
+bool Bme280ProfileFromName(const String &name, Bme280Profile &profile) {
+    for (int p = 0; p < BME280_PROFILE_COUNT; p++) {
+        if (name == profileNames[p]) {
+            profile = (Bme280Profile)p;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *Bme280ProfileName(Bme280Profile profile) {
+    return profileNames[profile];
+}
+
+bool Bme280Begin(uint8_t address, const Bme280Settings &settings) {
+    bmeAddress = address;
+    uint8_t id;
+    if (!ReadRegisters(BME280_REG_CHIP_ID, &id, 1) || id != BME280_CHIP_ID) {
+        return false;
+    }
+
+    uint8_t tp[24], h1, h[7];
+    if (!ReadRegisters(BME280_REG_CALIB_TP, tp, sizeof(tp)) ||
+        !ReadRegisters(BME280_REG_CALIB_H1, &h1, 1) ||
+        !ReadRegisters(BME280_REG_CALIB_H, h, sizeof(h))) {
+        return false;
+    }
+    // Коэффициенты хранятся младшим байтом вперед
+    calibration.t1 = tp[0] | (tp[1] << 8);
+    calibration.t2 = (int16_t)(tp[2] | (tp[3] << 8));
+    calibration.t3 = (int16_t)(tp[4] | (tp[5] << 8));
+    calibration.p1 = tp[6] | (tp[7] << 8);
+    int16_t *p = &calibration.p2;
+    for (int i = 0; i < 8; i++) {
+        p[i] = (int16_t)(tp[8 + i * 2] | (tp[9 + i * 2] << 8));
+    }
+    calibration.h1 = h1;
+    calibration.h2 = (int16_t)(h[0] | (h[1] << 8));
+    calibration.h3 = h[2];
+    calibration.h4 = (int16_t)(((int8_t)h[3] << 4) | (h[4] & 0x0F));
+    calibration.h5 = (int16_t)(((int8_t)h[5] << 4) | (h[4] >> 4));
+    calibration.h6 = (int8_t)h[6];
+
+    return Bme280Configure(settings);
+}
+
+bool Bme280Configure(const Bme280Settings &settings) {
+    current = settings;
+    // ctrl_hum вступает в силу только после записи ctrl_meas
+    return WriteRegister(BME280_REG_CONFIG, settings.filter << 2) &&
+           WriteRegister(BME280_REG_CTRL_HUM, settings.humidity);
+}
+
+/**
+ * Множитель передискретизации (0 - величина не измеряется)
+ */
+static uint32_t OversamplingFactor(uint8_t oversampling) {
+    return oversampling == BME280_SKIP ? 0 : 1UL << (oversampling - 1);
+}
+
+uint32_t Bme280StartMeasurement() {
+    uint8_t ctrl = (current.temperature << 5) | (current.pressure << 2) | BME280_MODE_FORCED;
+    if (!WriteRegister(BME280_REG_CTRL, ctrl)) {
+        return 0;
+    }
+    // Наибольшее время измерения по документации, мкс
+    uint32_t t = OversamplingFactor(current.temperature);
+    uint32_t p = OversamplingFactor(current.pressure);
+    uint32_t h = OversamplingFactor(current.humidity);
+    return 1250 + 2300 * t + (p ? 2300 * p + 575 : 0) + (h ? 2300 * h + 575 : 0);
+}
+
+bool Bme280ReadMeasurement(Bme280Reading &reading) {
+    uint8_t data[8];
+    if (!ReadRegisters(BME280_REG_DATA, data, sizeof(data))) {
+        return false;
+    }
+    int32_t adcP = ((uint32_t)data[0] << 12) | ((uint32_t)data[1] << 4) | (data[2] >> 4);
+    int32_t adcT = ((uint32_t)data[3] << 12) | ((uint32_t)data[4] << 4) | (data[5] >> 4);
+    int32_t adcH = ((uint32_t)data[6] << 8) | data[7];
+    if (adcT == 0x80000) {
+        return false; // Температура не измерена: без нее нет компенсации остальных величин
+    }
+
+    // Температура, заодно t_fine для давления и влажности
+    const Bme280Calibration &c = calibration;
+    int32_t var1 = ((((adcT >> 3) - ((int32_t)c.t1 << 1))) * c.t2) >> 11;
+    int32_t var2 = (((((adcT >> 4) - c.t1) * ((adcT >> 4) - c.t1)) >> 12) * c.t3) >> 14;
+    int32_t tFine = var1 + var2;
+    reading.temperature = ((tFine * 5 + 128) >> 8) / 100.0f;
+
+    // Давление, 64-битная формула
+    reading.pressure = NAN;
+    if (adcP != 0x80000) {
+        int64_t p1 = (int64_t)tFine - 128000;
+        int64_t p2 = p1 * p1 * c.p6;
+        p2 = p2 + ((p1 * c.p5) << 17);
+        p2 = p2 + ((int64_t)c.p4 << 35);
+        p1 = ((p1 * p1 * c.p3) >> 8) + ((p1 * c.p2) << 12);
+        p1 = ((((int64_t)1) << 47) + p1) * c.p1 >> 33;
+        if (p1 != 0) {
+            int64_t pressure = 1048576 - adcP;
+            pressure = (((pressure << 31) - p2) * 3125) / p1;
+            p1 = ((int64_t)c.p9 * (pressure >> 13) * (pressure >> 13)) >> 25;
+            p2 = ((int64_t)c.p8 * pressure) >> 19;
+            pressure = ((pressure + p1 + p2) >> 8) + ((int64_t)c.p7 << 4);
+            reading.pressure = (uint32_t)pressure / 25600.0f; // Q24.8 Па -> гПа
+        }
+    }
+
+    // Влажность
+    reading.humidity = NAN;
+    if (adcH != 0x8000) {
+        int32_t h = tFine - 76800;
+        h = (((((adcH << 14) - ((int32_t)c.h4 << 20) - (c.h5 * h)) + 16384) >> 15) *
+             (((((((h * c.h6) >> 10) * (((h * (int32_t)c.h3) >> 11) + 32768)) >> 10) + 2097152) * c.h2 + 8192) >> 14));
+        h = h - (((((h >> 15) * (h >> 15)) >> 7) * c.h1) >> 4);
+        h = h < 0 ? 0 : (h > 419430400 ? 419430400 : h);
+        reading.humidity = (h >> 12) / 1024.0f; // Q22.10 %
+    }
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef BME280_H
+#define BME280_H
+
+#include <Arduino.h>
+
+/**
+ * Драйвер BME280 в принудительном режиме (forced mode)
+ * Все регистры данных читаются одной транзакцией I2C, компенсация
+ * температуры, давления и влажности выполняется за один проход
+ */
+
+// Коэффициент передискретизации (значения регистров osrs_x)
+enum Bme280Oversampling {
+    BME280_SKIP,  // Величина не измеряется
+    BME280_X1,
+    BME280_X2,
+    BME280_X4,
+    BME280_X8,
+    BME280_X16
+};
+
+// Коэффициент IIR-фильтра (значения поля filter регистра config)
+enum Bme280Filter {
+    BME280_FILTER_OFF,
+    BME280_FILTER_2,
+    BME280_FILTER_4,
+    BME280_FILTER_8,
+    BME280_FILTER_16
+};
+
+// Готовые наборы настроек (рекомендации производителя)
+enum Bme280Profile {
+    BME280_PROFILE_WEATHER,   // Метеостанция: x1/x1/x1, без фильтра - наименьшее время и ток
+    BME280_PROFILE_HUMIDITY,  // Влажность: давление не измеряется
+    BME280_PROFILE_INDOOR,    // Помещение: давление x16, температура x2, фильтр 16 - наименьший шум
+    BME280_PROFILE_COUNT
+};
+
+/**
+ * Настройки измерения
+ */
+struct Bme280Settings {
+    uint8_t temperature;  // Bme280Oversampling
+    uint8_t pressure;     // Bme280Oversampling
+    uint8_t humidity;     // Bme280Oversampling
+    uint8_t filter;       // Bme280Filter
+};
+
+/**
+ * Результат измерения; неизмеряемые величины - NAN
+ */
+struct Bme280Reading {
+    float temperature;  // °C
+    float humidity;     // %
+    float pressure;     // гПа
+};
+
+/**
+ * Настройки готового профиля
+ */
+Bme280Settings Bme280ProfileSettings(Bme280Profile profile);
+
+/**
+ * Поиск профиля по имени ("weather", "humidity", "indoor")
+ * @return true, если имя известно
+ */
+bool Bme280ProfileFromName(const String &name, Bme280Profile &profile);
+
+/**
+ * Имя профиля
+ */
+const char *Bme280ProfileName(Bme280Profile profile);
+
+/**
+ * Проверка датчика, чтение калибровочных коэффициентов и настройка
+ * @param address Адрес I2C (0x76 или 0x77)
+ * @param settings Настройки измерения
+ * @return true, если датчик найден
+ */
+bool Bme280Begin(uint8_t address, const Bme280Settings &settings);
+
+/**
+ * Изменение настроек без повторного чтения калибровки
+ * @return true, если настройки записаны
+ */
+bool Bme280Configure(const Bme280Settings &settings);
+
+/**
+ * Запуск одного измерения
+ * @return Наибольшее время измерения при текущих настройках, мкс (0 - ошибка шины)
+ */
+uint32_t Bme280StartMeasurement();
+
+/**
+ * Чтение результата измерения одной транзакцией и компенсация
+ * @param reading Результат
+ * @return true, если данные прочитаны
+ */
+bool Bme280ReadMeasurement(Bme280Reading &reading);
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * Регулятор климата: реле с гистерезисом и минимальными временами включения/выключения,
+ * форточка с пропорциональным открытием по температуре
+ */
+#include "climate.h"
+#include <math.h>
+
+// Шаг угла форточки, градусы: мелкие колебания температуры не двигают сервопривод
+#define CLIMATE_WINDOW_STEP 10
+
+ClimateSettings ClimateDefaultSettings() {
+    ClimateSettings settings;
+    settings.enabled = true;
+    settings.fanTemperature = 30.0f;
+    settings.fanHumidity = 85.0f;
+    settings.ventTemperature = 25.0f;
+    settings.ventFullTemperature = 30.0f;
+    settings.pumpHumidity = 40.0f;
+    settings.hysteresis = 1.0f;
+    settings.minOnMs = 60000;
+    settings.minOffMs = 60000;
+    settings.windowMoveMs = 30000;
+    settings.manualTimeoutMs = 30UL * 60 * 1000;
+    settings.maxPumpOnMs = 10UL * 60 * 1000;
+    return settings;
+}
+
+void ClimateInit(ClimateState &state, bool fan, bool pump, uint8_t windowAngle, uint32_t nowMs) {
+    state.fan = {fan, nowMs};
+    state.pump = {pump, nowMs};
+    state.windowAngle = windowAngle;
+    state.windowMovedAt = nowMs;
+    for (int i = 0; i < CLIMATE_ACTUATOR_COUNT; i++) {
+        state.manual[i] = false;
+        state.manualUntil[i] = 0;
+        state.held[i] = false;
+    }
+    state.pumpStartHumidity = NAN;
+    ClimateResetPumpFault(state);
+}
+
+void ClimateResetPumpFault(ClimateState &state) {
+    state.pumpDryCutoffs = 0;
+    state.pumpFault = false;
+}
+
+void ClimateManualOverride(ClimateState &state, const ClimateSettings &settings,
+                           ClimateActuator actuator, uint8_t value, uint32_t nowMs) {
+    state.manual[actuator] = true;
+    state.manualUntil[actuator] = nowMs + settings.manualTimeoutMs;
+
+    // Регулятор продолжит с состояния, установленного пользователем
+    switch (actuator) {
+        case CLIMATE_FAN:
+            state.fan = {value != 0, nowMs};
+            break;
+        case CLIMATE_PUMP:
+            state.pump = {value != 0, nowMs};
+            state.pumpStartHumidity = NAN;
+            ClimateResetPumpFault(state);
+            break;
+        case CLIMATE_WINDOW:
+            state.windowAngle = value;
+            state.windowMovedAt = nowMs;
+            break;
+        default:
+            break;
+    }
+}
+
+void ClimateHold(ClimateState &state, ClimateActuator actuator, bool held, uint8_t value, uint32_t nowMs) {
+    state.held[actuator] = held;
+
+    // Время переключения обновляется только при изменении: минимальные времена реле сохраняются
+    switch (actuator) {
+        case CLIMATE_FAN:
+            if (state.fan.on != (value != 0)) {
+                state.fan = {value != 0, nowMs};
+            }
+            break;
+        case CLIMATE_PUMP:
+            if (state.pump.on != (value != 0)) {
+                state.pump = {value != 0, nowMs};
+                state.pumpStartHumidity = NAN;
+            }
+            break;
+        case CLIMATE_WINDOW:
+            if (state.windowAngle != value) {
+                state.windowAngle = value;
+                state.windowMovedAt = nowMs;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Переключение реле с учетом минимальных времен
+ * @return true, если состояние реле изменилось
+ */
+static bool UpdateRelay(ClimateRelay &relay, bool wanted, const ClimateSettings &settings, uint32_t nowMs) {
+    if (wanted == relay.on) {
+        return false;
+    }
+    uint32_t minTime = relay.on ? settings.minOnMs : settings.minOffMs;
+    if (nowMs - relay.changedAt < minTime) {
+        return false;
+    }
+    relay.on = wanted;
+    relay.changedAt = nowMs;
+    return true;
+}
+
+/**
+ * Гистерезис: включение выше порога, выключение ниже порога минус гистерезис
+ */
+static bool AboveWithHysteresis(bool on, float value, float threshold, float hysteresis) {
+    return on ? value > threshold - hysteresis : value > threshold;
+}
+
+/**
+ * Проверка и завершение ручного режима устройства
+ * @return true, если устройство все еще в ручном режиме
+ */
+static bool IsManual(ClimateState &state, ClimateActuator actuator, uint32_t nowMs) {
+    if (state.manual[actuator] && (int32_t)(state.manualUntil[actuator] - nowMs) <= 0) {
+        state.manual[actuator] = false;
+    }
+    return state.manual[actuator];
+}
+
+ClimateCommand ClimateTick(ClimateState &state, const ClimateSettings &settings,
+                           float temperature, float humidity, bool valid, uint32_t nowMs) {
+    ClimateCommand command = {};
+    // Устройства в ручном режиме и под управлением правил регулятор пропускает
+    bool manualFan = IsManual(state, CLIMATE_FAN, nowMs) || state.held[CLIMATE_FAN];
+    bool manualWindow = IsManual(state, CLIMATE_WINDOW, nowMs) || state.held[CLIMATE_WINDOW];
+    bool manualPump = IsManual(state, CLIMATE_PUMP, nowMs) || state.held[CLIMATE_PUMP];
+
+    bool readings = valid && !isnan(temperature) && !isnan(humidity);
+    if (settings.enabled && !readings) {
+        // Без показаний вентилятор и насос выключаются (с учетом минимальных времен), форточка остается
+        if (!manualFan) {
+            command.changed[CLIMATE_FAN] = UpdateRelay(state.fan, false, settings, nowMs);
+        }
+        if (!manualPump) {
+            command.changed[CLIMATE_PUMP] = UpdateRelay(state.pump, false, settings, nowMs);
+        }
+    } else if (settings.enabled) {
+        // Вентилятор: перегрев или избыточная влажность
+        if (!manualFan) {
+            bool wanted = AboveWithHysteresis(state.fan.on, temperature, settings.fanTemperature, settings.hysteresis) ||
+                          AboveWithHysteresis(state.fan.on, humidity, settings.fanHumidity, settings.hysteresis);
+            command.changed[CLIMATE_FAN] = UpdateRelay(state.fan, wanted, settings, nowMs);
+        }
+
+        // Насос: недостаточная влажность (включение ниже порога, выключение выше порога плюс гистерезис)
+        // Непрерывная работа ограничена maxPumpOnMs: если влажность не растет (пустой бак, обрыв шланга),
+        // насос выключается и включится снова не раньше чем через minOffMs. После
+        // CLIMATE_PUMP_FAULT_CUTOFFS таких выключений подряд насос блокируется до сброса пользователем
+        if (!manualPump) {
+            bool wanted = state.pump.on ? humidity < settings.pumpHumidity + settings.hysteresis
+                                        : humidity < settings.pumpHumidity;
+            bool cutoff = state.pump.on && settings.maxPumpOnMs > 0 &&
+                          nowMs - state.pump.changedAt >= settings.maxPumpOnMs;
+            if (cutoff || state.pumpFault) {
+                wanted = false;
+            }
+            command.changed[CLIMATE_PUMP] = UpdateRelay(state.pump, wanted, settings, nowMs);
+            if (command.changed[CLIMATE_PUMP] && state.pump.on) {
+                state.pumpStartHumidity = humidity;
+            } else if (command.changed[CLIMATE_PUMP]) {
+                bool dry = cutoff && humidity - state.pumpStartHumidity < CLIMATE_PUMP_MIN_RISE;
+                state.pumpDryCutoffs = dry ? state.pumpDryCutoffs + 1 : 0;
+                if (state.pumpDryCutoffs >= CLIMATE_PUMP_FAULT_CUTOFFS) {
+                    state.pumpFault = true;
+                }
+            }
+        }
+
+        // Форточка: угол пропорционален превышению температуры, с шагом и паузой между движениями
+        if (!manualWindow && nowMs - state.windowMovedAt >= settings.windowMoveMs) {
+            float span = settings.ventFullTemperature - settings.ventTemperature;
+            float ratio = span > 0 ? (temperature - settings.ventTemperature) / span
+                                   : (temperature >= settings.ventTemperature ? 1.0f : 0.0f);
+            ratio = ratio < 0 ? 0 : (ratio > 1 ? 1 : ratio);
+            int angle = (int)lroundf(ratio * CLIMATE_WINDOW_OPEN_ANGLE / CLIMATE_WINDOW_STEP) * CLIMATE_WINDOW_STEP;
+            if (angle != state.windowAngle) {
+                state.windowAngle = angle;
+                state.windowMovedAt = nowMs;
+                command.changed[CLIMATE_WINDOW] = true;
+            }
+        }
+    }
+
+    command.fan = state.fan.on;
+    command.pump = state.pump.on;
+    command.windowAngle = state.windowAngle;
+    return command;
+}
+
+uint32_t ClimateManualRemaining(const ClimateState &state, ClimateActuator actuator, uint32_t nowMs) {
+    if (!state.manual[actuator]) {
+        return 0;
+    }
+    int32_t remaining = (int32_t)(state.manualUntil[actuator] - nowMs);
+    return remaining > 0 ? remaining : 0;
+}
@@ -0,0 +1,156 @@
+#ifndef CLIMATE_H
+#define CLIMATE_H
+
+#include <stdint.h>
+
+/**
+ * Автоматическое управление климатом: вентилятор, форточка, насос
+ * Модуль не зависит от оборудования: на вход - показания и время,
+ * на выход - желаемые состояния устройств
+ */
+
+// Период такта регулятора, мс
+#ifndef CLIMATE_TICK_MS
+#define CLIMATE_TICK_MS 1000
+#endif
+
+// Выключений насоса по maxPumpOnMs подряд без роста влажности до блокировки насоса
+#ifndef CLIMATE_PUMP_FAULT_CUTOFFS
+#define CLIMATE_PUMP_FAULT_CUTOFFS 3
+#endif
+
+// Рост влажности за включение насоса, при котором выключение по maxPumpOnMs не считается сухим, %
+#ifndef CLIMATE_PUMP_MIN_RISE
+#define CLIMATE_PUMP_MIN_RISE 1.0f
+#endif
+
+// Устройства под управлением регулятора
+enum ClimateActuator {
+    CLIMATE_FAN,
+    CLIMATE_WINDOW,
+    CLIMATE_PUMP,
+    CLIMATE_ACTUATOR_COUNT
+};
+
+/**
+ * Уставки регулятора (изменяются во время работы)
+ */
+struct ClimateSettings {
+    bool enabled;               // Автоматический режим включен
+    float fanTemperature;       // Вентилятор включается выше этой температуры, °C
+    float fanHumidity;          // ... или выше этой влажности, %
+    float ventTemperature;      // Форточка начинает открываться, °C
+    float ventFullTemperature;  // Форточка открыта полностью, °C
+    float pumpHumidity;         // Насос включается ниже этой влажности, %
+    float hysteresis;           // Гистерезис для реле, °C и %
+    uint32_t minOnMs;           // Минимальное время включенного состояния реле
+    uint32_t minOffMs;          // Минимальное время выключенного состояния реле
+    uint32_t windowMoveMs;      // Минимальный интервал между движениями форточки
+    uint32_t manualTimeoutMs;   // Длительность ручного режима после команды пользователя
+    uint32_t maxPumpOnMs;       // Насос выключается, если работает дольше (0 - без ограничения)
+};
+
+/**
+ * Состояние реле с временем последнего переключения
+ */
+struct ClimateRelay {
+    bool on;
+    uint32_t changedAt;
+};
+
+/**
+ * Внутреннее состояние регулятора
+ */
+struct ClimateState {
+    ClimateRelay fan;
+    ClimateRelay pump;
+    uint8_t windowAngle;                          // Угол форточки, градусы
+    uint32_t windowMovedAt;                       // Время последнего движения форточки
+    uint32_t manualUntil[CLIMATE_ACTUATOR_COUNT]; // Конец ручного режима по устройствам
+    bool manual[CLIMATE_ACTUATOR_COUNT];          // Устройство в ручном режиме
+    bool held[CLIMATE_ACTUATOR_COUNT];            // Устройство удерживается правилом автоматизации
+    float pumpStartHumidity;                      // Влажность при включении насоса регулятором (NAN - неизвестна)
+    uint8_t pumpDryCutoffs;                       // Выключений по maxPumpOnMs подряд без роста влажности
+    bool pumpFault;                               // Насос заблокирован (пустой бак, обрыв шланга)
+};
+
+/**
+ * Команда регулятора за один такт
+ * Применять нужно только устройства, отмеченные в changed
+ */
+struct ClimateCommand {
+    bool fan;
+    bool pump;
+    uint8_t windowAngle;
+    bool changed[CLIMATE_ACTUATOR_COUNT];
+};
+
+// Угол полностью открытой форточки
+#define CLIMATE_WINDOW_OPEN_ANGLE 90
+
+/**
+ * Уставки по умолчанию
+ */
+ClimateSettings ClimateDefaultSettings();
+
+/**
+ * Начальное состояние регулятора
+ * @param state Состояние
+ * @param fan Текущее состояние вентилятора
+ * @param pump Текущее состояние насоса
+ * @param windowAngle Текущий угол форточки
+ * @param nowMs Текущее время, мс
+ */
+void ClimateInit(ClimateState &state, bool fan, bool pump, uint8_t windowAngle, uint32_t nowMs);
+
+/**
+ * Команда пользователя: устройство переходит в ручной режим на manualTimeoutMs
+ * @param state Состояние
+ * @param settings Уставки
+ * @param actuator Устройство
+ * @param value Установленное значение (для форточки - угол, для реле - 0/1)
+ * @param nowMs Текущее время, мс
+ */
+void ClimateManualOverride(ClimateState &state, const ClimateSettings &settings,
+                           ClimateActuator actuator, uint8_t value, uint32_t nowMs);
+
+/**
+ * Сброс блокировки насоса пользователем (бак наполнен, шланг исправлен)
+ * Блокировка ставится после CLIMATE_PUMP_FAULT_CUTOFFS выключений по maxPumpOnMs подряд,
+ * за которые влажность не выросла на CLIMATE_PUMP_MIN_RISE; пока она стоит, регулятор
+ * не включает насос. Команда насосу пользователя (ClimateManualOverride) тоже ее сбрасывает
+ * @param state Состояние
+ */
+void ClimateResetPumpFault(ClimateState &state);
+
+/**
+ * Передача устройства под управление правила автоматизации и возврат регулятору
+ * Пока устройство удерживается, регулятор его не переключает, но учитывает установленное значение
+ * @param state Состояние
+ * @param actuator Устройство
+ * @param held true - устройство удерживается правилом
+ * @param value Текущее значение устройства (для форточки - угол, для реле - 0/1)
+ * @param nowMs Текущее время, мс
+ */
+void ClimateHold(ClimateState &state, ClimateActuator actuator, bool held, uint8_t value, uint32_t nowMs);
+
+/**
+ * Такт регулятора
+ * @param state Состояние
+ * @param settings Уставки
+ * @param temperature Температура, °C
+ * @param humidity Влажность, %
+ * @param valid Показания достоверны (иначе вентилятор и насос выключаются, форточка сохраняет угол)
+ * @param nowMs Текущее время, мс
+ * @return Команда устройствам
+ */
+ClimateCommand ClimateTick(ClimateState &state, const ClimateSettings &settings,
+                           float temperature, float humidity, bool valid, uint32_t nowMs);
+
+/**
+ * Оставшееся время ручного режима
+ * @return Миллисекунды (0 - устройство в автоматическом режиме)
+ */
+uint32_t ClimateManualRemaining(const ClimateState &state, ClimateActuator actuator, uint32_t nowMs);
+
+#endif
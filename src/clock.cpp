@@ -0,0 +1,47 @@
+/**
+ * Программные часы на основе 64-битного системного таймера
+ */
+#include "clock.h"
+#include <esp_timer.h>
+
+static uint32_t clockBase = 0;     // Время часов в момент включения
+static bool clockSynced = false;
+static int timezoneMinutes = 0;    // Смещение местного времени от UTC
+
+uint32_t ClockUptime() {
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+}
+
+void ClockBegin(uint32_t restoredTime) {
+    uint32_t uptime = ClockUptime();
+    clockBase = restoredTime > uptime ? restoredTime - uptime : 0;
+}
+
+uint32_t ClockNow() {
+    return clockBase + ClockUptime();
+}
+
+void ClockSync(uint32_t unixTime) {
+    clockBase = unixTime - ClockUptime();
+    clockSynced = true;
+}
+
+bool ClockSynced() {
+    return clockSynced;
+}
+
+void ClockSetTimezone(int offsetMinutes) {
+    timezoneMinutes = offsetMinutes;
+}
+
+int ClockTimezone() {
+    return timezoneMinutes;
+}
+
+int ClockMinuteOfDay() {
+    if (!clockSynced) {
+        return -1;
+    }
+    int32_t local = (int32_t)((ClockNow() / 60) % 1440) + timezoneMinutes;
+    return ((local % 1440) + 1440) % 1440;
+}
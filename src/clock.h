@@ -0,0 +1,58 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <Arduino.h>
+
+/**
+ * Программные часы устройства
+ * До синхронизации продолжают отсчет от последнего сохраненного времени,
+ * после синхронизации по HTTP показывают время Unix в секундах
+ */
+
+/**
+ * Установка начального времени при старте
+ * @param restoredTime Время, с которого продолжить отсчет (например, время последней записи журнала)
+ */
+void ClockBegin(uint32_t restoredTime);
+
+/**
+ * Текущее время часов
+ * @return Секунды
+ */
+uint32_t ClockNow();
+
+/**
+ * Время с момента включения без переполнения через 49 суток, как у millis()
+ * @return Секунды
+ */
+uint32_t ClockUptime();
+
+/**
+ * Синхронизация часов
+ * @param unixTime Время Unix, секунды
+ */
+void ClockSync(uint32_t unixTime);
+
+/**
+ * Часы синхронизированы с реальным временем
+ */
+bool ClockSynced();
+
+/**
+ * Установка часового пояса для расчета местного времени суток
+ * @param offsetMinutes Смещение от UTC, минуты
+ */
+void ClockSetTimezone(int offsetMinutes);
+
+/**
+ * Смещение часового пояса от UTC, минуты
+ */
+int ClockTimezone();
+
+/**
+ * Местное время суток
+ * @return Минуты от полуночи (0..1439) или -1, если часы не синхронизированы
+ */
+int ClockMinuteOfDay();
+
+#endif
@@ -0,0 +1,277 @@
+/**
+ * Регулятор досветки: накопление DLI по датчику освещенности, план досветки до конца
+ * светового дня и плавное изменение яркости ленты
+ */
+#include "dli.h"
+#include "led_gamma.h"
+#include <math.h>
+#include <string.h>
+
+// Длительность ячейки профиля естественного света, с
+#define DLI_SLOT_SECONDS (86400 / DLI_PROFILE_SLOTS)
+// Доля новых суток в профиле естественного света
+#define DLI_PROFILE_ALPHA 0.3f
+// Меньший ожидаемый по профилю свет с начала суток не используется для сравнения с фактом, моль/м²
+#define DLI_MIN_EXPECTED 0.1f
+
+/**
+ * Культура и ее целевой DLI
+ */
+struct DliCropInfo {
+    const char *name;
+    float target;  // моль/м² за сутки
+};
+
+// Середины типичных диапазонов DLI для выращивания
+static const DliCropInfo crops[DLI_CROP_COUNT] = {
+    {"custom", 0},
+    {"microgreens", 10},
+    {"lettuce", 14},
+    {"herbs", 16},
+    {"strawberry", 17},
+    {"cucumber", 20},
+    {"tomato", 25},
+};
+
+DliSettings DliDefaultSettings() {
+    DliSettings settings;
+    settings.enabled = false;
+    settings.crop = DLI_CROP_LETTUCE;
+    settings.target = crops[DLI_CROP_LETTUCE].target;
+    settings.startMinute = 6 * 60;
+    settings.endMinute = 22 * 60;
+    settings.luxToPpfd = 0.0185f;  // Солнечный свет
+    settings.ledPpfd = 50.0f;
+    settings.rampPerMinute = 10.0f;
+    settings.minBrightness = 5;
+    settings.maxBrightness = 100;
+    settings.forecast = 0.8f;
+    return settings;
+}
+
+float DliCropTarget(uint8_t crop) {
+    return crop < DLI_CROP_COUNT ? crops[crop].target : 0;
+}
+
+const char *DliCropName(uint8_t crop) {
+    return crop < DLI_CROP_COUNT ? crops[crop].name : "custom";
+}
+
+int DliCropFind(const char *name) {
+    for (int i = 0; i < DLI_CROP_COUNT; i++) {
+        if (strcmp(crops[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void DliInit(DliState &state, float gamma) {
+    memset(&state, 0, sizeof(state));
+    for (int i = 0; i < DLI_PROFILE_SLOTS; i++) {
+        state.profile[i] = -1;
+    }
+    state.slot = -1;
+    state.gamma = gamma;
+    LedGammaSetup(gamma);
+}
+
+void DliRestore(DliState &state, const DliSettings &settings, float luxSeconds) {
+    state.accumulated = luxSeconds > 0 ? luxSeconds * settings.luxToPpfd / 1e6f : 0;
+    state.ledAccumulated = 0; // Вклад ленты до перезапуска неизвестен
+}
+
+/**
+ * Доля света ленты при заданной яркости (яркость - воспринимаемая, свет - линейный)
+ * Считается так же, как значение ШИМ при выводе: яркость в процентах переводится в 0..255,
+ * как при установке ленты, и проходит ту же таблицу гамма-коррекции с округлением
+ */
+static float LedFraction(const DliState &state, uint8_t percent) {
+    return LedGammaLevel(255, (uint32_t)percent * 255 / 100) / 255.0f;
+}
+
+/**
+ * Яркость, при которой лента дает заданную долю света (обратная к LedFraction без округления)
+ */
+static float BrightnessFor(const DliState &state, float fraction) {
+    return fraction > 0 ? 100.0f * powf(fraction, 1.0f / state.gamma) : 0;
+}
+
+/**
+ * Завершение ячейки профиля: средний естественный свет часа входит в профиль,
+ * если час учтен хотя бы наполовину
+ */
+static void CloseSlot(DliState &state) {
+    if (state.slot >= 0 && state.slotSeconds >= DLI_SLOT_SECONDS / 2) {
+        float average = state.slotSum / state.slotSeconds;
+        float &profile = state.profile[state.slot];
+        profile = profile < 0 ? average : profile + DLI_PROFILE_ALPHA * (average - profile);
+    }
+    state.slotSum = 0;
+    state.slotSeconds = 0;
+}
+
+/**
+ * Естественный свет за интервал суток по профилю, мкмоль/м² (неизвестные часы - без света)
+ * @param current PPFD для часа, в котором начинается интервал (< 0 - по профилю)
+ */
+static float ProfileNatural(const DliState &state, int32_t from, int32_t to, float current) {
+    float total = 0;
+    int firstSlot = from / DLI_SLOT_SECONDS;
+    while (from < to) {
+        int slot = from / DLI_SLOT_SECONDS;
+        int32_t slotEnd = (slot + 1) * DLI_SLOT_SECONDS;
+        if (slotEnd > to) {
+            slotEnd = to;
+        }
+        float expected = slot == firstSlot && current >= 0 ? current : state.profile[slot];
+        total += (expected > 0 ? expected : 0) * (slotEnd - from);
+        from = slotEnd;
+    }
+    return total;
+}
+
+/**
+ * Яркость, которой не хватает до цели к концу дня (без ограничения скорости)
+ */
+static float Demand(DliState &state, const DliSettings &settings, int32_t secondOfDay) {
+    int32_t start = settings.startMinute * 60;
+    int32_t end = settings.endMinute * 60;
+    float deficit = settings.target - state.accumulated;
+    if (secondOfDay < start || secondOfDay >= end || deficit <= 0 || settings.ledPpfd <= 0) {
+        return 0;
+    }
+
+    // Ожидаемый свет до конца дня: текущий час - по текущему показанию, дальше - по профилю.
+    // Профилю доверяется не больше, чем подтвердилось сегодня: в пасмурный день прогноз
+    // уменьшается в отношении фактического естественного света к ожидаемому с начала суток
+    float trust = settings.forecast;
+    float expectedSoFar = ProfileNatural(state, 0, secondOfDay, -1) / 1e6f;
+    if (expectedSoFar > DLI_MIN_EXPECTED) {
+        float ratio = (state.accumulated - state.ledAccumulated) / expectedSoFar;
+        trust *= ratio < 1 ? ratio : 1;
+    }
+    state.forecastNatural = trust * ProfileNatural(state, secondOfDay, end, state.naturalPpfd) / 1e6f;
+
+    // Недостающий свет распределяется по оставшемуся времени равномерно: при линейной ленте
+    // расход энергии тот же, что при любом другом распределении, а яркость меняется меньше всего
+    float remaining = end - secondOfDay;
+    float needed = deficit - state.forecastNatural;
+    state.requiredPpfd = needed > 0 ? needed * 1e6f / remaining : 0;
+    // Если даже без естественного света лента на наибольшей яркости едва успевает - она включается полностью
+    float ledMax = settings.ledPpfd * LedFraction(state, settings.maxBrightness);
+    if (deficit * 1e6f / remaining >= ledMax) {
+        state.requiredPpfd = ledMax;
+        return settings.maxBrightness;
+    }
+    if (needed <= 0) {
+        return 0;
+    }
+    float fraction = state.requiredPpfd / settings.ledPpfd;
+    float demand = BrightnessFor(state, fraction < 1 ? fraction : 1);
+    if (demand > settings.maxBrightness) {
+        demand = settings.maxBrightness;
+    }
+    // Гистерезис у нижней границы: включенная лента не гаснет, пока нужна хотя бы половина минимума
+    bool on = state.output > 0;
+    if (demand < settings.minBrightness) {
+        demand = on && demand >= settings.minBrightness / 2.0f ? settings.minBrightness : 0;
+    }
+    return demand;
+}
+
+DliCommand DliTick(DliState &state, const DliSettings &settings, const DliInputs &inputs) {
+    DliCommand command = {};
+    float dt = 0;
+    if (state.started) {
+        uint32_t gap = inputs.nowMs - state.lastMs;
+        dt = gap <= DLI_MAX_GAP_MS ? gap / 1000.0f : 0;
+    }
+    state.started = true;
+    state.lastMs = inputs.nowMs;
+
+    // Новые сутки: итог прошлых сохраняется, накопление начинается заново
+    bool synced = inputs.secondOfDay >= 0;
+    if (synced && (!state.dayKnown || inputs.day != state.day)) {
+        state.yesterday = state.dayKnown && inputs.day == state.day + 1 ? state.accumulated : 0;
+        state.day = inputs.day;
+        state.dayKnown = true;
+        state.accumulated = 0;
+        state.ledAccumulated = 0;
+        command.dayStarted = true;
+    }
+
+    // Накопление: датчик видит и солнце, и ленту, поэтому естественная часть - разность
+    if (inputs.valid) {
+        float led = settings.ledPpfd * LedFraction(state, inputs.lightLevel);
+        state.ppfd = (inputs.lux > 0 ? inputs.lux : 0) * settings.luxToPpfd;
+        state.naturalPpfd = state.ppfd > led ? state.ppfd - led : 0;
+        if (synced) {
+            state.accumulated += state.ppfd * dt / 1e6f;
+            state.ledAccumulated += (led < state.ppfd ? led : state.ppfd) * dt / 1e6f;
+            int slot = inputs.secondOfDay / DLI_SLOT_SECONDS;
+            if (slot != state.slot) {
+                CloseSlot(state);
+                state.slot = slot;
+            }
+            state.slotSum += state.naturalPpfd * dt;
+            state.slotSeconds += dt;
+        }
+    }
+
+    state.requiredPpfd = 0;
+    state.forecastNatural = 0;
+    state.active = false;
+
+    // Лентой управляет пользователь или правило: регулятор продолжит с установленной яркости
+    if (inputs.held) {
+        state.level = inputs.lightLevel;
+        state.output = inputs.lightLevel;
+        state.driving = false;
+        return command;
+    }
+    // Регулятор выключен или время неизвестно: включенная им лента гаснет
+    if (!settings.enabled || !synced) {
+        if (state.driving) {
+            state.level = 0;
+            state.output = 0;
+            state.driving = false;
+            command.changed = true;
+            command.brightness = 0;
+        }
+        return command;
+    }
+    // Без достоверного показания яркость не меняется
+    if (!inputs.valid) {
+        return command;
+    }
+    if (!state.driving) {
+        state.level = inputs.lightLevel;
+        state.output = inputs.lightLevel;
+    }
+
+    state.active = true;
+    float demand = Demand(state, settings, inputs.secondOfDay);
+
+    // Ограничение скорости; ниже минимальной яркости лента включается и гаснет сразу
+    float step = settings.rampPerMinute * dt / 60.0f;
+    if (settings.rampPerMinute <= 0) {
+        state.level = demand;
+    } else if (demand > state.level) {
+        state.level = state.level + step < demand ? state.level + step : demand;
+    } else {
+        state.level = state.level - step > demand ? state.level - step : demand;
+    }
+    if (state.level < settings.minBrightness) {
+        state.level = demand > 0 ? settings.minBrightness : 0;
+    }
+
+    // Яркость меняется шагами не меньше 1 %: колебания расчета около границы округления не мерцают
+    if (fabsf(state.level - state.output) >= 1 || (state.level == 0 && state.output > 0)) {
+        state.output = (uint8_t)lroundf(state.level);
+        command.changed = true;
+        command.brightness = state.output;
+    }
+    state.driving = state.output > 0;
+    return command;
+}
@@ -0,0 +1,146 @@
+#ifndef DLI_H
+#define DLI_H
+
+#include <stdint.h>
+
+/**
+ * Досветка по дневному интегралу освещенности (DLI)
+ * Освещенность BH1750 пересчитывается в PPFD и накапливается за сутки. Лента включается
+ * только на ту яркость, которой не хватает до целевого DLI к концу светового дня с учетом
+ * ожидаемого естественного света; яркость меняется плавно, не быстрее заданной скорости.
+ * Модуль не зависит от оборудования: на вход - освещенность, время и текущий уровень ленты,
+ * на выход - яркость ленты
+ */
+
+// Ячеек профиля естественного света за сутки (по часу)
+#define DLI_PROFILE_SLOTS 24
+// Наибольший учитываемый интервал между тактами, мс: после паузы интеграл не досчитывается
+#define DLI_MAX_GAP_MS 10000
+
+// Культуры с типичным целевым DLI
+enum DliCrop {
+    DLI_CROP_CUSTOM,       // Цель задана числом
+    DLI_CROP_MICROGREENS,
+    DLI_CROP_LETTUCE,
+    DLI_CROP_HERBS,
+    DLI_CROP_STRAWBERRY,
+    DLI_CROP_CUCUMBER,
+    DLI_CROP_TOMATO,
+    DLI_CROP_COUNT
+};
+
+/**
+ * Уставки регулятора досветки (изменяются во время работы)
+ */
+struct DliSettings {
+    bool enabled;             // Регулятор управляет лентой
+    uint8_t crop;             // DliCrop
+    float target;             // Целевой DLI, моль/м² за сутки
+    uint16_t startMinute;     // Начало светового дня, минуты от местной полуночи
+    uint16_t endMinute;       // Конец светового дня (больше начала)
+    float luxToPpfd;          // PPFD на 1 лк освещенности, мкмоль/(м²·с)
+    float ledPpfd;            // PPFD ленты на полной яркости в месте датчика, мкмоль/(м²·с)
+    float rampPerMinute;      // Наибольшая скорость изменения яркости, % в минуту
+    uint8_t minBrightness;    // Меньшая яркость не включается, %
+    uint8_t maxBrightness;    // Наибольшая яркость, %
+    float forecast;           // Доля ожидаемого естественного света, учитываемая в плане (0..1)
+};
+
+/**
+ * Состояние регулятора
+ */
+struct DliState {
+    uint32_t day;                        // Местные сутки накопления (от 01.01.1970)
+    bool dayKnown;                       // Сутки определены (часы синхронизированы)
+    float accumulated;                   // DLI за текущие сутки по датчику, моль/м²
+    float ledAccumulated;                // Из них оценка вклада ленты, моль/м²
+    float yesterday;                     // DLI за прошлые сутки, моль/м²
+    float ppfd;                          // Последний измеренный PPFD, мкмоль/(м²·с)
+    float naturalPpfd;                   // Оценка естественной части PPFD
+    float requiredPpfd;                  // Требуемый от ленты средний PPFD до конца дня
+    float forecastNatural;               // Ожидаемый естественный свет до конца дня, моль/м²
+    float profile[DLI_PROFILE_SLOTS];    // Средний естественный PPFD по часам суток (< 0 - неизвестно)
+    float slotSum;                       // Естественный свет за текущий час, мкмоль/м²
+    float slotSeconds;                   // Учтенная длительность текущего часа, с
+    int8_t slot;                         // Текущий час (-1 - нет)
+    float level;                         // Яркость, заданная регулятором, % (дробная - для плавного роста)
+    uint8_t output;                      // Последняя выданная яркость, %
+    bool driving;                        // Лента включена регулятором
+    bool active;                         // В последнем такте регулятор управлял лентой
+    float gamma;                         // Гамма ленты: яркость по доле света (прямой пересчет - LedGammaLevel)
+    uint32_t lastMs;                     // Время предыдущего такта
+    bool started;                        // Был хотя бы один такт
+};
+
+/**
+ * Входные данные такта
+ */
+struct DliInputs {
+    float lux;              // Освещенность, лк
+    bool valid;             // Освещенность достоверна
+    int32_t secondOfDay;    // Местное время суток, с (-1 - часы не синхронизированы)
+    uint32_t day;           // Местные сутки (от 01.01.1970)
+    uint8_t lightLevel;     // Текущая яркость ленты, % (0 - выключена)
+    bool held;              // Лентой управляет пользователь, правило или расписание
+    uint32_t nowMs;         // Текущее время, мс
+};
+
+/**
+ * Команда регулятора за один такт
+ */
+struct DliCommand {
+    bool changed;         // Яркость нужно установить
+    uint8_t brightness;   // Яркость, % (0 - выключить)
+    bool dayStarted;      // Начались новые сутки (или впервые определены): накопление обнулено
+};
+
+/**
+ * Уставки по умолчанию
+ */
+DliSettings DliDefaultSettings();
+
+/**
+ * Целевой DLI культуры
+ * @param crop DliCrop
+ * @return моль/м² за сутки (0 - нет такой культуры)
+ */
+float DliCropTarget(uint8_t crop);
+
+/**
+ * Название культуры для API
+ */
+const char *DliCropName(uint8_t crop);
+
+/**
+ * Поиск культуры по названию
+ * @return DliCrop или -1
+ */
+int DliCropFind(const char *name);
+
+/**
+ * Начальное состояние регулятора
+ * @param state Состояние
+ * @param gamma Гамма ленты (для нее же строится таблица LedGammaSetup)
+ */
+void DliInit(DliState &state, float gamma);
+
+/**
+ * Восстановление накопления текущих суток (например, по журналу после перезапуска)
+ * @param state Состояние
+ * @param settings Уставки
+ * @param luxSeconds Интеграл освещенности с начала суток, лк·с
+ */
+void DliRestore(DliState &state, const DliSettings &settings, float luxSeconds);
+
+/**
+ * Такт регулятора
+ * Накопление идет всегда, пока часы синхронизированы и показание достоверно; лентой регулятор
+ * управляет, только если включен и лента не удерживается (held)
+ * @param state Состояние
+ * @param settings Уставки
+ * @param inputs Входные данные
+ * @return Команда ленте
+ */
+DliCommand DliTick(DliState &state, const DliSettings &settings, const DliInputs &inputs);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * Фильтр показаний датчиков
+ * Медиана хранит окно дважды: в порядке поступления, чтобы знать вытесняемое значение,
+ * и по возрастанию, чтобы брать середину без сортировки
+ */
+#include "filter.h"
+#include <float.h>
+
+/**
+ * Позиция первого значения, не меньшего заданного (двоичный поиск)
+ */
+static int LowerBound(const float *sorted, int count, float value) {
+    int low = 0;
+    int high = count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (sorted[middle] < value) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * Добавление значения в окно медианы с вытеснением самого старого
+ * @return Медиана окна
+ */
+static float MedianPush(Filter &filter, uint8_t size, float value) {
+    if (filter.count == size) {
+        float oldest = filter.window[filter.head];
+        int position = LowerBound(filter.sorted, filter.count, oldest);
+        memmove(&filter.sorted[position], &filter.sorted[position + 1],
+                (filter.count - position - 1) * sizeof(float));
+        filter.count--;
+    }
+    filter.window[filter.head] = value;
+    filter.head = (filter.head + 1) % size;
+
+    int position = LowerBound(filter.sorted, filter.count, value);
+    memmove(&filter.sorted[position + 1], &filter.sorted[position], (filter.count - position) * sizeof(float));
+    filter.sorted[position] = value;
+    filter.count++;
+    return filter.sorted[filter.count / 2];
+}
+
+void FilterSanitize(FilterConfig &config) {
+    if (isnan(config.min)) {
+        config.min = -FLT_MAX;
+    }
+    if (isnan(config.max)) {
+        config.max = FLT_MAX;
+    }
+    if (config.min > config.max) {
+        float swap = config.min;
+        config.min = config.max;
+        config.max = swap;
+    }
+    if (isnan(config.maxRate) || config.maxRate < 0) {
+        config.maxRate = 0;
+    }
+    config.median = constrain(config.median, 1, FILTER_MEDIAN_MAX) | 1; // Только нечетное окно
+    if (config.median > FILTER_MEDIAN_MAX) {
+        config.median -= 2;
+    }
+    if (isnan(config.alpha) || config.alpha <= 0 || config.alpha > 1) {
+        config.alpha = 1;
+    }
+}
+
+void FilterReset(Filter &filter) {
+    filter.count = 0;
+    filter.head = 0;
+    filter.limited = NAN;
+    filter.output = NAN;
+    filter.rejectRun = 0;
+}
+
+bool FilterUpdate(Filter &filter, const FilterConfig &config, float value, uint32_t nowMs) {
+    // Отбраковка: датчик не ответил или значение физически невозможно
+    if (isnan(value) || value < config.min || value > config.max) {
+        filter.rejected++;
+        if (++filter.rejectRun >= FILTER_MAX_REJECTS) {
+            FilterReset(filter); // Выход устарел; после восстановления фильтр начнет заново
+        }
+        return false;
+    }
+    filter.rejectRun = 0;
+
+    // Ограничение скорости изменения относительно предыдущего показания
+    if (!isnan(filter.limited) && config.maxRate > 0) {
+        float step = config.maxRate * (nowMs - filter.lastMs) / 1000.0f;
+        value = constrain(value, filter.limited - step, filter.limited + step);
+    }
+    filter.limited = value;
+    filter.lastMs = nowMs;
+
+    if (config.median > 1) {
+        value = MedianPush(filter, config.median, value);
+    }
+
+    // Экспоненциальное среднее
+    if (isnan(filter.output)) {
+        filter.output = value;
+    } else {
+        filter.output += config.alpha * (value - filter.output);
+    }
+    return true;
+}
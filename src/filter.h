@@ -0,0 +1,70 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <Arduino.h>
+
+/**
+ * Фильтр одной величины с постоянным объемом памяти
+ * Ступени по порядку: отбраковка NAN и значений вне диапазона, ограничение
+ * скорости изменения, скользящая медиана, экспоненциальное среднее
+ */
+
+// Наибольшее окно медианы (нечетное)
+#ifndef FILTER_MEDIAN_MAX
+#define FILTER_MEDIAN_MAX 9
+#endif
+
+// После стольких отбракованных подряд показаний выход фильтра считается недействительным
+#ifndef FILTER_MAX_REJECTS
+#define FILTER_MAX_REJECTS 5
+#endif
+
+/**
+ * Настройки фильтра
+ */
+struct FilterConfig {
+    float min;       // Нижняя граница допустимых значений
+    float max;       // Верхняя граница допустимых значений
+    float maxRate;   // Наибольшая скорость изменения, единиц в секунду (0 - без ограничения)
+    uint8_t median;  // Окно медианы, нечетное 1..FILTER_MEDIAN_MAX (1 - без медианы)
+    float alpha;     // Коэффициент экспоненциального среднего 0..1 (1 - без сглаживания)
+};
+
+/**
+ * Состояние фильтра
+ */
+struct Filter {
+    float window[FILTER_MEDIAN_MAX];  // Окно медианы в порядке поступления (кольцевой буфер)
+    float sorted[FILTER_MEDIAN_MAX];  // То же окно по возрастанию
+    uint8_t count;      // Заполнено значений окна
+    uint8_t head;       // Место следующего значения в window
+    float limited;      // Последнее значение после ограничения скорости
+    float output;       // Выход фильтра (NAN - нет действительного значения)
+    uint32_t lastMs;    // Время последнего принятого показания
+    uint8_t rejectRun;  // Отбраковано подряд
+    uint32_t rejected;  // Отбраковано всего
+};
+
+/**
+ * Приведение настроек к допустимым значениям
+ */
+void FilterSanitize(FilterConfig &config);
+
+/**
+ * Сброс состояния: следующее показание начинает фильтр заново
+ * Счетчик отбракованных показаний сохраняется
+ */
+void FilterReset(Filter &filter);
+
+/**
+ * Обработка очередного показания
+ * Время обработки не зависит от истории: O(log n) поиск и сдвиг не более FILTER_MEDIAN_MAX значений
+ * @param filter Состояние фильтра
+ * @param config Настройки
+ * @param value Показание (NAN - чтение не удалось)
+ * @param nowMs Время показания, millis()
+ * @return true, если показание принято
+ */
+bool FilterUpdate(Filter &filter, const FilterConfig &config, float value, uint32_t nowMs);
+
+#endif
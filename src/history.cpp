@@ -0,0 +1,329 @@
+/**
+ * История показаний в кольцевых буферах фиксированного размера
+ * Значения хранятся в 16-битном фиксированном формате, уровни минут и часов
+ * накапливаются по мере поступления измерений без повторного просмотра данных
+ */
+#include "history.h"
+#include <ESPAsyncWebServer.h>
+
+// Признак отсутствия данных в ячейке
+#define HISTORY_MISSING INT16_MIN
+
+// Масштаб фиксированного формата: хранимое значение = физическое * масштаб
+static const float metricScale[HISTORY_METRIC_COUNT] = {
+    100.0f, // Температура: 0.01 °C
+    100.0f, // Влажность: 0.01 %
+    10.0f,  // Давление: 0.1 гПа
+    0.5f,   // Освещенность: 2 лк, до 65534 лк
+};
+
+static const char* const metricNames[HISTORY_METRIC_COUNT] = {"temperature", "humidity", "pressure", "lux"};
+static const char* const resolutionNames[HISTORY_RESOLUTION_COUNT] = {"raw", "minute", "hour"};
+static const uint32_t resolutionInterval[HISTORY_RESOLUTION_COUNT] = {1, 60, 3600};
+
+// Строка исходных показаний
+struct RawRow {
+    int16_t value[HISTORY_METRIC_COUNT];
+};
+
+// Строка агрегированных показаний
+struct AggregateRow {
+    int16_t min[HISTORY_METRIC_COUNT];
+    int16_t avg[HISTORY_METRIC_COUNT];
+    int16_t max[HISTORY_METRIC_COUNT];
+};
+
+/**
+ * Кольцевой буфер строк с равным шагом по времени
+ * Время строки не хранится, а вычисляется по времени самой новой строки
+ */
+template <typename Row, size_t N>
+struct HistoryRing {
+    Row rows[N];
+    uint32_t head;     // Индекс следующей записи
+    uint32_t count;    // Количество заполненных строк
+    uint32_t lastTime; // Время самой новой строки
+};
+
+/**
+ * Накопитель агрегатов текущего интервала
+ */
+struct HistoryAccumulator {
+    uint32_t bucket; // Начало интервала
+    bool open;       // В интервале есть хотя бы одно измерение
+    float sum[HISTORY_METRIC_COUNT];
+    float min[HISTORY_METRIC_COUNT];
+    float max[HISTORY_METRIC_COUNT];
+    uint16_t samples[HISTORY_METRIC_COUNT];
+};
+
+static HistoryRing<RawRow, HISTORY_RAW_COUNT> rawRing;
+static HistoryRing<AggregateRow, HISTORY_MINUTE_COUNT> minuteRing;
+static HistoryRing<AggregateRow, HISTORY_HOUR_COUNT> hourRing;
+static HistoryAccumulator minuteAccumulator;
+static HistoryAccumulator hourAccumulator;
+
+static_assert(sizeof(rawRing) + sizeof(minuteRing) + sizeof(hourRing) <= HISTORY_MAX_BYTES,
+              "История не помещается в HISTORY_MAX_BYTES");
+
+// Запись идет из основного цикла, чтение - из задачи веб-сервера
+static portMUX_TYPE historyLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Перевод значения в фиксированный формат
+ */
+static int16_t Encode(HistoryMetric metric, float value) {
+    float scaled = value * metricScale[metric];
+    if (scaled > INT16_MAX) {
+        return INT16_MAX;
+    }
+    if (scaled < INT16_MIN + 1) {
+        return INT16_MIN + 1;
+    }
+    return (int16_t)lroundf(scaled);
+}
+
+/**
+ * Перевод значения из фиксированного формата
+ */
+static float Decode(HistoryMetric metric, int16_t value) {
+    return value / metricScale[metric];
+}
+
+/**
+ * Добавление строки в кольцевой буфер
+ * Пропущенные интервалы заполняются пустыми строками, строка с тем же временем заменяется
+ */
+template <typename Row, size_t N>
+static void RingPush(HistoryRing<Row, N> &ring, uint32_t interval, uint32_t time, const Row &row, const Row &empty) {
+    if (ring.count > 0) {
+        if (time < ring.lastTime) {
+            return; // Измерение старше уже записанных
+        }
+        if (time == ring.lastTime) {
+            ring.rows[(ring.head + N - 1) % N] = row;
+            return;
+        }
+        uint32_t gap = (time - ring.lastTime) / interval - 1;
+        if (gap >= N) {
+            ring.count = 0; // Пропуск длиннее буфера: старые данные уже не нужны
+        } else {
+            for (uint32_t i = 0; i < gap; i++) {
+                ring.rows[ring.head] = empty;
+                ring.head = (ring.head + 1) % N;
+                if (ring.count < N) {
+                    ring.count++;
+                }
+            }
+        }
+    }
+    ring.rows[ring.head] = row;
+    ring.head = (ring.head + 1) % N;
+    if (ring.count < N) {
+        ring.count++;
+    }
+    ring.lastTime = time;
+}
+
+/**
+ * Чтение строк кольцевого буфера в интервале [from, to]
+ * @param decode Функция преобразования строки в точку; возвращает false для пустой строки
+ */
+template <typename Row, size_t N, typename Decoder>
+static size_t RingRead(const HistoryRing<Row, N> &ring, uint32_t interval, uint32_t &from, uint32_t to,
+                       HistoryPoint *out, size_t maxPoints, Decoder decode) {
+    if (ring.count == 0) {
+        return 0;
+    }
+    uint32_t oldest = ring.lastTime - (ring.count - 1) * interval;
+    if (from < oldest) {
+        from = oldest;
+    }
+    // Выравнивание на границу строки
+    uint32_t offset = (from - oldest + interval - 1) / interval;
+    from = oldest + offset * interval;
+    uint32_t last = to < ring.lastTime ? to : ring.lastTime;
+
+    size_t written = 0;
+    while (from <= last && written < maxPoints) {
+        const Row &row = ring.rows[(ring.head + N - ring.count + offset) % N];
+        if (decode(row, out[written])) {
+            out[written].time = from;
+            written++;
+        }
+        from += interval;
+        offset++;
+    }
+    return written;
+}
+
+/**
+ * Учет измерения в накопителе; при смене интервала завершенный интервал выгружается
+ */
+template <size_t N>
+static void Accumulate(HistoryAccumulator &acc, HistoryRing<AggregateRow, N> &ring, uint32_t interval,
+                       uint32_t time, const float values[], const bool valid[]) {
+    uint32_t bucket = time - time % interval;
+    if (acc.open && bucket != acc.bucket) {
+        AggregateRow row, empty;
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            HistoryMetric metric = (HistoryMetric)m;
+            bool has = acc.samples[m] > 0;
+            row.min[m] = has ? Encode(metric, acc.min[m]) : HISTORY_MISSING;
+            row.avg[m] = has ? Encode(metric, acc.sum[m] / acc.samples[m]) : HISTORY_MISSING;
+            row.max[m] = has ? Encode(metric, acc.max[m]) : HISTORY_MISSING;
+            empty.min[m] = empty.avg[m] = empty.max[m] = HISTORY_MISSING;
+        }
+        RingPush(ring, interval, acc.bucket, row, empty);
+        acc.open = false;
+    }
+    if (!acc.open) {
+        acc.bucket = bucket;
+        acc.open = true;
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            acc.sum[m] = 0;
+            acc.samples[m] = 0;
+        }
+    }
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        if (!valid[m]) {
+            continue;
+        }
+        if (acc.samples[m] == 0 || values[m] < acc.min[m]) {
+            acc.min[m] = values[m];
+        }
+        if (acc.samples[m] == 0 || values[m] > acc.max[m]) {
+            acc.max[m] = values[m];
+        }
+        acc.sum[m] += values[m];
+        acc.samples[m]++;
+    }
+}
+
+void HistoryAdd(uint32_t time, const float values[HISTORY_METRIC_COUNT], const bool valid[HISTORY_METRIC_COUNT]) {
+    RawRow row, empty;
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        row.value[m] = valid[m] ? Encode((HistoryMetric)m, values[m]) : HISTORY_MISSING;
+        empty.value[m] = HISTORY_MISSING;
+    }
+
+    portENTER_CRITICAL(&historyLock);
+    RingPush(rawRing, resolutionInterval[HISTORY_RAW], time, row, empty);
+    Accumulate(minuteAccumulator, minuteRing, resolutionInterval[HISTORY_MINUTE], time, values, valid);
+    Accumulate(hourAccumulator, hourRing, resolutionInterval[HISTORY_HOUR], time, values, valid);
+    portEXIT_CRITICAL(&historyLock);
+}
+
+size_t HistoryRead(HistoryMetric metric, HistoryResolution resolution, uint32_t &from, uint32_t to,
+                   HistoryPoint *out, size_t maxPoints) {
+    auto decodeRaw = [metric](const RawRow &row, HistoryPoint &point) {
+        if (row.value[metric] == HISTORY_MISSING) {
+            return false;
+        }
+        point.min = point.avg = point.max = Decode(metric, row.value[metric]);
+        return true;
+    };
+    auto decodeAggregate = [metric](const AggregateRow &row, HistoryPoint &point) {
+        if (row.avg[metric] == HISTORY_MISSING) {
+            return false;
+        }
+        point.min = Decode(metric, row.min[metric]);
+        point.avg = Decode(metric, row.avg[metric]);
+        point.max = Decode(metric, row.max[metric]);
+        return true;
+    };
+
+    size_t written = 0;
+    portENTER_CRITICAL(&historyLock);
+    switch (resolution) {
+        case HISTORY_RAW:
+            written = RingRead(rawRing, resolutionInterval[HISTORY_RAW], from, to, out, maxPoints, decodeRaw);
+            break;
+        case HISTORY_MINUTE:
+            written = RingRead(minuteRing, resolutionInterval[HISTORY_MINUTE], from, to, out, maxPoints, decodeAggregate);
+            break;
+        case HISTORY_HOUR:
+            written = RingRead(hourRing, resolutionInterval[HISTORY_HOUR], from, to, out, maxPoints, decodeAggregate);
+            break;
+        default:
+            break;
+    }
+    portEXIT_CRITICAL(&historyLock);
+    return written;
+}
+
+uint32_t HistoryInterval(HistoryResolution resolution) {
+    return resolutionInterval[resolution];
+}
+
+const char *HistoryMetricName(HistoryMetric metric) {
+    return metricNames[metric];
+}
+
+bool HistoryMetricFromName(const String &name, HistoryMetric &metric) {
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        if (name == metricNames[m]) {
+            metric = (HistoryMetric)m;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HistoryResolutionFromName(const String &name, HistoryResolution &resolution) {
+    for (int r = 0; r < HISTORY_RESOLUTION_COUNT; r++) {
+        if (name == resolutionNames[r]) {
+            resolution = (HistoryResolution)r;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t HistoryStreamChunk(HistoryStream &stream, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+
+    if (!stream.headerSent && !stream.binary) {
+        const char *header = stream.resolution == HISTORY_RAW ? "time,value\n" : "time,min,avg,max\n";
+        size_t length = strlen(header);
+        if (length > maxLen) {
+            return RESPONSE_TRY_AGAIN;
+        }
+        memcpy(buffer, header, length);
+        written = length;
+    }
+    stream.headerSent = true;
+
+    for (;;) {
+        // Точка забирается из истории, только если целиком помещается в буфер
+        uint32_t next = stream.from;
+        HistoryPoint point;
+        if (HistoryRead(stream.metric, stream.resolution, next, stream.to, &point, 1) == 0) {
+            stream.finished = true;
+            break;
+        }
+
+        char line[64];
+        size_t length;
+        if (stream.binary) {
+            memcpy(line, &point, sizeof(point));
+            length = sizeof(point);
+        } else if (stream.resolution == HISTORY_RAW) {
+            length = snprintf(line, sizeof(line), "%u,%.2f\n", (unsigned)point.time, point.avg);
+        } else {
+            length = snprintf(line, sizeof(line), "%u,%.2f,%.2f,%.2f\n",
+                              (unsigned)point.time, point.min, point.avg, point.max);
+        }
+        if (length > maxLen - written) {
+            break;
+        }
+        memcpy(buffer + written, line, length);
+        written += length;
+        stream.from = next;
+    }
+
+    if (written == 0 && !stream.finished) {
+        return RESPONSE_TRY_AGAIN; // В буфере нет места даже для одной точки
+    }
+    return written;
+}
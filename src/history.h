@@ -0,0 +1,119 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <Arduino.h>
+
+// Глубина хранения по уровням (можно переопределить через build_flags)
+#ifndef HISTORY_RAW_COUNT
+#define HISTORY_RAW_COUNT 600      // Исходные показания раз в секунду: 10 минут
+#endif
+#ifndef HISTORY_MINUTE_COUNT
+#define HISTORY_MINUTE_COUNT 1440  // Минутные min/avg/max: 24 часа
+#endif
+#ifndef HISTORY_HOUR_COUNT
+#define HISTORY_HOUR_COUNT 720     // Часовые min/avg/max: 30 суток
+#endif
+// Предел памяти под историю, проверяется при компиляции
+#ifndef HISTORY_MAX_BYTES
+#define HISTORY_MAX_BYTES 65536
+#endif
+
+// Величины, для которых хранится история
+enum HistoryMetric {
+    HISTORY_TEMPERATURE,
+    HISTORY_HUMIDITY,
+    HISTORY_PRESSURE,
+    HISTORY_LUX,
+    HISTORY_METRIC_COUNT
+};
+
+// Уровни детализации истории
+enum HistoryResolution {
+    HISTORY_RAW,     // Шаг 1 секунда
+    HISTORY_MINUTE,  // Шаг 1 минута
+    HISTORY_HOUR,    // Шаг 1 час
+    HISTORY_RESOLUTION_COUNT
+};
+
+/**
+ * Точка истории в физических единицах
+ * Для исходных показаний min, avg и max совпадают
+ */
+struct HistoryPoint {
+    uint32_t time; // Начало интервала, секунды
+    float min;
+    float avg;
+    float max;
+};
+
+/**
+ * Состояние потоковой выдачи истории для одного HTTP-ответа
+ */
+struct HistoryStream {
+    HistoryMetric metric;
+    HistoryResolution resolution;
+    uint32_t from;     // Время следующей точки
+    uint32_t to;       // Конец интервала включительно
+    bool binary;       // true - записи HistoryPoint, false - CSV
+    bool headerSent;   // Заголовок CSV уже выдан
+    bool finished;     // Все точки выданы
+};
+
+/**
+ * Добавление измерения в историю
+ * Уровни минут и часов обновляются накопительно, без пересчета
+ * @param time Время измерения, секунды
+ * @param values Значения в порядке HistoryMetric
+ * @param valid Признаки достоверности значений в порядке HistoryMetric
+ */
+void HistoryAdd(uint32_t time, const float values[HISTORY_METRIC_COUNT], const bool valid[HISTORY_METRIC_COUNT]);
+
+/**
+ * Чтение очередной порции истории
+ * Пропуски (нет данных) не выдаются
+ * @param metric Величина
+ * @param resolution Уровень детализации
+ * @param from Время, с которого продолжить чтение; сдвигается за последнюю выданную точку
+ * @param to Конец интервала включительно
+ * @param out Буфер для точек
+ * @param maxPoints Размер буфера
+ * @return Количество выданных точек (0 - интервал прочитан полностью)
+ */
+size_t HistoryRead(HistoryMetric metric, HistoryResolution resolution, uint32_t &from, uint32_t to,
+                   HistoryPoint *out, size_t maxPoints);
+
+/**
+ * Заполнение очередного фрагмента HTTP-ответа с историей
+ * В буфер попадают только целые строки CSV или записи HistoryPoint
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t HistoryStreamChunk(HistoryStream &stream, uint8_t *buffer, size_t maxLen);
+
+/**
+ * Шаг уровня детализации
+ * @param resolution Уровень детализации
+ * @return Шаг в секундах
+ */
+uint32_t HistoryInterval(HistoryResolution resolution);
+
+/**
+ * Имя величины ("temperature", "humidity", "pressure", "lux")
+ */
+const char *HistoryMetricName(HistoryMetric metric);
+
+/**
+ * Поиск величины по имени ("temperature", "humidity", "pressure", "lux")
+ * @return true, если имя известно
+ */
+bool HistoryMetricFromName(const String &name, HistoryMetric &metric);
+
+/**
+ * Поиск уровня детализации по имени ("raw", "minute", "hour")
+ * @return true, если имя известно
+ */
+bool HistoryResolutionFromName(const String &name, HistoryResolution &resolution);
+
+#endif
@@ -0,0 +1,328 @@
+/**
+ * Запись JSON в фиксированный буфер и отправка ответов API из статических буферов
+ */
+#include "json_writer.h"
+#include <ESPAsyncWebServer.h>
+
+static char responseBuffers[JSON_RESPONSE_SLOTS][JSON_RESPONSE_MAX];
+static bool responseBusy[JSON_RESPONSE_SLOTS];
+// Буферы занимают обработчики запросов, освобождает удаление ответа библиотекой
+static portMUX_TYPE responseLock = portMUX_INITIALIZER_UNLOCKED;
+
+static const uint32_t powersOfTen[7] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/**
+ * Запись фрагмента; при нехватке места запись прекращается
+ */
+static void Put(JsonWriter &writer, const char *text, size_t length) {
+    if (writer.overflow) {
+        return;
+    }
+    if (writer.length + length + 1 > writer.size) {
+        writer.overflow = true;
+        return;
+    }
+    memcpy(writer.buffer + writer.length, text, length);
+    writer.length += length;
+}
+
+static void PutChar(JsonWriter &writer, char c) {
+    Put(writer, &c, 1);
+}
+
+/**
+ * Запятая перед элементом и имя поля
+ */
+static void Prefix(JsonWriter &writer, const char *key) {
+    if (writer.depth > 0) {
+        uint16_t bit = 1 << (writer.depth - 1);
+        if (writer.filled & bit) {
+            PutChar(writer, ',');
+        }
+        writer.filled |= bit;
+    }
+    if (key != NULL) {
+        PutChar(writer, '"');
+        Put(writer, key, strlen(key));
+        Put(writer, "\":", 2);
+    }
+}
+
+/**
+ * Десятичная запись беззнакового числа
+ * @return Длина текста
+ */
+static size_t FormatUnsigned(char *text, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    for (size_t i = 0; i < count; i++) {
+        text[i] = digits[count - 1 - i];
+    }
+    return count;
+}
+
+/**
+ * Открытие вложенного уровня
+ */
+static void Open(JsonWriter &writer, const char *key, char bracket, bool array) {
+    Prefix(writer, key);
+    if (writer.depth >= JSON_WRITER_MAX_DEPTH) {
+        writer.overflow = true;
+        return;
+    }
+    uint16_t bit = 1 << writer.depth;
+    writer.arrays = array ? (writer.arrays | bit) : (writer.arrays & ~bit);
+    writer.filled &= ~bit;
+    writer.depth++;
+    PutChar(writer, bracket);
+}
+
+void JsonWriterBegin(JsonWriter &writer, char *buffer, size_t size) {
+    writer.buffer = buffer;
+    writer.size = buffer != NULL ? size : 0;
+    writer.length = 0;
+    writer.depth = 0;
+    writer.arrays = 0;
+    writer.filled = 0;
+    writer.overflow = buffer == NULL;
+}
+
+void JsonWriterObject(JsonWriter &writer, const char *key) {
+    Open(writer, key, '{', false);
+}
+
+void JsonWriterArray(JsonWriter &writer, const char *key) {
+    Open(writer, key, '[', true);
+}
+
+void JsonWriterEnd(JsonWriter &writer) {
+    if (writer.depth == 0) {
+        writer.overflow = true;
+        return;
+    }
+    writer.depth--;
+    PutChar(writer, (writer.arrays & (1 << writer.depth)) ? ']' : '}');
+}
+
+void JsonWriterInt(JsonWriter &writer, const char *key, int32_t value) {
+    Prefix(writer, key);
+    char text[12];
+    size_t length = 0;
+    if (value < 0) {
+        text[length++] = '-';
+    }
+    length += FormatUnsigned(text + length, value < 0 ? -(int64_t)value : value);
+    Put(writer, text, length);
+}
+
+void JsonWriterUint(JsonWriter &writer, const char *key, uint32_t value) {
+    Prefix(writer, key);
+    char text[12];
+    Put(writer, text, FormatUnsigned(text, value));
+}
+
+void JsonWriterBool(JsonWriter &writer, const char *key, bool value) {
+    Prefix(writer, key);
+    if (value) {
+        Put(writer, "true", 4);
+    } else {
+        Put(writer, "false", 5);
+    }
+}
+
+void JsonWriterNull(JsonWriter &writer, const char *key) {
+    Prefix(writer, key);
+    Put(writer, "null", 4);
+}
+
+size_t JsonFormatFloat(char *text, float value, uint8_t decimals) {
+    decimals = min(decimals, (uint8_t)6);
+    double scaled = (double)value * powersOfTen[decimals];
+    if (fabs(scaled) >= 1e15) {
+        // Очень большие значения (например, открытые границы диапазона) - в экспоненциальной записи
+        return snprintf(text, 24, "%.6e", (double)value);
+    }
+    int64_t fixed = llround(scaled);
+    size_t length = 0;
+    if (fixed < 0) {
+        text[length++] = '-';
+        fixed = -fixed;
+    }
+    length += FormatUnsigned(text + length, (uint64_t)fixed / powersOfTen[decimals]);
+    if (decimals > 0) {
+        text[length++] = '.';
+        uint32_t fraction = (uint64_t)fixed % powersOfTen[decimals];
+        for (int i = decimals - 1; i >= 0; i--) {
+            text[length + i] = '0' + fraction % 10;
+            fraction /= 10;
+        }
+        length += decimals;
+    }
+    return length;
+}
+
+size_t JsonFormatFloatExact(char *text, float value) {
+    for (uint8_t decimals = 0; decimals <= 6; decimals++) {
+        size_t length = JsonFormatFloat(text, value, decimals);
+        text[length] = '\0';
+        if (strtof(text, NULL) == value) {
+            return length;
+        }
+    }
+    return snprintf(text, 24, "%.9g", (double)value);
+}
+
+void JsonWriterFloat(JsonWriter &writer, const char *key, float value, uint8_t decimals) {
+    if (!isfinite(value)) {
+        JsonWriterNull(writer, key);
+        return;
+    }
+    Prefix(writer, key);
+    char text[24];
+    Put(writer, text, JsonFormatFloat(text, value, decimals));
+}
+
+void JsonWriterFloatExact(JsonWriter &writer, const char *key, float value) {
+    if (!isfinite(value)) {
+        JsonWriterNull(writer, key);
+        return;
+    }
+    Prefix(writer, key);
+    char text[24];
+    Put(writer, text, JsonFormatFloatExact(text, value));
+}
+
+void JsonWriterString(JsonWriter &writer, const char *key, const char *value) {
+    Prefix(writer, key);
+    PutChar(writer, '"');
+    const char *run = value; // Начало участка, не требующего экранирования
+    for (const char *c = value; *c != '\0'; c++) {
+        if (*c != '"' && *c != '\\' && (uint8_t)*c >= 0x20) {
+            continue;
+        }
+        Put(writer, run, c - run);
+        char escape[7];
+        if (*c == '"' || *c == '\\') {
+            escape[0] = '\\';
+            escape[1] = *c;
+            Put(writer, escape, 2);
+        } else {
+            snprintf(escape, sizeof(escape), "\\u%04x", (uint8_t)*c);
+            Put(writer, escape, 6);
+        }
+        run = c + 1;
+    }
+    Put(writer, run, strlen(run));
+    PutChar(writer, '"');
+}
+
+bool JsonWriterFinish(JsonWriter &writer) {
+    if (writer.depth != 0) {
+        writer.overflow = true;
+    }
+    if (writer.size > 0) {
+        writer.buffer[min(writer.length, writer.size - 1)] = '\0';
+    }
+    return !writer.overflow;
+}
+
+/**
+ * Номер буфера ответа, в который идет запись (-1 - буфер не из пула)
+ */
+static int ResponseSlot(const JsonWriter &writer) {
+    for (int slot = 0; slot < JSON_RESPONSE_SLOTS; slot++) {
+        if (writer.buffer == responseBuffers[slot]) {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Освобождение буфера ответа
+ */
+static void ReleaseResponse(int slot) {
+    portENTER_CRITICAL(&responseLock);
+    responseBusy[slot] = false;
+    portEXIT_CRITICAL(&responseLock);
+}
+
+/**
+ * Ответ, тело которого читается прямо из буфера пула
+ * Библиотека удаляет ответ вместе с запросом - после отправки или отключения клиента,
+ * поэтому буфер освобождается только тогда, когда он больше не читается
+ */
+class JsonSlotResponse : public AsyncProgmemResponse {
+public:
+    JsonSlotResponse(int code, const char *type, const JsonWriter &writer, int slot)
+        : AsyncProgmemResponse(code, type, (const uint8_t *)writer.buffer, writer.length), slot(slot) {}
+
+    ~JsonSlotResponse() override {
+        ReleaseResponse(slot);
+    }
+
+private:
+    int slot;
+};
+
+void JsonWriterBeginResponse(JsonWriter &writer) {
+    int found = -1;
+    portENTER_CRITICAL(&responseLock);
+    for (int slot = 0; slot < JSON_RESPONSE_SLOTS && found < 0; slot++) {
+        if (!responseBusy[slot]) {
+            responseBusy[slot] = true;
+            found = slot;
+        }
+    }
+    portEXIT_CRITICAL(&responseLock);
+    JsonWriterBegin(writer, found >= 0 ? responseBuffers[found] : NULL, JSON_RESPONSE_MAX);
+}
+
+uint8_t JsonWriterBusyResponses() {
+    uint8_t busy = 0;
+    portENTER_CRITICAL(&responseLock);
+    for (int slot = 0; slot < JSON_RESPONSE_SLOTS; slot++) {
+        busy += responseBusy[slot] ? 1 : 0;
+    }
+    portEXIT_CRITICAL(&responseLock);
+    return busy;
+}
+
+/**
+ * Отправка содержимого буфера ответа
+ * @param complete Содержимое записано полностью
+ */
+static void SendResponse(AsyncWebServerRequest *request, int code, JsonWriter &writer, bool complete,
+                         const char *type, const char *etag) {
+    int slot = ResponseSlot(writer);
+    if (slot < 0) {
+        request->send(503, "text/plain", "Busy");
+        return;
+    }
+    if (!complete) {
+        ReleaseResponse(slot);
+        request->send(500, "text/plain", "Response too large");
+        return;
+    }
+
+    // Тело читается из буфера по мере отправки; буфер освобождается при удалении ответа
+    AsyncWebServerResponse *response = new JsonSlotResponse(code, type, writer, slot);
+    if (etag != NULL) {
+        response->addHeader("ETag", etag);
+    }
+    request->send(response);
+}
+
+void JsonWriterSend(AsyncWebServerRequest *request, int code, JsonWriter &writer, const char *etag) {
+    bool complete = JsonWriterFinish(writer);
+    SendResponse(request, code, writer, complete, "application/json", etag);
+}
+
+void JsonWriterSendAs(AsyncWebServerRequest *request, int code, JsonWriter &writer, const char *type,
+                      const char *etag) {
+    SendResponse(request, code, writer, !writer.overflow, type, etag);
+}
@@ -0,0 +1,151 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <Arduino.h>
+
+class AsyncWebServerRequest;
+
+/**
+ * Запись JSON в буфер фиксированного размера без выделения памяти
+ * (память выделяют только разбор тел запросов и объект ответа библиотеки)
+ * Запятые между элементами расставляются сами; при нехватке места запись
+ * прекращается и выставляется признак переполнения
+ */
+
+// Размер буфера одного ответа API, байты
+#ifndef JSON_RESPONSE_MAX
+#define JSON_RESPONSE_MAX 1024
+#endif
+
+// Количество буферов ответов: столько JSON-ответов может отправляться одновременно
+#ifndef JSON_RESPONSE_SLOTS
+#define JSON_RESPONSE_SLOTS 4
+#endif
+
+// Наибольшая вложенность объектов и массивов
+#define JSON_WRITER_MAX_DEPTH 16
+
+/**
+ * Состояние записи
+ */
+struct JsonWriter {
+    char *buffer;
+    size_t size;
+    size_t length;      // Записано байт (без завершающего нуля)
+    uint8_t depth;      // Текущая вложенность
+    uint16_t arrays;    // Бит уровня: 1 - массив, 0 - объект
+    uint16_t filled;    // Бит уровня: на уровне уже есть элемент
+    bool overflow;      // Не хватило места или нарушена вложенность
+};
+
+/**
+ * Начало записи в буфер
+ * @param writer Состояние записи
+ * @param buffer Буфер (может быть NULL - тогда любая запись дает переполнение)
+ * @param size Размер буфера с учетом завершающего нуля
+ */
+void JsonWriterBegin(JsonWriter &writer, char *buffer, size_t size);
+
+/**
+ * Открытие объекта
+ * @param key Имя поля внутри объекта (NULL - элемент массива или корень)
+ */
+void JsonWriterObject(JsonWriter &writer, const char *key = NULL);
+
+/**
+ * Открытие массива
+ * @param key Имя поля внутри объекта (NULL - элемент массива или корень)
+ */
+void JsonWriterArray(JsonWriter &writer, const char *key = NULL);
+
+/**
+ * Закрытие последнего открытого объекта или массива
+ */
+void JsonWriterEnd(JsonWriter &writer);
+
+void JsonWriterInt(JsonWriter &writer, const char *key, int32_t value);
+void JsonWriterUint(JsonWriter &writer, const char *key, uint32_t value);
+void JsonWriterBool(JsonWriter &writer, const char *key, bool value);
+void JsonWriterNull(JsonWriter &writer, const char *key);
+
+/**
+ * Число с фиксированным количеством знаков после запятой
+ * @param value Значение (NAN и бесконечность записываются как null)
+ * @param decimals Знаков после запятой, 0..6
+ */
+void JsonWriterFloat(JsonWriter &writer, const char *key, float value, uint8_t decimals);
+
+/**
+ * Число с наименьшим количеством знаков после запятой, которое читается обратно в то же значение
+ * Для уставок, которые клиент получает и загружает снова (например, пороги правил)
+ * @param value Значение (NAN и бесконечность записываются как null)
+ */
+void JsonWriterFloatExact(JsonWriter &writer, const char *key, float value);
+
+/**
+ * Строка с экранированием кавычек, обратной косой черты и управляющих символов
+ */
+void JsonWriterString(JsonWriter &writer, const char *key, const char *value);
+
+/**
+ * Завершение записи: проверка вложенности и завершающий ноль
+ * @return true, если документ записан полностью
+ */
+bool JsonWriterFinish(JsonWriter &writer);
+
+/**
+ * Форматирование числа с фиксированной точкой без printf и без выделения памяти
+ * @param text Буфер (не меньше 24 байт)
+ * @param value Значение
+ * @param decimals Знаков после запятой, 0..6
+ * @return Длина текста
+ */
+size_t JsonFormatFloat(char *text, float value, uint8_t decimals);
+
+/**
+ * Форматирование числа, которое читается обратно (strtof) в то же значение
+ * Пробуются 0..6 знаков после запятой, иначе - 9 значащих цифр в экспоненциальной записи
+ * @param text Буфер (не меньше 24 байт)
+ * @param value Значение
+ * @return Длина текста
+ */
+size_t JsonFormatFloatExact(char *text, float value);
+
+/**
+ * Начало JSON-ответа HTTP в одном из статических буферов ответов
+ * Буфер занят, пока библиотека не удалит ответ (после отправки или отключения клиента),
+ * поэтому начатый ответ нужно отправить JsonWriterSend или JsonWriterSendAs.
+ * Если свободных буферов нет, запись дает переполнение
+ * @param writer Состояние записи
+ */
+void JsonWriterBeginResponse(JsonWriter &writer);
+
+/**
+ * Количество занятых буферов ответов
+ */
+uint8_t JsonWriterBusyResponses();
+
+/**
+ * Отправка ответа, начатого JsonWriterBeginResponse
+ * Тело передается прямо из буфера, без копирования в String
+ * При переполнении отправляется 503 (нет свободного буфера) или 500 (ответ не поместился)
+ * @param request Запрос
+ * @param code Код ответа
+ * @param writer Состояние записи
+ * @param etag Значение заголовка ETag (NULL - без заголовка)
+ */
+void JsonWriterSend(AsyncWebServerRequest *request, int code, JsonWriter &writer, const char *etag = NULL);
+
+/**
+ * Отправка ответа другого типа из буфера, начатого JsonWriterBeginResponse
+ * Тело записано прямо в writer.buffer (writer.length байт), например, двоичный кадр
+ * @param request Запрос
+ * @param code Код ответа
+ * @param writer Состояние записи (overflow - тело не поместилось)
+ * @param type Тип содержимого
+ * @param etag Значение заголовка ETag (NULL - без заголовка)
+ */
+void JsonWriterSendAs(AsyncWebServerRequest *request, int code, JsonWriter &writer, const char *type,
+                      const char *etag = NULL);
+
+#endif
@@ -0,0 +1,171 @@
+/**
+ * Вывод на RGB-ленту из отдельной задачи
+ * Обработчики только задают целевое состояние; задача выводит кадры с ограничением
+ * частоты, плавно переходит к цели и пропускает вывод, когда ничего не меняется
+ */
+#include "led.h"
+#include "metrics.h"
+#include <esp_timer.h>
+
+static CRGB leds[LED_COUNT];     // Кадр для вывода
+
+/**
+ * Переход между двумя состояниями
+ */
+struct LedFade {
+    LedState from;        // Состояние в начале перехода
+    LedState to;          // Целевое состояние
+    uint32_t startedAt;   // Начало перехода, millis()
+    uint32_t durationMs;  // Длительность перехода
+};
+
+static LedFade fade = {};
+static bool dirty = false;           // Выведенный кадр не совпадает с целью
+static LedStats stats = {};
+static TaskHandle_t ledTask = NULL;
+static bool powerSave = false;       // Переходы без анимации
+static portMUX_TYPE ledLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Линейная интерполяция компоненты
+ * @param progress Доля перехода, 0..256
+ */
+static uint8_t Blend(uint8_t from, uint8_t to, uint32_t progress) {
+    return from + (((int32_t)to - from) * (int32_t)progress >> 8);
+}
+
+/**
+ * Состояние перехода на момент now (вызывается под ledLock)
+ * @param finished Переход завершен
+ */
+static LedState CurrentState(uint32_t now, bool &finished) {
+    uint32_t elapsed = now - fade.startedAt;
+    finished = elapsed >= fade.durationMs;
+    if (finished) {
+        return fade.to;
+    }
+    uint32_t progress = (elapsed << 8) / fade.durationMs;
+    LedState state;
+    state.color = CRGB(Blend(fade.from.color.r, fade.to.color.r, progress),
+                       Blend(fade.from.color.g, fade.to.color.g, progress),
+                       Blend(fade.from.color.b, fade.to.color.b, progress));
+    state.brightness = Blend(fade.from.brightness, fade.to.brightness, progress);
+    return state;
+}
+
+/**
+ * Начало перехода к новой цели от текущего выведенного состояния
+ * Цель изменяется под блокировкой: одновременные запросы цвета и яркости не теряются
+ * @param color Новый цвет (NULL - без изменений)
+ * @param brightness Новая яркость (-1 - без изменений)
+ * @param fadeMs Длительность перехода, мс
+ */
+static void StartFade(const CRGB *color, int brightness, uint32_t fadeMs) {
+    uint32_t now = millis();
+    portENTER_CRITICAL(&ledLock);
+    bool finished;
+    fade.from = CurrentState(now, finished);
+    if (color != NULL) {
+        fade.to.color = *color;
+    }
+    if (brightness >= 0) {
+        fade.to.brightness = brightness;
+    }
+    fade.startedAt = now;
+    fade.durationMs = powerSave ? 0 : fadeMs;
+    dirty = true;
+    stats.requests++;
+    portEXIT_CRITICAL(&ledLock);
+
+    if (ledTask != NULL) {
+        xTaskNotifyGive(ledTask);
+    }
+}
+
+/**
+ * Задача вывода
+ * Без изменений спит до уведомления, во время перехода выводит кадры не чаще LED_MAX_FPS
+ */
+static void LedTask(void *) {
+    const TickType_t framePeriod = pdMS_TO_TICKS(1000 / LED_MAX_FPS);
+    TickType_t lastFrame = xTaskGetTickCount() - framePeriod;
+
+    for (;;) {
+        portENTER_CRITICAL(&ledLock);
+        bool idle = !dirty;
+        portEXIT_CRITICAL(&ledLock);
+        if (idle) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        }
+
+        // Серия запросов за один период кадра дает один вывод
+        TickType_t sinceFrame = xTaskGetTickCount() - lastFrame;
+        if (sinceFrame < framePeriod) {
+            vTaskDelay(framePeriod - sinceFrame);
+        }
+        lastFrame = xTaskGetTickCount();
+
+        bool finished;
+        portENTER_CRITICAL(&ledLock);
+        LedState state = CurrentState(millis(), finished);
+        if (finished) {
+            dirty = false;
+        }
+        portEXIT_CRITICAL(&ledLock);
+
+        // Яркость входит в значения каналов: гамма-коррекция применяется один раз
+        CRGB color(LedGammaLevel(state.color.r, state.brightness),
+                   LedGammaLevel(state.color.g, state.brightness),
+                   LedGammaLevel(state.color.b, state.brightness));
+        for (int i = 0; i < LED_COUNT; i++) {
+            leds[i] = color;
+        }
+        int64_t started = esp_timer_get_time();
+        FastLED.show();
+
+        uint32_t showUs = (uint32_t)(esp_timer_get_time() - started);
+        MetricsObserve(METRICS_LED_SHOW, showUs);
+
+        portENTER_CRITICAL(&ledLock);
+        stats.frames++;
+        stats.lastShowUs = showUs;
+        portEXIT_CRITICAL(&ledLock);
+    }
+}
+
+void LedBegin(const CRGB &color, uint8_t brightness) {
+    LedGammaSetup(LED_GAMMA);
+    FastLED.addLeds<LED_TYPE, LED_PIN, GRB>(leds, LED_COUNT); // Настройка типа ленты и порядка цветов
+    FastLED.setBrightness(255); // Яркость уже учтена в значениях каналов
+    fade.to = {color, brightness};
+    fade.from = fade.to;
+    dirty = true;
+
+    xTaskCreatePinnedToCore(LedTask, "leds", 2048, NULL, 1, &ledTask, LED_TASK_CORE);
+}
+
+void LedSetBrightness(uint8_t brightness, uint32_t fadeMs) {
+    StartFade(NULL, brightness, fadeMs);
+}
+
+void LedSetColor(const CRGB &color, uint32_t fadeMs) {
+    StartFade(&color, -1, fadeMs);
+}
+
+void LedSetPowerSave(bool enabled) {
+    portENTER_CRITICAL(&ledLock);
+    powerSave = enabled;
+    portEXIT_CRITICAL(&ledLock);
+}
+
+void LedGetTarget(LedState &state) {
+    portENTER_CRITICAL(&ledLock);
+    state = fade.to;
+    portEXIT_CRITICAL(&ledLock);
+}
+
+void LedGetStats(LedStats &out) {
+    portENTER_CRITICAL(&ledLock);
+    out = stats;
+    portEXIT_CRITICAL(&ledLock);
+}
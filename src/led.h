@@ -0,0 +1,84 @@
+#ifndef LED_H
+#define LED_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "led_gamma.h"
+
+// Настройки RGB-ленты (можно переопределить через build_flags)
+#ifndef LED_PIN
+#define LED_PIN 18          // Пин данных для подключения RGB-ленты
+#endif
+#ifndef LED_COUNT
+#define LED_COUNT 64        // Количество светодиодов в ленте
+#endif
+#ifndef LED_TYPE
+#define LED_TYPE SK6812     // Тип используемой RGB-ленты
+#endif
+#ifndef LED_MAX_FPS
+#define LED_MAX_FPS 50      // Наибольшая частота кадров, Гц
+#endif
+#ifndef LED_FADE_MS
+#define LED_FADE_MS 300     // Длительность плавного перехода по умолчанию, мс
+#endif
+#ifndef LED_TASK_CORE
+#define LED_TASK_CORE 1     // Ядро задачи вывода (WiFi работает на ядре 0)
+#endif
+
+/**
+ * Целевое состояние ленты в воспринимаемой яркости (до гамма-коррекции)
+ */
+struct LedState {
+    CRGB color;          // Цвет
+    uint8_t brightness;  // Общая яркость, 0..255
+};
+
+/**
+ * Статистика вывода
+ */
+struct LedStats {
+    uint32_t requests;    // Изменений целевого состояния
+    uint32_t frames;      // Выведенных кадров
+    uint32_t lastShowUs;  // Длительность вывода последнего кадра, мкс
+};
+
+/**
+ * Запуск задачи вывода на ленту
+ * Лента выводится только этой задачей: не чаще LED_MAX_FPS и только при изменениях
+ * @param color Начальный цвет
+ * @param brightness Начальная яркость, 0..255
+ */
+void LedBegin(const CRGB &color, uint8_t brightness);
+
+/**
+ * Новая целевая яркость; переход начинается с текущего выведенного значения
+ * @param brightness Яркость, 0..255
+ * @param fadeMs Длительность перехода, мс (0 - сразу)
+ */
+void LedSetBrightness(uint8_t brightness, uint32_t fadeMs = LED_FADE_MS);
+
+/**
+ * Новый целевой цвет; переход начинается с текущего выведенного цвета
+ * @param color Цвет
+ * @param fadeMs Длительность перехода, мс (0 - сразу)
+ */
+void LedSetColor(const CRGB &color, uint32_t fadeMs = LED_FADE_MS);
+
+/**
+ * Режим экономии: переходы не анимируются, новое состояние выводится одним кадром
+ * Выведенные цвет и яркость не меняются
+ * @param enabled Включить экономию
+ */
+void LedSetPowerSave(bool enabled);
+
+/**
+ * Получение целевого состояния ленты
+ */
+void LedGetTarget(LedState &state);
+
+/**
+ * Получение статистики вывода
+ */
+void LedGetStats(LedStats &stats);
+
+#endif
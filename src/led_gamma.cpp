@@ -0,0 +1,32 @@
+/**
+ * Гамма-коррекция RGB-ленты
+ */
+#include "led_gamma.h"
+#include <math.h>
+
+// Узлы таблицы - произведения цвета и яркости, кратные 255; значения - ШИМ * 256
+static uint16_t gammaTable[256];
+static float tableGamma = 0; // Гамма построенной таблицы (0 - таблица не построена)
+
+void LedGammaSetup(float gamma) {
+    if (gamma == tableGamma) {
+        return;
+    }
+    for (int i = 0; i < 256; i++) {
+        gammaTable[i] = (uint16_t)(powf(i / 255.0f, gamma) * 255.0f * 256.0f + 0.5f);
+    }
+    tableGamma = gamma;
+}
+
+uint8_t LedGammaLevel(uint8_t channel, uint8_t brightness) {
+    uint32_t perceived = (uint32_t)channel * brightness; // 0..255*255
+    if (perceived == 0) {
+        return 0;
+    }
+    uint32_t index = perceived / 255;
+    uint32_t weight = perceived % 255;   // Ненулевой остаток только при index < 255
+    uint32_t low = gammaTable[index];
+    uint32_t high = weight > 0 ? gammaTable[index + 1] : low;
+    uint32_t level = ((low * (255 - weight) + high * weight) / 255 + 128) >> 8;
+    return level > 0 ? level : 1;
+}
@@ -0,0 +1,35 @@
+#ifndef LED_GAMMA_H
+#define LED_GAMMA_H
+
+#include <stdint.h>
+
+/**
+ * Гамма-коррекция RGB-ленты: перевод воспринимаемой яркости в значение ШИМ
+ * Одна модель для вывода на ленту, оценки потребляемого тока и учета света ленты
+ * регулятором досветки. Модуль не зависит от оборудования
+ */
+
+#ifndef LED_GAMMA
+#define LED_GAMMA 2.2f      // Гамма для перевода значений в линейную яркость светодиодов
+#endif
+
+/**
+ * Построение таблицы гамма-коррекции (256 значений); таблица перестраивается, только если гамма изменилась
+ * Вызывается при запуске до задач, которые читают таблицу (LedBegin, DliInit)
+ * @param gamma Гамма ленты
+ */
+void LedGammaSetup(float gamma);
+
+/**
+ * Значение ШИМ канала светодиода по таблице LedGammaSetup
+ * Компонента цвета и общая яркость перемножаются в воспринимаемой яркости,
+ * гамма-коррекция применяется к произведению один раз (между узлами таблицы -
+ * линейная интерполяция). Ненулевое произведение дает ШИМ не меньше 1:
+ * включенная тусклая лента не гаснет из-за округления
+ * @param channel Компонента цвета, 0..255
+ * @param brightness Общая яркость, 0..255
+ * @return Значение ШИМ, 0..255
+ */
+uint8_t LedGammaLevel(uint8_t channel, uint8_t brightness);
+
+#endif
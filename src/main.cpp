@@ -6,74 +6,955 @@
 #include <WiFi.h>           // WiFi
 #include <AsyncTCP.h>       // Асинхронный TCP
 #include <ESPAsyncWebServer.h> // Веб-сервер
-#include <ESP32Servo.h>     // Сервопривод
-#include <FastLED.h>        // RGB-светодиоды
-#include <Adafruit_BME280.h> // Датчик темп/влаж/давл
 #include <Wire.h>           // I2C
-#include <BH1750.h>         // Датчик освещенности
-#include "page.h"           // HTML-страница
-
-// Прототип функции FillSolidColor
-void FillSolidColor(uint32_t c);
+#include <ArduinoJson.h>    // Разбор JSON в запросах
+#include "page_gz.h"        // Сжатая HTML-страница (генерируется tools/build_web.py)
+#include "sensors.h"        // Фоновый опрос датчиков
+#include "history.h"        // История показаний
+#include "clock.h"          // Программные часы
+#include "telemetry_log.h"  // Журнал показаний на флеш
+#include "climate.h"        // Автоматическое управление климатом
+#include "rules.h"          // Пользовательские правила автоматизации
+#include "schedule.h"       // Расписания полива и освещения
+#include "dli.h"            // Досветка по дневному интегралу освещенности
+#include "led.h"            // Вывод на RGB-ленту
+#include "actuators.h"      // Насос, вентилятор, форточка, освещение
+#include "metrics.h"        // Метрики для Prometheus
+#include "json_writer.h"    // Ответы API из статических буферов
+#include "power.h"          // Управление питанием
+#include "state_store.h"    // Состояние устройств и уставки в NVS
+#include "proto.h"          // Двоичный протокол телеметрии
+#include <esp_timer.h>
+#include <esp_system.h>
 
 // Настройки WiFi
 const char* ap_ssid = "ESP32_AP";
 const char* ap_password = "12345678";
 
-// Состояния устройств
-bool pumpState = false;    // Насос
-bool windState = false;    // Вентилятор
-bool windowState = false;  // Форточка
-bool lightState = false;   // Освещение
+// Создание объекта веб-сервера на порту 80
+AsyncWebServer server(80);
+// WebSocket для рассылки показаний и состояний устройств
+AsyncWebSocket ws("/ws");
+
+// Кэширование главной страницы: браузер открывает ее из кэша без запроса к устройству,
+// а версию сверяет в фоне уже после показа данных (страница перезагружается, если ETag изменился)
+#ifndef PAGE_CACHE_CONTROL
+#define PAGE_CACHE_CONTROL "max-age=604800"
+#endif
 
-// GPIO выводы
-const int pumpPin = 17;    // Насос
-const int windPin = 16;    // Вентилятор
-const int windowPin = 19;  // Сервопривод форточки
-const int lightPin = 18;   // Освещение
+// Наибольший размер тела PATCH /api/state, байты
+#ifndef API_STATE_MAX_JSON
+#define API_STATE_MAX_JSON 512
+#endif
 
-// Объект для управления сервоприводом форточки
-Servo servoWindow;
+// Наибольшие времена регулятора климата в POST /climate (min_on, min_off, ...), секунды
+#ifndef CLIMATE_MAX_SECONDS
+#define CLIMATE_MAX_SECONDS 86400
+#endif
 
-// Настройки RGB-ленты
-#define LED_PIN     18     // Пин данных для подключения RGB-ленты
-#define LED_COUNT   64     // Количество светодиодов в ленте
-#define LED_TYPE    SK6812 // Тип используемой RGB-ленты
-CRGB leds[LED_COUNT];      // Массив для хранения состояния каждого светодиода
+// Регулятор климата: уставки и состояние
+// Изменяются и обработчиками запросов, и основным циклом, поэтому защищены climateLock
+ClimateSettings climateSettings = ClimateDefaultSettings();
+ClimateState climateState;
+portMUX_TYPE climateLock = portMUX_INITIALIZER_UNLOCKED;
+// Конец ручного режима освещения (освещение не входит в регулятор климата)
+volatile uint32_t lightManualUntil = 0;
+volatile bool lightManual = false;
 
-// Инициализация датчиков
-BH1750 lightSensor;        // Датчик освещенности BH1750
-Adafruit_BME280 bme;       // Датчик температуры, влажности и давления BME280
+// Регулятор досветки: уставки меняют обработчики запросов, состояние - основной цикл
+DliSettings dliSettings = DliDefaultSettings();
+DliState dliState;
+portMUX_TYPE dliLock = portMUX_INITIALIZER_UNLOCKED;
+int dliPrevious = 0; // Уровень освещения до включения ленты регулятором, % (только основной цикл)
 
-// Создание объекта веб-сервера на порту 80
-AsyncWebServer server(80);
+/**
+ * Этапы запуска, мс от старта (esp_timer)
+ */
+struct BootTimes {
+    uint32_t wifiMs;         // Длительность запуска точки доступа
+    uint32_t setupMs;        // Окончание setup()
+    uint32_t firstRequestMs; // Первый обслуженный запрос (0 - запросов еще не было), пишет задача веб-сервера
+    bool restored;           // Состояние устройств восстановлено из NVS
+};
+BootTimes bootTimes = {};
+// Точка доступа запускается отдельной задачей параллельно с остальной инициализацией
+SemaphoreHandle_t wifiReady = NULL;
+volatile bool wifiStarted = false;
 
 /**
  * Функция преобразования шестнадцатеричного представления цвета в RGB
  * @param hexColor Строка с шестнадцатеричным представлением цвета (например, "#FF0000" для красного)
- * @return Целочисленное представление цвета в формате GRB (для FastLED)
+ * @param color Цвет (порядок байтов ленты учитывает FastLED)
+ * @return true, если строка - корректный цвет из шести шестнадцатеричных цифр
  */
-uint32_t HexToRGB(String hexColor) {
+bool HexToRGB(String hexColor, CRGB &color) {
     if (hexColor.startsWith("#")) {
         hexColor = hexColor.substring(1); // Убираем символ #
     }
-    uint32_t red = strtol(&hexColor[0], NULL, 16);   // Красный компонент
-    uint32_t green = strtol(&hexColor[2], NULL, 16); // Зеленый компонент
-    uint32_t blue = strtol(&hexColor[4], NULL, 16);  // Синий компонент
+    if (hexColor.length() != 6) {
+        return false;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (!isxdigit(hexColor[i])) {
+            return false;
+        }
+    }
+    uint32_t value = strtoul(hexColor.c_str(), NULL, 16);
+    color = CRGB((value >> 16) & 0xFF, (value >> 8) & 0xFF, value & 0xFF); // Красный, зеленый, синий
+    return true;
+}
 
-    // Для FastLED нужно поменять порядок на GRB
-    return (green << 16) | (red << 8) | blue;
+/**
+ * Форматирование цвета в виде "#RRGGBB"
+ * @param color Цвет
+ * @param text Буфер не меньше 8 байт
+ */
+void FormatColor(const CRGB &color, char *text) {
+    snprintf(text, 8, "#%02X%02X%02X", color.r, color.g, color.b);
 }
 
 /**
- * Функция для заполнения всей RGB-ленты одним цветом
- * @param c Цвет в формате GRB для FastLED
+ * Запись JSON с показаниями датчиков и состояниями устройств
+ * Используется и API-маршрутом /sensor/data, и рассылкой по WebSocket
+ * @param json Состояние записи
  */
-void FillSolidColor(uint32_t c) {
-    for (int i = 0; i < LED_COUNT; i++) {
-        leds[i] = c;
+void BuildStateJson(JsonWriter &json) {
+    SensorSnapshot snapshot;
+    SensorsGetSnapshot(snapshot);
+
+    // Показания неисправного датчика передаются как null, возраст снимка - в миллисекундах
+    JsonWriterObject(json);
+    JsonWriterFloat(json, "temperature", snapshot.bmeOk ? snapshot.temperature : NAN, 1);
+    JsonWriterFloat(json, "humidity", snapshot.bmeOk ? snapshot.humidity : NAN, 1);
+    JsonWriterFloat(json, "pressure", snapshot.bmeOk ? snapshot.pressure : NAN, 1);
+    JsonWriterFloat(json, "lux", snapshot.lightOk ? snapshot.lux : NAN, 1);
+    JsonWriterUint(json, "age", SensorsSnapshotAge(snapshot));
+    JsonWriterUint(json, "bus_us", snapshot.busUs);
+    JsonWriterUint(json, "filter_us", snapshot.filterUs);
+    // Исходные показания до фильтра
+    JsonWriterObject(json, "raw");
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        JsonWriterFloat(json, HistoryMetricName((HistoryMetric)m), snapshot.raw[m], 1);
     }
-    FastLED.show(); // Применение изменений и отображение цвета на ленте
+    JsonWriterEnd(json);
+    JsonWriterBool(json, "bme280", snapshot.bmeOk);
+    JsonWriterBool(json, "bh1750", snapshot.lightOk);
+    // Состояния устройств - из одного согласованного снимка
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    char color[8];
+    FormatColor(actuators.color, color);
+    JsonWriterBool(json, "pump", actuators.pump);
+    JsonWriterBool(json, "wind", actuators.wind);
+    JsonWriterBool(json, "window", actuators.windowTarget > 0);
+    JsonWriterUint(json, "window_angle", actuators.windowAngle);
+    JsonWriterUint(json, "window_target", actuators.windowTarget);
+    JsonWriterBool(json, "light", actuators.light);
+    JsonWriterUint(json, "brightness", actuators.brightness); // Яркость в процентах
+    JsonWriterString(json, "color", color);
+    JsonWriterEnd(json);
+}
+
+/**
+ * Насос заблокирован регулятором климата после выключений без роста влажности
+ */
+bool PumpFault() {
+    portENTER_CRITICAL(&climateLock);
+    bool fault = climateState.pumpFault;
+    portEXIT_CRITICAL(&climateLock);
+    return fault;
+}
+
+/**
+ * Запись JSON с заданным состоянием устройств для /api/state
+ * @param json Состояние записи
+ * @param state Снимок состояния устройств
+ */
+void BuildActuatorJson(JsonWriter &json, const ActuatorState &state) {
+    char color[8];
+    FormatColor(state.color, color);
+    JsonWriterObject(json);
+    JsonWriterUint(json, "version", state.version);
+    JsonWriterBool(json, "pump", state.pump);
+    JsonWriterBool(json, "wind", state.wind);
+    JsonWriterUint(json, "window_angle", state.windowTarget);
+    JsonWriterUint(json, "window_position", state.windowAngle); // Текущее положение во время движения
+    JsonWriterBool(json, "light", state.light);
+    JsonWriterUint(json, "brightness", state.brightness);
+    JsonWriterString(json, "color", color);
+    JsonWriterBool(json, "pump_fault", PumpFault());
+    JsonWriterEnd(json);
+}
+
+/**
+ * Клиент запросил двоичный протокол: заголовок Accept содержит PROTO_MEDIA_TYPE
+ * @param request Запрос
+ */
+bool WantsProto(AsyncWebServerRequest *request) {
+    return request->hasHeader("Accept") && request->getHeader("Accept")->value().indexOf(PROTO_MEDIA_TYPE) >= 0;
+}
+
+/**
+ * Ответ с состоянием устройств; версия передается и в ETag для условных запросов
+ * @param request Запрос
+ * @param code Код ответа
+ * @param state Снимок состояния устройств
+ */
+void SendActuatorState(AsyncWebServerRequest *request, int code, const ActuatorState &state) {
+    JsonWriter json;
+    JsonWriterBeginResponse(json);
+    char etag[16];
+    snprintf(etag, sizeof(etag), "\"%u\"", (unsigned)state.version);
+    if (WantsProto(request)) {
+        json.length = ProtoEncodeState((uint8_t *)json.buffer, json.size, state);
+        json.overflow = json.length == 0;
+        JsonWriterSendAs(request, code, json, PROTO_CONTENT_TYPE, etag);
+        return;
+    }
+    BuildActuatorJson(json, state);
+    JsonWriterSend(request, code, json, etag);
+}
+
+/**
+ * Рассылка состояния всем клиентам WebSocket, если появились новые данные
+ * Кадр формируется один раз и отправляется всем клиентам
+ */
+void BroadcastState() {
+    static uint32_t lastSequence = 0;
+    static uint32_t lastVersion = 0;
+
+    SensorSnapshot snapshot;
+    SensorsGetSnapshot(snapshot);
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    if (snapshot.sequence == lastSequence && actuators.version == lastVersion) {
+        return;
+    }
+    lastSequence = snapshot.sequence;
+    lastVersion = actuators.version;
+
+    if (ws.count() == 0) {
+        return;
+    }
+    static char frame[JSON_RESPONSE_MAX]; // Только для основного цикла
+    JsonWriter json;
+    JsonWriterBegin(json, frame, sizeof(frame));
+    BuildStateJson(json);
+    if (JsonWriterFinish(json)) {
+        ws.textAll(frame, json.length);
+    }
+}
+
+/**
+ * Запись нового снимка показаний в историю и журнал на флеш
+ * Время истории - секунды с момента включения, журнала - по программным часам
+ */
+void RecordHistory() {
+    static uint32_t lastSequence = 0;
+
+    SensorSnapshot snapshot;
+    SensorsGetSnapshot(snapshot);
+    if (snapshot.sequence == lastSequence) {
+        return;
+    }
+    lastSequence = snapshot.sequence;
+
+    const float values[HISTORY_METRIC_COUNT] = {snapshot.temperature, snapshot.humidity, snapshot.pressure, snapshot.lux};
+    const bool valid[HISTORY_METRIC_COUNT] = {snapshot.bmeOk, snapshot.bmeOk, snapshot.bmeOk && !isnan(snapshot.pressure), snapshot.lightOk};
+    HistoryAdd(ClockUptime(), values, valid);
+    TelemetryLogAdd(ClockNow(), values, valid);
+}
+
+/**
+ * Включение или выключение насоса
+ * Команда ставится в очередь и применяется задачей устройств
+ * @param on true - включить
+ */
+void SetPump(bool on) {
+    ActuatorSet(ACTUATOR_PUMP, on);
+}
+
+/**
+ * Включение или выключение вентилятора
+ * @param on true - включить
+ */
+void SetWind(bool on) {
+    ActuatorSet(ACTUATOR_WIND, on);
+}
+
+/**
+ * Установка угла открытия форточки
+ * @param angle Угол, 0 - закрыта, 90 - открыта полностью
+ */
+void SetWindowAngle(int angle) {
+    ActuatorSet(ACTUATOR_WINDOW, constrain(angle, 0, CLIMATE_WINDOW_OPEN_ANGLE));
+}
+
+/**
+ * Включение или выключение освещения
+ * @param on true - включить с максимальной яркостью RGB-ленты
+ */
+void SetLight(bool on) {
+    ActuatorSet(ACTUATOR_LIGHT, on);
+}
+
+/**
+ * Установка яркости RGB-ленты
+ * @param percent Яркость, 0..100 %
+ */
+void SetLightBrightness(int percent) {
+    ActuatorSet(ACTUATOR_BRIGHTNESS, constrain(percent, 0, 100));
+}
+
+/**
+ * Установка уровня освещения одним значением (для правил автоматизации)
+ * @param percent Яркость, %; 0 - освещение выключено
+ */
+void SetLightLevel(int percent) {
+    SetLight(percent > 0);
+    if (percent > 0) {
+        SetLightBrightness(percent); // Применяется после включения, которое задает полную яркость
+    }
+}
+
+/**
+ * Текущий уровень освещения
+ * @return Яркость, %; 0 - освещение выключено
+ */
+int LightLevel() {
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    return actuators.light ? actuators.brightness : 0;
+}
+
+/**
+ * Перевод освещения в ручной режим после команды пользователя
+ * Длительность ручного режима - та же, что у устройств регулятора климата
+ */
+void LightManual() {
+    portENTER_CRITICAL(&climateLock);
+    lightManualUntil = millis() + climateSettings.manualTimeoutMs;
+    lightManual = true;
+    portEXIT_CRITICAL(&climateLock);
+}
+
+/**
+ * Перевод устройства в ручной режим после команды пользователя
+ * @param actuator Устройство
+ * @param value Установленное значение (угол форточки или 0/1 для реле)
+ */
+void ClimateManual(ClimateActuator actuator, int value) {
+    portENTER_CRITICAL(&climateLock);
+    ClimateManualOverride(climateState, climateSettings, actuator, value, millis());
+    portEXIT_CRITICAL(&climateLock);
+}
+
+// Устройства регулятора климата, соответствующие устройствам правил (-1 - нет в регуляторе)
+const int ruleClimateActuator[RULE_ACTUATOR_COUNT] = {CLIMATE_PUMP, CLIMATE_FAN, CLIMATE_WINDOW, -1};
+// Устройства правил, соответствующие устройствам расписания (-1 - цвет ленты, удерживается отдельно)
+const int scheduleRuleActuator[SCHEDULE_ACTUATOR_COUNT] = {RULE_PUMP, RULE_WIND, RULE_WINDOW, RULE_LIGHT, -1};
+
+// Удержание устройств правилами и расписанием (только основной цикл)
+bool ruleHeld[RULE_ACTUATOR_COUNT];
+int rulePrevious[RULE_ACTUATOR_COUNT]; // Значение до начала удержания
+bool colorHeld = false;                // Цвет ленты задан расписанием
+CRGB colorPrevious;                    // Цвет до начала удержания
+
+/**
+ * Текущее значение устройства в единицах правил
+ * @param actuator Устройство
+ * @return 0/1 для реле, угол для форточки, яркость в % для освещения
+ */
+int RuleActuatorValue(RuleActuator actuator) {
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    switch (actuator) {
+        case RULE_PUMP:
+            return actuators.pump ? 1 : 0;
+        case RULE_WIND:
+            return actuators.wind ? 1 : 0;
+        case RULE_WINDOW:
+            return actuators.windowTarget;
+        case RULE_LIGHT:
+            return LightLevel();
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Установка устройства значением правила
+ * @param actuator Устройство
+ * @param value 0/1 для реле, угол для форточки, яркость в % для освещения
+ */
+void ApplyRuleActuator(RuleActuator actuator, int value) {
+    switch (actuator) {
+        case RULE_PUMP:
+            SetPump(value != 0);
+            break;
+        case RULE_WIND:
+            SetWind(value != 0);
+            break;
+        case RULE_WINDOW:
+            SetWindowAngle(value);
+            break;
+        case RULE_LIGHT:
+            SetLightLevel(value);
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Устройство в ручном режиме: правила его не трогают
+ */
+bool RuleActuatorManual(RuleActuator actuator, uint32_t now) {
+    bool manual;
+    portENTER_CRITICAL(&climateLock);
+    if (actuator == RULE_LIGHT) {
+        if (lightManual && (int32_t)(lightManualUntil - now) <= 0) {
+            lightManual = false;
+        }
+        manual = lightManual;
+    } else {
+        manual = ClimateManualRemaining(climateState, (ClimateActuator)ruleClimateActuator[actuator], now) > 0;
+    }
+    portEXIT_CRITICAL(&climateLock);
+    return manual;
+}
+
+/**
+ * Удержание цвета ленты заданием расписания
+ * Как и освещение, цвет не меняется, пока освещение в ручном режиме
+ * @param scheduled Устройства, удерживаемые расписанием
+ * @param now Текущее время, мс
+ */
+void ScheduleColorLoop(const ScheduleOutputs &scheduled, uint32_t now) {
+    static int32_t applied;
+    bool manual = RuleActuatorManual(RULE_LIGHT, now);
+    bool hold = scheduled.set[SCHEDULE_COLOR] && !manual;
+    if (hold) {
+        if (!colorHeld) {
+            ActuatorState actuators;
+            ActuatorsGetState(actuators);
+            colorPrevious = actuators.color;
+        }
+        if (!colorHeld || applied != scheduled.value[SCHEDULE_COLOR]) {
+            applied = scheduled.value[SCHEDULE_COLOR];
+            ActuatorSet(ACTUATOR_COLOR, applied);
+        }
+    } else if (colorHeld && !manual) {
+        ActuatorSet(ACTUATOR_COLOR, ((uint32_t)colorPrevious.r << 16) | (colorPrevious.g << 8) | colorPrevious.b);
+    }
+    colorHeld = hold;
+}
+
+/**
+ * Такт правил автоматизации и расписания
+ * Сработавшее правило или действующее задание удерживает устройство; после отпускания
+ * устройство возвращается к значению, которое было до удержания.
+ * Задание расписания действует как правило с наименьшим приоритетом: сработавшее правило важнее
+ * @param snapshot Снимок показаний
+ * @param now Текущее время, мс
+ */
+void RulesLoop(const SensorSnapshot &snapshot, uint32_t now) {
+    static int applied[RULE_ACTUATOR_COUNT];  // Значение, установленное правилом
+
+    RuleInputs inputs = {
+        {snapshot.temperature, snapshot.humidity, snapshot.pressure, snapshot.lux},
+        {snapshot.bmeOk, snapshot.bmeOk, snapshot.bmeOk && !isnan(snapshot.pressure), snapshot.lightOk},
+        ClockMinuteOfDay(),
+        now
+    };
+    RuleOutputs outputs;
+    RulesEvaluate(inputs, outputs);
+
+    ScheduleOutputs scheduled;
+    ScheduleGetOutputs(scheduled);
+    for (int i = 0; i < SCHEDULE_ACTUATOR_COUNT; i++) {
+        int actuator = scheduleRuleActuator[i];
+        if (actuator >= 0 && scheduled.set[i] && !outputs.set[actuator]) {
+            outputs.set[actuator] = true;
+            outputs.value[actuator] = scheduled.value[i];
+        }
+    }
+    ScheduleColorLoop(scheduled, now);
+
+    for (int i = 0; i < RULE_ACTUATOR_COUNT; i++) {
+        RuleActuator actuator = (RuleActuator)i;
+        // Команда пользователя важнее правила; значение пользователя после отпускания не восстанавливается
+        bool manual = RuleActuatorManual(actuator, now);
+        bool hold = outputs.set[i] && !manual;
+        // Команды применяются задачей устройств позже, поэтому регулятору передается заданное значение
+        int value = RuleActuatorValue(actuator);
+        if (hold) {
+            if (!ruleHeld[i]) {
+                rulePrevious[i] = value;
+            }
+            if (!ruleHeld[i] || applied[i] != outputs.value[i]) {
+                applied[i] = outputs.value[i];
+                ApplyRuleActuator(actuator, applied[i]);
+            }
+            value = applied[i];
+        } else if (ruleHeld[i] && !manual) {
+            ApplyRuleActuator(actuator, rulePrevious[i]);
+            value = rulePrevious[i];
+        }
+        ruleHeld[i] = hold;
+
+        // Регулятор климата пропускает удерживаемые устройства и продолжает с их текущего значения
+        if (ruleClimateActuator[i] >= 0) {
+            portENTER_CRITICAL(&climateLock);
+            ClimateHold(climateState, (ClimateActuator)ruleClimateActuator[i], hold, value, now);
+            portEXIT_CRITICAL(&climateLock);
+        }
+    }
+}
+
+/**
+ * Такт регулятора досветки
+ * Лента, удерживаемая правилом, расписанием или пользователем, регулятору не отдается
+ * @param snapshot Снимок показаний
+ * @param now Текущее время, мс
+ */
+void DliLoop(const SensorSnapshot &snapshot, uint32_t now) {
+    DliInputs inputs;
+    inputs.lux = snapshot.lux;
+    inputs.valid = snapshot.lightOk;
+    inputs.secondOfDay = -1;
+    inputs.day = 0;
+    uint32_t clock = ClockNow();
+    if (ClockSynced()) {
+        uint32_t local = clock + ClockTimezone() * 60;
+        inputs.secondOfDay = local % 86400;
+        inputs.day = local / 86400;
+    }
+    inputs.lightLevel = LightLevel();
+    inputs.held = ruleHeld[RULE_LIGHT] || RuleActuatorManual(RULE_LIGHT, now);
+    inputs.nowMs = now;
+
+    portENTER_CRITICAL(&dliLock);
+    bool wasDriving = dliState.driving;
+    DliCommand command = DliTick(dliState, dliSettings, inputs);
+    portEXIT_CRITICAL(&dliLock);
+
+    // Сутки начались или впервые известны (после перезапуска - после синхронизации часов):
+    // накопленное с полуночи восстанавливается по журналу, записи которого - средние за минуту
+    if (command.dayStarted) {
+        float luxSum;
+        TelemetryLogSum(HISTORY_LUX, clock - inputs.secondOfDay, clock, luxSum);
+        portENTER_CRITICAL(&dliLock);
+        DliRestore(dliState, dliSettings, luxSum * LOG_INTERVAL_S);
+        portEXIT_CRITICAL(&dliLock);
+    }
+
+    if (command.changed) {
+        if (!wasDriving) {
+            dliPrevious = inputs.lightLevel;
+        }
+        if (command.brightness > 0 && inputs.lightLevel > 0) {
+            SetLightBrightness(command.brightness);
+        } else {
+            SetLightLevel(command.brightness);
+        }
+    }
+}
+
+/**
+ * Такт правил автоматизации и регулятора климата
+ * Выполняется из основного цикла строго раз в CLIMATE_TICK_MS
+ */
+void ClimateLoop() {
+    static uint32_t nextTick = millis();
+    if ((int32_t)(millis() - nextTick) < 0) {
+        return;
+    }
+    nextTick += CLIMATE_TICK_MS;
+
+    SensorSnapshot snapshot;
+    SensorsGetSnapshot(snapshot);
+
+    // Правила и расписание выполняются первыми: удерживаемые ими устройства регулятор пропускает
+    ScheduleLoop(ClockNow(), ClockTimezone());
+    RulesLoop(snapshot, millis());
+    DliLoop(snapshot, millis());
+
+    portENTER_CRITICAL(&climateLock);
+    bool pumpFault = climateState.pumpFault;
+    ClimateCommand command = ClimateTick(climateState, climateSettings, snapshot.temperature,
+                                         snapshot.humidity, snapshot.bmeOk, millis());
+    bool pumpFaultLatched = !pumpFault && climateState.pumpFault;
+    portEXIT_CRITICAL(&climateLock);
+
+    if (pumpFaultLatched) {
+        Serial.println("Насос заблокирован: влажность не растет после выключений по max_pump_on, проверьте бак");
+    }
+
+    if (command.changed[CLIMATE_FAN]) {
+        SetWind(command.fan);
+    }
+    if (command.changed[CLIMATE_PUMP]) {
+        SetPump(command.pump);
+    }
+    if (command.changed[CLIMATE_WINDOW]) {
+        SetWindowAngle(command.windowAngle);
+    }
+}
+
+/**
+ * Ответ с уставками и режимами регулятора климата
+ * @param request Запрос
+ */
+void SendClimateJson(AsyncWebServerRequest *request) {
+    portENTER_CRITICAL(&climateLock);
+    ClimateSettings settings = climateSettings;
+    uint32_t now = millis();
+    uint32_t manual[CLIMATE_ACTUATOR_COUNT];
+    for (int i = 0; i < CLIMATE_ACTUATOR_COUNT; i++) {
+        manual[i] = ClimateManualRemaining(climateState, (ClimateActuator)i, now);
+    }
+    bool pumpFault = climateState.pumpFault;
+    portEXIT_CRITICAL(&climateLock);
+
+    JsonWriter json;
+    JsonWriterBeginResponse(json);
+    JsonWriterObject(json);
+    JsonWriterBool(json, "enabled", settings.enabled);
+    JsonWriterFloat(json, "fan_temperature", settings.fanTemperature, 1);
+    JsonWriterFloat(json, "fan_humidity", settings.fanHumidity, 1);
+    JsonWriterFloat(json, "vent_temperature", settings.ventTemperature, 1);
+    JsonWriterFloat(json, "vent_full_temperature", settings.ventFullTemperature, 1);
+    JsonWriterFloat(json, "pump_humidity", settings.pumpHumidity, 1);
+    JsonWriterFloat(json, "hysteresis", settings.hysteresis, 1);
+    JsonWriterUint(json, "min_on", settings.minOnMs / 1000);
+    JsonWriterUint(json, "min_off", settings.minOffMs / 1000);
+    JsonWriterUint(json, "window_move", settings.windowMoveMs / 1000);
+    JsonWriterUint(json, "manual_timeout", settings.manualTimeoutMs / 1000);
+    JsonWriterUint(json, "max_pump_on", settings.maxPumpOnMs / 1000);
+    JsonWriterBool(json, "pump_fault", pumpFault);
+    // Оставшееся время ручного режима по устройствам, секунды (0 - автоматический режим)
+    JsonWriterObject(json, "manual");
+    JsonWriterUint(json, "wind", manual[CLIMATE_FAN] / 1000);
+    JsonWriterUint(json, "window", manual[CLIMATE_WINDOW] / 1000);
+    JsonWriterUint(json, "pump", manual[CLIMATE_PUMP] / 1000);
+    JsonWriterEnd(json);
+    JsonWriterEnd(json);
+    JsonWriterSend(request, 200, json);
+}
+
+/**
+ * Запись времени суток "ЧЧ:ММ"
+ * @param json Ответ
+ * @param key Ключ
+ * @param minute Минуты от полуночи
+ */
+void WriteDayMinute(JsonWriter &json, const char *key, uint16_t minute) {
+    char text[8];
+    snprintf(text, sizeof(text), "%02u:%02u", minute / 60, minute % 60);
+    JsonWriterString(json, key, text);
+}
+
+/**
+ * Разбор времени суток "ЧЧ:ММ" (до 24:00 включительно)
+ * @return Минуты от полуночи или -1 при ошибке
+ */
+int ParseDayMinute(const char *text) {
+    int hours, minutes;
+    char tail;
+    if (sscanf(text, "%d:%d%c", &hours, &minutes, &tail) != 2 || hours < 0 || minutes < 0 || minutes > 59 ||
+        hours * 60 + minutes > 24 * 60) {
+        return -1;
+    }
+    return hours * 60 + minutes;
+}
+
+/**
+ * Ответ с уставками и состоянием регулятора досветки
+ * @param request Запрос
+ */
+void SendDliJson(AsyncWebServerRequest *request) {
+    portENTER_CRITICAL(&dliLock);
+    DliSettings settings = dliSettings;
+    DliState state = dliState;
+    portEXIT_CRITICAL(&dliLock);
+
+    JsonWriter json;
+    JsonWriterBeginResponse(json);
+    JsonWriterObject(json);
+    JsonWriterBool(json, "enabled", settings.enabled);
+    JsonWriterString(json, "crop", DliCropName(settings.crop));
+    JsonWriterFloat(json, "target", settings.target, 1);
+    WriteDayMinute(json, "start", settings.startMinute);
+    WriteDayMinute(json, "end", settings.endMinute);
+    JsonWriterFloat(json, "lux_to_ppfd", settings.luxToPpfd, 5);
+    JsonWriterFloat(json, "led_ppfd", settings.ledPpfd, 1);
+    JsonWriterFloat(json, "ramp", settings.rampPerMinute, 1);
+    JsonWriterUint(json, "min_brightness", settings.minBrightness);
+    JsonWriterUint(json, "max_brightness", settings.maxBrightness);
+    JsonWriterFloat(json, "forecast", settings.forecast, 2);
+    // Состояние: DLI в моль/м², PPFD в мкмоль/(м²·с); до синхронизации часов сутки неизвестны
+    JsonWriterBool(json, "active", state.active);
+    JsonWriterBool(json, "driving", state.driving);
+    JsonWriterUint(json, "brightness", state.output);
+    if (state.dayKnown) {
+        JsonWriterFloat(json, "dli", state.accumulated, 3);
+        JsonWriterFloat(json, "led_dli", state.ledAccumulated, 3);
+    } else {
+        JsonWriterNull(json, "dli");
+        JsonWriterNull(json, "led_dli");
+    }
+    JsonWriterFloat(json, "yesterday", state.yesterday, 3);
+    JsonWriterFloat(json, "ppfd", state.ppfd, 1);
+    JsonWriterFloat(json, "natural_ppfd", state.naturalPpfd, 1);
+    JsonWriterFloat(json, "required_ppfd", state.requiredPpfd, 1);
+    JsonWriterFloat(json, "forecast_dli", state.forecastNatural, 3);
+    // Средний естественный PPFD по часам суток (null - час еще не учтен)
+    JsonWriterArray(json, "profile");
+    for (int i = 0; i < DLI_PROFILE_SLOTS; i++) {
+        JsonWriterFloat(json, NULL, state.profile[i] >= 0 ? state.profile[i] : NAN, 1);
+    }
+    JsonWriterEnd(json);
+    JsonWriterEnd(json);
+    JsonWriterSend(request, 200, json);
+}
+
+/**
+ * Ответ с таблицей правил; выдается по частям, по одному правилу
+ * @param request Запрос
+ */
+void SendRulesJson(AsyncWebServerRequest *request) {
+    RulesStream stream = {};
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+            return RulesStreamChunk(stream, buffer, maxLen);
+        });
+    request->send(response);
+}
+
+/**
+ * Ответ с таблицей заданий расписания; выдается по частям, по одному заданию
+ * @param request Запрос
+ */
+void SendScheduleJson(AsyncWebServerRequest *request) {
+    ScheduleStream stream = {};
+    AsyncWebServerResponse *response = request->beginChunkedResponse("application/json",
+        [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+            return ScheduleStreamChunk(stream, buffer, maxLen);
+        });
+    request->send(response);
+}
+
+/**
+ * Чтение числового параметра POST-запроса
+ * @param request Запрос
+ * @param name Имя параметра
+ * @param value Значение (не изменяется, если параметра нет)
+ * @return true, если параметр есть
+ */
+bool ReadFloatParam(AsyncWebServerRequest *request, const char *name, float &value) {
+    if (!request->hasParam(name, true)) {
+        return false;
+    }
+    value = request->getParam(name, true)->value().toFloat();
+    return true;
+}
+
+/**
+ * Чтение длительности в секундах из параметра запроса с проверкой диапазона 0..CLIMATE_MAX_SECONDS
+ * @param request Запрос
+ * @param name Имя параметра
+ * @param ms Длительность, мс (не изменяется, если параметра нет)
+ * @return false, если значение вне диапазона (ответ 400 уже отправлен)
+ */
+bool ReadSecondsParam(AsyncWebServerRequest *request, const char *name, uint32_t &ms) {
+    float value;
+    if (!ReadFloatParam(request, name, value)) {
+        return true;
+    }
+    if (!(value >= 0 && value <= CLIMATE_MAX_SECONDS)) {
+        request->send(400, "text/plain", String(name) + ": 0.." + String(CLIMATE_MAX_SECONDS) + " s");
+        return false;
+    }
+    ms = lroundf(value * 1000);
+    return true;
+}
+
+/**
+ * Сохранение состояния устройств и уставок климата
+ * Запись в NVS откладывается, пока изменения не прекратятся, и выполняется одна на серию
+ */
+void PersistState() {
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    StoredState current;
+    StateStoreDefaults(current);
+    current.pump = actuators.pump;
+    current.wind = actuators.wind;
+    current.light = actuators.light;
+    current.windowAngle = actuators.windowTarget;
+    current.brightness = actuators.brightness;
+    current.color[0] = actuators.color.r;
+    current.color[1] = actuators.color.g;
+    current.color[2] = actuators.color.b;
+    // Удерживаемые правилами и расписанием устройства сохраняются со значением до удержания:
+    // удержание, которое еще действует, после перезапуска установится заново
+    if (ruleHeld[RULE_PUMP]) {
+        current.pump = rulePrevious[RULE_PUMP] != 0;
+    }
+    if (ruleHeld[RULE_WIND]) {
+        current.wind = rulePrevious[RULE_WIND] != 0;
+    }
+    if (ruleHeld[RULE_WINDOW]) {
+        current.windowAngle = rulePrevious[RULE_WINDOW];
+    }
+    if (ruleHeld[RULE_LIGHT]) {
+        current.light = rulePrevious[RULE_LIGHT] > 0;
+        if (current.light) {
+            current.brightness = rulePrevious[RULE_LIGHT];
+        }
+    }
+    // Яркость, которую ведет регулятор досветки, меняется часто и после синхронизации часов установится заново
+    if (dliState.driving) {
+        current.light = dliPrevious > 0;
+        if (current.light) {
+            current.brightness = dliPrevious;
+        }
+    }
+    if (colorHeld) {
+        current.color[0] = colorPrevious.r;
+        current.color[1] = colorPrevious.g;
+        current.color[2] = colorPrevious.b;
+    }
+    portENTER_CRITICAL(&climateLock);
+    current.climate = climateSettings;
+    current.pumpFault = climateState.pumpFault;
+    // Насос, которым управляет регулятор, сохраняется выключенным: после перезапуска регулятор
+    // включит его по новым показаниям, а не продолжит полив, начатый до перезапуска
+    if (climateSettings.enabled && !climateState.manual[CLIMATE_PUMP]) {
+        current.pump = false;
+    }
+    portEXIT_CRITICAL(&climateLock);
+    portENTER_CRITICAL(&dliLock);
+    current.dli = dliSettings;
+    portEXIT_CRITICAL(&dliLock);
+    StateStoreLoop(current, millis());
+}
+
+/**
+ * Задача запуска точки доступа; завершается после запуска
+ */
+void WifiStartTask(void *) {
+    int64_t started = esp_timer_get_time();
+    wifiStarted = WiFi.softAP(ap_ssid, ap_password);
+    bootTimes.wifiMs = (uint32_t)((esp_timer_get_time() - started) / 1000);
+    xSemaphoreGive(wifiReady);
+    vTaskDelete(NULL);
+}
+
+/**
+ * Название причины последнего перезапуска
+ */
+const char *ResetReasonName(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON:
+            return "power_on";
+        case ESP_RST_BROWNOUT:
+            return "brownout";
+        case ESP_RST_SW:
+            return "software";
+        case ESP_RST_PANIC:
+            return "panic";
+        case ESP_RST_INT_WDT:
+        case ESP_RST_TASK_WDT:
+        case ESP_RST_WDT:
+            return "watchdog";
+        case ESP_RST_EXT:
+            return "external";
+        case ESP_RST_DEEPSLEEP:
+            return "deep_sleep";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * Обертка обработчика HTTP-запроса с учетом его длительности в метриках
+ * Для потоковых ответов учитывается только подготовка ответа, без выдачи данных
+ * Запрос отмечается как активность пользователя, кроме опроса метрик и состояния питания
+ * Время окончания первого запроса после запуска сохраняется в bootTimes
+ * @param route Маршрут для метрик
+ * @param handler Обработчик
+ * @return Обработчик для server.on
+ */
+ArRequestHandlerFunction Timed(MetricsTiming route, ArRequestHandlerFunction handler) {
+    return [route, handler](AsyncWebServerRequest *request) {
+        if (route != METRICS_ROUTE_METRICS && route != METRICS_ROUTE_POWER) {
+            PowerActivity();
+        }
+        int64_t started = esp_timer_get_time();
+        handler(request);
+        int64_t finished = esp_timer_get_time();
+        MetricsObserve(route, (uint32_t)(finished - started));
+        if (bootTimes.firstRequestMs == 0) {
+            bootTimes.firstRequestMs = max((uint32_t)(finished / 1000), (uint32_t)1);
+            Serial.printf("Первый запрос обслужен через %u мс после запуска\n", (unsigned)bootTimes.firstRequestMs);
+        }
+    };
+}
+
+/**
+ * Сборка тела запроса в буфер request->_tempObject (освобождается вместе с запросом)
+ * Тело больше maxLen не собирается: обработчик запроса получит NULL
+ * @param request Запрос
+ * @param data Очередная часть тела
+ * @param len Длина части
+ * @param index Смещение части в теле
+ * @param total Полная длина тела
+ * @param maxLen Наибольшая допустимая длина
+ */
+void CollectBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total, size_t maxLen) {
+    if (total > maxLen) {
+        return;
+    }
+    if (index == 0) {
+        request->_tempObject = calloc(total + 1, 1);
+    }
+    if (request->_tempObject != NULL) {
+        memcpy((char *)request->_tempObject + index, data, len);
+    }
+}
+
+/**
+ * Чтение одного поля документа /api/state в пакет команд
+ * @param field Значение поля (null - поле отсутствует)
+ * @param batch Пакет команд
+ * @param id Устройство
+ * @param maxValue Наибольшее числовое значение (для логических полей - 1)
+ * @return false, если значение недопустимо
+ */
+bool ReadStateField(JsonVariant field, ActuatorBatch &batch, ActuatorId id, int maxValue) {
+    if (field.isNull()) {
+        return true;
+    }
+    int value;
+    if (maxValue == 1) {
+        if (!field.is<bool>()) {
+            return false;
+        }
+        value = field.as<bool>() ? 1 : 0;
+    } else {
+        if (!field.is<int>()) {
+            return false;
+        }
+        value = field.as<int>();
+    }
+    if (value < 0 || value > maxValue) {
+        return false;
+    }
+    batch.set[id] = true;
+    batch.value[id] = value;
+    return true;
 }
 
 /**
@@ -88,200 +969,816 @@ void setup() {
     // Инициализация шины I2C для работы с датчиками
     Wire.begin(21, 22); // GP21 - SDA, GP22 - SCL (линии данных I2C)
 
-    // Инициализация и проверка датчика освещенности
-    if (!lightSensor.begin()) {
-        Serial.println("Ошибка инициализации BH1750");
-    } else {
-        Serial.println("BH1750 инициализирован");
-    }
-    
-    // Инициализация и проверка датчика температуры/влажности/давления
-    // 0x77 - I2C-адрес датчика BME280
-    if (!bme.begin(0x77)) { 
-        Serial.println("Ошибка инициализации BME280");
-    } else {
-        Serial.println("BME280 инициализирован");
-    }
+    // Создание точки доступа WiFi - в отдельной задаче на другом ядре, пока идет остальная инициализация
+    wifiReady = xSemaphoreCreateBinary();
+    xTaskCreatePinnedToCore(WifiStartTask, "wifi_start", 4096, NULL, 1, NULL, 0);
 
-    // Настройка выводов GPIO для управления устройствами
-    pinMode(pumpPin, OUTPUT);   // Настройка пина насоса как выход
-    pinMode(windPin, OUTPUT);   // Настройка пина вентилятора как выход
-    pinMode(lightPin, OUTPUT);  // Настройка пина освещения как выход
-    // Установка начальных состояний (все выключено)
-    digitalWrite(pumpPin, LOW);
-    digitalWrite(windPin, LOW);
-    digitalWrite(lightPin, LOW);
+    // Запуск фоновой задачи опроса; датчики инициализируются в ней с повторами
+    SensorsBegin();
 
-    // Создание точки доступа WiFi
-    if (WiFi.softAP(ap_ssid, ap_password)) {
-        Serial.println("Access Point started.");
-        Serial.print("Connect to SSID: ");
-        Serial.println(ap_ssid);
-        Serial.print("Password: ");
-        Serial.println(ap_password);
-        Serial.println("IP address: 192.168.4.1"); // IP-адрес по умолчанию для точки доступа
-    } else {
-        Serial.println("Failed to create Access Point.");
-        return;
+    // Состояние устройств и уставки до перезапуска (при первом запуске - все выключено)
+    StoredState stored;
+    bootTimes.restored = StateStoreLoad(stored);
+    Serial.printf("Перезапуск: %s, состояние %s\n", ResetReasonName(esp_reset_reason()),
+                  bootTimes.restored ? "восстановлено" : "по умолчанию");
+    climateSettings = stored.climate;
+    dliSettings = stored.dli;
+    DliInit(dliState, LED_GAMMA);
+
+    // Выводы устройств и сервопривод форточки в сохраненном состоянии, запуск задачи устройств
+    ActuatorState initial = {};
+    initial.pump = stored.pump;
+    initial.wind = stored.wind;
+    initial.light = stored.light;
+    initial.windowTarget = stored.windowAngle;
+    initial.brightness = stored.brightness;
+    initial.color = CRGB(stored.color[0], stored.color[1], stored.color[2]);
+    ActuatorsBegin(initial);
+
+    // Инициализация RGB-ленты в сохраненном цвете и яркости
+    LedBegin(initial.color, map(initial.brightness, 0, 100, 0, 255));
+
+    // Регулятор климата начинает с восстановленных состояний устройств
+    ClimateInit(climateState, stored.wind, stored.pump, stored.windowAngle, millis());
+    // Блокировка насоса переживает перезапуск: пустой бак от перезапуска не наполнится
+    climateState.pumpFault = stored.pumpFault;
+
+    // Восстановление журнала на флеш; часы продолжают отсчет от его последней записи
+    if (TelemetryLogBegin()) {
+        TelemetryLogStats logStats;
+        TelemetryLogGetStats(logStats);
+        Serial.printf("Журнал: %u записей, восстановлен за %u мс\n",
+                      (unsigned)logStats.records, (unsigned)logStats.recoveryMs);
     }
+    ClockBegin(TelemetryLogLastTime() + LOG_INTERVAL_S);
 
-    // Инициализация сервопривода для форточки
-    servoWindow.attach(windowPin);  // Привязка сервопривода к соответствующему пину
-    servoWindow.write(0);           // Установка начального положения (форточка закрыта)
+    // Правила автоматизации, сохраненные в NVS
+    if (RulesBegin()) {
+        RulesStats rulesStats;
+        RulesGetStats(rulesStats);
+        Serial.printf("Правила: %u загружено\n", (unsigned)rulesStats.count);
+    }
+
+    // Настройки отправки на сборщик
+    ProtoPushBegin();
 
-    // Инициализация RGB-ленты
-    FastLED.addLeds<LED_TYPE, LED_PIN, GRB>(leds, LED_COUNT); // Настройка типа ленты и порядка цветов
-    FastLED.setBrightness(50);                                // Начальная яркость 50/255
-    FillSolidColor(0xFFFFFF);                                 // Установка белого цвета
+    // Задания расписания, сохраненные в NVS
+    if (ScheduleBegin()) {
+        ScheduleStats scheduleStats;
+        ScheduleGetStats(scheduleStats);
+        Serial.printf("Расписание: %u заданий загружено\n", (unsigned)scheduleStats.count);
+    }
 
     // Настройка маршрутов веб-сервера
     
     // Обработка запросов к главной странице
-    server.on("/", HTTP_GET, [](AsyncWebServerRequest *request) {
-        String page = PAGE; // Получение шаблона HTML-страницы
-
-        // Получение данных с датчиков
-        float temperature = bme.readTemperature();    // Чтение температуры в °C
-        float humidity = bme.readHumidity();          // Чтение относительной влажности в %
-        float pressure = bme.readPressure() / 100.0F; // Чтение давления в гПа
-        float lux = lightSensor.readLightLevel();     // Чтение уровня освещенности в люксах
-
-        // Замена плейсхолдеров в HTML-шаблоне на актуальные значения
-        page.replace("%TEMPERATURE%", String(temperature, 1)); // Температура с одним знаком после запятой
-        page.replace("%HUMIDITY%", String(humidity, 1));       // Влажность с одним знаком после запятой
-        page.replace("%PRESSURE%", String(pressure, 1));       // Давление с одним знаком после запятой
-        page.replace("%LUX%", String(lux, 1));                 // Освещенность с одним знаком после запятой
-        // Установка состояний переключателей в зависимости от текущего состояния устройств
-        page.replace("%WINDOW_STATE%", windowState ? "checked" : "");
-        page.replace("%PUMP_STATE%", pumpState ? "checked" : "");
-        page.replace("%WIND_STATE%", windState ? "checked" : "");
-        page.replace("%LIGHT_STATE%", lightState ? "checked" : "");
-        page.replace("%BRIGHTNESS%", String(FastLED.getBrightness())); // Текущая яркость освещения
-
-        // Отправка HTML-страницы клиенту
-        request->send(200, "text/html", page);
-    });
+    server.on("/", HTTP_GET, Timed(METRICS_ROUTE_INDEX, [](AsyncWebServerRequest *request) {
+        // Страница статическая: если у клиента актуальная копия, отвечаем 304 без тела
+        // (запрос фоновой сверки версии со страницы или открытие после истечения PAGE_CACHE_CONTROL)
+        if (request->hasHeader("If-None-Match") &&
+            request->getHeader("If-None-Match")->value().indexOf(PAGE_GZ_ETAG) >= 0) {
+            AsyncWebServerResponse *response = request->beginResponse(304);
+            response->addHeader("ETag", PAGE_GZ_ETAG);
+            response->addHeader("Cache-Control", PAGE_CACHE_CONTROL); // Продление срока кэша
+            request->send(response);
+            return;
+        }
+
+        // Отправка сжатой страницы прямо из флеш-памяти
+        AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", PAGE_GZ, PAGE_GZ_LENGTH);
+        response->addHeader("Content-Encoding", "gzip");
+        response->addHeader("ETag", PAGE_GZ_ETAG);
+        response->addHeader("Cache-Control", PAGE_CACHE_CONTROL);
+        request->send(response);
+    }));
 
     // API-маршрут для получения актуальных данных с датчиков в формате JSON
-    server.on("/sensor/data", HTTP_GET, [](AsyncWebServerRequest *request) {
-        float temperature = bme.readTemperature();
-        float humidity = bme.readHumidity();
-        float pressure = bme.readPressure() / 100.0F;
-        float lux = lightSensor.readLightLevel();
-
-        // Формирование JSON-ответа с данными
-        String jsonResponse = "{";
-        jsonResponse += "\"temperature\":" + String(temperature, 1) + ",";
-        jsonResponse += "\"humidity\":" + String(humidity, 1) + ",";
-        jsonResponse += "\"pressure\":" + String(pressure, 1) + ",";
-        jsonResponse += "\"lux\":" + String(lux, 1);
-        jsonResponse += "}";
-
-        request->send(200, "application/json", jsonResponse);
-    });
+    server.on("/sensor/data", HTTP_GET, Timed(METRICS_ROUTE_SENSOR_DATA, [](AsyncWebServerRequest *request) {
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        if (WantsProto(request)) {
+            SensorSnapshot snapshot;
+            SensorsGetSnapshot(snapshot);
+            ActuatorState actuators;
+            ActuatorsGetState(actuators);
+            json.length = ProtoEncodeSample((uint8_t *)json.buffer, json.size, snapshot, actuators, ClockNow());
+            json.overflow = json.length == 0;
+            JsonWriterSendAs(request, 200, json, PROTO_CONTENT_TYPE);
+            return;
+        }
+        BuildStateJson(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // Настройки опроса датчиков: period - период, мс; profile - weather, humidity, indoor
+    // Фильтр одной величины: metric и любые из min, max, rate (в секунду), median (окно), alpha
+    server.on("/sensor/config", HTTP_GET | HTTP_POST, Timed(METRICS_ROUTE_SENSOR_CONFIG, [](AsyncWebServerRequest *request) {
+        if (request->method() == HTTP_POST) {
+            // Сначала проверяются все параметры: при ошибке ничего не меняется
+            Bme280Profile profile;
+            bool setProfile = request->hasParam("profile", true);
+            if (setProfile && !Bme280ProfileFromName(request->getParam("profile", true)->value(), profile)) {
+                request->send(400, "text/plain", "Unknown profile");
+                return;
+            }
+            float period = 0;
+            bool setPeriod = ReadFloatParam(request, "period", period);
+            if (setPeriod && !(period >= SENSOR_PERIOD_MIN_MS && period <= SENSOR_PERIOD_MAX_MS)) {
+                request->send(400, "text/plain", "period: " + String(SENSOR_PERIOD_MIN_MS) + ".." +
+                                                 String(SENSOR_PERIOD_MAX_MS) + " ms");
+                return;
+            }
+            HistoryMetric metric;
+            bool setFilter = request->hasParam("metric", true);
+            if (setFilter && !HistoryMetricFromName(request->getParam("metric", true)->value(), metric)) {
+                request->send(400, "text/plain", "Unknown metric");
+                return;
+            }
+
+            if (setProfile) {
+                SensorsSetProfile(profile);
+            }
+            if (setPeriod) {
+                SensorsSetPeriod(lroundf(period));
+            }
+            if (setFilter) {
+                FilterConfig config;
+                SensorsGetFilter(metric, config);
+                float median = config.median;
+                ReadFloatParam(request, "min", config.min);
+                ReadFloatParam(request, "max", config.max);
+                ReadFloatParam(request, "rate", config.maxRate);
+                ReadFloatParam(request, "alpha", config.alpha);
+                if (ReadFloatParam(request, "median", median)) {
+                    config.median = (uint8_t)constrain((int)median, 1, FILTER_MEDIAN_MAX);
+                }
+                SensorsSetFilter(metric, config);
+            }
+        }
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterUint(json, "period", SensorsGetPeriod());
+        JsonWriterString(json, "profile", Bme280ProfileName(SensorsGetProfile()));
+        JsonWriterObject(json, "filters");
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            FilterConfig config;
+            uint32_t rejected = SensorsGetFilter((HistoryMetric)m, config);
+            JsonWriterObject(json, HistoryMetricName((HistoryMetric)m));
+            JsonWriterFloat(json, "min", config.min, 2);
+            JsonWriterFloat(json, "max", config.max, 2);
+            JsonWriterFloat(json, "rate", config.maxRate, 2);
+            JsonWriterUint(json, "median", config.median);
+            JsonWriterFloat(json, "alpha", config.alpha, 2);
+            JsonWriterUint(json, "rejected", rejected);
+            JsonWriterEnd(json);
+        }
+        JsonWriterEnd(json);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // История показаний: /history?metric=temperature&res=minute&from=0&to=3600&format=csv
+    // metric - temperature, humidity, pressure, lux; res - raw, minute, hour; format - csv, bin, proto
+    // (кадры двоичного протокола выдаются и по заголовку Accept с PROTO_MEDIA_TYPE)
+    // Время - секунды с момента включения; ответ выдается по частям, без сборки в памяти
+    server.on("/history", HTTP_GET, Timed(METRICS_ROUTE_HISTORY, [](AsyncWebServerRequest *request) {
+        HistoryStream stream = {};
+        stream.resolution = HISTORY_MINUTE;
+        stream.to = ClockUptime();
+
+        if (!request->hasParam("metric") || !HistoryMetricFromName(request->getParam("metric")->value(), stream.metric)) {
+            request->send(400, "text/plain", "Unknown metric");
+            return;
+        }
+        if (request->hasParam("res") && !HistoryResolutionFromName(request->getParam("res")->value(), stream.resolution)) {
+            request->send(400, "text/plain", "Unknown resolution");
+            return;
+        }
+        if (request->hasParam("from")) {
+            stream.from = request->getParam("from")->value().toInt();
+        }
+        if (request->hasParam("to")) {
+            stream.to = request->getParam("to")->value().toInt();
+        }
+        String format = request->hasParam("format") ? request->getParam("format")->value() : String();
+        stream.binary = format == "bin";
+
+        if (format == "proto" || (format.length() == 0 && WantsProto(request))) {
+            request->send(request->beginChunkedResponse(PROTO_CONTENT_TYPE,
+                [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+                    return ProtoHistoryChunk(stream, buffer, maxLen);
+                }));
+            return;
+        }
+        AsyncWebServerResponse *response = request->beginChunkedResponse(
+            stream.binary ? "application/octet-stream" : "text/csv",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+                return HistoryStreamChunk(stream, buffer, maxLen);
+            });
+        request->send(response);
+    }));
+
+    // Состояние журнала на флеш (регистрируется раньше /log, который совпадает и с /log/...)
+    server.on("/log/info", HTTP_GET, Timed(METRICS_ROUTE_LOG, [](AsyncWebServerRequest *request) {
+        TelemetryLogStats logStats;
+        TelemetryLogGetStats(logStats);
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterUint(json, "segments", logStats.segments);
+        JsonWriterUint(json, "records", logStats.records);
+        JsonWriterUint(json, "pending", logStats.pending);
+        JsonWriterUint(json, "recovery_ms", logStats.recoveryMs);
+        JsonWriterUint(json, "last_flush_us", logStats.lastFlushUs);
+        JsonWriterUint(json, "flushes", logStats.flushes);
+        JsonWriterUint(json, "discarded", logStats.discarded);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // Журнал на флеш: /log?from=&to= (время по программным часам), CSV с усреднением за LOG_INTERVAL_S
+    server.on("/log", HTTP_GET, Timed(METRICS_ROUTE_LOG, [](AsyncWebServerRequest *request) {
+        TelemetryLogStream stream = {};
+        stream.to = ClockNow();
+        if (request->hasParam("from")) {
+            stream.from = request->getParam("from")->value().toInt();
+        }
+        if (request->hasParam("to")) {
+            stream.to = request->getParam("to")->value().toInt();
+        }
+
+        AsyncWebServerResponse *response = request->beginChunkedResponse("text/csv",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+                return TelemetryLogStreamChunk(stream, buffer, maxLen);
+            });
+        request->send(response);
+    }));
+
+    // Программные часы: GET - текущее время, POST с параметром epoch - синхронизация (время Unix)
+    // и необязательным tz - смещение местного времени от UTC в минутах
+    server.on("/time", HTTP_GET, Timed(METRICS_ROUTE_TIME, [](AsyncWebServerRequest *request) {
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterUint(json, "time", ClockNow());
+        JsonWriterUint(json, "uptime", ClockUptime());
+        JsonWriterBool(json, "synced", ClockSynced());
+        JsonWriterInt(json, "tz", ClockTimezone());
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+    server.on("/time", HTTP_POST, Timed(METRICS_ROUTE_TIME, [](AsyncWebServerRequest *request) {
+        if (!request->hasParam("epoch", true)) {
+            request->send(400, "text/plain", "Missing epoch");
+            return;
+        }
+        ClockSync(strtoul(request->getParam("epoch", true)->value().c_str(), NULL, 10));
+        if (request->hasParam("tz", true)) {
+            ClockSetTimezone(request->getParam("tz", true)->value().toInt()); // Смещение от UTC, минуты
+        }
+        Serial.println("Часы синхронизированы");
+        request->send(200, "text/plain", "OK");
+    }));
 
     // Маршруты для управления насосом
     
     // Включение насоса
-    server.on("/pump/on", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(pumpPin, HIGH); // Включаем насос
-        pumpState = true;           // Обновляем состояние
-        Serial.println("Насос ВКЛ");
+    server.on("/pump/on", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetPump(true);                   // Включаем насос
+        ClimateManual(CLIMATE_PUMP, 1);  // Автоматика не трогает насос до конца ручного режима
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Выключение насоса
-    server.on("/pump/off", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(pumpPin, LOW);  // Выключаем насос
-        pumpState = false;          // Обновляем состояние
-        Serial.println("Насос ВЫКЛ");
+    server.on("/pump/off", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetPump(false);                  // Выключаем насос
+        ClimateManual(CLIMATE_PUMP, 0);
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Маршруты для управления вентилятором
     
     // Включение вентилятора
-    server.on("/wind/on", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(windPin, HIGH); // Включаем вентилятор
-        windState = true;           // Обновляем состояние
-        Serial.println("Вентилятор ВКЛ");
+    server.on("/wind/on", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetWind(true);                   // Включаем вентилятор
+        ClimateManual(CLIMATE_FAN, 1);
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Выключение вентилятора
-    server.on("/wind/off", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(windPin, LOW);  // Выключаем вентилятор
-        windState = false;          // Обновляем состояние
-        Serial.println("Вентилятор ВЫКЛ");
+    server.on("/wind/off", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetWind(false);                  // Выключаем вентилятор
+        ClimateManual(CLIMATE_FAN, 0);
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Маршруты для управления форточкой
     
     // Открытие форточки
-    server.on("/window/open", HTTP_GET, [](AsyncWebServerRequest *request) {
-        servoWindow.write(90);      // Устанавливаем сервопривод в положение 90° (форточка открыта)
-        windowState = true;         // Обновляем состояние
-        Serial.println("Форточка ОТКРЫТА");
+    server.on("/window/open", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetWindowAngle(CLIMATE_WINDOW_OPEN_ANGLE);                 // Форточка открыта полностью
+        ClimateManual(CLIMATE_WINDOW, CLIMATE_WINDOW_OPEN_ANGLE);
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Закрытие форточки
-    server.on("/window/close", HTTP_GET, [](AsyncWebServerRequest *request) {
-        servoWindow.write(0);       // Устанавливаем сервопривод в положение 0° (форточка закрыта)
-        windowState = false;        // Обновляем состояние
-        Serial.println("Форточка ЗАКРЫТА");
+    server.on("/window/close", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetWindowAngle(0);                                         // Форточка закрыта
+        ClimateManual(CLIMATE_WINDOW, 0);
+        request->send(200, "text/plain", "OK");
+    }));
+
+    // Регулятор климата: GET - уставки и режимы, POST - изменение уставок
+    // Параметры POST: enabled (0/1), fan_temperature, fan_humidity, vent_temperature,
+    // vent_full_temperature, pump_humidity, hysteresis, min_on, min_off, window_move, manual_timeout,
+    // max_pump_on (секунды, 0 - без ограничения)
+    // Параметр auto=1 досрочно возвращает все устройства в автоматический режим,
+    // pump_fault=0 снимает блокировку насоса после пустого бака
+    server.on("/climate", HTTP_GET, Timed(METRICS_ROUTE_CLIMATE, [](AsyncWebServerRequest *request) {
+        SendClimateJson(request);
+    }));
+    server.on("/climate", HTTP_POST, Timed(METRICS_ROUTE_CLIMATE, [](AsyncWebServerRequest *request) {
+        portENTER_CRITICAL(&climateLock);
+        ClimateSettings settings = climateSettings;
+        portEXIT_CRITICAL(&climateLock);
+
+        float value;
+        if (ReadFloatParam(request, "enabled", value)) {
+            settings.enabled = value != 0;
+        }
+        ReadFloatParam(request, "fan_temperature", settings.fanTemperature);
+        ReadFloatParam(request, "fan_humidity", settings.fanHumidity);
+        ReadFloatParam(request, "vent_temperature", settings.ventTemperature);
+        ReadFloatParam(request, "vent_full_temperature", settings.ventFullTemperature);
+        ReadFloatParam(request, "pump_humidity", settings.pumpHumidity);
+        ReadFloatParam(request, "hysteresis", settings.hysteresis);
+        if (!ReadSecondsParam(request, "min_on", settings.minOnMs) ||
+            !ReadSecondsParam(request, "min_off", settings.minOffMs) ||
+            !ReadSecondsParam(request, "window_move", settings.windowMoveMs) ||
+            !ReadSecondsParam(request, "manual_timeout", settings.manualTimeoutMs) ||
+            !ReadSecondsParam(request, "max_pump_on", settings.maxPumpOnMs)) {
+            return;
+        }
+
+        if (settings.ventFullTemperature < settings.ventTemperature || settings.hysteresis < 0) {
+            request->send(400, "text/plain", "Invalid settings");
+            return;
+        }
+
+        bool resetManual = ReadFloatParam(request, "auto", value) && value != 0;
+        bool resetPumpFault = ReadFloatParam(request, "pump_fault", value) && value == 0;
+
+        portENTER_CRITICAL(&climateLock);
+        climateSettings = settings;
+        for (int i = 0; i < CLIMATE_ACTUATOR_COUNT && resetManual; i++) {
+            climateState.manual[i] = false;
+        }
+        if (resetPumpFault) {
+            ClimateResetPumpFault(climateState);
+        }
+        portEXIT_CRITICAL(&climateLock);
+        SendClimateJson(request);
+    }));
+
+    // Досветка по DLI: GET - уставки, накопленный за сутки DLI и план, POST - изменение уставок
+    // Параметры POST: enabled (0/1), crop (культура) или target (моль/м²), start, end (ЧЧ:ММ),
+    // lux_to_ppfd, led_ppfd, ramp (% в минуту), min_brightness, max_brightness, forecast (0..1)
+    server.on("/dli", HTTP_GET, Timed(METRICS_ROUTE_DLI, [](AsyncWebServerRequest *request) {
+        SendDliJson(request);
+    }));
+    server.on("/dli", HTTP_POST, Timed(METRICS_ROUTE_DLI, [](AsyncWebServerRequest *request) {
+        portENTER_CRITICAL(&dliLock);
+        DliSettings settings = dliSettings;
+        portEXIT_CRITICAL(&dliLock);
+
+        float value;
+        if (ReadFloatParam(request, "enabled", value)) {
+            settings.enabled = value != 0;
+        }
+        if (request->hasParam("crop", true)) {
+            int crop = DliCropFind(request->getParam("crop", true)->value().c_str());
+            if (crop <= DLI_CROP_CUSTOM) {
+                request->send(400, "text/plain", "crop: unknown");
+                return;
+            }
+            settings.crop = crop;
+            settings.target = DliCropTarget(crop);
+        }
+        if (ReadFloatParam(request, "target", settings.target)) {
+            settings.crop = DLI_CROP_CUSTOM;
+        }
+        const char *times[2] = {"start", "end"};
+        uint16_t *minutes[2] = {&settings.startMinute, &settings.endMinute};
+        for (int i = 0; i < 2; i++) {
+            if (request->hasParam(times[i], true)) {
+                int minute = ParseDayMinute(request->getParam(times[i], true)->value().c_str());
+                if (minute < 0) {
+                    request->send(400, "text/plain", String(times[i]) + ": HH:MM expected");
+                    return;
+                }
+                *minutes[i] = minute;
+            }
+        }
+        ReadFloatParam(request, "lux_to_ppfd", settings.luxToPpfd);
+        ReadFloatParam(request, "led_ppfd", settings.ledPpfd);
+        ReadFloatParam(request, "ramp", settings.rampPerMinute);
+        if (ReadFloatParam(request, "min_brightness", value)) {
+            settings.minBrightness = constrain(value, 0, 100);
+        }
+        if (ReadFloatParam(request, "max_brightness", value)) {
+            settings.maxBrightness = constrain(value, 0, 100);
+        }
+        ReadFloatParam(request, "forecast", settings.forecast);
+
+        if (settings.target <= 0 || settings.target > 100 || settings.startMinute >= settings.endMinute ||
+            settings.luxToPpfd <= 0 || settings.luxToPpfd > 1 || settings.ledPpfd < 0 || settings.rampPerMinute < 0 ||
+            settings.minBrightness > settings.maxBrightness || settings.forecast < 0 || settings.forecast > 1) {
+            request->send(400, "text/plain", "Invalid settings");
+            return;
+        }
+
+        portENTER_CRITICAL(&dliLock);
+        dliSettings = settings;
+        portEXIT_CRITICAL(&dliLock);
+        SendDliJson(request);
+    }));
+
+    // Правила автоматизации: GET - таблица, состояние и длительность такта, POST - загрузка (JSON в теле),
+    // DELETE - удаление всех правил. Формат правил описан в rules.h
+    server.on("/rules", HTTP_GET, Timed(METRICS_ROUTE_RULES, [](AsyncWebServerRequest *request) {
+        SendRulesJson(request);
+    }));
+    server.on("/rules", HTTP_POST, Timed(METRICS_ROUTE_RULES, [](AsyncWebServerRequest *request) {
+        // Тело собрано обработчиком ниже; буфер освобождается вместе с запросом
+        char *body = (char *)request->_tempObject;
+        if (body == NULL) {
+            request->send(413, "text/plain", "Body missing or larger than " + String(RULES_MAX_JSON) + " bytes");
+            return;
+        }
+        String error;
+        if (!RulesCompile(body, strlen(body), error)) {
+            request->send(400, "text/plain", error);
+            return;
+        }
+        SendRulesJson(request);
+    }), NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        CollectBody(request, data, len, index, total, RULES_MAX_JSON);
+    });
+    server.on("/rules", HTTP_DELETE, Timed(METRICS_ROUTE_RULES, [](AsyncWebServerRequest *request) {
+        RulesClear();
+        request->send(200, "text/plain", "OK");
+    }));
+
+    // Расписание: GET - задания, их состояние и время до следующего срабатывания, POST - загрузка
+    // (JSON в теле), DELETE - удаление всех заданий. Формат заданий описан в schedule.h
+    server.on("/schedule", HTTP_GET, Timed(METRICS_ROUTE_SCHEDULE, [](AsyncWebServerRequest *request) {
+        SendScheduleJson(request);
+    }));
+    server.on("/schedule", HTTP_POST, Timed(METRICS_ROUTE_SCHEDULE, [](AsyncWebServerRequest *request) {
+        char *body = (char *)request->_tempObject;
+        if (body == NULL) {
+            request->send(413, "text/plain", "Body missing or larger than " + String(SCHEDULE_MAX_JSON) + " bytes");
+            return;
+        }
+        String error;
+        if (!ScheduleCompile(body, strlen(body), error)) {
+            request->send(400, "text/plain", error);
+            return;
+        }
+        SendScheduleJson(request);
+    }), NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        CollectBody(request, data, len, index, total, SCHEDULE_MAX_JSON);
+    });
+    server.on("/schedule", HTTP_DELETE, Timed(METRICS_ROUTE_SCHEDULE, [](AsyncWebServerRequest *request) {
+        ScheduleClear();
         request->send(200, "text/plain", "OK");
+    }));
+
+    // Состояние устройств одним документом: GET - текущее, PATCH (или POST) - изменение любой части
+    // {"pump":true,"wind":false,"window_angle":45,"light":true,"brightness":80,"color":"#FF8000"}
+    // Документ применяется целиком или не применяется; ответ - полное состояние с версией.
+    // Условное изменение: поле "version" или заголовок If-Match с версией, при несовпадении - 412
+    server.on("/api/state", HTTP_GET, Timed(METRICS_ROUTE_API_STATE, [](AsyncWebServerRequest *request) {
+        ActuatorState state;
+        ActuatorsGetState(state);
+        SendActuatorState(request, 200, state);
+    }));
+    server.on("/api/state", HTTP_PATCH | HTTP_POST, Timed(METRICS_ROUTE_API_STATE, [](AsyncWebServerRequest *request) {
+        char *body = (char *)request->_tempObject;
+        if (body == NULL) {
+            request->send(413, "text/plain", "Body missing or larger than " + String(API_STATE_MAX_JSON) + " bytes");
+            return;
+        }
+        JsonDocument doc;
+        DeserializationError parseError = deserializeJson(doc, body, strlen(body));
+        if (parseError || !doc.is<JsonObject>()) {
+            request->send(400, "text/plain", String("JSON: ") + (parseError ? parseError.c_str() : "object expected"));
+            return;
+        }
+
+        ActuatorBatch batch = {};
+        if (!ReadStateField(doc["pump"], batch, ACTUATOR_PUMP, 1) ||
+            !ReadStateField(doc["wind"], batch, ACTUATOR_WIND, 1) ||
+            !ReadStateField(doc["window_angle"], batch, ACTUATOR_WINDOW, CLIMATE_WINDOW_OPEN_ANGLE) ||
+            !ReadStateField(doc["light"], batch, ACTUATOR_LIGHT, 1) ||
+            !ReadStateField(doc["brightness"], batch, ACTUATOR_BRIGHTNESS, 100)) {
+            request->send(400, "text/plain", "Invalid value");
+            return;
+        }
+        if (!doc["color"].isNull()) {
+            CRGB color;
+            if (!doc["color"].is<const char*>() || !HexToRGB(doc["color"].as<const char*>(), color)) {
+                request->send(400, "text/plain", "Invalid color");
+                return;
+            }
+            batch.set[ACTUATOR_COLOR] = true;
+            batch.value[ACTUATOR_COLOR] = ((uint32_t)color.r << 16) | (color.g << 8) | color.b;
+        }
+
+        int64_t expectedVersion = -1;
+        if (doc["version"].is<uint32_t>()) {
+            expectedVersion = doc["version"].as<uint32_t>();
+        } else if (request->hasHeader("If-Match")) {
+            String tag = request->getHeader("If-Match")->value();
+            tag.replace("\"", "");
+            expectedVersion = strtoul(tag.c_str(), NULL, 10);
+        }
+
+        ActuatorState state;
+        ActuatorBatchResult result = ActuatorApplyBatch(batch, expectedVersion, state);
+        if (result == ACTUATOR_BATCH_BUSY) {
+            request->send(503, "text/plain", "Actuators busy");
+            return;
+        }
+        if (result == ACTUATOR_BATCH_CONFLICT) {
+            SendActuatorState(request, 412, state);
+            return;
+        }
+
+        // Изменение через API - команда пользователя: автоматика не трогает эти устройства до конца ручного режима
+        if (batch.set[ACTUATOR_PUMP]) {
+            ClimateManual(CLIMATE_PUMP, batch.value[ACTUATOR_PUMP]);
+        }
+        if (batch.set[ACTUATOR_WIND]) {
+            ClimateManual(CLIMATE_FAN, batch.value[ACTUATOR_WIND]);
+        }
+        if (batch.set[ACTUATOR_WINDOW]) {
+            ClimateManual(CLIMATE_WINDOW, batch.value[ACTUATOR_WINDOW]);
+        }
+        if (batch.set[ACTUATOR_LIGHT] || batch.set[ACTUATOR_BRIGHTNESS] || batch.set[ACTUATOR_COLOR]) {
+            LightManual();
+        }
+        SendActuatorState(request, 200, state);
+    }), NULL, [](AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {
+        CollectBody(request, data, len, index, total, API_STATE_MAX_JSON);
     });
 
     // Маршруты для управления освещением
     
     // Включение освещения
-    server.on("/light/on", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(lightPin, HIGH); // Включаем свет (для обычного освещения)
-        lightState = true;           // Обновляем состояние
-        FastLED.setBrightness(255);  // Устанавливаем максимальную яркость RGB-ленты
-        FastLED.show();              // Обновляем состояние RGB-ленты
-        Serial.println("Свет ВКЛ");
+    server.on("/light/on", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetLight(true);   // Включаем свет и RGB-ленту на полную яркость
+        LightManual();    // Правила не трогают освещение до конца ручного режима
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Выключение освещения
-    server.on("/light/off", HTTP_GET, [](AsyncWebServerRequest *request) {
-        digitalWrite(lightPin, LOW);  // Выключаем свет (для обычного освещения)
-        lightState = false;          // Обновляем состояние
-        FastLED.setBrightness(0);    // Устанавливаем минимальную яркость RGB-ленты (выключаем)
-        FastLED.show();              // Обновляем состояние RGB-ленты
-        Serial.println("Свет ВЫКЛ");
+    server.on("/light/off", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        SetLight(false);  // Выключаем свет и RGB-ленту
+        LightManual();
         request->send(200, "text/plain", "OK");
-    });
+    }));
 
     // Регулировка яркости освещения
-    server.on("/light/brightness/", HTTP_GET, [=](AsyncWebServerRequest *request) {
+    server.on("/light/brightness/", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [=](AsyncWebServerRequest *request) {
         if (request->hasParam("value")) {
-            AsyncWebParameter* p = request->getParam("value");
-            int newBrightness = p->value().toInt();              // Получаем значение из параметра запроса
-            int constrainedBrightness = constrain(newBrightness, 0, 100); // Ограничиваем значение от 0 до 100
-            FastLED.setBrightness(map(constrainedBrightness, 0, 100, 0, 255)); // Преобразуем значение от 0-100 к 0-255
-            FastLED.show();                                      // Применяем новую яркость
-            Serial.print("Яркость: ");
-            Serial.println(constrainedBrightness);
+            SetLightBrightness(request->getParam("value")->value().toInt()); // Яркость 0..100 %
+            LightManual();
+        }
+        request->send(200, "text/plain", "OK");
+    }));
+
+    // Счетчики очереди команд устройств: пропускная способность, объединение, задержка применения
+    server.on("/actuators", HTTP_GET, Timed(METRICS_ROUTE_ACTUATORS, [](AsyncWebServerRequest *request) {
+        ActuatorStats stats;
+        ActuatorsGetStats(stats);
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterUint(json, "enqueued", stats.enqueued);
+        JsonWriterUint(json, "dropped", stats.dropped);
+        JsonWriterUint(json, "coalesced", stats.coalesced);
+        JsonWriterUint(json, "applied", stats.applied);
+        JsonWriterUint(json, "max_depth", stats.maxDepth);
+        JsonWriterUint(json, "last_latency_us", stats.lastLatencyUs);
+        JsonWriterUint(json, "max_latency_us", stats.maxLatencyUs);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // Цвет RGB-ленты: /light/color?value=%23FF8000 (символ # необязателен)
+    server.on("/light/color", HTTP_GET, Timed(METRICS_ROUTE_CONTROL, [](AsyncWebServerRequest *request) {
+        CRGB color;
+        if (!request->hasParam("value") || !HexToRGB(request->getParam("value")->value(), color)) {
+            request->send(400, "text/plain", "Invalid color");
+            return;
         }
+        LightManual();    // До команды: задание расписания не должно перекрасить ленту следом
+        ActuatorSet(ACTUATOR_COLOR,((uint32_t)color.r << 16) | (color.g << 8) | color.b);
         request->send(200, "text/plain", "OK");
+    }));
+
+    // Метрики в текстовом формате Prometheus; ответ выдается по строкам, без сборки в памяти
+    server.on("/metrics", HTTP_GET, Timed(METRICS_ROUTE_METRICS, [](AsyncWebServerRequest *request) {
+        MetricsStream stream = {};
+        stream.wifiStations = WiFi.softAPgetStationNum();
+        stream.websocketClients = ws.count();
+        AsyncWebServerResponse *response = request->beginChunkedResponse("text/plain; version=0.0.4",
+            [stream](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+                return MetricsStreamChunk(stream, buffer, maxLen);
+            });
+        request->send(response);
+    }));
+
+    // Управление питанием: режим, частота процессора, оценка тока и израсходованного заряда
+    server.on("/power", HTTP_GET, Timed(METRICS_ROUTE_POWER, [](AsyncWebServerRequest *request) {
+        PowerStats power;
+        PowerGetStats(power);
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterString(json, "mode", power.mode == POWER_IDLE ? "idle" : "active");
+        JsonWriterUint(json, "cpu_mhz", power.cpuMhz);
+        JsonWriterUint(json, "sample_period", SensorsGetEffectivePeriod());
+        JsonWriterUint(json, "stations", power.stations);
+        JsonWriterUint(json, "websocket_clients", power.websocketClients);
+        JsonWriterUint(json, "since_activity", power.sinceActivityMs / 1000);
+        JsonWriterUint(json, "active_s", power.activeMs / 1000);
+        JsonWriterUint(json, "idle_s", power.idleMs / 1000);
+        JsonWriterUint(json, "transitions", power.transitions);
+        JsonWriterFloat(json, "current_ma", power.currentMa, 1);
+        JsonWriterFloat(json, "average_ma", power.averageMa, 1);
+        JsonWriterFloat(json, "charge_mah", power.chargeMah, 2);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // Отправка измерений на сборщик по UDP: GET - настройки и счетчики, POST - изменение
+    // Параметры POST: enabled (0/1), host (IPv4), port, batch (измерений в пакете), period (мс), node
+    server.on("/push", HTTP_GET | HTTP_POST, Timed(METRICS_ROUTE_PUSH, [](AsyncWebServerRequest *request) {
+        ProtoPushConfig config;
+        ProtoPushStats stats;
+        ProtoPushGet(config, stats);
+        if (request->method() == HTTP_POST) {
+            float value;
+            if (ReadFloatParam(request, "enabled", value)) {
+                config.enabled = value != 0;
+            }
+            if (request->hasParam("host", true)) {
+                IPAddress address;
+                if (!address.fromString(request->getParam("host", true)->value().c_str())) {
+                    request->send(400, "text/plain", "host: IPv4 address expected");
+                    return;
+                }
+                config.address = (uint32_t)address[0] | ((uint32_t)address[1] << 8) |
+                                 ((uint32_t)address[2] << 16) | ((uint32_t)address[3] << 24);
+            }
+            if (ReadFloatParam(request, "port", value)) {
+                if (value < 1 || value > 65535) {
+                    request->send(400, "text/plain", "port: 1..65535");
+                    return;
+                }
+                config.port = value;
+            }
+            if (ReadFloatParam(request, "batch", value)) {
+                if (value < 1 || value > 64) {
+                    request->send(400, "text/plain", "batch: 1..64");
+                    return;
+                }
+                config.batch = value;
+            }
+            if (ReadFloatParam(request, "period", value)) {
+                if (value < 100) {
+                    request->send(400, "text/plain", "period: at least 100 ms");
+                    return;
+                }
+                config.periodMs = value;
+            }
+            if (request->hasParam("node", true)) {
+                config.node = strtoul(request->getParam("node", true)->value().c_str(), NULL, 0);
+            }
+            if (config.enabled && config.address == 0) {
+                request->send(400, "text/plain", "host required");
+                return;
+            }
+            if (!ProtoPushConfigure(config)) {
+                request->send(500, "text/plain", "NVS write failed");
+                return;
+            }
+        }
+
+        char host[16];
+        snprintf(host, sizeof(host), "%u.%u.%u.%u", (unsigned)(config.address & 0xFF),
+                 (unsigned)((config.address >> 8) & 0xFF), (unsigned)((config.address >> 16) & 0xFF),
+                 (unsigned)(config.address >> 24));
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterBool(json, "enabled", config.enabled);
+        JsonWriterString(json, "host", host);
+        JsonWriterUint(json, "port", config.port);
+        JsonWriterUint(json, "batch", config.batch);
+        JsonWriterUint(json, "period", config.periodMs);
+        JsonWriterUint(json, "node", config.node);
+        JsonWriterUint(json, "packets", stats.packets);
+        JsonWriterUint(json, "samples", stats.samples);
+        JsonWriterUint(json, "bytes", stats.bytes);
+        JsonWriterUint(json, "failures", stats.failures);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // Запуск: причина перезапуска, восстановление состояния, длительность этапов (мс от старта)
+    server.on("/boot", HTTP_GET, Timed(METRICS_ROUTE_BOOT, [](AsyncWebServerRequest *request) {
+        StateStoreStats store;
+        StateStoreGetStats(store);
+        uint32_t sensorsMs = SensorsProbeDoneMs();
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        JsonWriterObject(json);
+        JsonWriterString(json, "reset_reason", ResetReasonName(esp_reset_reason()));
+        JsonWriterBool(json, "restored", bootTimes.restored);
+        JsonWriterUint(json, "wifi_ms", bootTimes.wifiMs);
+        if (sensorsMs > 0) {
+            JsonWriterUint(json, "sensors_ms", sensorsMs);
+        } else {
+            JsonWriterNull(json, "sensors_ms");
+        }
+        JsonWriterUint(json, "setup_ms", bootTimes.setupMs);
+        JsonWriterUint(json, "first_request_ms", bootTimes.firstRequestMs);
+        JsonWriterObject(json, "state_store");
+        JsonWriterUint(json, "writes", store.writes);
+        JsonWriterUint(json, "failures", store.failures);
+        JsonWriterBool(json, "pending", store.pending);
+        JsonWriterEnd(json);
+        JsonWriterEnd(json);
+        JsonWriterSend(request, 200, json);
+    }));
+
+    // WebSocket: новому клиенту сразу отправляется текущее состояние
+    ws.onEvent([](AsyncWebSocket *socket, AsyncWebSocketClient *client, AwsEventType type,
+                  void *arg, uint8_t *data, size_t len) {
+        if (type == WS_EVT_CONNECT) {
+            PowerActivity();
+            static char frame[JSON_RESPONSE_MAX]; // Только для задачи веб-сервера
+            JsonWriter json;
+            JsonWriterBegin(json, frame, sizeof(frame));
+            BuildStateJson(json);
+            if (JsonWriterFinish(json)) {
+                client->text(frame, json.length);
+            }
+        }
     });
+    server.addHandler(&ws);
+
+    // Ожидание точки доступа
+    xSemaphoreTake(wifiReady, portMAX_DELAY);
+
+    // Полный режим питания до первого простоя; основной цикл работает и без точки доступа
+    PowerBegin();
+
+    if (wifiStarted) {
+        Serial.printf("Access Point started in %u ms.\n", (unsigned)bootTimes.wifiMs);
+        Serial.print("Connect to SSID: ");
+        Serial.println(ap_ssid);
+        Serial.print("Password: ");
+        Serial.println(ap_password);
+        Serial.println("IP address: 192.168.4.1"); // IP-адрес по умолчанию для точки доступа
+    } else {
+        Serial.println("Failed to create Access Point.");
+        return;
+    }
 
     // Запуск веб-сервера
     server.begin();
+    bootTimes.setupMs = (uint32_t)(esp_timer_get_time() / 1000);
     Serial.println("Веб-сервер запущен. Подключитесь к точке доступа и откройте 192.168.4.1 в браузере");
 }
 
 /**
  * Основной цикл программы
- * В данной реализации пуст, так как вся обработка происходит 
- * асинхронно через обработчики запросов веб-сервера
+ * Обработка запросов происходит асинхронно, здесь выполняется
+ * автоматическое управление климатом и рассылка новых данных клиентам WebSocket
  */
 void loop() {
-    // Ничего не делаем в основном цикле, так как используем асинхронный подход
-    // При необходимости здесь можно добавить периодические операции, 
-    // например, чтение датчиков и автоматическое управление устройствами
-}
\ No newline at end of file
+    RecordHistory();    // Запись новых показаний в историю
+    TelemetryLogLoop(millis()); // Запись журнала на флеш, если пакет копится слишком долго
+    ClimateLoop();      // Такт регулятора климата
+    BroadcastState();   // Отправка нового кадра, если есть новые данные
+    ws.cleanupClients(); // Освобождение отключившихся клиентов
+    PowerLoop(WiFi.softAPgetStationNum(), ws.count()); // Выбор режима питания по активности
+    PersistState();     // Отложенное сохранение состояния устройств и уставок
+    ProtoPushLoop(millis()); // Отправка новых измерений на сборщик
+    delay(PowerLoopDelayMs());
+}
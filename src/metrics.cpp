@@ -0,0 +1,277 @@
+/**
+ * Метрики в формате Prometheus
+ * Каждое ядро пишет в свой набор атомарных счетчиков, поэтому запись не ждет блокировок
+ * и не конкурирует за одни и те же ячейки с другим ядром
+ */
+#include "metrics.h"
+#include <atomic>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <ESPAsyncWebServer.h>
+
+// Верхние границы интервалов гистограмм, мкс, и они же в секундах для выдачи
+#define METRICS_BUCKET_COUNT 12
+static const uint32_t bucketBoundsUs[METRICS_BUCKET_COUNT] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+static const char* const bucketLabels[METRICS_BUCKET_COUNT] = {
+    "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "1"
+};
+
+/**
+ * Гистограмма одного ядра; последний интервал - больше всех границ (+Inf)
+ */
+struct MetricsHistogram {
+    std::atomic<uint32_t> buckets[METRICS_BUCKET_COUNT + 1];
+    std::atomic<uint64_t> sumUs;  // 32 бит хватило бы на 71 минуту: _sum пошел бы назад и сломал rate()
+};
+
+static MetricsHistogram histograms[portNUM_PROCESSORS][METRICS_TIMING_COUNT];
+static std::atomic<uint32_t> counters[portNUM_PROCESSORS][METRICS_COUNTER_COUNT];
+
+// Значения меток по величинам
+static const char* const timingLabels[METRICS_TIMING_COUNT] = {
+    "/", "/sensor/data", "/sensor/config", "/history", "/log", "/time", "/climate", "/rules", "/schedule",
+    "/api/state", "control", "/actuators", "/metrics", "/power", "/boot", "/push", "/dli", "bme280", "bh1750", NULL
+};
+static const char* const counterLabels[METRICS_COUNTER_COUNT] = {"bme280", "bh1750"};
+
+// Мгновенные значения, вычисляемые при выдаче
+enum MetricsGauge {
+    GAUGE_HEAP_FREE,
+    GAUGE_HEAP_MIN_FREE,
+    GAUGE_HEAP_LARGEST_BLOCK,
+    GAUGE_STACK_FIRST,
+    GAUGE_STACK_LAST = GAUGE_STACK_FIRST + 4,
+    GAUGE_WIFI_STATIONS,
+    GAUGE_WEBSOCKET_CLIENTS,
+    GAUGE_UPTIME,
+    GAUGE_COUNT
+};
+// Задачи, для которых выдается запас стека
+static const char* const taskNames[GAUGE_STACK_LAST - GAUGE_STACK_FIRST + 1] = {
+    "loopTask", "async_tcp", "sensors", "leds", "actuators"
+};
+
+// Источник значений семейства
+enum MetricsSource {
+    SOURCE_HISTOGRAM,
+    SOURCE_COUNTER,
+    SOURCE_GAUGE
+};
+
+/**
+ * Семейство метрик: одно имя, несколько значений метки
+ */
+struct MetricsFamily {
+    const char *name;
+    const char *help;
+    const char *label;  // Имя метки (NULL - без метки)
+    uint8_t source;     // MetricsSource
+    uint8_t first;      // Первая величина семейства (MetricsTiming, MetricsCounter или MetricsGauge)
+    uint8_t count;      // Количество величин
+};
+
+static const MetricsFamily families[] = {
+    {"greenhouse_http_request_duration_seconds", "HTTP handler duration", "route",
+     SOURCE_HISTOGRAM, METRICS_ROUTE_INDEX, METRICS_ROUTE_COUNT},
+    {"greenhouse_i2c_read_duration_seconds", "I2C sensor read duration", "sensor",
+     SOURCE_HISTOGRAM, METRICS_I2C_BME280, 2},
+    {"greenhouse_led_show_duration_seconds", "LED strip frame output duration", NULL,
+     SOURCE_HISTOGRAM, METRICS_LED_SHOW, 1},
+    {"greenhouse_sensor_errors_total", "Failed sensor reads", "sensor",
+     SOURCE_COUNTER, METRICS_ERRORS_BME280, METRICS_COUNTER_COUNT},
+    {"greenhouse_heap_free_bytes", "Free heap", NULL, SOURCE_GAUGE, GAUGE_HEAP_FREE, 1},
+    {"greenhouse_heap_min_free_bytes", "Minimum free heap since boot", NULL, SOURCE_GAUGE, GAUGE_HEAP_MIN_FREE, 1},
+    {"greenhouse_heap_largest_free_block_bytes", "Largest free heap block", NULL,
+     SOURCE_GAUGE, GAUGE_HEAP_LARGEST_BLOCK, 1},
+    {"greenhouse_task_stack_free_bytes", "Task stack high-water mark", "task",
+     SOURCE_GAUGE, GAUGE_STACK_FIRST, GAUGE_STACK_LAST - GAUGE_STACK_FIRST + 1},
+    {"greenhouse_wifi_stations", "Stations connected to the access point", NULL,
+     SOURCE_GAUGE, GAUGE_WIFI_STATIONS, 1},
+    {"greenhouse_websocket_clients", "Connected WebSocket clients", NULL, SOURCE_GAUGE, GAUGE_WEBSOCKET_CLIENTS, 1},
+    {"greenhouse_uptime_seconds", "Time since boot", NULL, SOURCE_GAUGE, GAUGE_UPTIME, 1},
+};
+#define METRICS_FAMILY_COUNT (sizeof(families) / sizeof(families[0]))
+
+void MetricsObserve(MetricsTiming timing, uint32_t us) {
+    int bucket = 0;
+    while (bucket < METRICS_BUCKET_COUNT && us > bucketBoundsUs[bucket]) {
+        bucket++;
+    }
+    MetricsHistogram &histogram = histograms[xPortGetCoreID()][timing];
+    histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    histogram.sumUs.fetch_add(us, std::memory_order_relaxed);
+}
+
+void MetricsIncrement(MetricsCounter counter) {
+    counters[xPortGetCoreID()][counter].fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * Сумма по ядрам: количество наблюдений с длительностью не больше границы интервала
+ * @param bucket Интервал (METRICS_BUCKET_COUNT - все наблюдения)
+ */
+static uint32_t CumulativeCount(int timing, int bucket) {
+    uint32_t total = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        for (int b = 0; b <= bucket; b++) {
+            total += histograms[core][timing].buckets[b].load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+/**
+ * Мгновенное значение
+ */
+static uint32_t GaugeValue(int gauge, const MetricsStream &stream) {
+    switch (gauge) {
+        case GAUGE_HEAP_FREE:
+            return heap_caps_get_free_size(MALLOC_CAP_8BIT);
+        case GAUGE_HEAP_MIN_FREE:
+            return heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+        case GAUGE_HEAP_LARGEST_BLOCK:
+            return heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+        case GAUGE_WIFI_STATIONS:
+            return stream.wifiStations;
+        case GAUGE_WEBSOCKET_CLIENTS:
+            return stream.websocketClients;
+        case GAUGE_UPTIME:
+            return (uint32_t)(esp_timer_get_time() / 1000000);
+        default: {
+            // Запас стека задачи, байты (задача еще не создана - 0)
+            TaskHandle_t task = xTaskGetHandle(taskNames[gauge - GAUGE_STACK_FIRST]);
+            return task != NULL ? uxTaskGetStackHighWaterMark(task) : 0;
+        }
+    }
+}
+
+// Размер буфера строки выдачи и начала набора меток, байты
+#define METRICS_LINE_MAX 160
+#define METRICS_LABEL_MAX 48
+
+/**
+ * Начало набора меток: {route="/x" или пустая строка
+ * @return Длина текста (не меньше size - текст не поместился)
+ */
+static int FormatLabel(char *text, size_t size, const MetricsFamily &family, int index) {
+    if (family.label == NULL) {
+        text[0] = '\0';
+        return 0;
+    }
+    const char *value;
+    if (family.source == SOURCE_HISTOGRAM) {
+        value = timingLabels[index];
+    } else if (family.source == SOURCE_COUNTER) {
+        value = counterLabels[index];
+    } else {
+        value = taskNames[index - GAUGE_STACK_FIRST];
+    }
+    return snprintf(text, size, "{%s=\"%s\"", family.label, value);
+}
+
+/**
+ * Строка гистограммы: интервалы, затем _sum и _count
+ * @param sub Номер строки внутри гистограммы одной величины
+ */
+static int FormatHistogramLine(char *line, size_t size, const MetricsFamily &family, int timing, int sub) {
+    char label[METRICS_LABEL_MAX];
+    int labelLength = FormatLabel(label, sizeof(label), family, timing);
+    if (labelLength >= (int)sizeof(label)) {
+        return size;
+    }
+    const char *close = labelLength > 0 ? "}" : "";
+
+    if (sub <= METRICS_BUCKET_COUNT) {
+        const char *le = sub < METRICS_BUCKET_COUNT ? bucketLabels[sub] : "+Inf";
+        return snprintf(line, size, "%s_bucket%s%sle=\"%s\"} %u\n", family.name,
+                        labelLength > 0 ? label : "{", labelLength > 0 ? "," : "", le,
+                        (unsigned)CumulativeCount(timing, sub));
+    }
+    if (sub == METRICS_BUCKET_COUNT + 1) {
+        uint64_t sumUs = 0;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            sumUs += histograms[core][timing].sumUs.load(std::memory_order_relaxed);
+        }
+        return snprintf(line, size, "%s_sum%s%s %llu.%06u\n", family.name, label, close,
+                        (unsigned long long)(sumUs / 1000000), (unsigned)(sumUs % 1000000));
+    }
+    return snprintf(line, size, "%s_count%s%s %u\n", family.name, label, close,
+                    (unsigned)CumulativeCount(timing, METRICS_BUCKET_COUNT));
+}
+
+/**
+ * Формирование строки выдачи по сквозному номеру
+ * @return Длина строки (не меньше size - строка не поместилась) или -1, если строки закончились
+ */
+static int FormatLine(const MetricsStream &stream, uint32_t number, char *line, size_t size) {
+    for (size_t f = 0; f < METRICS_FAMILY_COUNT; f++) {
+        const MetricsFamily &family = families[f];
+        uint32_t perValue = family.source == SOURCE_HISTOGRAM ? METRICS_BUCKET_COUNT + 3 : 1;
+        uint32_t lines = 2 + family.count * perValue;
+        if (number >= lines) {
+            number -= lines;
+            continue;
+        }
+
+        if (number == 0) {
+            return snprintf(line, size, "# HELP %s %s\n", family.name, family.help);
+        }
+        if (number == 1) {
+            const char *type = family.source == SOURCE_HISTOGRAM ? "histogram"
+                               : (family.source == SOURCE_COUNTER ? "counter" : "gauge");
+            return snprintf(line, size, "# TYPE %s %s\n", family.name, type);
+        }
+        int index = family.first + (number - 2) / perValue;
+        if (family.source == SOURCE_HISTOGRAM) {
+            return FormatHistogramLine(line, size, family, index, (number - 2) % perValue);
+        }
+
+        char label[METRICS_LABEL_MAX];
+        int labelLength = FormatLabel(label, sizeof(label), family, index);
+        if (labelLength >= (int)sizeof(label)) {
+            return size;
+        }
+        bool labeled = labelLength > 0;
+        uint32_t value = 0;
+        if (family.source == SOURCE_COUNTER) {
+            for (int core = 0; core < portNUM_PROCESSORS; core++) {
+                value += counters[core][index].load(std::memory_order_relaxed);
+            }
+        } else {
+            value = GaugeValue(index, stream);
+        }
+        return snprintf(line, size, "%s%s%s %u\n", family.name, label, labeled ? "}" : "", (unsigned)value);
+    }
+    return -1;
+}
+
+size_t MetricsStreamChunk(MetricsStream &stream, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    char line[METRICS_LINE_MAX];
+    while (!stream.finished) {
+        int length = FormatLine(stream, stream.line, line, sizeof(line));
+        if (length < 0) {
+            stream.finished = true;
+            break;
+        }
+        if (length >= (int)sizeof(line)) {
+            // Строка длиннее буфера пропускается целиком: обрезанная строка испортила бы разбор ответа.
+            // Все строки текущих семейств помещаются с запасом (проверяется тестом test_metrics)
+            stream.line++;
+            continue;
+        }
+        if (written + length > maxLen) {
+            break;
+        }
+        memcpy(buffer + written, line, length);
+        written += length;
+        stream.line++;
+    }
+
+    if (written == 0 && !stream.finished) {
+        return RESPONSE_TRY_AGAIN; // В буфере нет места даже для одной строки
+    }
+    return written;
+}
@@ -0,0 +1,81 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+
+/**
+ * Метрики работы устройства в формате Prometheus
+ * Запись - атомарные счетчики отдельно для каждого ядра, без блокировок;
+ * выдача суммирует ядра и пишется по строкам прямо в буфер ответа
+ */
+
+// Измеряемые длительности (у каждой - гистограмма с фиксированными границами)
+enum MetricsTiming {
+    // Обработчики HTTP-маршрутов
+    METRICS_ROUTE_INDEX,
+    METRICS_ROUTE_SENSOR_DATA,
+    METRICS_ROUTE_SENSOR_CONFIG,
+    METRICS_ROUTE_HISTORY,
+    METRICS_ROUTE_LOG,
+    METRICS_ROUTE_TIME,
+    METRICS_ROUTE_CLIMATE,
+    METRICS_ROUTE_RULES,
+    METRICS_ROUTE_SCHEDULE,
+    METRICS_ROUTE_API_STATE,
+    METRICS_ROUTE_CONTROL,    // /pump, /wind, /window, /light
+    METRICS_ROUTE_ACTUATORS,
+    METRICS_ROUTE_METRICS,
+    METRICS_ROUTE_POWER,
+    METRICS_ROUTE_BOOT,
+    METRICS_ROUTE_PUSH,
+    METRICS_ROUTE_DLI,
+    METRICS_ROUTE_COUNT,
+    // Чтение датчиков по I2C
+    METRICS_I2C_BME280 = METRICS_ROUTE_COUNT,
+    METRICS_I2C_BH1750,
+    // Вывод кадра на RGB-ленту
+    METRICS_LED_SHOW,
+    METRICS_TIMING_COUNT
+};
+
+// Счетчики событий
+enum MetricsCounter {
+    METRICS_ERRORS_BME280,  // Неудачные чтения BME280
+    METRICS_ERRORS_BH1750,  // Неудачные чтения BH1750
+    METRICS_COUNTER_COUNT
+};
+
+/**
+ * Состояние потоковой выдачи метрик для одного HTTP-ответа
+ * Значения, которые знает только вызывающий код, передаются при создании
+ */
+struct MetricsStream {
+    uint32_t line;            // Номер следующей строки
+    uint32_t wifiStations;    // Клиентов точки доступа
+    uint32_t websocketClients; // Клиентов WebSocket
+    bool finished;
+};
+
+/**
+ * Учет длительности (безопасно из любой задачи и любого ядра)
+ * @param timing Измеряемая величина
+ * @param us Длительность, мкс
+ */
+void MetricsObserve(MetricsTiming timing, uint32_t us);
+
+/**
+ * Увеличение счетчика событий
+ */
+void MetricsIncrement(MetricsCounter counter);
+
+/**
+ * Заполнение очередного фрагмента ответа /metrics (текстовый формат Prometheus)
+ * В буфер попадают только целые строки
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t MetricsStreamChunk(MetricsStream &stream, uint8_t *buffer, size_t maxLen);
+
+#endif
@@ -0,0 +1,117 @@
+/**
+ * Управление питанием: выбор режима по активности пользователя и оценка потребления
+ * Точка доступа не может спать (клиенты ждут маяки), поэтому в простое снижаются
+ * частота процессора и мощность передатчика, а не выключается радио
+ */
+#include "power.h"
+#include <atomic>
+#include "sensors.h"
+#include "led.h"
+#include "actuators.h"
+
+static std::atomic<uint32_t> lastActivity(0);
+static PowerStats stats = {};
+static double chargeMaMs = 0;      // Накопленный заряд, мА*мс
+static uint32_t lastTick = 0;      // Время прошлого такта
+static uint32_t lastStations = 0;
+// Статистика пишется основным циклом, читается обработчиком запроса
+static portMUX_TYPE powerLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Применение настроек режима
+ */
+static void ApplyMode(PowerMode mode) {
+    bool idle = mode == POWER_IDLE;
+    setCpuFrequencyMhz(idle ? POWER_IDLE_CPU_MHZ : POWER_ACTIVE_CPU_MHZ);
+    WiFi.setTxPower(idle ? POWER_IDLE_TX_POWER : POWER_ACTIVE_TX_POWER);
+    SensorsSetMinPeriod(idle ? POWER_IDLE_SAMPLE_PERIOD_MS : 0);
+    LedSetPowerSave(idle);
+    Serial.println(idle ? "Питание: режим простоя" : "Питание: полный режим");
+}
+
+/**
+ * Оценка текущего тока по режиму и состоянию нагрузок
+ */
+static float EstimateCurrent(PowerMode mode) {
+    bool idle = mode == POWER_IDLE;
+    float current = idle ? POWER_CPU_IDLE_MA + POWER_WIFI_IDLE_MA : POWER_CPU_ACTIVE_MA + POWER_WIFI_ACTIVE_MA;
+
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    current += POWER_RELAY_MA * ((actuators.pump ? 1 : 0) + (actuators.wind ? 1 : 0) + (actuators.light ? 1 : 0));
+
+    // Лента: ток пропорционален значениям ШИМ каналов (та же гамма-коррекция, что при выводе)
+    LedState led;
+    LedGetTarget(led);
+    uint32_t channels = LedGammaLevel(led.color.r, led.brightness) +
+                        LedGammaLevel(led.color.g, led.brightness) +
+                        LedGammaLevel(led.color.b, led.brightness);
+    current += POWER_LED_CHANNEL_MA * LED_COUNT * channels / 255.0f;
+    return current;
+}
+
+void PowerBegin() {
+    uint32_t now = millis();
+    lastActivity.store(now, std::memory_order_relaxed);
+    lastTick = now;
+    stats.mode = POWER_ACTIVE;
+    ApplyMode(POWER_ACTIVE);
+}
+
+void PowerActivity() {
+    lastActivity.store(millis(), std::memory_order_relaxed);
+}
+
+void PowerLoop(uint32_t stations, uint32_t websocketClients) {
+    uint32_t now = millis();
+    // Новое подключение к точке доступа и открытая страница - активность
+    if (stations > lastStations || websocketClients > 0) {
+        PowerActivity();
+    }
+    lastStations = stations;
+
+    // Отметка из обработчика запроса может оказаться чуть позже now
+    int32_t sinceActivity = max((int32_t)(now - lastActivity.load(std::memory_order_relaxed)), (int32_t)0);
+    PowerMode mode = (uint32_t)sinceActivity >= POWER_IDLE_TIMEOUT_MS ? POWER_IDLE : POWER_ACTIVE;
+    if (mode != stats.mode) {
+        ApplyMode(mode);
+    }
+
+    uint32_t elapsed = now - lastTick;
+    lastTick = now;
+    float current = EstimateCurrent(mode);
+    chargeMaMs += (double)current * elapsed;
+
+    portENTER_CRITICAL(&powerLock);
+    if (mode == POWER_IDLE && stats.mode != POWER_IDLE) {
+        stats.transitions++;
+    }
+    if (stats.mode == POWER_IDLE) {
+        stats.idleMs += elapsed;
+    } else {
+        stats.activeMs += elapsed;
+    }
+    stats.mode = mode;
+    stats.stations = stations;
+    stats.websocketClients = websocketClients;
+    stats.sinceActivityMs = sinceActivity;
+    stats.currentMa = current;
+    stats.chargeMah = chargeMaMs / 3600000.0;
+    uint32_t total = stats.activeMs + stats.idleMs;
+    stats.averageMa = total > 0 ? chargeMaMs / total : current;
+    portEXIT_CRITICAL(&powerLock);
+}
+
+uint32_t PowerLoopDelayMs() {
+    portENTER_CRITICAL(&powerLock);
+    PowerMode mode = stats.mode;
+    portEXIT_CRITICAL(&powerLock);
+    return mode == POWER_IDLE ? POWER_IDLE_LOOP_MS : POWER_ACTIVE_LOOP_MS;
+}
+
+void PowerGetStats(PowerStats &out) {
+    portENTER_CRITICAL(&powerLock);
+    out = stats;
+    portEXIT_CRITICAL(&powerLock);
+    out.cpuMhz = getCpuFrequencyMhz();
+}
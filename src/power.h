@@ -0,0 +1,116 @@
+#ifndef POWER_H
+#define POWER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+/**
+ * Управление питанием
+ * Пока устройством никто не пользуется, снижаются частота процессора и мощность
+ * передатчика, датчики опрашиваются реже, переходы ленты не анимируются.
+ * Любой запрос, подключение к точке доступа или клиент WebSocket возвращают полный режим
+ */
+
+// Время без активности до перехода в режим простоя, мс
+#ifndef POWER_IDLE_TIMEOUT_MS
+#define POWER_IDLE_TIMEOUT_MS 120000
+#endif
+// Частота процессора, МГц (80 - наименьшая, при которой работает WiFi)
+#ifndef POWER_ACTIVE_CPU_MHZ
+#define POWER_ACTIVE_CPU_MHZ 240
+#endif
+#ifndef POWER_IDLE_CPU_MHZ
+#define POWER_IDLE_CPU_MHZ 80
+#endif
+// Мощность передатчика точки доступа
+#ifndef POWER_ACTIVE_TX_POWER
+#define POWER_ACTIVE_TX_POWER WIFI_POWER_19_5dBm
+#endif
+#ifndef POWER_IDLE_TX_POWER
+#define POWER_IDLE_TX_POWER WIFI_POWER_11dBm
+#endif
+// Период опроса датчиков в режиме простоя, мс (не меньше заданного пользователем)
+#ifndef POWER_IDLE_SAMPLE_PERIOD_MS
+#define POWER_IDLE_SAMPLE_PERIOD_MS 10000
+#endif
+// Пауза основного цикла, мс
+#ifndef POWER_ACTIVE_LOOP_MS
+#define POWER_ACTIVE_LOOP_MS 20
+#endif
+#ifndef POWER_IDLE_LOOP_MS
+#define POWER_IDLE_LOOP_MS 200
+#endif
+
+// Модель потребления для оценки тока, мА (уточняются измерением конкретной платы)
+#ifndef POWER_CPU_ACTIVE_MA
+#define POWER_CPU_ACTIVE_MA 50.0f    // Процессор на POWER_ACTIVE_CPU_MHZ
+#endif
+#ifndef POWER_CPU_IDLE_MA
+#define POWER_CPU_IDLE_MA 20.0f      // Процессор на POWER_IDLE_CPU_MHZ
+#endif
+#ifndef POWER_WIFI_ACTIVE_MA
+#define POWER_WIFI_ACTIVE_MA 95.0f   // Точка доступа: прием и маяки на полной мощности
+#endif
+#ifndef POWER_WIFI_IDLE_MA
+#define POWER_WIFI_IDLE_MA 80.0f     // Точка доступа на сниженной мощности
+#endif
+#ifndef POWER_RELAY_MA
+#define POWER_RELAY_MA 70.0f         // Катушка одного включенного реле
+#endif
+#ifndef POWER_LED_CHANNEL_MA
+#define POWER_LED_CHANNEL_MA 20.0f   // Один канал одного светодиода на полной яркости
+#endif
+
+// Режим питания
+enum PowerMode {
+    POWER_ACTIVE,
+    POWER_IDLE
+};
+
+/**
+ * Состояние и оценка потребления
+ */
+struct PowerStats {
+    PowerMode mode;
+    uint32_t cpuMhz;          // Текущая частота процессора
+    uint32_t stations;        // Клиентов точки доступа
+    uint32_t websocketClients;
+    uint32_t sinceActivityMs; // Время с последней активности
+    uint32_t activeMs;        // Время в полном режиме с момента включения
+    uint32_t idleMs;          // Время в режиме простоя с момента включения
+    uint32_t transitions;     // Переходов в режим простоя
+    float currentMa;          // Оценка текущего тока
+    float averageMa;          // Средний ток с момента включения
+    float chargeMah;          // Израсходованный заряд с момента включения
+};
+
+/**
+ * Начальное состояние: полный режим
+ */
+void PowerBegin();
+
+/**
+ * Отметка активности пользователя (безопасно из любой задачи)
+ */
+void PowerActivity();
+
+/**
+ * Такт управления питанием (вызывается основным циклом)
+ * Выбирает режим, применяет его настройки и накапливает оценку заряда
+ * @param stations Клиентов точки доступа
+ * @param websocketClients Клиентов WebSocket
+ */
+void PowerLoop(uint32_t stations, uint32_t websocketClients);
+
+/**
+ * Пауза основного цикла для текущего режима
+ * @return Пауза в миллисекундах
+ */
+uint32_t PowerLoopDelayMs();
+
+/**
+ * Получение состояния и оценки потребления
+ */
+void PowerGetStats(PowerStats &stats);
+
+#endif
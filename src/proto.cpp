@@ -0,0 +1,408 @@
+/**
+ * Двоичный протокол телеметрии: кадры для HTTP и пакеты с приращениями для UDP
+ */
+#include "proto.h"
+#include <WiFi.h>
+#include <WiFiUdp.h>
+#include <Preferences.h>
+#include <ESPAsyncWebServer.h>
+#include "clock.h"
+
+// Версия формата настроек в NVS
+#define PROTO_PUSH_FORMAT 1
+
+// Наибольшая длина varint для 32 бит
+#define VARINT_MAX 5
+// Наибольшая длина точки истории и измерения в пакете
+#define HISTORY_POINT_MAX (4 * VARINT_MAX)
+#define DELTA_RECORD_MAX (DELTA_FIELD_COUNT * VARINT_MAX)
+
+// Множители фиксированной точки истории по HistoryMetric (те же, что у показаний в кадрах)
+static const float historyScale[HISTORY_METRIC_COUNT] = {100, 100, 10, 100};
+
+/**
+ * Запись в буфер; при нехватке места запись прекращается
+ */
+struct ByteWriter {
+    uint8_t *buffer;
+    size_t size;
+    size_t length;
+    bool overflow;
+};
+
+static void Begin(ByteWriter &writer, uint8_t *buffer, size_t size) {
+    writer.buffer = buffer;
+    writer.size = buffer != NULL ? size : 0;
+    writer.length = 0;
+    writer.overflow = false;
+}
+
+static void PutByte(ByteWriter &writer, uint8_t value) {
+    if (writer.length >= writer.size) {
+        writer.overflow = true;
+        return;
+    }
+    writer.buffer[writer.length++] = value;
+}
+
+static void PutU16(ByteWriter &writer, uint16_t value) {
+    PutByte(writer, value & 0xFF);
+    PutByte(writer, value >> 8);
+}
+
+static void PutU32(ByteWriter &writer, uint32_t value) {
+    PutU16(writer, value & 0xFFFF);
+    PutU16(writer, value >> 16);
+}
+
+static void PutVarint(ByteWriter &writer, uint32_t value) {
+    while (value >= 0x80) {
+        PutByte(writer, (value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    PutByte(writer, value);
+}
+
+/**
+ * Знаковое число в varint: малые по модулю значения любого знака занимают один байт
+ */
+static void PutZigzag(ByteWriter &writer, int32_t value) {
+    PutVarint(writer, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+/**
+ * Заголовок кадра; длина данных дописывается FinishFrame
+ */
+static void BeginFrame(ByteWriter &writer, ProtoType type) {
+    PutByte(writer, 'G');
+    PutByte(writer, 'H');
+    PutByte(writer, PROTO_VERSION);
+    PutByte(writer, type);
+    PutU16(writer, 0);
+}
+
+/**
+ * Запись длины данных в заголовок кадра, начатого с начала буфера
+ * @return Длина кадра (0 - не поместился)
+ */
+static size_t FinishFrame(ByteWriter &writer) {
+    size_t payload = writer.length - PROTO_HEADER_SIZE;
+    if (writer.overflow || writer.length < PROTO_HEADER_SIZE || payload > 0xFFFF) {
+        return 0;
+    }
+    writer.buffer[4] = payload & 0xFF;
+    writer.buffer[5] = payload >> 8;
+    return writer.length;
+}
+
+/**
+ * Начало пакета PROTO_DELTA: заголовок, узел, номер пакета, нулевой счетчик измерений
+ * @return Положение счетчика измерений в пакете
+ */
+static size_t BeginDelta(ByteWriter &writer, uint32_t node, uint32_t number) {
+    BeginFrame(writer, PROTO_DELTA);
+    PutU32(writer, node);
+    PutU32(writer, number);
+    size_t countOffset = writer.length;
+    PutByte(writer, 0);
+    return countOffset;
+}
+
+/**
+ * Измерение пакета PROTO_DELTA: разности полей с предыдущим измерением
+ * @param previous Поля предыдущего измерения (нули для первого), заменяются полями этого
+ */
+static void PutDeltaRecord(ByteWriter &writer, const uint32_t fields[DELTA_FIELD_COUNT],
+                           uint32_t previous[DELTA_FIELD_COUNT]) {
+    for (int f = 0; f < DELTA_FIELD_COUNT; f++) {
+        PutZigzag(writer, (int32_t)(fields[f] - previous[f]));
+        previous[f] = fields[f];
+    }
+}
+
+/**
+ * Показания в фиксированной точке; отсутствующие - PROTO_NO_*
+ */
+static void ScaleValues(const SensorSnapshot &snapshot, uint32_t values[HISTORY_METRIC_COUNT]) {
+    values[HISTORY_TEMPERATURE] = snapshot.bmeOk ? (uint32_t)constrain(lroundf(snapshot.temperature * 100), -32767L, 32767L)
+                                                 : (uint32_t)PROTO_NO_TEMPERATURE;
+    values[HISTORY_HUMIDITY] = snapshot.bmeOk ? constrain(lroundf(snapshot.humidity * 100), 0L, 65534L) : PROTO_NO_HUMIDITY;
+    values[HISTORY_PRESSURE] = snapshot.bmeOk && !isnan(snapshot.pressure)
+                                   ? constrain(lroundf(snapshot.pressure * 10), 0L, 65534L) : PROTO_NO_PRESSURE;
+    values[HISTORY_LUX] = snapshot.lightOk ? (uint32_t)constrain(llroundf(snapshot.lux * 100), 0LL, 0xFFFFFFFELL)
+                                           : PROTO_NO_LUX;
+}
+
+static uint8_t Flags(const SensorSnapshot *snapshot, const ActuatorState &actuators) {
+    uint8_t flags = (actuators.pump ? PROTO_FLAG_PUMP : 0) | (actuators.wind ? PROTO_FLAG_WIND : 0) |
+                    (actuators.light ? PROTO_FLAG_LIGHT : 0);
+    if (snapshot != NULL) {
+        flags |= (snapshot->bmeOk ? PROTO_FLAG_BME280 : 0) | (snapshot->lightOk ? PROTO_FLAG_BH1750 : 0);
+    }
+    return flags;
+}
+
+/**
+ * Состояние устройств, 11 байт
+ */
+static void PutActuators(ByteWriter &writer, const SensorSnapshot *snapshot, const ActuatorState &actuators) {
+    PutByte(writer, Flags(snapshot, actuators));
+    PutByte(writer, actuators.windowAngle);
+    PutByte(writer, actuators.windowTarget);
+    PutByte(writer, actuators.brightness);
+    PutByte(writer, actuators.color.r);
+    PutByte(writer, actuators.color.g);
+    PutByte(writer, actuators.color.b);
+    PutU32(writer, actuators.version);
+}
+
+size_t ProtoEncodeSample(uint8_t *buffer, size_t size, const SensorSnapshot &snapshot,
+                         const ActuatorState &actuators, uint32_t time) {
+    ByteWriter writer;
+    Begin(writer, buffer, size);
+    BeginFrame(writer, PROTO_SAMPLE);
+    PutU32(writer, snapshot.sequence);
+    PutU32(writer, time);
+    uint32_t values[HISTORY_METRIC_COUNT];
+    ScaleValues(snapshot, values);
+    PutU16(writer, values[HISTORY_TEMPERATURE]);
+    PutU16(writer, values[HISTORY_HUMIDITY]);
+    PutU16(writer, values[HISTORY_PRESSURE]);
+    PutU32(writer, values[HISTORY_LUX]);
+    PutActuators(writer, &snapshot, actuators);
+    return FinishFrame(writer);
+}
+
+size_t ProtoEncodeState(uint8_t *buffer, size_t size, const ActuatorState &actuators) {
+    ByteWriter writer;
+    Begin(writer, buffer, size);
+    BeginFrame(writer, PROTO_STATE);
+    PutActuators(writer, NULL, actuators);
+    return FinishFrame(writer);
+}
+
+size_t ProtoEncodeDelta(uint8_t *buffer, size_t size, uint32_t node, uint32_t number,
+                        const uint32_t records[][DELTA_FIELD_COUNT], uint8_t count) {
+    ByteWriter writer;
+    Begin(writer, buffer, size);
+    size_t countOffset = BeginDelta(writer, node, number);
+    uint32_t previous[DELTA_FIELD_COUNT] = {};
+    for (uint8_t i = 0; i < count; i++) {
+        PutDeltaRecord(writer, records[i], previous);
+    }
+    if (!writer.overflow) {
+        writer.buffer[countOffset] = count;
+    }
+    return FinishFrame(writer);
+}
+
+size_t ProtoHistoryChunk(HistoryStream &stream, uint8_t *buffer, size_t maxLen) {
+    // Пустая история выдается одним кадром без точек; после последнего кадра - конец ответа
+    if (stream.finished && stream.headerSent) {
+        return 0;
+    }
+    if (maxLen < PROTO_HEADER_SIZE + 4 + HISTORY_POINT_MAX) {
+        return RESPONSE_TRY_AGAIN;
+    }
+
+    ByteWriter writer;
+    Begin(writer, buffer, min(maxLen, (size_t)PROTO_HEADER_SIZE + 0xFFFF));
+    BeginFrame(writer, PROTO_HISTORY);
+    PutByte(writer, stream.metric);
+    PutByte(writer, stream.resolution);
+    PutU16(writer, 0);
+
+    float scale = historyScale[stream.metric];
+    uint32_t count = 0;
+    uint32_t previousTime = 0;
+    int32_t previousAvg = 0;
+    while (count < 0xFFFF) {
+        // Точка забирается из истории, только если целиком помещается в кадр
+        uint32_t next = stream.from;
+        HistoryPoint point;
+        if (HistoryRead(stream.metric, stream.resolution, next, stream.to, &point, 1) == 0) {
+            stream.finished = true;
+            break;
+        }
+        int32_t avg = lroundf(point.avg * scale);
+        int32_t low = lroundf(point.min * scale);
+        int32_t high = lroundf(point.max * scale);
+        uint8_t encoded[HISTORY_POINT_MAX];
+        ByteWriter pointWriter;
+        Begin(pointWriter, encoded, sizeof(encoded));
+        PutVarint(pointWriter, point.time - previousTime);
+        PutZigzag(pointWriter, avg - previousAvg);
+        PutVarint(pointWriter, max(avg - low, (int32_t)0));
+        PutVarint(pointWriter, max(high - avg, (int32_t)0));
+        if (writer.length + pointWriter.length > writer.size) {
+            break;
+        }
+        memcpy(writer.buffer + writer.length, encoded, pointWriter.length);
+        writer.length += pointWriter.length;
+        count++;
+        previousTime = point.time;
+        previousAvg = avg;
+        stream.from = next;
+    }
+
+    if (count == 0 && stream.finished && stream.headerSent) {
+        return 0;
+    }
+    stream.headerSent = true;
+    writer.buffer[PROTO_HEADER_SIZE + 2] = count & 0xFF;
+    writer.buffer[PROTO_HEADER_SIZE + 3] = count >> 8;
+    return FinishFrame(writer);
+}
+
+// Отправка на сборщик: настройки и счетчики меняются обработчиком запроса, пакет собирает основной цикл
+static ProtoPushConfig pushConfig = {false, 0, PROTO_PUSH_PORT, 8, 10000, 0};
+static ProtoPushStats pushStats = {};
+static bool pushReset = false;   // Настройки изменены: неотправленный пакет сбрасывается
+static portMUX_TYPE pushLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Пакет (только основной цикл)
+static WiFiUDP udp;
+static uint8_t packet[PROTO_PUSH_MAX_BYTES];
+static ByteWriter packetWriter;
+static uint8_t packetCount = 0;         // Измерений в пакете
+static size_t packetCountOffset = 0;    // Положение счетчика измерений в пакете
+static uint32_t packetStarted = 0;      // Время первого измерения в пакете, мс
+static uint32_t packetNumber = 0;       // Номер следующего пакета
+static uint32_t previousFields[DELTA_FIELD_COUNT];
+static uint32_t lastSequence = 0;       // Последнее добавленное измерение
+
+/**
+ * Настройки в NVS
+ */
+struct StoredPushConfig {
+    uint32_t format;
+    ProtoPushConfig config;
+};
+
+void ProtoPushBegin() {
+    StoredPushConfig stored;
+    Preferences preferences;
+    bool ok = false;
+    if (preferences.begin("push", true)) {
+        ok = preferences.getBytesLength("config") == sizeof(stored) &&
+             preferences.getBytes("config", &stored, sizeof(stored)) == sizeof(stored) &&
+             stored.format == PROTO_PUSH_FORMAT;
+        preferences.end();
+    }
+    portENTER_CRITICAL(&pushLock);
+    if (ok) {
+        pushConfig = stored.config;
+    } else {
+        pushConfig.node = (uint32_t)(ESP.getEfuseMac() >> 16); // Последние четыре байта MAC-адреса
+    }
+    portEXIT_CRITICAL(&pushLock);
+}
+
+bool ProtoPushConfigure(const ProtoPushConfig &config) {
+    StoredPushConfig stored;
+    memset(&stored, 0, sizeof(stored));
+    stored.format = PROTO_PUSH_FORMAT;
+    stored.config = config;
+    Preferences preferences;
+    if (!preferences.begin("push", false)) {
+        return false;
+    }
+    bool ok = preferences.putBytes("config", &stored, sizeof(stored)) == sizeof(stored);
+    preferences.end();
+    if (ok) {
+        portENTER_CRITICAL(&pushLock);
+        pushConfig = config;
+        pushReset = true;
+        portEXIT_CRITICAL(&pushLock);
+    }
+    return ok;
+}
+
+/**
+ * Начало пакета: заголовок, узел, номер пакета, место под счетчик измерений
+ */
+static void StartPacket(const ProtoPushConfig &config, uint32_t nowMs) {
+    Begin(packetWriter, packet, sizeof(packet));
+    packetCountOffset = BeginDelta(packetWriter, config.node, packetNumber++);
+    memset(previousFields, 0, sizeof(previousFields));
+    packetCount = 0;
+    packetStarted = nowMs;
+}
+
+/**
+ * Отправка собранного пакета
+ */
+static void SendPacket(const ProtoPushConfig &config) {
+    packet[packetCountOffset] = packetCount;
+    size_t length = FinishFrame(packetWriter);
+    bool ok = length > 0 &&
+              udp.beginPacket(IPAddress(config.address & 0xFF, (config.address >> 8) & 0xFF,
+                                        (config.address >> 16) & 0xFF, config.address >> 24), config.port) &&
+              udp.write(packet, length) == length && udp.endPacket();
+
+    portENTER_CRITICAL(&pushLock);
+    if (ok) {
+        pushStats.packets++;
+        pushStats.samples += packetCount;
+        pushStats.bytes += length;
+    } else {
+        pushStats.failures++;
+    }
+    portEXIT_CRITICAL(&pushLock);
+    packetCount = 0;
+}
+
+void ProtoPushLoop(uint32_t nowMs) {
+    portENTER_CRITICAL(&pushLock);
+    ProtoPushConfig config = pushConfig;
+    bool reset = pushReset;
+    pushReset = false;
+    portEXIT_CRITICAL(&pushLock);
+    if (reset || !config.enabled) {
+        packetCount = 0;
+    }
+    if (!config.enabled) {
+        return;
+    }
+
+    SensorSnapshot snapshot;
+    SensorsGetSnapshot(snapshot);
+    if (snapshot.sequence != 0 && snapshot.sequence != lastSequence) {
+        lastSequence = snapshot.sequence;
+        ActuatorState actuators;
+        ActuatorsGetState(actuators);
+        uint32_t fields[DELTA_FIELD_COUNT];
+        uint32_t values[HISTORY_METRIC_COUNT];
+        ScaleValues(snapshot, values);
+        fields[DELTA_SEQUENCE] = snapshot.sequence;
+        fields[DELTA_TIME] = ClockNow();
+        // Температура - со знаком: разность берется от числа, расширенного до 32 бит
+        fields[DELTA_TEMPERATURE] = (uint32_t)(int32_t)(int16_t)values[HISTORY_TEMPERATURE];
+        fields[DELTA_HUMIDITY] = values[HISTORY_HUMIDITY];
+        fields[DELTA_PRESSURE] = values[HISTORY_PRESSURE];
+        fields[DELTA_LUX] = values[HISTORY_LUX];
+        fields[DELTA_FLAGS] = Flags(&snapshot, actuators);
+        fields[DELTA_WINDOW] = actuators.windowTarget;
+        fields[DELTA_BRIGHTNESS] = actuators.brightness;
+
+        if (packetCount > 0 && packetWriter.length + DELTA_RECORD_MAX > packetWriter.size) {
+            SendPacket(config);
+        }
+        if (packetCount == 0) {
+            StartPacket(config, nowMs);
+        }
+        PutDeltaRecord(packetWriter, fields, previousFields);
+        packetCount++;
+    }
+
+    if (packetCount > 0 && (packetCount >= config.batch || nowMs - packetStarted >= config.periodMs)) {
+        SendPacket(config);
+    }
+}
+
+void ProtoPushGet(ProtoPushConfig &config, ProtoPushStats &stats) {
+    portENTER_CRITICAL(&pushLock);
+    config = pushConfig;
+    stats = pushStats;
+    portEXIT_CRITICAL(&pushLock);
+}
@@ -0,0 +1,171 @@
+#ifndef PROTO_H
+#define PROTO_H
+
+#include <Arduino.h>
+#include "sensors.h"
+#include "actuators.h"
+#include "history.h"
+
+/**
+ * Компактный двоичный протокол телеметрии
+ * Показания, состояние устройств и история выдаются кадрами вместо JSON/CSV, если клиент
+ * присылает заголовок Accept с PROTO_MEDIA_TYPE. Тот же формат отправляется пакетами по UDP
+ * на сборщик (tools/collector.py)
+ *
+ * Все числа - little-endian. Кадр: 'G' 'H', версия (1 байт), тип (1 байт), длина данных (2 байта), данные.
+ * Показания в фиксированной точке: температура int16 в 0,01 °C, влажность uint16 в 0,01 %,
+ * давление uint16 в 0,1 гПа, освещенность uint32 в 0,01 лк; нет значения - PROTO_NO_* (см. ниже).
+ * Устройства: флаги (1 байт, PROTO_FLAG_*), угол форточки, целевой угол, яркость, %,
+ * цвет R, G, B, версия состояния uint32 - 11 байт.
+ *
+ * PROTO_SAMPLE:  номер измерения uint32, время часов uint32, показания (10 байт), устройства (11 байт)
+ * PROTO_STATE:   устройства (11 байт)
+ * PROTO_HISTORY: величина, уровень детализации, количество точек uint16, затем точки:
+ *                varint приращения времени, zigzag-varint приращения avg, varint avg-min, varint max-avg
+ *                (значения в единицах показаний выше; первая точка - от нуля)
+ * PROTO_DELTA:   узел uint32, номер пакета uint32, количество измерений (1 байт), затем измерения:
+ *                поля номер, время, температура, влажность, давление, освещенность, флаги, угол
+ *                форточки, яркость - zigzag-varint разности с предыдущим измерением по модулю 2^32
+ *                (первое - от нуля, поэтому каждый пакет декодируется отдельно)
+ */
+
+#define PROTO_VERSION 1
+#define PROTO_MEDIA_TYPE "application/x-greenhouse"
+#define PROTO_CONTENT_TYPE "application/x-greenhouse; v=1"
+#define PROTO_HEADER_SIZE 6
+
+// Типы кадров
+enum ProtoType {
+    PROTO_SAMPLE = 1,
+    PROTO_STATE = 2,
+    PROTO_HISTORY = 3,
+    PROTO_DELTA = 4
+};
+
+// Поля измерения в пакете PROTO_DELTA
+enum ProtoDeltaField {
+    DELTA_SEQUENCE,
+    DELTA_TIME,
+    DELTA_TEMPERATURE,
+    DELTA_HUMIDITY,
+    DELTA_PRESSURE,
+    DELTA_LUX,
+    DELTA_FLAGS,
+    DELTA_WINDOW,
+    DELTA_BRIGHTNESS,
+    DELTA_FIELD_COUNT
+};
+
+// Отсутствующие показания
+#define PROTO_NO_TEMPERATURE INT16_MIN
+#define PROTO_NO_HUMIDITY 0xFFFF
+#define PROTO_NO_PRESSURE 0xFFFF
+#define PROTO_NO_LUX 0xFFFFFFFF
+
+// Флаги устройств и датчиков
+#define PROTO_FLAG_PUMP 0x01
+#define PROTO_FLAG_WIND 0x02
+#define PROTO_FLAG_LIGHT 0x04
+#define PROTO_FLAG_BME280 0x08   // Температура и влажность действительны
+#define PROTO_FLAG_BH1750 0x10   // Освещенность действительна
+
+// Отправка по UDP (можно переопределить через build_flags)
+#ifndef PROTO_PUSH_MAX_BYTES
+#define PROTO_PUSH_MAX_BYTES 512      // Наибольший размер пакета: меньше MTU, без фрагментации
+#endif
+#ifndef PROTO_PUSH_PORT
+#define PROTO_PUSH_PORT 5683          // Порт сборщика по умолчанию
+#endif
+
+/**
+ * Настройки отправки на сборщик
+ */
+struct ProtoPushConfig {
+    bool enabled;
+    uint32_t address;   // IPv4-адрес сборщика (первый октет - младший байт)
+    uint16_t port;
+    uint8_t batch;      // Измерений в пакете
+    uint32_t periodMs;  // Наибольшая задержка неполного пакета, мс
+    uint32_t node;      // Номер узла в пакетах
+};
+
+/**
+ * Счетчики отправки
+ */
+struct ProtoPushStats {
+    uint32_t packets;   // Отправлено пакетов
+    uint32_t samples;   // Отправлено измерений
+    uint32_t bytes;     // Отправлено байт данных UDP
+    uint32_t failures;  // Ошибок отправки
+};
+
+/**
+ * Кадр с последними показаниями и состоянием устройств
+ * @param buffer Буфер
+ * @param size Размер буфера
+ * @param snapshot Снимок показаний
+ * @param actuators Состояние устройств
+ * @param time Время часов, с
+ * @return Длина кадра (0 - не поместился)
+ */
+size_t ProtoEncodeSample(uint8_t *buffer, size_t size, const SensorSnapshot &snapshot,
+                         const ActuatorState &actuators, uint32_t time);
+
+/**
+ * Кадр с состоянием устройств
+ * @return Длина кадра (0 - не поместился)
+ */
+size_t ProtoEncodeState(uint8_t *buffer, size_t size, const ActuatorState &actuators);
+
+/**
+ * Пакет PROTO_DELTA из готовых измерений - тот же, что собирает ProtoPushLoop
+ * (для проверки сборщика tools/collector.py)
+ * @param buffer Буфер
+ * @param size Размер буфера
+ * @param node Номер узла
+ * @param number Номер пакета
+ * @param records Поля измерений по ProtoDeltaField в единицах кадров; температура - int16,
+ *                расширенное до 32 бит со знаком
+ * @param count Количество измерений
+ * @return Длина пакета (0 - не поместился)
+ */
+size_t ProtoEncodeDelta(uint8_t *buffer, size_t size, uint32_t node, uint32_t number,
+                        const uint32_t records[][DELTA_FIELD_COUNT], uint8_t count);
+
+/**
+ * Заполнение очередного фрагмента HTTP-ответа с историей: один кадр PROTO_HISTORY
+ * с теми точками, которые в него поместились
+ * Используются поля metric, resolution, from, to, headerSent (выдан первый кадр) и finished
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t ProtoHistoryChunk(HistoryStream &stream, uint8_t *buffer, size_t maxLen);
+
+/**
+ * Загрузка настроек отправки из NVS
+ * По умолчанию отправка выключена, номер узла - последние байты MAC-адреса
+ */
+void ProtoPushBegin();
+
+/**
+ * Такт отправки (вызывается основным циклом)
+ * Каждое новое измерение добавляется в пакет; пакет отправляется, когда набрано batch
+ * измерений или первое из них ждет periodMs
+ * @param nowMs Текущее время, мс
+ */
+void ProtoPushLoop(uint32_t nowMs);
+
+/**
+ * Замена настроек отправки с сохранением в NVS; неотправленные измерения сбрасываются
+ * @return true, если настройки сохранены
+ */
+bool ProtoPushConfigure(const ProtoPushConfig &config);
+
+/**
+ * Получение настроек и счетчиков отправки
+ */
+void ProtoPushGet(ProtoPushConfig &config, ProtoPushStats &stats);
+
+#endif
@@ -0,0 +1,402 @@
+/**
+ * Правила автоматизации: компиляция из JSON, хранение в NVS и проверка каждый такт
+ */
+#include "rules.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <ESPAsyncWebServer.h>
+#include "json_writer.h"
+
+// Версия формата таблицы в NVS: при изменении структуры Rule старые данные не загружаются
+#define RULES_FORMAT 1
+
+static const char* const operatorNames[] = {"<", "<=", ">", ">="};
+static const char* const actuatorNames[RULE_ACTUATOR_COUNT] = {"pump", "wind", "window", "light"};
+// Допустимые значения по устройствам
+static const int16_t actuatorMax[RULE_ACTUATOR_COUNT] = {1, 1, 90, 100};
+
+/**
+ * Таблица правил в том виде, в котором она хранится в NVS
+ */
+struct RuleTable {
+    uint32_t format;
+    uint32_t count;
+    Rule rules[RULE_MAX];
+};
+
+/**
+ * Состояние правила во время работы
+ */
+struct RuleRuntime {
+    uint32_t trueSince;  // Время, с которого условия выполняются непрерывно
+    bool conditionsMet;  // Условия выполнялись на прошлом такте
+    bool active;         // Правило сработало
+};
+
+static RuleTable table = {RULES_FORMAT, 0, {}};
+static RuleRuntime runtime[RULE_MAX];
+static RulesStats stats = {};
+// Таблица заменяется обработчиком запроса, а проверяется основным циклом
+static portMUX_TYPE rulesLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Поиск строки в списке имен
+ * @return Индекс или -1, если имя неизвестно
+ */
+static int FindName(const char *name, const char* const names[], int count) {
+    for (int i = 0; i < count && name != NULL; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Разбор времени суток "ЧЧ:ММ"
+ * @return Минуты от полуночи или -1 при ошибке
+ */
+static int ParseMinute(const char *text) {
+    int hours, minutes;
+    char tail;
+    if (text == NULL || sscanf(text, "%d:%d%c", &hours, &minutes, &tail) != 2) {
+        return -1;
+    }
+    if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -1;
+    }
+    return hours * 60 + minutes;
+}
+
+/**
+ * Компиляция одного правила
+ * @return true, если правило корректно
+ */
+static bool CompileRule(JsonObject source, Rule &rule, String &error) {
+    memset(&rule, 0, sizeof(rule));
+
+    JsonArray when = source["when"];
+    if (when.isNull() || when.size() == 0 || when.size() > RULE_MAX_CONDITIONS) {
+        error = "when: 1.." + String(RULE_MAX_CONDITIONS) + " conditions expected";
+        return false;
+    }
+    for (JsonObject condition : when) {
+        HistoryMetric metric;
+        if (!HistoryMetricFromName(String(condition["metric"] | ""), metric)) {
+            error = "unknown metric";
+            return false;
+        }
+        int op = FindName(condition["op"] | "", operatorNames, 4);
+        if (op < 0) {
+            error = "unknown op";
+            return false;
+        }
+        if (!condition["value"].is<float>()) {
+            error = "condition value must be a number";
+            return false;
+        }
+        RuleCondition &compiled = rule.conditions[rule.conditionCount++];
+        compiled.metric = metric;
+        compiled.op = op;
+        compiled.value = condition["value"].as<float>();
+    }
+
+    JsonObject then = source["then"];
+    int actuator = FindName(then["actuator"] | "", actuatorNames, RULE_ACTUATOR_COUNT);
+    if (actuator < 0) {
+        error = "unknown actuator";
+        return false;
+    }
+    int value = then["value"].is<bool>() ? (then["value"].as<bool>() ? actuatorMax[actuator] : 0)
+                                         : (then["value"] | -1);
+    if (value < 0 || value > actuatorMax[actuator]) {
+        error = String("value for ") + actuatorNames[actuator] + ": 0.." + String(actuatorMax[actuator]);
+        return false;
+    }
+    rule.actuator = actuator;
+    rule.value = value;
+
+    rule.fromMinute = RULE_NO_TIME;
+    rule.toMinute = RULE_NO_TIME;
+    if (!source["from"].isNull() || !source["to"].isNull()) {
+        int from = ParseMinute(source["from"] | "");
+        int to = ParseMinute(source["to"] | "");
+        if (from < 0 || to < 0 || from == to) {
+            error = "from/to: HH:MM expected";
+            return false;
+        }
+        rule.fromMinute = from;
+        rule.toMinute = to;
+    }
+
+    int hold = source["for"] | 0;
+    if (hold < 0 || hold > 86400) {
+        error = "for: 0..86400 seconds";
+        return false;
+    }
+    rule.holdMs = (uint32_t)hold * 1000;
+    return true;
+}
+
+/**
+ * Замена текущей таблицы; состояние правил сбрасывается
+ */
+static void InstallTable(const RuleTable &compiled) {
+    portENTER_CRITICAL(&rulesLock);
+    table = compiled;
+    memset(runtime, 0, sizeof(runtime));
+    stats.count = compiled.count;
+    stats.version++;
+    portEXIT_CRITICAL(&rulesLock);
+}
+
+/**
+ * Сохранение таблицы в NVS (записываются только занятые элементы)
+ */
+static bool SaveTable(const RuleTable &compiled) {
+    Preferences preferences;
+    if (!preferences.begin("rules", false)) {
+        return false;
+    }
+    size_t size = offsetof(RuleTable, rules) + compiled.count * sizeof(Rule);
+    bool ok = preferences.putBytes("table", &compiled, size) == size;
+    preferences.end();
+    return ok;
+}
+
+bool RulesBegin() {
+    static RuleTable stored;
+    Preferences preferences;
+    if (!preferences.begin("rules", true)) {
+        return false;
+    }
+    size_t size = preferences.getBytesLength("table");
+    bool ok = size >= offsetof(RuleTable, rules) && size <= sizeof(stored) &&
+              preferences.getBytes("table", &stored, size) == size &&
+              stored.format == RULES_FORMAT && stored.count <= RULE_MAX &&
+              size == offsetof(RuleTable, rules) + stored.count * sizeof(Rule);
+    preferences.end();
+    if (ok) {
+        InstallTable(stored);
+    }
+    return ok;
+}
+
+bool RulesCompile(const char *json, size_t length, String &error) {
+    JsonDocument doc;
+    DeserializationError parseError = deserializeJson(doc, json, length);
+    if (parseError) {
+        error = String("JSON: ") + parseError.c_str();
+        return false;
+    }
+    JsonArray rules = doc["rules"];
+    if (rules.isNull() || rules.size() > RULE_MAX) {
+        error = "rules: up to " + String(RULE_MAX) + " rules expected";
+        return false;
+    }
+
+    // Таблица собирается отдельно и заменяет текущую только целиком
+    static RuleTable compiled;
+    compiled.format = RULES_FORMAT;
+    compiled.count = 0;
+    for (JsonObject source : rules) {
+        if (!CompileRule(source, compiled.rules[compiled.count], error)) {
+            error = "rule " + String(compiled.count) + ": " + error;
+            return false;
+        }
+        compiled.count++;
+    }
+
+    if (!SaveTable(compiled)) {
+        error = "NVS write failed";
+        return false;
+    }
+    InstallTable(compiled);
+    return true;
+}
+
+void RulesClear() {
+    RuleTable empty = {RULES_FORMAT, 0, {}};
+    Preferences preferences;
+    if (preferences.begin("rules", false)) {
+        preferences.remove("table");
+        preferences.end();
+    }
+    InstallTable(empty);
+}
+
+/**
+ * Проверка условия
+ * Недостоверное показание условие не выполняет
+ */
+static bool CheckCondition(const RuleCondition &condition, const RuleInputs &inputs) {
+    if (!inputs.valid[condition.metric] || isnan(inputs.values[condition.metric])) {
+        return false;
+    }
+    float value = inputs.values[condition.metric];
+    switch (condition.op) {
+        case RULE_LT:
+            return value < condition.value;
+        case RULE_LE:
+            return value <= condition.value;
+        case RULE_GT:
+            return value > condition.value;
+        case RULE_GE:
+            return value >= condition.value;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Проверка интервала суток; интервал может переходить через полночь
+ * Без синхронизированных часов правило с интервалом не срабатывает
+ */
+static bool CheckTime(const Rule &rule, int minuteOfDay) {
+    if (rule.fromMinute == RULE_NO_TIME) {
+        return true;
+    }
+    if (minuteOfDay < 0) {
+        return false;
+    }
+    if (rule.fromMinute < rule.toMinute) {
+        return minuteOfDay >= rule.fromMinute && minuteOfDay < rule.toMinute;
+    }
+    return minuteOfDay >= rule.fromMinute || minuteOfDay < rule.toMinute;
+}
+
+void RulesEvaluate(const RuleInputs &inputs, RuleOutputs &outputs) {
+    memset(&outputs, 0, sizeof(outputs));
+    int64_t started = esp_timer_get_time();
+
+    portENTER_CRITICAL(&rulesLock);
+    for (uint32_t i = 0; i < table.count; i++) {
+        const Rule &rule = table.rules[i];
+        RuleRuntime &state = runtime[i];
+
+        bool met = CheckTime(rule, inputs.minuteOfDay);
+        for (int c = 0; c < rule.conditionCount && met; c++) {
+            met = CheckCondition(rule.conditions[c], inputs);
+        }
+
+        // Выдержка: условия должны выполняться непрерывно не меньше holdMs
+        if (met && !state.conditionsMet) {
+            state.trueSince = inputs.nowMs;
+        }
+        state.conditionsMet = met;
+        state.active = met && inputs.nowMs - state.trueSince >= rule.holdMs;
+
+        if (state.active) {
+            outputs.set[rule.actuator] = true;
+            outputs.value[rule.actuator] = rule.value;
+        }
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - started);
+    stats.evaluations++;
+    stats.lastUs = elapsed;
+    if (elapsed > stats.maxUs) {
+        stats.maxUs = elapsed;
+    }
+    portEXIT_CRITICAL(&rulesLock);
+}
+
+/**
+ * Запись одного правила в JSON (в формате загрузки) с его состоянием
+ */
+static void WriteRule(JsonWriter &json, const Rule &rule, bool active) {
+    JsonWriterObject(json);
+    JsonWriterArray(json, "when");
+    for (int c = 0; c < rule.conditionCount; c++) {
+        const RuleCondition &condition = rule.conditions[c];
+        JsonWriterObject(json);
+        JsonWriterString(json, "metric", HistoryMetricName((HistoryMetric)condition.metric));
+        JsonWriterString(json, "op", operatorNames[condition.op]);
+        // Порог выдается точно: правила, полученные и загруженные обратно, не меняются
+        JsonWriterFloatExact(json, "value", condition.value);
+        JsonWriterEnd(json);
+    }
+    JsonWriterEnd(json);
+    if (rule.fromMinute != RULE_NO_TIME) {
+        char text[8];
+        snprintf(text, sizeof(text), "%02u:%02u", rule.fromMinute / 60, rule.fromMinute % 60);
+        JsonWriterString(json, "from", text);
+        snprintf(text, sizeof(text), "%02u:%02u", rule.toMinute / 60, rule.toMinute % 60);
+        JsonWriterString(json, "to", text);
+    }
+    JsonWriterUint(json, "for", rule.holdMs / 1000);
+    JsonWriterObject(json, "then");
+    JsonWriterString(json, "actuator", actuatorNames[rule.actuator]);
+    JsonWriterInt(json, "value", rule.value);
+    JsonWriterEnd(json);
+    JsonWriterBool(json, "active", active);
+    JsonWriterEnd(json);
+}
+
+/**
+ * Часть выдачи: заголовок, одно правило или окончание со статистикой
+ * Каждое правило копируется под блокировкой отдельно, поэтому при замене таблицы
+ * во время выдачи документ остается корректным JSON
+ * @param part Номер части
+ * @param last Это окончание документа
+ * @return Длина части
+ */
+static int FormatPart(uint32_t part, char *text, size_t size, bool &last) {
+    last = false;
+    if (part == 0) {
+        return snprintf(text, size, "{\"rules\":[");
+    }
+    uint32_t index = part - 1;
+    Rule rule;
+    bool active = false;
+    RulesStats snapshot;
+    portENTER_CRITICAL(&rulesLock);
+    bool isRule = index < table.count;
+    if (isRule) {
+        rule = table.rules[index];
+        active = runtime[index].active;
+    }
+    snapshot = stats;
+    portEXIT_CRITICAL(&rulesLock);
+
+    if (isRule) {
+        size_t comma = index > 0 ? 1 : 0;
+        text[0] = ',';
+        JsonWriter json;
+        JsonWriterBegin(json, text + comma, size - comma);
+        WriteRule(json, rule, active);
+        JsonWriterFinish(json); // Размер правила ограничен и всегда помещается
+        return json.length + comma;
+    }
+    last = true;
+    return snprintf(text, size, "],\"version\":%u,\"evaluations\":%u,\"last_us\":%u,\"max_us\":%u}",
+                    (unsigned)snapshot.version, (unsigned)snapshot.evaluations,
+                    (unsigned)snapshot.lastUs, (unsigned)snapshot.maxUs);
+}
+
+size_t RulesStreamChunk(RulesStream &stream, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    char part[512];
+    while (!stream.finished) {
+        bool last;
+        int length = FormatPart(stream.part, part, sizeof(part), last);
+        if (written + length > maxLen) {
+            break;
+        }
+        memcpy(buffer + written, part, length);
+        written += length;
+        stream.part++;
+        stream.finished = last;
+    }
+
+    if (written == 0 && !stream.finished) {
+        return RESPONSE_TRY_AGAIN; // В буфере нет места даже для одной части
+    }
+    return written;
+}
+
+void RulesGetStats(RulesStats &out) {
+    portENTER_CRITICAL(&rulesLock);
+    out = stats;
+    portEXIT_CRITICAL(&rulesLock);
+}
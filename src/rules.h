@@ -0,0 +1,153 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <Arduino.h>
+#include "history.h"
+
+/**
+ * Пользовательские правила автоматизации
+ * Правила загружаются в JSON, компилируются в плоский массив структур
+ * и проверяются каждый такт без выделения памяти
+ *
+ * Формат: {"rules":[{"when":[{"metric":"lux","op":"<","value":2000}],
+ *                    "from":"06:00","to":"20:00","for":600,
+ *                    "then":{"actuator":"light","value":80}}]}
+ * Условия when объединяются по И; from/to и for необязательны
+ */
+
+// Ограничения (можно переопределить через build_flags)
+#ifndef RULE_MAX
+#define RULE_MAX 16                // Правил в таблице
+#endif
+#ifndef RULE_MAX_CONDITIONS
+#define RULE_MAX_CONDITIONS 4      // Условий в одном правиле
+#endif
+#ifndef RULES_MAX_JSON
+#define RULES_MAX_JSON 4096        // Наибольший размер загружаемого JSON, байты
+#endif
+
+// Правило без ограничения по времени суток
+#define RULE_NO_TIME 0xFFFF
+
+// Операции сравнения
+enum RuleOperator {
+    RULE_LT,  // <
+    RULE_LE,  // <=
+    RULE_GT,  // >
+    RULE_GE   // >=
+};
+
+// Устройства, которыми управляют правила
+enum RuleActuator {
+    RULE_PUMP,    // Насос: 0/1
+    RULE_WIND,    // Вентилятор: 0/1
+    RULE_WINDOW,  // Форточка: угол, градусы
+    RULE_LIGHT,   // Освещение: яркость, % (0 - выключено)
+    RULE_ACTUATOR_COUNT
+};
+
+/**
+ * Условие: показание сравнивается с порогом
+ */
+struct RuleCondition {
+    uint8_t metric;   // HistoryMetric
+    uint8_t op;       // RuleOperator
+    float value;      // Порог
+};
+
+/**
+ * Скомпилированное правило
+ */
+struct Rule {
+    RuleCondition conditions[RULE_MAX_CONDITIONS];
+    uint8_t conditionCount;
+    uint8_t actuator;     // RuleActuator
+    int16_t value;        // Значение, устанавливаемое правилом
+    uint16_t fromMinute;  // Начало интервала суток, минуты (RULE_NO_TIME - без ограничения)
+    uint16_t toMinute;    // Конец интервала суток, минуты (не включительно)
+    uint32_t holdMs;      // Условия должны выполняться непрерывно это время
+};
+
+/**
+ * Входные данные такта
+ */
+struct RuleInputs {
+    float values[HISTORY_METRIC_COUNT];  // Показания в порядке HistoryMetric
+    bool valid[HISTORY_METRIC_COUNT];    // Признаки достоверности
+    int minuteOfDay;                     // Местное время суток (-1 - часы не синхронизированы)
+    uint32_t nowMs;                      // Текущее время, мс
+};
+
+/**
+ * Результат такта: устройства, которые удерживаются сработавшими правилами
+ * При нескольких правилах для одного устройства действует последнее в списке
+ */
+struct RuleOutputs {
+    bool set[RULE_ACTUATOR_COUNT];
+    int16_t value[RULE_ACTUATOR_COUNT];
+};
+
+/**
+ * Статистика правил
+ */
+struct RulesStats {
+    uint32_t count;        // Правил в таблице
+    uint32_t version;      // Номер версии таблицы (увеличивается при каждой загрузке)
+    uint32_t evaluations;  // Выполненных тактов
+    uint32_t lastUs;       // Длительность последнего такта, мкс
+    uint32_t maxUs;        // Наибольшая длительность такта, мкс
+};
+
+/**
+ * Загрузка таблицы правил из NVS
+ * @return true, если правила найдены
+ */
+bool RulesBegin();
+
+/**
+ * Компиляция правил из JSON и замена текущей таблицы
+ * При ошибке текущая таблица не изменяется
+ * @param json Текст JSON
+ * @param length Длина текста
+ * @param error Описание ошибки
+ * @return true, если правила скомпилированы и сохранены в NVS
+ */
+bool RulesCompile(const char *json, size_t length, String &error);
+
+/**
+ * Удаление всех правил (и из NVS)
+ */
+void RulesClear();
+
+/**
+ * Проверка правил за один такт
+ * Длительность ограничена: не более RULE_MAX * RULE_MAX_CONDITIONS сравнений
+ * @param inputs Входные данные
+ * @param outputs Устройства, удерживаемые правилами
+ */
+void RulesEvaluate(const RuleInputs &inputs, RuleOutputs &outputs);
+
+/**
+ * Состояние потоковой выдачи таблицы правил для одного HTTP-ответа
+ */
+struct RulesStream {
+    uint32_t part;  // Номер следующей части: 0 - заголовок, затем правила, затем окончание
+    bool finished;
+};
+
+/**
+ * Заполнение очередного фрагмента выдачи таблицы в JSON (в формате загрузки)
+ * с состоянием правил и статистикой; в буфер попадают только целые правила
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t RulesStreamChunk(RulesStream &stream, uint8_t *buffer, size_t maxLen);
+
+/**
+ * Получение статистики правил
+ */
+void RulesGetStats(RulesStats &stats);
+
+#endif
@@ -0,0 +1,502 @@
+/**
+ * Расписания: компиляция из JSON, хранение в NVS и иерархическое колесо таймеров
+ *
+ * У каждого задания ровно один таймер: до начала включения или до его конца.
+ * Таймер лежит на уровне колеса по старшей группе разрядов, в которой его время
+ * отличается от текущего, и в ячейке по этой группе разрядов его времени. Когда младшие
+ * разряды текущего времени обнуляются, ячейка верхнего уровня переносится ниже;
+ * ячейка нижнего уровня содержит только таймеры, срабатывающие в эту секунду
+ */
+#include "schedule.h"
+#include <ArduinoJson.h>
+#include <Preferences.h>
+#include <esp_timer.h>
+#include <ESPAsyncWebServer.h>
+#include "json_writer.h"
+
+// Версия формата таблицы в NVS: при изменении структуры ScheduleJob старые данные не загружаются
+#define SCHEDULE_FORMAT 1
+
+#define WHEEL_SLOTS (1 << SCHEDULE_WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define NO_JOB ((int16_t)-1)
+
+static_assert(SCHEDULE_MAX_JOBS <= 32767, "индексы заданий - int16_t");
+
+static const char* const actuatorNames[SCHEDULE_ACTUATOR_COUNT] = {"pump", "wind", "window", "light", "color"};
+// Допустимые значения по устройствам
+static const int32_t actuatorMax[SCHEDULE_ACTUATOR_COUNT] = {1, 1, 90, 100, 0xFFFFFF};
+
+/**
+ * Таблица заданий в том виде, в котором она хранится в NVS
+ */
+struct ScheduleTable {
+    uint32_t format;
+    uint32_t count;
+    ScheduleJob jobs[SCHEDULE_MAX_JOBS];
+};
+
+/**
+ * Состояние задания во время работы
+ */
+struct ScheduleRuntime {
+    uint32_t expires;    // Время срабатывания таймера (местное), с
+    int16_t wheelNext;   // Следующий таймер в той же ячейке колеса
+    int16_t activeNext;  // Соседи в списке действующих заданий устройства
+    int16_t activePrev;
+    bool active;         // Задание действует, таймер - до его конца
+};
+
+static ScheduleTable table = {SCHEDULE_FORMAT, 0, {}};
+static ScheduleRuntime runtime[SCHEDULE_MAX_JOBS];
+static int16_t wheel[SCHEDULE_WHEEL_LEVELS][WHEEL_SLOTS];  // Первые таймеры ячеек
+static int16_t activeHead[SCHEDULE_ACTUATOR_COUNT];         // Последнее начавшееся задание устройства
+static uint32_t wheelNow = 0;           // Время, до которого продвинуто колесо (местное), с
+static int wheelTimezone = 0;           // Часовой пояс, для которого построено колесо
+static bool rebuildPending = true;      // Таблица заменена, колесо нужно построить заново
+static ScheduleStats stats = {};
+// Таблица заменяется обработчиком запроса, а колесо продвигается основным циклом
+static portMUX_TYPE scheduleLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Постановка таймера задания
+ * @param job Задание
+ * @param expires Время срабатывания; прошедшее - в следующую секунду. Текущее допустимо только
+ *                при переносе с верхнего уровня: нижняя ячейка обрабатывается сразу после переноса
+ */
+static void WheelInsert(int16_t job, uint32_t expires) {
+    if ((int32_t)(expires - wheelNow) < 0) {
+        expires = wheelNow + 1;
+    }
+    runtime[job].expires = expires;
+    uint32_t diff = expires ^ wheelNow;
+    int level = 0;
+    while (level < SCHEDULE_WHEEL_LEVELS - 1 && (diff >> (SCHEDULE_WHEEL_BITS * (level + 1))) != 0) {
+        level++;
+    }
+    uint32_t slot = (expires >> (SCHEDULE_WHEEL_BITS * level)) & WHEEL_MASK;
+    runtime[job].wheelNext = wheel[level][slot];
+    wheel[level][slot] = job;
+}
+
+/**
+ * Добавление задания в начало списка действующих заданий его устройства
+ */
+static void Activate(int16_t job) {
+    uint8_t actuator = table.jobs[job].actuator;
+    ScheduleRuntime &state = runtime[job];
+    state.active = true;
+    state.activePrev = NO_JOB;
+    state.activeNext = activeHead[actuator];
+    if (state.activeNext != NO_JOB) {
+        runtime[state.activeNext].activePrev = job;
+    }
+    activeHead[actuator] = job;
+}
+
+/**
+ * Удаление задания из списка действующих заданий его устройства
+ */
+static void Deactivate(int16_t job) {
+    ScheduleRuntime &state = runtime[job];
+    if (state.activePrev != NO_JOB) {
+        runtime[state.activePrev].activeNext = state.activeNext;
+    } else {
+        activeHead[table.jobs[job].actuator] = state.activeNext;
+    }
+    if (state.activeNext != NO_JOB) {
+        runtime[state.activeNext].activePrev = state.activePrev;
+    }
+    state.active = false;
+}
+
+/**
+ * Срабатывание таймера: начало или конец задания и постановка следующего таймера
+ */
+static void Fire(int16_t job) {
+    const ScheduleJob &definition = table.jobs[job];
+    if (!runtime[job].active) {
+        Activate(job);
+        WheelInsert(job, wheelNow + definition.duration);
+    } else {
+        Deactivate(job);
+        WheelInsert(job, wheelNow + definition.every - definition.duration);
+    }
+    stats.fired++;
+}
+
+/**
+ * Продвижение колеса на одну секунду
+ */
+static void WheelTick() {
+    wheelNow++;
+
+    // Уровни, у которых обнулились все младшие разряды времени, переносятся ниже, начиная с верхнего
+    int top = 0;
+    while (top < SCHEDULE_WHEEL_LEVELS - 1 &&
+           (wheelNow & ((1UL << (SCHEDULE_WHEEL_BITS * (top + 1))) - 1)) == 0) {
+        top++;
+    }
+    for (int level = top; level >= 1; level--) {
+        uint32_t slot = (wheelNow >> (SCHEDULE_WHEEL_BITS * level)) & WHEEL_MASK;
+        int16_t job = wheel[level][slot];
+        wheel[level][slot] = NO_JOB;
+        while (job != NO_JOB) {
+            int16_t next = runtime[job].wheelNext;
+            WheelInsert(job, runtime[job].expires);
+            stats.cascaded++;
+            job = next;
+        }
+    }
+
+    // Все таймеры нижней ячейки срабатывают в эту секунду
+    int16_t job = wheel[0][wheelNow & WHEEL_MASK];
+    wheel[0][wheelNow & WHEEL_MASK] = NO_JOB;
+    while (job != NO_JOB) {
+        int16_t next = runtime[job].wheelNext;
+        Fire(job);
+        job = next;
+    }
+}
+
+/**
+ * Построение колеса заново: состояние каждого задания вычисляется по текущему времени
+ * @param local Текущее местное время, с
+ */
+static void Rebuild(uint32_t local) {
+    memset(wheel, 0xFF, sizeof(wheel));
+    memset(activeHead, 0xFF, sizeof(activeHead));
+    wheelNow = local;
+    for (uint32_t i = 0; i < table.count; i++) {
+        const ScheduleJob &definition = table.jobs[i];
+        // Время от последнего начала задания
+        uint32_t phase = (local % definition.every + definition.every - definition.at % definition.every) % definition.every;
+        runtime[i].active = false;
+        if (phase < definition.duration) {
+            Activate(i);
+            WheelInsert(i, local + definition.duration - phase);
+        } else {
+            WheelInsert(i, local + definition.every - phase);
+        }
+    }
+    stats.rebuilds++;
+}
+
+/**
+ * Поиск строки в списке имен
+ * @return Индекс или -1, если имя неизвестно
+ */
+static int FindName(const char *name, const char* const names[], int count) {
+    for (int i = 0; i < count && name != NULL; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Разбор времени суток "ЧЧ:ММ"
+ * @return Секунды от полуночи или -1 при ошибке
+ */
+static int32_t ParseTimeOfDay(const char *text) {
+    int hours, minutes;
+    char tail;
+    if (text == NULL || sscanf(text, "%d:%d%c", &hours, &minutes, &tail) != 2) {
+        return -1;
+    }
+    if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -1;
+    }
+    return (hours * 60 + minutes) * 60;
+}
+
+/**
+ * Разбор значения задания: число, true/false или цвет "#RRGGBB"
+ * @return Значение или -1 при ошибке
+ */
+static int32_t ParseValue(JsonVariant value, int actuator) {
+    if (value.is<bool>()) {
+        return value.as<bool>() ? actuatorMax[actuator] : 0;
+    }
+    if (actuator == SCHEDULE_COLOR && value.is<const char *>()) {
+        const char *text = value.as<const char *>();
+        if (text[0] == '#') {
+            text++;
+        }
+        if (strlen(text) != 6 || strspn(text, "0123456789abcdefABCDEF") != 6) {
+            return -1;
+        }
+        return (int32_t)strtoul(text, NULL, 16);
+    }
+    return value.is<int32_t>() ? value.as<int32_t>() : -1;
+}
+
+/**
+ * Компиляция одного задания
+ * @return true, если задание корректно
+ */
+static bool CompileJob(JsonObject source, ScheduleJob &job, String &error) {
+    memset(&job, 0, sizeof(job));
+
+    int actuator = FindName(source["actuator"] | "", actuatorNames, SCHEDULE_ACTUATOR_COUNT);
+    if (actuator < 0) {
+        error = "unknown actuator";
+        return false;
+    }
+    int32_t value = ParseValue(source["value"], actuator);
+    if (value < 0 || value > actuatorMax[actuator]) {
+        error = String("value for ") + actuatorNames[actuator] +
+                (actuator == SCHEDULE_COLOR ? ": #RRGGBB" : ": 0.." + String(actuatorMax[actuator]));
+        return false;
+    }
+
+    int32_t at = ParseTimeOfDay(source["at"] | "");
+    if (at < 0) {
+        error = "at: HH:MM expected";
+        return false;
+    }
+
+    int32_t every = source["every"] | 86400;
+    if (every < 60 || every > 7 * 86400 || (86400 % every != 0 && every % 86400 != 0)) {
+        error = "every: divisor of 86400 or 1..7 days, seconds";
+        return false;
+    }
+
+    int32_t duration = source["for"] | 0;
+    if (duration < 1 || duration >= every) {
+        error = "for: 1..every-1 seconds";
+        return false;
+    }
+
+    job.actuator = actuator;
+    job.value = value;
+    job.at = at;
+    job.every = every;
+    job.duration = duration;
+    return true;
+}
+
+/**
+ * Замена текущей таблицы; колесо перестраивается на следующем такте
+ */
+static void InstallTable(const ScheduleTable &compiled) {
+    portENTER_CRITICAL(&scheduleLock);
+    table = compiled;
+    memset(wheel, 0xFF, sizeof(wheel));
+    memset(activeHead, 0xFF, sizeof(activeHead));
+    memset(runtime, 0, sizeof(runtime));
+    rebuildPending = true;
+    stats.count = compiled.count;
+    stats.version++;
+    portEXIT_CRITICAL(&scheduleLock);
+}
+
+/**
+ * Сохранение таблицы в NVS (записываются только занятые элементы)
+ */
+static bool SaveTable(const ScheduleTable &compiled) {
+    Preferences preferences;
+    if (!preferences.begin("schedule", false)) {
+        return false;
+    }
+    size_t size = offsetof(ScheduleTable, jobs) + compiled.count * sizeof(ScheduleJob);
+    bool ok = preferences.putBytes("table", &compiled, size) == size;
+    preferences.end();
+    return ok;
+}
+
+bool ScheduleBegin() {
+    static ScheduleTable stored;
+    Preferences preferences;
+    if (!preferences.begin("schedule", true)) {
+        return false;
+    }
+    size_t size = preferences.getBytesLength("table");
+    bool ok = size >= offsetof(ScheduleTable, jobs) && size <= sizeof(stored) &&
+              preferences.getBytes("table", &stored, size) == size &&
+              stored.format == SCHEDULE_FORMAT && stored.count <= SCHEDULE_MAX_JOBS &&
+              size == offsetof(ScheduleTable, jobs) + stored.count * sizeof(ScheduleJob);
+    preferences.end();
+    if (ok) {
+        InstallTable(stored);
+    }
+    return ok;
+}
+
+bool ScheduleCompile(const char *json, size_t length, String &error) {
+    JsonDocument doc;
+    DeserializationError parseError = deserializeJson(doc, json, length);
+    if (parseError) {
+        error = String("JSON: ") + parseError.c_str();
+        return false;
+    }
+    JsonArray jobs = doc["jobs"];
+    if (jobs.isNull() || jobs.size() > SCHEDULE_MAX_JOBS) {
+        error = "jobs: up to " + String(SCHEDULE_MAX_JOBS) + " jobs expected";
+        return false;
+    }
+
+    // Таблица собирается отдельно и заменяет текущую только целиком
+    static ScheduleTable compiled;
+    compiled.format = SCHEDULE_FORMAT;
+    compiled.count = 0;
+    for (JsonObject source : jobs) {
+        if (!CompileJob(source, compiled.jobs[compiled.count], error)) {
+            error = "job " + String(compiled.count) + ": " + error;
+            return false;
+        }
+        compiled.count++;
+    }
+
+    if (!SaveTable(compiled)) {
+        error = "NVS write failed";
+        return false;
+    }
+    InstallTable(compiled);
+    return true;
+}
+
+void ScheduleClear() {
+    static ScheduleTable empty = {SCHEDULE_FORMAT, 0, {}};
+    Preferences preferences;
+    if (preferences.begin("schedule", false)) {
+        preferences.remove("table");
+        preferences.end();
+    }
+    InstallTable(empty);
+}
+
+void ScheduleLoop(uint32_t now, int timezoneMinutes) {
+    uint32_t local = now + timezoneMinutes * 60;
+    int64_t started = esp_timer_get_time();
+
+    portENTER_CRITICAL(&scheduleLock);
+    int32_t behind = (int32_t)(local - wheelNow);
+    if (rebuildPending || timezoneMinutes != wheelTimezone || behind < 0 || behind > SCHEDULE_MAX_CATCHUP_S) {
+        Rebuild(local);
+        wheelTimezone = timezoneMinutes;
+        rebuildPending = false;
+    } else {
+        while (wheelNow != local) {
+            WheelTick();
+        }
+    }
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - started);
+    stats.lastUs = elapsed;
+    if (elapsed > stats.maxUs) {
+        stats.maxUs = elapsed;
+    }
+    portEXIT_CRITICAL(&scheduleLock);
+}
+
+void ScheduleGetOutputs(ScheduleOutputs &outputs) {
+    portENTER_CRITICAL(&scheduleLock);
+    for (int i = 0; i < SCHEDULE_ACTUATOR_COUNT; i++) {
+        int16_t job = rebuildPending ? NO_JOB : activeHead[i];
+        outputs.set[i] = job != NO_JOB;
+        outputs.value[i] = job != NO_JOB ? table.jobs[job].value : 0;
+    }
+    portEXIT_CRITICAL(&scheduleLock);
+}
+
+/**
+ * Запись одного задания в JSON (в формате загрузки) с его состоянием
+ * @param next Время до следующего срабатывания, с (-1 - колесо еще не построено)
+ */
+static void WriteJob(JsonWriter &json, const ScheduleJob &job, bool active, int32_t next) {
+    char text[8];
+    JsonWriterObject(json);
+    JsonWriterString(json, "actuator", actuatorNames[job.actuator]);
+    if (job.actuator == SCHEDULE_COLOR) {
+        snprintf(text, sizeof(text), "#%06X", (unsigned)job.value & 0xFFFFFF);
+        JsonWriterString(json, "value", text);
+    } else {
+        JsonWriterInt(json, "value", job.value);
+    }
+    // at < суток (CompileJob); остаток от деления показывает компилятору, что текст помещается в буфер
+    snprintf(text, sizeof(text), "%02u:%02u", (unsigned)(job.at / 3600 % 24), (unsigned)(job.at / 60 % 60));
+    JsonWriterString(json, "at", text);
+    JsonWriterUint(json, "every", job.every);
+    JsonWriterUint(json, "for", job.duration);
+    JsonWriterBool(json, "active", active);
+    if (next >= 0) {
+        JsonWriterInt(json, "next", next);
+    } else {
+        JsonWriterNull(json, "next");
+    }
+    JsonWriterEnd(json);
+}
+
+/**
+ * Часть выдачи: заголовок, одно задание или окончание со статистикой
+ * Каждое задание копируется под блокировкой отдельно, поэтому при замене таблицы
+ * во время выдачи документ остается корректным JSON
+ * @param part Номер части
+ * @param last Это окончание документа
+ * @return Длина части
+ */
+static int FormatPart(uint32_t part, char *text, size_t size, bool &last) {
+    last = false;
+    if (part == 0) {
+        return snprintf(text, size, "{\"jobs\":[");
+    }
+    uint32_t index = part - 1;
+    ScheduleJob job;
+    bool active = false;
+    int32_t next = -1;
+    ScheduleStats snapshot;
+    portENTER_CRITICAL(&scheduleLock);
+    bool isJob = index < table.count;
+    if (isJob) {
+        job = table.jobs[index];
+        active = runtime[index].active;
+        if (!rebuildPending) {
+            next = (int32_t)(runtime[index].expires - wheelNow);
+        }
+    }
+    snapshot = stats;
+    portEXIT_CRITICAL(&scheduleLock);
+
+    if (isJob) {
+        size_t comma = index > 0 ? 1 : 0;
+        text[0] = ',';
+        JsonWriter json;
+        JsonWriterBegin(json, text + comma, size - comma);
+        WriteJob(json, job, active, next);
+        JsonWriterFinish(json); // Размер задания ограничен и всегда помещается
+        return json.length + comma;
+    }
+    last = true;
+    return snprintf(text, size, "],\"version\":%u,\"fired\":%u,\"cascaded\":%u,\"rebuilds\":%u,"
+                    "\"last_us\":%u,\"max_us\":%u}",
+                    (unsigned)snapshot.version, (unsigned)snapshot.fired, (unsigned)snapshot.cascaded,
+                    (unsigned)snapshot.rebuilds, (unsigned)snapshot.lastUs, (unsigned)snapshot.maxUs);
+}
+
+size_t ScheduleStreamChunk(ScheduleStream &stream, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+    char part[256];
+    while (!stream.finished) {
+        bool last;
+        int length = FormatPart(stream.part, part, sizeof(part), last);
+        if (written + length > maxLen) {
+            break;
+        }
+        memcpy(buffer + written, part, length);
+        written += length;
+        stream.part++;
+        stream.finished = last;
+    }
+
+    if (written == 0 && !stream.finished) {
+        return RESPONSE_TRY_AGAIN; // В буфере нет места даже для одной части
+    }
+    return written;
+}
+
+void ScheduleGetStats(ScheduleStats &out) {
+    portENTER_CRITICAL(&scheduleLock);
+    out = stats;
+    portEXIT_CRITICAL(&scheduleLock);
+}
@@ -0,0 +1,137 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <Arduino.h>
+
+/**
+ * Расписания полива и освещения
+ * Повторяющиеся задания включают устройство на заданное время. Задания лежат в иерархическом
+ * колесе таймеров: постановка и срабатывание - O(1), такт просматривает одну ячейку колеса,
+ * а не все задания. Время - местное, по программным часам
+ *
+ * Формат: {"jobs":[{"actuator":"pump","value":1,"at":"06:00","every":14400,"for":60},
+ *                  {"actuator":"light","value":80,"at":"06:00","for":57600},
+ *                  {"actuator":"color","value":"#FF8000","at":"20:00","for":3600}]}
+ * at - время первого включения от местной полуночи, every - период в секундах
+ * (делитель суток или целое число суток до недели, по умолчанию сутки; многосуточный
+ * период отсчитывается от 01.01.1970), for - длительность в секундах, меньше периода
+ */
+
+// Ограничения (можно переопределить через build_flags)
+#ifndef SCHEDULE_MAX_JOBS
+#define SCHEDULE_MAX_JOBS 32           // Заданий в таблице
+#endif
+#ifndef SCHEDULE_MAX_JSON
+#define SCHEDULE_MAX_JSON 4096         // Наибольший размер загружаемого JSON, байты
+#endif
+#ifndef SCHEDULE_MAX_CATCHUP_S
+#define SCHEDULE_MAX_CATCHUP_S 600     // Отставание, которое колесо догоняет по секундам; большее - перестройка
+#endif
+
+// Колесо: SCHEDULE_WHEEL_LEVELS уровней по 2^SCHEDULE_WHEEL_BITS ячеек в секундах (4 x 64 - 194 суток)
+#define SCHEDULE_WHEEL_BITS 6
+#define SCHEDULE_WHEEL_LEVELS 4
+
+// Устройства, которыми управляют задания (первые четыре - в порядке RuleActuator)
+enum ScheduleActuator {
+    SCHEDULE_PUMP,    // Насос: 0/1
+    SCHEDULE_WIND,    // Вентилятор: 0/1
+    SCHEDULE_WINDOW,  // Форточка: угол, градусы
+    SCHEDULE_LIGHT,   // Освещение: яркость, % (0 - выключено)
+    SCHEDULE_COLOR,   // Цвет RGB-ленты: 0xRRGGBB
+    SCHEDULE_ACTUATOR_COUNT
+};
+
+/**
+ * Задание расписания
+ */
+struct ScheduleJob {
+    int32_t value;      // Значение на время задания
+    uint32_t at;        // Смещение включения от местной полуночи, с
+    uint32_t every;     // Период, с
+    uint32_t duration;  // Длительность, с
+    uint8_t actuator;   // ScheduleActuator
+};
+
+/**
+ * Устройства, удерживаемые действующими заданиями
+ * При нескольких заданиях для одного устройства действует начавшееся последним
+ */
+struct ScheduleOutputs {
+    bool set[SCHEDULE_ACTUATOR_COUNT];
+    int32_t value[SCHEDULE_ACTUATOR_COUNT];
+};
+
+/**
+ * Статистика расписания
+ */
+struct ScheduleStats {
+    uint32_t count;     // Заданий в таблице
+    uint32_t version;   // Номер версии таблицы (увеличивается при каждой загрузке)
+    uint32_t fired;     // Срабатываний таймеров (начало или конец задания)
+    uint32_t cascaded;  // Переносов таймеров с верхних уровней колеса
+    uint32_t rebuilds;  // Перестроек колеса (загрузка, перевод часов, смена часового пояса)
+    uint32_t lastUs;    // Длительность последнего такта, мкс
+    uint32_t maxUs;     // Наибольшая длительность такта, мкс
+};
+
+/**
+ * Загрузка таблицы заданий из NVS
+ * @return true, если задания найдены
+ */
+bool ScheduleBegin();
+
+/**
+ * Компиляция заданий из JSON и замена текущей таблицы
+ * При ошибке текущая таблица не изменяется
+ * @param json Текст JSON
+ * @param length Длина текста
+ * @param error Описание ошибки
+ * @return true, если задания скомпилированы и сохранены в NVS
+ */
+bool ScheduleCompile(const char *json, size_t length, String &error);
+
+/**
+ * Удаление всех заданий (и из NVS)
+ */
+void ScheduleClear();
+
+/**
+ * Такт расписания: продвижение колеса до текущего времени
+ * Пропущенные секунды догоняются по одной; при переводе часов назад, отставании больше
+ * SCHEDULE_MAX_CATCHUP_S или смене часового пояса колесо строится заново по текущему времени
+ * @param now Текущее время часов, с
+ * @param timezoneMinutes Смещение часового пояса от UTC, минуты
+ */
+void ScheduleLoop(uint32_t now, int timezoneMinutes);
+
+/**
+ * Получение устройств, удерживаемых действующими заданиями
+ * @param outputs Устройства и значения
+ */
+void ScheduleGetOutputs(ScheduleOutputs &outputs);
+
+/**
+ * Состояние потоковой выдачи таблицы заданий для одного HTTP-ответа
+ */
+struct ScheduleStream {
+    uint32_t part;  // Номер следующей части: 0 - заголовок, затем задания, затем окончание
+    bool finished;
+};
+
+/**
+ * Заполнение очередного фрагмента выдачи таблицы в JSON (в формате загрузки)
+ * с состоянием заданий и статистикой; в буфер попадают только целые задания
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t ScheduleStreamChunk(ScheduleStream &stream, uint8_t *buffer, size_t maxLen);
+
+/**
+ * Получение статистики расписания
+ */
+void ScheduleGetStats(ScheduleStats &stats);
+
+#endif
@@ -0,0 +1,338 @@
+/**
+ * Фоновый опрос датчиков BME280 и BH1750
+ * Задача читает датчики с заданным периодом и публикует снимок
+ * через seqlock, поэтому обработчики веб-сервера не ждут шину I2C
+ */
+#include "sensors.h"
+#include "metrics.h"
+#include <atomic>
+#include <Wire.h>
+#include <BH1750.h>
+#include <esp_timer.h>
+
+// Период повторной попытки инициализации неисправного датчика, мс
+#ifndef SENSOR_RETRY_PERIOD_MS
+#define SENSOR_RETRY_PERIOD_MS 10000
+#endif
+// Попытки инициализации при запуске и пауза между ними, мс
+#ifndef SENSOR_PROBE_ATTEMPTS
+#define SENSOR_PROBE_ATTEMPTS 3
+#endif
+#ifndef SENSOR_PROBE_DELAY_MS
+#define SENSOR_PROBE_DELAY_MS 50
+#endif
+
+// Наибольшее время однократного измерения BH1750 в режиме высокого разрешения, мс
+#define BH1750_CONVERSION_MS 180
+
+static BH1750 lightSensor;        // Датчик освещенности BH1750
+
+static bool bmeReady = false;     // BME280 успешно инициализирован
+static bool lightReady = false;   // BH1750 успешно инициализирован
+static bool lightOneShot = false; // BH1750 в однократном режиме
+static std::atomic<uint32_t> probeDoneMs(0); // Время окончания первичной инициализации от запуска, мс
+
+// Опубликованный снимок и счетчик seqlock (нечетное значение - идет запись)
+static SensorSnapshot published = {};
+static std::atomic<uint32_t> publishedSeq(0);
+
+static std::atomic<uint32_t> samplePeriodMs(SENSOR_SAMPLE_PERIOD_MS);
+static std::atomic<uint32_t> minPeriodMs(0);  // Нижняя граница периода от управления питанием
+static std::atomic<int> bmeProfile(SENSOR_BME280_PROFILE);
+static Bme280Profile bmeConfigured = (Bme280Profile)SENSOR_BME280_PROFILE; // Записан в датчик
+
+// Настройки фильтров по HistoryMetric: диапазон, скорость в секунду, окно медианы, коэффициент среднего
+static FilterConfig filterConfigs[HISTORY_METRIC_COUNT] = {
+    {-40, 85, 2, 3, 0.5f},        // Температура, °C: рабочий диапазон BME280
+    {0, 100, 5, 3, 0.5f},         // Влажность, %
+    {300, 1100, 1, 3, 0.3f},      // Давление, гПа: рабочий диапазон BME280
+    {0, 65535, 0, 5, 0.5f},       // Освещенность, лк: тень и блики гасит медиана, а не ограничение скорости
+};
+static uint32_t filterVersions[HISTORY_METRIC_COUNT];  // Растет при каждом изменении настроек
+static std::atomic<uint32_t> filterRejected[HISTORY_METRIC_COUNT];
+// Настройки меняются обработчиками запросов, читаются задачей опроса
+static portMUX_TYPE filterLock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Инициализация BME280
+ * 0x77 - I2C-адрес датчика BME280
+ */
+static bool BeginBme() {
+    bmeConfigured = (Bme280Profile)bmeProfile.load(std::memory_order_relaxed);
+    bmeReady = Bme280Begin(0x77, Bme280ProfileSettings(bmeConfigured));
+    return bmeReady;
+}
+
+/**
+ * Режим BH1750 для текущего периода опроса
+ * При частом опросе датчик измеряет непрерывно, при редком - спит между однократными измерениями
+ */
+static bool LightOneShotWanted() {
+    return SensorsGetEffectivePeriod() >= SENSOR_BH1750_ONE_SHOT_PERIOD_MS;
+}
+
+/**
+ * Инициализация BH1750
+ * В однократном режиме begin сразу запускает первое измерение
+ */
+static bool BeginLight() {
+    lightOneShot = LightOneShotWanted();
+    lightReady = lightSensor.begin(lightOneShot ? BH1750::ONE_TIME_HIGH_RES_MODE
+                                                : BH1750::CONTINUOUS_HIGH_RES_MODE);
+    return lightReady;
+}
+
+/**
+ * Публикация нового снимка (вызывается только задачей опроса)
+ * @param snapshot Новые показания
+ */
+static void Publish(const SensorSnapshot &snapshot) {
+    uint32_t seq = publishedSeq.load(std::memory_order_relaxed);
+    publishedSeq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    published = snapshot;
+    publishedSeq.store(seq + 2, std::memory_order_release);
+}
+
+/**
+ * Применение изменений профиля BME280 и режима BH1750, запрошенных через API
+ */
+static void ApplyConfiguration() {
+    Bme280Profile profile = (Bme280Profile)bmeProfile.load(std::memory_order_relaxed);
+    if (bmeReady && profile != bmeConfigured) {
+        bmeConfigured = profile;
+        bmeReady = Bme280Configure(Bme280ProfileSettings(profile));
+    }
+    if (lightReady && LightOneShotWanted() != lightOneShot) {
+        lightOneShot = !lightOneShot;
+        lightReady = lightSensor.configure(lightOneShot ? BH1750::ONE_TIME_HIGH_RES_MODE
+                                                        : BH1750::CONTINUOUS_HIGH_RES_MODE);
+    }
+}
+
+/**
+ * Фильтрация исходных показаний снимка (вызывается только задачей опроса)
+ * Настройки, измененные через API, подхватываются здесь с полным сбросом фильтра
+ * @param snapshot Снимок с исходными показаниями; сюда же пишутся отфильтрованные
+ * @param measured Величина измерялась (false - пропущена профилем, это не сбой)
+ */
+static void FilterSnapshot(SensorSnapshot &snapshot, const bool measured[]) {
+    static Filter filters[HISTORY_METRIC_COUNT];
+    static FilterConfig configs[HISTORY_METRIC_COUNT];
+    static uint32_t versions[HISTORY_METRIC_COUNT] = {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+    int64_t started = esp_timer_get_time();
+    float *outputs[HISTORY_METRIC_COUNT] = {&snapshot.temperature, &snapshot.humidity, &snapshot.pressure, &snapshot.lux};
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        portENTER_CRITICAL(&filterLock);
+        bool changed = versions[m] != filterVersions[m];
+        if (changed) {
+            configs[m] = filterConfigs[m];
+            versions[m] = filterVersions[m];
+        }
+        portEXIT_CRITICAL(&filterLock);
+        if (changed) {
+            FilterReset(filters[m]);
+        }
+
+        if (measured[m]) {
+            FilterUpdate(filters[m], configs[m], snapshot.raw[m], snapshot.timestamp);
+        } else {
+            FilterReset(filters[m]);
+        }
+        *outputs[m] = filters[m].output;
+        filterRejected[m].store(filters[m].rejected, std::memory_order_relaxed);
+    }
+    snapshot.filterUs = (uint32_t)(esp_timer_get_time() - started);
+
+    snapshot.bmeOk = !isnan(snapshot.temperature) && !isnan(snapshot.humidity);
+    snapshot.lightOk = !isnan(snapshot.lux);
+}
+
+/**
+ * Задача опроса датчиков
+ * BME280 запускается в принудительном режиме; пока он измеряет, читается BH1750,
+ * затем все регистры BME280 забираются одной транзакцией.
+ * Исходные показания проходят фильтр; при сбое фильтр держит прежнее значение,
+ * пока сбои не повторятся FILTER_MAX_REJECTS раз подряд
+ */
+static void SensorTask(void *) {
+    SensorSnapshot current = {};
+
+    // Первичная инициализация с повторами; отсутствующий датчик не задерживает запуск остальной системы
+    for (int attempt = 0; attempt < SENSOR_PROBE_ATTEMPTS && (!bmeReady || !lightReady); attempt++) {
+        if (attempt > 0) {
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_PROBE_DELAY_MS));
+        }
+        if (!lightReady && BeginLight()) {
+            Serial.println("BH1750 инициализирован");
+        }
+        if (!bmeReady && BeginBme()) {
+            Serial.println("BME280 инициализирован");
+        }
+    }
+    if (!lightReady) {
+        Serial.println("Ошибка инициализации BH1750");
+    }
+    if (!bmeReady) {
+        Serial.println("Ошибка инициализации BME280");
+    }
+    probeDoneMs.store(max((uint32_t)(esp_timer_get_time() / 1000), (uint32_t)1), std::memory_order_relaxed);
+
+    uint32_t lastRetry = millis();
+    TickType_t lastWake = xTaskGetTickCount();
+
+    for (;;) {
+        // Периодическая попытка переинициализировать неисправные датчики
+        if ((!bmeReady || !lightReady) && millis() - lastRetry >= SENSOR_RETRY_PERIOD_MS) {
+            lastRetry = millis();
+            if (!bmeReady && BeginBme()) {
+                Serial.println("BME280 инициализирован");
+            }
+            if (!lightReady && BeginLight()) {
+                Serial.println("BH1750 инициализирован");
+            }
+        }
+        ApplyConfiguration();
+
+        // Запуск измерения BME280
+        uint32_t bmeBusUs = 0;
+        uint32_t conversionUs = 0;
+        int64_t bmeStarted = 0;
+        if (bmeReady) {
+            bmeStarted = esp_timer_get_time();
+            conversionUs = Bme280StartMeasurement();
+            bmeBusUs = (uint32_t)(esp_timer_get_time() - bmeStarted);
+        }
+
+        // Чтение BH1750 во время измерения BME280
+        uint32_t lightBusUs = 0;
+        current.raw[HISTORY_LUX] = NAN;
+        if (lightReady) {
+            int64_t started = esp_timer_get_time();
+            float lux = lightSensor.readLightLevel();     // Чтение уровня освещенности в люксах
+            lightBusUs = (uint32_t)(esp_timer_get_time() - started);
+            MetricsObserve(METRICS_I2C_BH1750, lightBusUs);
+            if (lux >= 0) {                               // Отрицательное значение - ошибка чтения
+                current.raw[HISTORY_LUX] = lux;
+            } else {
+                MetricsIncrement(METRICS_ERRORS_BH1750);
+            }
+        }
+
+        // Ожидание окончания измерения BME280 и чтение результата
+        bool bmeRead = false;
+        current.raw[HISTORY_TEMPERATURE] = NAN;
+        current.raw[HISTORY_HUMIDITY] = NAN;
+        current.raw[HISTORY_PRESSURE] = NAN;
+        if (bmeReady) {
+            Bme280Reading reading;
+            bool read = false;
+            if (conversionUs > 0) {
+                uint32_t elapsed = (uint32_t)(esp_timer_get_time() - bmeStarted);
+                if (elapsed < conversionUs) {
+                    vTaskDelay(max((TickType_t)1, pdMS_TO_TICKS((conversionUs - elapsed + 999) / 1000)));
+                }
+                int64_t started = esp_timer_get_time();
+                read = Bme280ReadMeasurement(reading);
+                bmeBusUs += (uint32_t)(esp_timer_get_time() - started);
+            }
+            MetricsObserve(METRICS_I2C_BME280, bmeBusUs);
+            if (read && !isnan(reading.temperature) && !isnan(reading.humidity)) {
+                current.raw[HISTORY_TEMPERATURE] = reading.temperature;
+                current.raw[HISTORY_HUMIDITY] = reading.humidity;
+                current.raw[HISTORY_PRESSURE] = reading.pressure;
+                bmeRead = true;
+            } else {
+                MetricsIncrement(METRICS_ERRORS_BME280);
+            }
+        }
+
+        current.busUs = bmeBusUs + lightBusUs;
+        current.timestamp = millis();
+        // Давление, пропущенное профилем BME280, - не сбой датчика
+        const bool measured[HISTORY_METRIC_COUNT] = {true, true, !bmeRead || !isnan(current.raw[HISTORY_PRESSURE]), true};
+        FilterSnapshot(current, measured);
+        current.sequence++;
+        Publish(current);
+
+        TickType_t period = pdMS_TO_TICKS(SensorsGetEffectivePeriod());
+        TickType_t conversion = pdMS_TO_TICKS(BH1750_CONVERSION_MS);
+        if (lightReady && lightOneShot && period > conversion) {
+            // Однократное измерение BH1750 запускается так, чтобы закончиться к следующему опросу
+            vTaskDelayUntil(&lastWake, period - conversion);
+            lightReady = lightSensor.configure(BH1750::ONE_TIME_HIGH_RES_MODE);
+            vTaskDelayUntil(&lastWake, conversion);
+        } else {
+            vTaskDelayUntil(&lastWake, period);
+        }
+    }
+}
+
+void SensorsBegin() {
+    Wire.setClock(SENSOR_I2C_CLOCK);
+    // Датчики инициализирует сама задача опроса
+    xTaskCreatePinnedToCore(SensorTask, "sensors", 4096, NULL, 1, NULL, SENSOR_TASK_CORE);
+}
+
+uint32_t SensorsProbeDoneMs() {
+    return probeDoneMs.load(std::memory_order_relaxed);
+}
+
+void SensorsGetSnapshot(SensorSnapshot &out) {
+    uint32_t before, after;
+    do {
+        before = publishedSeq.load(std::memory_order_acquire);
+        out = published;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = publishedSeq.load(std::memory_order_relaxed);
+    } while ((before & 1) || before != after);
+}
+
+uint32_t SensorsSnapshotAge(const SensorSnapshot &snapshot) {
+    if (snapshot.sequence == 0) {
+        return millis();
+    }
+    return millis() - snapshot.timestamp;
+}
+
+void SensorsSetPeriod(uint32_t periodMs) {
+    samplePeriodMs.store(constrain(periodMs, (uint32_t)SENSOR_PERIOD_MIN_MS, (uint32_t)SENSOR_PERIOD_MAX_MS),
+                         std::memory_order_relaxed);
+}
+
+uint32_t SensorsGetPeriod() {
+    return samplePeriodMs.load(std::memory_order_relaxed);
+}
+
+void SensorsSetProfile(Bme280Profile profile) {
+    bmeProfile.store(profile, std::memory_order_relaxed);
+}
+
+Bme280Profile SensorsGetProfile() {
+    return (Bme280Profile)bmeProfile.load(std::memory_order_relaxed);
+}
+
+void SensorsSetFilter(HistoryMetric metric, const FilterConfig &config) {
+    FilterConfig sanitized = config;
+    FilterSanitize(sanitized);
+    portENTER_CRITICAL(&filterLock);
+    filterConfigs[metric] = sanitized;
+    filterVersions[metric]++;
+    portEXIT_CRITICAL(&filterLock);
+}
+
+uint32_t SensorsGetFilter(HistoryMetric metric, FilterConfig &config) {
+    portENTER_CRITICAL(&filterLock);
+    config = filterConfigs[metric];
+    portEXIT_CRITICAL(&filterLock);
+    return filterRejected[metric].load(std::memory_order_relaxed);
+}
+
+void SensorsSetMinPeriod(uint32_t periodMs) {
+    minPeriodMs.store(periodMs, std::memory_order_relaxed);
+}
+
+uint32_t SensorsGetEffectivePeriod() {
+    return max(samplePeriodMs.load(std::memory_order_relaxed), minPeriodMs.load(std::memory_order_relaxed));
+}
@@ -0,0 +1,139 @@
+#ifndef SENSORS_H
+#define SENSORS_H
+
+#include <Arduino.h>
+#include "bme280.h"
+#include "filter.h"
+#include "history.h"
+
+// Период опроса датчиков по умолчанию, мс (можно переопределить через build_flags)
+#ifndef SENSOR_SAMPLE_PERIOD_MS
+#define SENSOR_SAMPLE_PERIOD_MS 1000
+#endif
+
+// Допустимый период опроса датчиков, мс
+#ifndef SENSOR_PERIOD_MIN_MS
+#define SENSOR_PERIOD_MIN_MS 100
+#endif
+#ifndef SENSOR_PERIOD_MAX_MS
+#define SENSOR_PERIOD_MAX_MS 60000
+#endif
+
+// Частота шины I2C, Гц (оба датчика поддерживают Fast mode 400 кГц)
+#ifndef SENSOR_I2C_CLOCK
+#define SENSOR_I2C_CLOCK 400000
+#endif
+
+// Профиль измерения BME280 при старте (Bme280Profile)
+#ifndef SENSOR_BME280_PROFILE
+#define SENSOR_BME280_PROFILE BME280_PROFILE_WEATHER
+#endif
+
+// Начиная с этого периода опроса BH1750 работает в однократном режиме и между измерениями спит, мс
+#ifndef SENSOR_BH1750_ONE_SHOT_PERIOD_MS
+#define SENSOR_BH1750_ONE_SHOT_PERIOD_MS 1000
+#endif
+
+// Ядро, на котором работает задача опроса датчиков
+#ifndef SENSOR_TASK_CORE
+#define SENSOR_TASK_CORE 1
+#endif
+
+/**
+ * Снимок показаний датчиков
+ * Публикуется задачей опроса, обработчики HTTP только копируют его
+ * Основные значения прошли фильтр; исходные - последнее прочитанное с датчика
+ */
+struct SensorSnapshot {
+    float temperature;  // Температура, °C
+    float humidity;     // Относительная влажность, %
+    float pressure;     // Давление, гПа (NAN - не измеряется в текущем профиле)
+    float lux;          // Освещенность, лк
+    float raw[HISTORY_METRIC_COUNT]; // Исходные показания по HistoryMetric (NAN - чтение не удалось)
+    uint32_t timestamp; // Время измерения, millis()
+    uint32_t sequence;  // Номер измерения (0 - измерений еще не было)
+    uint32_t busUs;     // Время обмена по I2C за это измерение, мкс
+    uint32_t filterUs;  // Время фильтрации всех величин за это измерение, мкс
+    bool bmeOk;         // Температура и влажность после фильтра действительны
+    bool lightOk;       // Освещенность после фильтра действительна
+};
+
+/**
+ * Запуск фоновой задачи опроса
+ * Датчики инициализируются уже в задаче, с повторами, поэтому вызов не ждет шину I2C
+ * Шина I2C должна быть инициализирована заранее
+ */
+void SensorsBegin();
+
+/**
+ * Время окончания первичной инициализации датчиков
+ * @return Миллисекунды от запуска (0 - инициализация еще идет)
+ */
+uint32_t SensorsProbeDoneMs();
+
+/**
+ * Получение последнего опубликованного снимка показаний
+ * Не обращается к шине I2C и не блокирует вызывающую задачу
+ * @param out Снимок, в который копируются показания
+ */
+void SensorsGetSnapshot(SensorSnapshot &out);
+
+/**
+ * Возраст снимка в миллисекундах
+ * @param snapshot Снимок показаний
+ * @return Время, прошедшее с момента измерения
+ */
+uint32_t SensorsSnapshotAge(const SensorSnapshot &snapshot);
+
+/**
+ * Изменение периода опроса датчиков
+ * @param periodMs Новый период в миллисекундах (приводится к SENSOR_PERIOD_MIN_MS..SENSOR_PERIOD_MAX_MS)
+ */
+void SensorsSetPeriod(uint32_t periodMs);
+
+/**
+ * Текущий период опроса датчиков
+ * @return Период в миллисекундах
+ */
+uint32_t SensorsGetPeriod();
+
+/**
+ * Нижняя граница периода опроса, не меняющая заданный период
+ * Используется управлением питанием: в режиме простоя датчики опрашиваются реже
+ * @param periodMs Граница в миллисекундах (0 - без ограничения)
+ */
+void SensorsSetMinPeriod(uint32_t periodMs);
+
+/**
+ * Действующий период опроса с учетом нижней границы
+ * @return Период в миллисекундах
+ */
+uint32_t SensorsGetEffectivePeriod();
+
+/**
+ * Изменение профиля измерения BME280 (применяется задачей опроса перед следующим измерением)
+ * @param profile Профиль передискретизации и фильтра
+ */
+void SensorsSetProfile(Bme280Profile profile);
+
+/**
+ * Текущий профиль измерения BME280
+ */
+Bme280Profile SensorsGetProfile();
+
+/**
+ * Изменение настроек фильтра величины (состояние фильтра сбрасывается перед следующим измерением)
+ * @param metric Величина
+ * @param config Настройки; недопустимые значения приводятся к допустимым
+ */
+void SensorsSetFilter(HistoryMetric metric, const FilterConfig &config);
+
+/**
+ * Текущие настройки фильтра величины
+ * @param metric Величина
+ * @param config Настройки
+ * @return Количество отбракованных показаний с момента запуска
+ */
+uint32_t SensorsGetFilter(HistoryMetric metric, FilterConfig &config);
+
+#endif
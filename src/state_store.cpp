@@ -0,0 +1,130 @@
+/**
+ * Сохранение состояния устройств и уставок в NVS с объединением изменений
+ */
+#include "state_store.h"
+#include <Preferences.h>
+#include <stddef.h>
+
+static StoredState saved;        // Последнее записанное (или прочитанное при старте) состояние
+static StoredState latest;       // Последнее переданное основным циклом
+static bool dirty = false;       // latest отличается от saved
+static uint32_t dirtySince = 0;  // Время первого несохраненного изменения
+static uint32_t lastChange = 0;  // Время последнего изменения
+static StateStoreStats stats = {};
+// Счетчики пишет основной цикл, читают обработчики запросов
+static portMUX_TYPE storeLock = portMUX_INITIALIZER_UNLOCKED;
+
+// Запись версий 1 и 2: уставки климата без последнего поля maxPumpOnMs, за ними уставки досветки (версия 2)
+static const size_t climateV2Size = offsetof(ClimateSettings, maxPumpOnMs);
+static const size_t dliV2Offset = offsetof(StoredState, climate) + climateV2Size;
+static_assert(dliV2Offset % alignof(DliSettings) == 0, "Уставки досветки в записи версии 2 не выровнены");
+// Запись версии 3 заканчивается уставками досветки
+static const size_t v3Size = offsetof(StoredState, pumpFault);
+
+void StateStoreDefaults(StoredState &state) {
+    memset(&state, 0, sizeof(state));
+    state.format = STATE_STORE_FORMAT;
+    state.brightness = 20; // 50/255
+    state.color[0] = 255;
+    state.color[1] = 255;
+    state.color[2] = 255;
+    state.climate = ClimateDefaultSettings();
+    state.dli = DliDefaultSettings();
+}
+
+bool StateStoreLoad(StoredState &state) {
+    StateStoreDefaults(state);
+    Preferences preferences;
+    bool ok = false;
+    if (preferences.begin("state", true)) {
+        StoredState stored;
+        StateStoreDefaults(stored);
+        size_t length = preferences.getBytesLength("state");
+        if (length == sizeof(stored)) {
+            ok = preferences.getBytes("state", &stored, sizeof(stored)) == sizeof(stored) &&
+                 stored.format == STATE_STORE_FORMAT;
+        } else if (length == v3Size) {
+            // Запись версии 3: те же поля без блокировки насоса
+            ok = preferences.getBytes("state", &stored, length) == length &&
+                 stored.format == STATE_STORE_FORMAT_NO_PUMP_FAULT;
+            stored.format = STATE_STORE_FORMAT;
+            stored.pumpFault = false;
+        } else if (length == dliV2Offset + sizeof(DliSettings) || length == dliV2Offset) {
+            // Запись прежней версии: поля до уставок климата на тех же местах, уставки досветки сдвинуты
+            uint8_t buffer[dliV2Offset + sizeof(DliSettings)];
+            uint32_t format = length == dliV2Offset ? STATE_STORE_FORMAT_NO_DLI : STATE_STORE_FORMAT_NO_PUMP_LIMIT;
+            ok = preferences.getBytes("state", buffer, length) == length;
+            memcpy(&stored, buffer, dliV2Offset);
+            if (length > dliV2Offset) {
+                memcpy(&stored.dli, buffer + dliV2Offset, sizeof(DliSettings));
+            }
+            ok = ok && stored.format == format;
+            stored.format = STATE_STORE_FORMAT;
+        }
+        preferences.end();
+        if (ok) {
+            state = stored;
+        }
+    }
+    saved = state;
+    latest = state;
+    return ok;
+}
+
+/**
+ * Запись состояния в NVS
+ */
+static bool Save(const StoredState &state) {
+    Preferences preferences;
+    if (!preferences.begin("state", false)) {
+        return false;
+    }
+    bool ok = preferences.putBytes("state", &state, sizeof(state)) == sizeof(state);
+    preferences.end();
+    return ok;
+}
+
+bool StateStoreLoop(const StoredState &current, uint32_t nowMs) {
+    if (memcmp(&current, &latest, sizeof(current)) != 0) {
+        latest = current;
+        lastChange = nowMs;
+        bool changed = memcmp(&latest, &saved, sizeof(latest)) != 0;
+        if (changed && !dirty) {
+            dirtySince = nowMs;
+        }
+        dirty = changed;
+        portENTER_CRITICAL(&storeLock);
+        stats.pending = dirty;
+        portEXIT_CRITICAL(&storeLock);
+    }
+    if (!dirty || (nowMs - lastChange < STATE_STORE_DELAY_MS && nowMs - dirtySince < STATE_STORE_MAX_DELAY_MS)) {
+        return false;
+    }
+
+    bool ok = Save(latest);
+    if (ok) {
+        saved = latest;
+        dirty = false;
+    } else {
+        // Повтор не раньше, чем через STATE_STORE_DELAY_MS
+        lastChange = nowMs;
+        dirtySince = nowMs;
+    }
+
+    portENTER_CRITICAL(&storeLock);
+    if (ok) {
+        stats.writes++;
+        stats.lastWriteMs = nowMs;
+        stats.pending = false;
+    } else {
+        stats.failures++;
+    }
+    portEXIT_CRITICAL(&storeLock);
+    return ok;
+}
+
+void StateStoreGetStats(StateStoreStats &out) {
+    portENTER_CRITICAL(&storeLock);
+    out = stats;
+    portEXIT_CRITICAL(&storeLock);
+}
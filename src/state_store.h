@@ -0,0 +1,84 @@
+#ifndef STATE_STORE_H
+#define STATE_STORE_H
+
+#include <Arduino.h>
+#include "climate.h"
+#include "dli.h"
+
+/**
+ * Сохранение состояния устройств и уставок в NVS
+ * После перезапуска (например, просадки питания) устройства возвращаются в прежнее состояние,
+ * а не выключаются. Изменения копятся и записываются одной записью, когда поток изменений стихнет
+ */
+
+// Версия формата записи; запись другой версии не восстанавливается
+#define STATE_STORE_FORMAT 4
+// Прежние версии восстанавливаются, недостающие уставки - по умолчанию:
+#define STATE_STORE_FORMAT_NO_DLI 1         // без уставок досветки и ограничения работы насоса
+#define STATE_STORE_FORMAT_NO_PUMP_LIMIT 2  // без ограничения работы насоса (ClimateSettings::maxPumpOnMs)
+#define STATE_STORE_FORMAT_NO_PUMP_FAULT 3  // без блокировки насоса (ClimateState::pumpFault)
+
+// Запись откладывается, пока изменения не прекратятся на это время, мс
+#ifndef STATE_STORE_DELAY_MS
+#define STATE_STORE_DELAY_MS 5000
+#endif
+// ... но не дольше этого времени с первого несохраненного изменения, мс
+#ifndef STATE_STORE_MAX_DELAY_MS
+#define STATE_STORE_MAX_DELAY_MS 30000
+#endif
+
+/**
+ * Сохраняемое состояние
+ * Сравнивается побайтно, поэтому заполняется только через StateStoreDefaults
+ */
+struct StoredState {
+    uint32_t format;
+    bool pump;
+    bool wind;
+    bool light;
+    uint8_t windowAngle;  // Целевой угол форточки
+    uint8_t brightness;   // Яркость RGB-ленты, %
+    uint8_t color[3];     // Цвет RGB-ленты: красный, зеленый, синий
+    ClimateSettings climate;
+    DliSettings dli;      // Новые поля - только в конце: начало записи прежних версий совпадает
+                          // (кроме maxPumpOnMs в конце ClimateSettings, см. StateStoreLoad)
+    bool pumpFault;       // Насос заблокирован регулятором климата: снимается только пользователем
+};
+
+/**
+ * Счетчики записи
+ */
+struct StateStoreStats {
+    uint32_t writes;      // Выполнено записей
+    uint32_t failures;    // Ошибок записи
+    uint32_t lastWriteMs; // Время последней записи, millis()
+    bool pending;         // Есть несохраненные изменения
+};
+
+/**
+ * Состояние по умолчанию: все выключено, форточка закрыта, лента белая на 20%, уставки по умолчанию
+ * @param state Состояние (заполняется полностью, включая выравнивание)
+ */
+void StateStoreDefaults(StoredState &state);
+
+/**
+ * Чтение сохраненного состояния
+ * @param state Состояние (при неудаче - состояние по умолчанию)
+ * @return true, если сохраненное состояние прочитано
+ */
+bool StateStoreLoad(StoredState &state);
+
+/**
+ * Учет текущего состояния и отложенная запись (вызывается основным циклом)
+ * @param current Текущее состояние, заполненное поверх StateStoreDefaults
+ * @param nowMs Текущее время, мс
+ * @return true, если состояние записано
+ */
+bool StateStoreLoop(const StoredState &current, uint32_t nowMs);
+
+/**
+ * Получение счетчиков записи
+ */
+void StateStoreGetStats(StateStoreStats &stats);
+
+#endif
@@ -0,0 +1,581 @@
+/**
+ * Журнал показаний на LittleFS
+ * Сегменты только дописываются записями фиксированного размера с CRC,
+ * время записей строго возрастает, поэтому поиск по времени - двоичный.
+ * Таблица сегментов (первое и последнее время) хранится в памяти
+ * и служит разреженным индексом
+ */
+#include "telemetry_log.h"
+#include <LittleFS.h>
+#include <ESPAsyncWebServer.h>
+#include <esp_system.h>
+
+#define LOG_DIR "/log"
+
+// Флаги записи
+#define LOG_FLAG_BME 0x01    // Показания BME280 достоверны
+#define LOG_FLAG_LIGHT 0x02  // Показание BH1750 достоверно
+
+/**
+ * Запись журнала (16 байт)
+ */
+struct LogRecord {
+    uint32_t time;        // Время по программным часам, секунды
+    int16_t temperature;  // 0.01 °C
+    uint16_t humidity;    // 0.01 %
+    uint16_t pressure;    // 0.1 гПа
+    uint16_t lux;         // 1 лк
+    uint16_t flags;       // LOG_FLAG_*
+    uint16_t crc;         // CRC-16 предыдущих полей
+};
+
+static_assert(sizeof(LogRecord) == 16, "Размер записи журнала должен быть 16 байт");
+
+/**
+ * Сегмент журнала в таблице
+ */
+struct LogSegment {
+    uint32_t id;         // Номер сегмента, он же имя файла
+    uint32_t firstTime;  // Время первой записи
+    uint32_t lastTime;   // Время последней записи
+    uint32_t count;      // Количество достоверных записей
+    bool sealed;         // Дописывать нельзя (поврежденный хвост)
+};
+
+static LogSegment segments[LOG_MAX_SEGMENTS];
+static size_t segmentCount = 0;
+
+static LogRecord pending[LOG_BATCH_RECORDS];
+static size_t pendingCount = 0;
+static bool pendingSeen = false;  // Основной цикл уже видел записи в буфере
+static uint32_t pendingSince = 0; // Время, когда он их увидел, мс
+
+static uint32_t lastTime = 0;     // Время последней записи (на флеш или в буфере)
+static bool logReady = false;
+
+// Накопитель средних значений текущего интервала
+static uint32_t accumulatorBucket = 0;
+static bool accumulatorOpen = false;
+static float accumulatorSum[HISTORY_METRIC_COUNT];
+static uint16_t accumulatorSamples[HISTORY_METRIC_COUNT];
+
+static TelemetryLogStats stats = {};
+
+// Запись идет из основного цикла, чтение - из задачи веб-сервера
+static SemaphoreHandle_t logLock = NULL;
+
+/**
+ * CRC-16/CCITT-FALSE
+ */
+static uint16_t Crc16(const uint8_t *data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t RecordCrc(const LogRecord &record) {
+    return Crc16((const uint8_t *)&record, offsetof(LogRecord, crc));
+}
+
+static void SegmentPath(uint32_t id, char *path, size_t size) {
+    snprintf(path, size, LOG_DIR "/%08x.bin", (unsigned)id);
+}
+
+/**
+ * Чтение записи сегмента по номеру с проверкой CRC
+ */
+static bool ReadRecord(File &file, uint32_t index, LogRecord &record) {
+    if (!file.seek(index * sizeof(LogRecord))) {
+        return false;
+    }
+    if (file.read((uint8_t *)&record, sizeof(record)) != sizeof(record)) {
+        return false;
+    }
+    return record.crc == RecordCrc(record);
+}
+
+/**
+ * Удаление самого старого сегмента
+ */
+static void RemoveOldestSegment() {
+    char path[24];
+    SegmentPath(segments[0].id, path, sizeof(path));
+    LittleFS.remove(path);
+    memmove(&segments[0], &segments[1], (segmentCount - 1) * sizeof(LogSegment));
+    segmentCount--;
+}
+
+/**
+ * Восстановление сегмента: проверка первой записи и поиск последней целой записи с конца
+ * После обрыва питания поврежден может быть только последний записанный пакет
+ * @return false, если сегмент не содержит достоверных записей
+ */
+static bool RecoverSegment(LogSegment &segment) {
+    char path[24];
+    SegmentPath(segment.id, path, sizeof(path));
+    File file = LittleFS.open(path, "r");
+    if (!file) {
+        return false;
+    }
+
+    size_t size = file.size();
+    uint32_t count = size / sizeof(LogRecord);
+    LogRecord record;
+    if (count == 0 || !ReadRecord(file, 0, record)) {
+        file.close();
+        return false;
+    }
+    segment.firstTime = record.time;
+
+    // Поиск последней целой записи, не дальше одного пакета от конца
+    uint32_t valid = count;
+    while (valid > 1 && count - valid <= LOG_BATCH_RECORDS && !ReadRecord(file, valid - 1, record)) {
+        valid--;
+    }
+    if (!ReadRecord(file, valid - 1, record)) {
+        // Повреждение глубже последнего пакета: сегмент проверяется целиком
+        valid = 1;
+        while (valid < count && ReadRecord(file, valid, record)) {
+            valid++;
+        }
+        ReadRecord(file, valid - 1, record);
+    }
+    file.close();
+
+    segment.lastTime = record.time;
+    segment.count = valid;
+    // Сегмент с поврежденным хвостом больше не дописывается
+    segment.sealed = size != valid * sizeof(LogRecord);
+    stats.discarded += count - valid;
+    return true;
+}
+
+bool TelemetryLogBegin() {
+    uint32_t start = millis();
+    if (logLock == NULL) {
+        logLock = xSemaphoreCreateMutex();
+        // Буфер записывается перед программным перезапуском
+        esp_register_shutdown_handler(TelemetryLogFlush);
+    }
+    logReady = false;
+    segmentCount = 0;
+    pendingCount = 0;
+    pendingSeen = false;
+    accumulatorOpen = false;
+    lastTime = 0;
+    stats = {};
+
+    if (!LittleFS.begin(true)) { // При ошибке монтирования раздел форматируется
+        Serial.println("Ошибка монтирования LittleFS");
+        return false;
+    }
+    LittleFS.mkdir(LOG_DIR);
+
+    // Сбор списка сегментов, отсортированного по номеру
+    File dir = LittleFS.open(LOG_DIR);
+    File file;
+    while (dir && (file = dir.openNextFile())) {
+        const char *name = strrchr(file.name(), '/');
+        name = name ? name + 1 : file.name();
+        uint32_t id = strtoul(name, NULL, 16);
+        file.close();
+
+        if (segmentCount == LOG_MAX_SEGMENTS) {
+            // Сегментов больше, чем разрешено: удаляем самый старый
+            if (id < segments[0].id) {
+                char path[24];
+                SegmentPath(id, path, sizeof(path));
+                LittleFS.remove(path);
+                continue;
+            }
+            RemoveOldestSegment();
+        }
+        size_t i = segmentCount++;
+        while (i > 0 && segments[i - 1].id > id) {
+            segments[i] = segments[i - 1];
+            i--;
+        }
+        segments[i] = {id, 0, 0, 0, false};
+    }
+    if (dir) {
+        dir.close();
+    }
+
+    // Проверка сегментов; пустые и поврежденные удаляются
+    size_t kept = 0;
+    for (size_t i = 0; i < segmentCount; i++) {
+        if (RecoverSegment(segments[i])) {
+            segments[kept++] = segments[i];
+        } else {
+            char path[24];
+            SegmentPath(segments[i].id, path, sizeof(path));
+            LittleFS.remove(path);
+        }
+    }
+    segmentCount = kept;
+    // Сегменты дописываются только в конец: все, кроме последнего, закрыты
+    for (size_t i = 0; i + 1 < segmentCount; i++) {
+        segments[i].sealed = true;
+    }
+
+    lastTime = segmentCount > 0 ? segments[segmentCount - 1].lastTime : 0;
+    stats.recoveryMs = millis() - start;
+    logReady = true;
+    return true;
+}
+
+uint32_t TelemetryLogLastTime() {
+    return lastTime;
+}
+
+/**
+ * Запись буфера на флеш (вызывается под logLock)
+ */
+static void FlushLocked() {
+    uint32_t start = micros();
+    size_t written = 0;
+
+    while (written < pendingCount) {
+        // Новый сегмент, если текущий заполнен или закрыт
+        if (segmentCount == 0 || segments[segmentCount - 1].sealed ||
+            segments[segmentCount - 1].count >= LOG_SEGMENT_RECORDS) {
+            if (segmentCount == LOG_MAX_SEGMENTS) {
+                RemoveOldestSegment();
+            }
+            uint32_t id = segmentCount > 0 ? segments[segmentCount - 1].id + 1 : 0;
+            segments[segmentCount++] = {id, pending[written].time, 0, 0, false};
+        }
+
+        LogSegment &segment = segments[segmentCount - 1];
+        size_t count = pendingCount - written;
+        if (count > LOG_SEGMENT_RECORDS - segment.count) {
+            count = LOG_SEGMENT_RECORDS - segment.count;
+        }
+
+        char path[24];
+        SegmentPath(segment.id, path, sizeof(path));
+        File file = LittleFS.open(path, "a");
+        size_t bytes = file ? file.write((const uint8_t *)&pending[written], count * sizeof(LogRecord)) : 0;
+        if (file) {
+            file.close();
+        }
+
+        size_t records = bytes / sizeof(LogRecord);
+        if (segment.count == 0 && records > 0) {
+            segment.firstTime = pending[written].time;
+        }
+        segment.count += records;
+        if (records > 0) {
+            segment.lastTime = pending[written + records - 1].time;
+        }
+        written += records;
+        if (records < count) {
+            // Ошибка записи: сегмент закрывается, остаток пакета теряется
+            segment.sealed = true;
+            if (segment.count == 0) {
+                LittleFS.remove(path);
+                segmentCount--;
+            }
+            break;
+        }
+    }
+
+    pendingCount = 0;
+    pendingSeen = false;
+    stats.lastFlushUs = micros() - start;
+    stats.flushes++;
+}
+
+/**
+ * Добавление записи со средними значениями интервала в буфер
+ */
+static void AppendAccumulated() {
+    if (accumulatorBucket <= lastTime && lastTime != 0) {
+        return; // Время записей должно строго возрастать (например, после перевода часов назад)
+    }
+
+    LogRecord record = {};
+    record.time = accumulatorBucket;
+    float average[HISTORY_METRIC_COUNT];
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        average[m] = accumulatorSamples[m] > 0 ? accumulatorSum[m] / accumulatorSamples[m] : 0;
+    }
+    if (accumulatorSamples[HISTORY_TEMPERATURE] > 0) {
+        record.flags |= LOG_FLAG_BME;
+        record.temperature = (int16_t)constrain(lroundf(average[HISTORY_TEMPERATURE] * 100), -32767L, 32767L);
+        record.humidity = (uint16_t)constrain(lroundf(average[HISTORY_HUMIDITY] * 100), 0L, 65535L);
+        record.pressure = (uint16_t)constrain(lroundf(average[HISTORY_PRESSURE] * 10), 0L, 65535L);
+    }
+    if (accumulatorSamples[HISTORY_LUX] > 0) {
+        record.flags |= LOG_FLAG_LIGHT;
+        record.lux = (uint16_t)constrain(lroundf(average[HISTORY_LUX]), 0L, 65535L);
+    }
+    record.crc = RecordCrc(record);
+
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    pending[pendingCount++] = record;
+    lastTime = record.time;
+    if (pendingCount == LOG_BATCH_RECORDS) {
+        FlushLocked();
+    }
+    xSemaphoreGive(logLock);
+}
+
+void TelemetryLogAdd(uint32_t time, const float values[HISTORY_METRIC_COUNT], const bool valid[HISTORY_METRIC_COUNT]) {
+    if (!logReady) {
+        return;
+    }
+
+    uint32_t bucket = time - time % LOG_INTERVAL_S;
+    if (accumulatorOpen && bucket != accumulatorBucket) {
+        AppendAccumulated();
+        accumulatorOpen = false;
+    }
+    if (!accumulatorOpen) {
+        accumulatorBucket = bucket;
+        accumulatorOpen = true;
+        for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+            accumulatorSum[m] = 0;
+            accumulatorSamples[m] = 0;
+        }
+    }
+    for (int m = 0; m < HISTORY_METRIC_COUNT; m++) {
+        if (valid[m]) {
+            accumulatorSum[m] += values[m];
+            accumulatorSamples[m]++;
+        }
+    }
+}
+
+void TelemetryLogFlush() {
+    if (!logReady) {
+        return;
+    }
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    if (pendingCount > 0) {
+        FlushLocked();
+    }
+    xSemaphoreGive(logLock);
+}
+
+void TelemetryLogLoop(uint32_t nowMs) {
+    if (!logReady) {
+        return;
+    }
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    if (pendingCount == 0) {
+        pendingSeen = false;
+    } else if (!pendingSeen) {
+        pendingSeen = true;
+        pendingSince = nowMs;
+    } else if (nowMs - pendingSince >= LOG_FLUSH_MAX_AGE_MS) {
+        FlushLocked();
+    }
+    xSemaphoreGive(logLock);
+}
+
+/**
+ * Двоичный поиск первой записи сегмента с временем не раньше from
+ * @return Номер записи (count - такой записи нет)
+ */
+static uint32_t FindRecord(File &file, uint32_t count, uint32_t from) {
+    uint32_t low = 0, high = count;
+    LogRecord record;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (ReadRecord(file, middle, record) && record.time < from) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * Значение величины из записи
+ * @return false, если значение в записи недостоверно
+ */
+static bool RecordValue(const LogRecord &record, HistoryMetric metric, float &value) {
+    switch (metric) {
+        case HISTORY_TEMPERATURE:
+            value = record.temperature / 100.0f;
+            return record.flags & LOG_FLAG_BME;
+        case HISTORY_HUMIDITY:
+            value = record.humidity / 100.0f;
+            return record.flags & LOG_FLAG_BME;
+        case HISTORY_PRESSURE:
+            value = record.pressure / 10.0f;
+            return (record.flags & LOG_FLAG_BME) && record.pressure != 0;
+        case HISTORY_LUX:
+            value = record.lux;
+            return record.flags & LOG_FLAG_LIGHT;
+        default:
+            return false;
+    }
+}
+
+/**
+ * Форматирование записи в строку CSV
+ * @return Длина строки
+ */
+static size_t FormatRecord(const LogRecord &record, char *line, size_t size) {
+    if ((record.flags & LOG_FLAG_BME) && (record.flags & LOG_FLAG_LIGHT)) {
+        return snprintf(line, size, "%u,%.2f,%.2f,%.1f,%u\n", (unsigned)record.time,
+                        record.temperature / 100.0f, record.humidity / 100.0f, record.pressure / 10.0f, record.lux);
+    }
+    if (record.flags & LOG_FLAG_BME) {
+        return snprintf(line, size, "%u,%.2f,%.2f,%.1f,\n", (unsigned)record.time,
+                        record.temperature / 100.0f, record.humidity / 100.0f, record.pressure / 10.0f);
+    }
+    if (record.flags & LOG_FLAG_LIGHT) {
+        return snprintf(line, size, "%u,,,,%u\n", (unsigned)record.time, record.lux);
+    }
+    return snprintf(line, size, "%u,,,,\n", (unsigned)record.time);
+}
+
+/**
+ * Вывод записи в буфер фрагмента, если она в интервале и помещается целиком
+ * @return false, если выдачу нужно прекратить (конец интервала или нет места)
+ */
+static bool EmitRecord(TelemetryLogStream &stream, const LogRecord &record,
+                       uint8_t *buffer, size_t maxLen, size_t &written) {
+    if (record.time > stream.to) {
+        stream.finished = true;
+        return false;
+    }
+    char line[64];
+    size_t length = FormatRecord(record, line, sizeof(line));
+    if (length > maxLen - written) {
+        return false;
+    }
+    memcpy(buffer + written, line, length);
+    written += length;
+    stream.from = record.time + 1;
+    return true;
+}
+
+size_t TelemetryLogStreamChunk(TelemetryLogStream &stream, uint8_t *buffer, size_t maxLen) {
+    size_t written = 0;
+
+    if (!stream.headerSent) {
+        static const char header[] = "time,temperature,humidity,pressure,lux\n";
+        if (sizeof(header) - 1 > maxLen) {
+            return RESPONSE_TRY_AGAIN;
+        }
+        memcpy(buffer, header, sizeof(header) - 1);
+        written = sizeof(header) - 1;
+        stream.headerSent = true;
+    }
+    if (!logReady || stream.finished) {
+        stream.finished = true;
+        return written;
+    }
+
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    bool more = true;
+    for (size_t i = 0; i < segmentCount && more; i++) {
+        const LogSegment &segment = segments[i];
+        if (segment.lastTime < stream.from) {
+            continue;
+        }
+
+        char path[24];
+        SegmentPath(segment.id, path, sizeof(path));
+        File file = LittleFS.open(path, "r");
+        if (!file) {
+            continue;
+        }
+
+        // Последовательное чтение от первой записи интервала
+        uint32_t low = FindRecord(file, segment.count, stream.from);
+        LogRecord record;
+        file.seek(low * sizeof(LogRecord));
+        for (uint32_t index = low; index < segment.count && more; index++) {
+            if (file.read((uint8_t *)&record, sizeof(record)) != sizeof(record)) {
+                break;
+            }
+            if (record.crc != RecordCrc(record) || record.time < stream.from) {
+                continue;
+            }
+            more = EmitRecord(stream, record, buffer, maxLen, written);
+        }
+        file.close();
+    }
+
+    // Записи из буфера, еще не попавшие на флеш
+    for (size_t i = 0; i < pendingCount && more; i++) {
+        if (pending[i].time >= stream.from) {
+            more = EmitRecord(stream, pending[i], buffer, maxLen, written);
+        }
+    }
+    if (more) {
+        stream.finished = true;
+    }
+    xSemaphoreGive(logLock);
+
+    if (written == 0 && !stream.finished) {
+        return RESPONSE_TRY_AGAIN; // В буфере нет места даже для одной записи
+    }
+    return written;
+}
+
+uint32_t TelemetryLogSum(HistoryMetric metric, uint32_t from, uint32_t to, float &sum) {
+    sum = 0;
+    if (!logReady || from > to) {
+        return 0;
+    }
+    uint32_t count = 0;
+    float value;
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    for (size_t i = 0; i < segmentCount; i++) {
+        const LogSegment &segment = segments[i];
+        if (segment.lastTime < from || segment.firstTime > to) {
+            continue;
+        }
+        char path[24];
+        SegmentPath(segment.id, path, sizeof(path));
+        File file = LittleFS.open(path, "r");
+        if (!file) {
+            continue;
+        }
+        file.seek(FindRecord(file, segment.count, from) * sizeof(LogRecord));
+        LogRecord record;
+        while (file.read((uint8_t *)&record, sizeof(record)) == sizeof(record) && record.time <= to) {
+            if (record.crc == RecordCrc(record) && record.time >= from && RecordValue(record, metric, value)) {
+                sum += value;
+                count++;
+            }
+        }
+        file.close();
+    }
+    for (size_t i = 0; i < pendingCount; i++) {
+        if (pending[i].time >= from && pending[i].time <= to && RecordValue(pending[i], metric, value)) {
+            sum += value;
+            count++;
+        }
+    }
+    xSemaphoreGive(logLock);
+    return count;
+}
+
+void TelemetryLogGetStats(TelemetryLogStats &out) {
+    if (logLock == NULL) {
+        out = stats;
+        return;
+    }
+    xSemaphoreTake(logLock, portMAX_DELAY);
+    out = stats;
+    out.segments = segmentCount;
+    out.records = 0;
+    for (size_t i = 0; i < segmentCount; i++) {
+        out.records += segments[i].count;
+    }
+    out.pending = pendingCount;
+    xSemaphoreGive(logLock);
+}
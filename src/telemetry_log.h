@@ -0,0 +1,107 @@
+#ifndef TELEMETRY_LOG_H
+#define TELEMETRY_LOG_H
+
+#include <Arduino.h>
+#include "history.h"
+
+// Параметры журнала (можно переопределить через build_flags)
+#ifndef LOG_INTERVAL_S
+#define LOG_INTERVAL_S 60          // Одна запись (средние значения) за интервал, секунды
+#endif
+#ifndef LOG_BATCH_RECORDS
+#define LOG_BATCH_RECORDS 16       // Записей в буфере перед записью на флеш
+#endif
+#ifndef LOG_SEGMENT_RECORDS
+#define LOG_SEGMENT_RECORDS 1024   // Записей в одном сегменте (16 КБ)
+#endif
+#ifndef LOG_MAX_SEGMENTS
+#define LOG_MAX_SEGMENTS 32        // Сегментов на флеш, самый старый удаляется при ротации
+#endif
+#ifndef LOG_FLUSH_MAX_AGE_MS
+#define LOG_FLUSH_MAX_AGE_MS 300000 // Неполный пакет пишется на флеш, если ждет дольше, мс
+#endif
+
+/**
+ * Статистика журнала
+ */
+struct TelemetryLogStats {
+    uint32_t segments;       // Количество сегментов
+    uint32_t records;        // Записей на флеш
+    uint32_t pending;        // Записей в буфере, еще не записанных
+    uint32_t recoveryMs;     // Длительность восстановления при старте
+    uint32_t lastFlushUs;    // Длительность последней записи пакета
+    uint32_t flushes;        // Количество записей пакетов
+    uint32_t discarded;      // Поврежденных записей, отброшенных при восстановлении
+};
+
+/**
+ * Состояние потоковой выдачи журнала для одного HTTP-ответа
+ */
+struct TelemetryLogStream {
+    uint32_t from;     // Время следующей записи
+    uint32_t to;       // Конец интервала включительно
+    bool headerSent;   // Заголовок CSV уже выдан
+    bool finished;     // Все записи выданы
+};
+
+/**
+ * Монтирование файловой системы и восстановление журнала после перезапуска
+ * Проверяются только первая и последние записи сегментов, полный просмотр не нужен
+ * @return true, если журнал готов к работе
+ */
+bool TelemetryLogBegin();
+
+/**
+ * Время последней записи журнала (0 - журнал пуст)
+ */
+uint32_t TelemetryLogLastTime();
+
+/**
+ * Учет измерения; раз в LOG_INTERVAL_S в буфер добавляется запись со средними значениями,
+ * заполненный буфер записывается на флеш одним пакетом
+ * @param time Время измерения по программным часам, секунды
+ * @param values Значения в порядке HistoryMetric
+ * @param valid Признаки достоверности значений в порядке HistoryMetric
+ */
+void TelemetryLogAdd(uint32_t time, const float values[HISTORY_METRIC_COUNT], const bool valid[HISTORY_METRIC_COUNT]);
+
+/**
+ * Принудительная запись буфера на флеш
+ * Вызывается и при программном перезапуске (обработчик esp_restart)
+ */
+void TelemetryLogFlush();
+
+/**
+ * Запись неполного пакета на флеш, если записи ждут в буфере дольше LOG_FLUSH_MAX_AGE_MS
+ * Ограничивает потерю записей при обрыве питания (вызывается из основного цикла)
+ * @param nowMs Текущее время, millis()
+ */
+void TelemetryLogLoop(uint32_t nowMs);
+
+/**
+ * Заполнение очередного фрагмента CSV-ответа с записями журнала
+ * Начало интервала находится двоичным поиском по сегментам
+ * @param stream Состояние выдачи
+ * @param buffer Буфер фрагмента
+ * @param maxLen Размер буфера
+ * @return Количество записанных байт (0 - выдача завершена)
+ */
+size_t TelemetryLogStreamChunk(TelemetryLogStream &stream, uint8_t *buffer, size_t maxLen);
+
+/**
+ * Сумма значений величины по записям журнала за интервал (например, для интеграла за сутки)
+ * Каждая запись - среднее за LOG_INTERVAL_S
+ * @param metric Величина
+ * @param from Начало интервала по программным часам, включительно
+ * @param to Конец интервала, включительно
+ * @param sum Сумма значений
+ * @return Количество записей с достоверным значением
+ */
+uint32_t TelemetryLogSum(HistoryMetric metric, uint32_t from, uint32_t to, float &sum);
+
+/**
+ * Получение статистики журнала
+ */
+void TelemetryLogGetStats(TelemetryLogStats &stats);
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * Замена Arduino.h для сборки на компьютере (env:native)
+ * Время, String, Serial, макросы, выводы GPIO и частота процессора - то, чем пользуется прошивка
+ */
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+using std::max;
+using std::min;
+
+typedef uint8_t byte;
+
+inline std::atomic<uint64_t> &HostClockShiftUs() {
+    static std::atomic<uint64_t> shift(0);
+    return shift;
+}
+
+/**
+ * Монотонное время процесса, мкс (со сдвигом HostAdvanceMillis)
+ */
+inline uint64_t HostMicros() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count() +
+           HostClockShiftUs().load();
+}
+
+/**
+ * Сдвиг millis() и micros() вперед: тест проходит долгие таймауты без ожидания
+ * (тики FreeRTOS и паузы не сдвигаются)
+ */
+inline void HostAdvanceMillis(uint32_t ms) {
+    HostClockShiftUs() += (uint64_t)ms * 1000;
+}
+
+inline unsigned long millis() {
+    return (unsigned long)(HostMicros() / 1000);
+}
+
+inline unsigned long micros() {
+    return (unsigned long)HostMicros();
+}
+
+inline void delay(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {
+    std::this_thread::yield();
+}
+
+inline long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+/**
+ * Выводы GPIO: уровень и режим запоминаются, тест читает их через HostPinLevel
+ */
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+#define HOST_PIN_COUNT 40
+
+inline std::atomic<uint8_t> *HostPins() {
+    static std::atomic<uint8_t> pins[HOST_PIN_COUNT];
+    return pins;
+}
+
+inline uint8_t HostPinLevel(uint8_t pin) {
+    return pin < HOST_PIN_COUNT ? HostPins()[pin].load() : LOW;
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {}
+
+inline void digitalWrite(uint8_t pin, uint8_t level) {
+    if (pin < HOST_PIN_COUNT) {
+        HostPins()[pin].store(level);
+    }
+}
+
+inline int digitalRead(uint8_t pin) {
+    return HostPinLevel(pin);
+}
+
+/**
+ * Частота процессора: только запоминается
+ */
+inline std::atomic<uint32_t> &HostCpuFrequencyMhz() {
+    static std::atomic<uint32_t> mhz(240);
+    return mhz;
+}
+
+inline bool setCpuFrequencyMhz(uint32_t mhz) {
+    HostCpuFrequencyMhz().store(mhz);
+    return true;
+}
+
+inline uint32_t getCpuFrequencyMhz() {
+    return HostCpuFrequencyMhz().load();
+}
+
+/**
+ * Строка Arduino поверх std::string (только используемые методы)
+ */
+class String {
+public:
+    String() {}
+    String(const char *text) : value(text != NULL ? text : "") {}
+    String(const std::string &text) : value(text) {}
+    String(char c) : value(1, c) {}
+    String(int number) : value(std::to_string(number)) {}
+    String(unsigned number) : value(std::to_string(number)) {}
+    String(long number) : value(std::to_string(number)) {}
+    String(unsigned long number) : value(std::to_string(number)) {}
+    String(float number, unsigned decimals = 2) { Format(number, decimals); }
+    String(double number, unsigned decimals = 2) { Format(number, decimals); }
+
+    const char *c_str() const { return value.c_str(); }
+    unsigned length() const { return value.size(); }
+    bool isEmpty() const { return value.empty(); }
+    bool reserve(unsigned size) { value.reserve(size); return true; }
+    long toInt() const { return atol(value.c_str()); }
+    float toFloat() const { return atof(value.c_str()); }
+    int indexOf(const char *text) const { return Position(value.find(text)); }
+    int indexOf(char c) const { return Position(value.find(c)); }
+    bool startsWith(const String &prefix) const { return value.compare(0, prefix.value.size(), prefix.value) == 0; }
+    bool endsWith(const String &suffix) const {
+        return value.size() >= suffix.value.size() &&
+               value.compare(value.size() - suffix.value.size(), suffix.value.size(), suffix.value) == 0;
+    }
+    bool equalsIgnoreCase(const String &other) const {
+        return value.size() == other.value.size() &&
+               std::equal(value.begin(), value.end(), other.value.begin(),
+                          [](char a, char b) { return tolower((unsigned char)a) == tolower((unsigned char)b); });
+    }
+    void replace(const String &from, const String &to) {
+        if (from.value.empty()) {
+            return;
+        }
+        for (size_t position = value.find(from.value); position != std::string::npos;
+             position = value.find(from.value, position + to.value.size())) {
+            value.replace(position, from.value.size(), to.value);
+        }
+    }
+    void toLowerCase() {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return tolower(c); });
+    }
+    bool equals(const String &other) const { return value == other.value; }
+    String substring(unsigned from) const { return from < value.size() ? String(value.substr(from)) : String(); }
+    String substring(unsigned from, unsigned to) const {
+        return from < to && from < value.size() ? String(value.substr(from, to - from)) : String();
+    }
+    char operator[](unsigned index) const { return index < value.size() ? value[index] : '\0'; }
+
+    String &operator+=(const String &other) { value += other.value; return *this; }
+    String &operator+=(const char *other) { value += other; return *this; }
+    String &operator+=(char c) { value += c; return *this; }
+    bool operator==(const String &other) const { return value == other.value; }
+    bool operator==(const char *other) const { return value == other; }
+    bool operator!=(const String &other) const { return value != other.value; }
+    bool operator!=(const char *other) const { return value != other; }
+
+    friend String operator+(const String &a, const String &b) { return String(a.value + b.value); }
+    friend String operator+(const String &a, const char *b) { return String(a.value + b); }
+    friend String operator+(const char *a, const String &b) { return String(a + b.value); }
+
+private:
+    std::string value;
+
+    void Format(double number, unsigned decimals) {
+        char text[48];
+        snprintf(text, sizeof(text), "%.*f", (int)decimals, number);
+        value = text;
+    }
+
+    static int Position(size_t position) {
+        return position == std::string::npos ? -1 : (int)position;
+    }
+};
+
+/**
+ * Serial: вывод в stdout; HostMute отключает вывод (замеры под нагрузкой)
+ */
+class HostSerial {
+public:
+    void begin(unsigned long) {}
+    void print(const char *text) { Write(text, false); }
+    void print(const String &text) { Write(text.c_str(), false); }
+    void print(long number) { Write(String(number).c_str(), false); }
+    void println(const char *text = "") { Write(text, true); }
+    void println(const String &text) { Write(text.c_str(), true); }
+    void println(long number) { Write(String(number).c_str(), true); }
+    template <typename... Args>
+    void printf(const char *format, Args... args) {
+        if (!muted.load()) {
+            ::printf(format, args...);
+        }
+    }
+
+    void HostMute(bool mute) { muted.store(mute); }
+
+private:
+    std::atomic<bool> muted{false};
+
+    void Write(const char *text, bool newline) {
+        if (!muted.load()) {
+            fputs(text, stdout);
+            if (newline) {
+                fputc('\n', stdout);
+            }
+        }
+    }
+};
+
+inline HostSerial Serial;
+
+/**
+ * Объект ESP: MAC-адрес из eFuse
+ */
+class HostEsp {
+public:
+    uint64_t getEfuseMac() { return 0x0000A1B2C3D4E5F6ULL; }
+};
+
+inline HostEsp ESP;
+
+#endif
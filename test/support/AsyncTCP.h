@@ -0,0 +1,6 @@
+#ifndef HOST_ASYNC_TCP_H
+#define HOST_ASYNC_TCP_H
+
+// Сокеты сервера открывает замена ESPAsyncWebServer
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef HOST_BH1750_H
+#define HOST_BH1750_H
+
+/**
+ * Замена библиотеки BH1750 (claws/BH1750) поверх Wire: команды и чтение - те же транзакции,
+ * что у библиотеки, поэтому отсутствие датчика на шине видно так же, как на плате
+ */
+#include <Wire.h>
+
+class BH1750 {
+public:
+    enum Mode {
+        UNCONFIGURED = 0,
+        CONTINUOUS_HIGH_RES_MODE = 0x10,
+        CONTINUOUS_HIGH_RES_MODE_2 = 0x11,
+        CONTINUOUS_LOW_RES_MODE = 0x13,
+        ONE_TIME_HIGH_RES_MODE = 0x20,
+        ONE_TIME_HIGH_RES_MODE_2 = 0x21,
+        ONE_TIME_LOW_RES_MODE = 0x23
+    };
+
+    BH1750(uint8_t address = 0x23) : address(address) {}
+
+    bool begin(Mode mode = CONTINUOUS_HIGH_RES_MODE, uint8_t address = 0x23, TwoWire *wire = NULL) {
+        this->address = address;
+        return configure(mode);
+    }
+
+    bool configure(Mode mode) {
+        Wire.beginTransmission(address);
+        Wire.write((uint8_t)mode);
+        if (Wire.endTransmission() != 0) {
+            return false;
+        }
+        this->mode = mode;
+        return true;
+    }
+
+    /**
+     * @return Освещенность, лк; -1 - ошибка чтения, -2 - датчик не настроен
+     */
+    float readLightLevel() {
+        if (mode == UNCONFIGURED) {
+            return -2;
+        }
+        if (Wire.requestFrom(address, 2) != 2) {
+            return -1;
+        }
+        uint16_t raw = Wire.read() << 8;
+        raw |= Wire.read();
+        float lux = raw / 1.2f;
+        return mode == CONTINUOUS_HIGH_RES_MODE_2 || mode == ONE_TIME_HIGH_RES_MODE_2 ? lux / 2 : lux;
+    }
+
+private:
+    uint8_t address;
+    Mode mode = UNCONFIGURED;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HOST_ESP32_SERVO_H
+#define HOST_ESP32_SERVO_H
+
+/**
+ * Замена ESP32Servo: угол запоминается, тест читает его через HostServoAngle
+ */
+#include <Arduino.h>
+
+inline std::atomic<int> *HostServoAngles() {
+    static std::atomic<int> angles[HOST_PIN_COUNT];
+    return angles;
+}
+
+inline int HostServoAngle(uint8_t pin) {
+    return pin < HOST_PIN_COUNT ? HostServoAngles()[pin].load() : 0;
+}
+
+class Servo {
+public:
+    int attach(int pin) {
+        this->pin = pin;
+        return 0;
+    }
+
+    bool attached() const { return pin >= 0; }
+
+    void write(int value) {
+        angle = constrain(value, 0, 180);
+        if (pin >= 0 && pin < HOST_PIN_COUNT) {
+            HostServoAngles()[pin].store(angle);
+        }
+    }
+
+    int read() const { return angle; }
+
+private:
+    int pin = -1;
+    int angle = 0;
+};
+
+#endif
@@ -0,0 +1,695 @@
+#ifndef HOST_ESP_ASYNC_WEB_SERVER_H
+#define HOST_ESP_ASYNC_WEB_SERVER_H
+
+/**
+ * Замена ESPAsyncWebServer
+ *
+ * Запрос можно создать прямо в тесте: запрос запоминает отправленный ответ, HostFinishRequest
+ * завершает его так же, как библиотека после отправки или отключения клиента.
+ *
+ * AsyncWebServer::begin открывает настоящий сервер HTTP/1.1 на 127.0.0.1 (порт выбирает система,
+ * его возвращает HostPort). Как и в библиотеке, запросы обслуживает одна задача (async_tcp):
+ * обработчик выбирается по правилам AsyncCallbackWebHandler, тело формы разбирается в параметры
+ * POST, остальные тела передаются обработчику тела частями по сегменту TCP, потоковый ответ
+ * выдается кусками Transfer-Encoding: chunked. Соединение закрывается после ответа.
+ * WebSocket не поддерживается: клиентов всегда нет
+ */
+#include <Arduino.h>
+#include <esp_timer.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <functional>
+#include <list>
+#include <utility>
+#include <vector>
+
+// Потоковый ответ: данных пока нет, выдача продолжится позже
+#define RESPONSE_TRY_AGAIN 0xFFFFFFFF
+
+// Часть тела, передаваемая обработчику тела за раз (сегмент TCP)
+#define HOST_HTTP_SEGMENT 1436
+
+enum WebRequestMethod {
+    HTTP_GET = 0b00000001,
+    HTTP_POST = 0b00000010,
+    HTTP_DELETE = 0b00000100,
+    HTTP_PUT = 0b00001000,
+    HTTP_PATCH = 0b00010000,
+    HTTP_HEAD = 0b00100000,
+    HTTP_OPTIONS = 0b01000000,
+    HTTP_ANY = 0b01111111
+};
+
+typedef uint8_t WebRequestMethodComposite;
+
+class AsyncWebServerRequest;
+
+typedef std::function<size_t(uint8_t *, size_t, size_t)> AwsResponseFiller;
+typedef std::function<String(const String &)> AwsTemplateProcessor;
+typedef std::function<void(AsyncWebServerRequest *)> ArRequestHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, const String &, size_t, uint8_t *, size_t, bool)>
+    ArUploadHandlerFunction;
+typedef std::function<void(AsyncWebServerRequest *, uint8_t *, size_t, size_t, size_t)> ArBodyHandlerFunction;
+
+class AsyncWebServerResponse {
+public:
+    AsyncWebServerResponse(int code, const String &contentType) : code(code), contentType(contentType) {}
+    virtual ~AsyncWebServerResponse() {}
+
+    void addHeader(const String &name, const String &value) { headers.push_back(std::make_pair(name, value)); }
+    void setCode(int code) { this->code = code; }
+
+    /**
+     * Длина тела (-1 - неизвестна, тело выдается кусками)
+     */
+    virtual long contentLength() const { return 0; }
+
+    /**
+     * Очередная часть тела, как у заполняющей функции библиотеки
+     * @return Длина части, 0 - тело закончилось, RESPONSE_TRY_AGAIN - данных пока нет
+     */
+    virtual size_t fill(uint8_t *buffer, size_t maxLen, size_t index) { return 0; }
+
+    /**
+     * Тело ответа целиком (для ответа из памяти - читается из буфера в момент вызова)
+     */
+    String body() {
+        std::string text;
+        uint8_t buffer[HOST_HTTP_SEGMENT];
+        for (;;) {
+            size_t length = fill(buffer, sizeof(buffer), text.size());
+            if (length == RESPONSE_TRY_AGAIN) {
+                yield();
+                continue;
+            }
+            if (length == 0) {
+                return String(text);
+            }
+            text.append((const char *)buffer, length);
+        }
+    }
+
+    int code;
+    String contentType;
+    std::vector<std::pair<String, String>> headers;
+};
+
+/**
+ * Ответ с телом в String
+ */
+class AsyncBasicResponse : public AsyncWebServerResponse {
+public:
+    AsyncBasicResponse(int code, const String &contentType, const String &content)
+        : AsyncWebServerResponse(code, contentType), content(content) {}
+
+    long contentLength() const override { return content.length(); }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) override {
+        size_t length = index < content.length() ? std::min(maxLen, (size_t)content.length() - index) : 0;
+        memcpy(buffer, content.c_str() + index, length);
+        return length;
+    }
+
+    String content;
+};
+
+/**
+ * Ответ, тело которого читается из буфера по мере отправки
+ */
+class AsyncProgmemResponse : public AsyncWebServerResponse {
+public:
+    AsyncProgmemResponse(int code, const String &contentType, const uint8_t *content, size_t len,
+                         AwsTemplateProcessor callback = nullptr)
+        : AsyncWebServerResponse(code, contentType), content(content), length(len) {}
+
+    long contentLength() const override { return length; }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) override {
+        size_t part = index < length ? std::min(maxLen, length - index) : 0;
+        memcpy(buffer, content + index, part);
+        return part;
+    }
+
+    const uint8_t *content;
+    size_t length;
+};
+
+/**
+ * Потоковый ответ: тело выдает заполняющая функция
+ */
+class AsyncChunkedResponse : public AsyncWebServerResponse {
+public:
+    AsyncChunkedResponse(const String &contentType, AwsResponseFiller filler)
+        : AsyncWebServerResponse(200, contentType), filler(filler) {}
+
+    long contentLength() const override { return -1; }
+
+    size_t fill(uint8_t *buffer, size_t maxLen, size_t index) override { return filler(buffer, maxLen, index); }
+
+    AwsResponseFiller filler;
+};
+
+class AsyncWebParameter {
+public:
+    AsyncWebParameter(const String &name, const String &value, bool form) : _name(name), _value(value), form(form) {}
+
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+    bool isPost() const { return form; }
+    bool isFile() const { return false; }
+
+private:
+    String _name;
+    String _value;
+    bool form;
+};
+
+class AsyncWebHeader {
+public:
+    AsyncWebHeader(const String &name, const String &value) : _name(name), _value(value) {}
+
+    const String &name() const { return _name; }
+    const String &value() const { return _value; }
+
+private:
+    String _name;
+    String _value;
+};
+
+class AsyncWebServerRequest {
+public:
+    AsyncWebServerRequest() {}
+
+    // Буфер _tempObject освобождается вместе с запросом, как в библиотеке
+    ~AsyncWebServerRequest() {
+        delete response;
+        free(_tempObject);
+    }
+
+    WebRequestMethodComposite method() const { return _method; }
+    const String &url() const { return _url; }
+
+    size_t params() const { return _params.size(); }
+
+    AsyncWebParameter *getParam(size_t index) const {
+        for (const AsyncWebParameter &param : _params) {
+            if (index-- == 0) {
+                return const_cast<AsyncWebParameter *>(&param);
+            }
+        }
+        return NULL;
+    }
+
+    bool hasParam(const String &name, bool post = false, bool file = false) const {
+        return getParam(name, post, file) != NULL;
+    }
+
+    AsyncWebParameter *getParam(const String &name, bool post = false, bool file = false) const {
+        for (const AsyncWebParameter &param : _params) {
+            if (param.name() == name && param.isPost() == post && !file) {
+                return const_cast<AsyncWebParameter *>(&param);
+            }
+        }
+        return NULL;
+    }
+
+    bool hasHeader(const String &name) const { return getHeader(name) != NULL; }
+
+    AsyncWebHeader *getHeader(const String &name) const {
+        for (const AsyncWebHeader &header : _headers) {
+            if (header.name().equalsIgnoreCase(name)) {
+                return const_cast<AsyncWebHeader *>(&header);
+            }
+        }
+        return NULL;
+    }
+
+    AsyncWebServerResponse *beginResponse(int code, const String &contentType = String(),
+                                          const String &content = String()) {
+        return new AsyncBasicResponse(code, contentType, content);
+    }
+
+    AsyncWebServerResponse *beginResponse_P(int code, const String &contentType, const uint8_t *content, size_t len,
+                                            AwsTemplateProcessor callback = nullptr) {
+        return new AsyncProgmemResponse(code, contentType, content, len, callback);
+    }
+
+    AsyncWebServerResponse *beginChunkedResponse(const String &contentType, AwsResponseFiller filler,
+                                                 AwsTemplateProcessor callback = nullptr) {
+        return new AsyncChunkedResponse(contentType, filler);
+    }
+
+    void send(AsyncWebServerResponse *sent) {
+        delete response;
+        response = sent;
+    }
+
+    void send(int code, const String &contentType = String(), const String &content = String()) {
+        send(beginResponse(code, contentType, content));
+    }
+
+    void onDisconnect(std::function<void()> handler) { disconnectHandler = handler; }
+
+    /**
+     * Разбор запроса сервером (и тестом, создающим запрос сам)
+     */
+    void HostSetMethod(WebRequestMethodComposite method) { _method = method; }
+    void HostSetUrl(const String &url) { _url = url; }
+    void HostAddParam(const String &name, const String &value, bool post) { _params.emplace_back(name, value, post); }
+    void HostAddHeader(const String &name, const String &value) { _headers.emplace_back(name, value); }
+
+    void *_tempObject = NULL;
+    AsyncWebServerResponse *response = NULL;  // Отправленный ответ
+    std::function<void()> disconnectHandler;
+
+private:
+    WebRequestMethodComposite _method = HTTP_GET;
+    String _url;
+    std::list<AsyncWebParameter> _params;  // Адреса параметров не меняются при добавлении
+    std::list<AsyncWebHeader> _headers;
+};
+
+/**
+ * Завершение запроса после отправки ответа или отключения клиента: вызывается обработчик
+ * onDisconnect, затем запрос удаляется вместе с ответом
+ */
+inline void HostFinishRequest(AsyncWebServerRequest *request) {
+    if (request->disconnectHandler) {
+        request->disconnectHandler();
+    }
+    delete request;
+}
+
+class AsyncWebHandler {
+public:
+    virtual ~AsyncWebHandler() {}
+    virtual bool canHandle(AsyncWebServerRequest *request) { return false; }
+    virtual void handleRequest(AsyncWebServerRequest *request) {}
+    virtual void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) {}
+};
+
+/**
+ * Обработчик server.on: совпадает адрес целиком, адрес с продолжением "/..." или префикс перед "*"
+ */
+class AsyncCallbackWebHandler : public AsyncWebHandler {
+public:
+    AsyncCallbackWebHandler(const String &uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                            ArUploadHandlerFunction onUpload, ArBodyHandlerFunction onBody)
+        : uri(uri), method(method), onRequest(onRequest), onUpload(onUpload), onBody(onBody) {}
+
+    bool canHandle(AsyncWebServerRequest *request) override {
+        if (!onRequest || !(method & request->method())) {
+            return false;
+        }
+        if (uri.length() > 0 && uri.endsWith("*")) {
+            return request->url().startsWith(uri.substring(0, uri.length() - 1));
+        }
+        return uri.length() == 0 || uri == request->url() || request->url().startsWith(uri + "/");
+    }
+
+    void handleRequest(AsyncWebServerRequest *request) override { onRequest(request); }
+
+    void handleBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total) override {
+        if (onBody) {
+            onBody(request, data, len, index, total);
+        }
+    }
+
+private:
+    String uri;
+    WebRequestMethodComposite method;
+    ArRequestHandlerFunction onRequest;
+    ArUploadHandlerFunction onUpload;
+    ArBodyHandlerFunction onBody;
+};
+
+class AsyncWebSocketClient {
+public:
+    uint32_t id() const { return 0; }
+    void text(const char *message, size_t len) {}
+    void text(const char *message) {}
+};
+
+enum AwsEventType { WS_EVT_CONNECT, WS_EVT_DISCONNECT, WS_EVT_PONG, WS_EVT_ERROR, WS_EVT_DATA };
+
+class AsyncWebSocket : public AsyncWebHandler {
+public:
+    typedef std::function<void(AsyncWebSocket *, AsyncWebSocketClient *, AwsEventType, void *, uint8_t *, size_t)>
+        AwsEventHandler;
+
+    AsyncWebSocket(const String &url) {}
+
+    void onEvent(AwsEventHandler handler) {}
+    void textAll(const char *message, size_t len) {}
+    void textAll(const char *message) {}
+    void binaryAll(const uint8_t *message, size_t len) {}
+    void cleanupClients(uint16_t maxClients = 8) {}
+    size_t count() const { return 0; }
+};
+
+/**
+ * Обслуженный запрос (для замеров)
+ */
+struct HostServedRequest {
+    uint32_t sequence;     // Номер запроса с запуска сервера
+    int code;              // Код ответа
+    size_t bodyBytes;      // Длина отправленного тела
+    uint32_t handlerUs;    // Время в обработчике запроса
+    size_t allocations;    // Выделений памяти задачей сервера от разбора тела до удаления запроса
+    size_t peakHeapBytes;  // Наибольший прирост кучи задачи сервера за то же время
+};
+
+class AsyncWebServer {
+public:
+    AsyncWebServer(uint16_t port) {}
+
+    AsyncCallbackWebHandler &on(const char *uri, WebRequestMethodComposite method, ArRequestHandlerFunction onRequest,
+                                ArUploadHandlerFunction onUpload = nullptr, ArBodyHandlerFunction onBody = nullptr) {
+        AsyncCallbackWebHandler *handler = new AsyncCallbackWebHandler(uri, method, onRequest, onUpload, onBody);
+        handlers.push_back(handler);
+        return *handler;
+    }
+
+    AsyncWebHandler &addHandler(AsyncWebHandler *handler) {
+        handlers.push_back(handler);
+        return *handler;
+    }
+
+    void onNotFound(ArRequestHandlerFunction handler) { notFound = handler; }
+
+    /**
+     * Запуск сервера на 127.0.0.1 (порт возвращает HostPort)
+     */
+    void begin() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t length = sizeof(address);
+        if (bind(fd, (sockaddr *)&address, sizeof(address)) != 0 || listen(fd, 16) != 0 ||
+            getsockname(fd, (sockaddr *)&address, &length) != 0) {
+            close(fd);
+            return;
+        }
+        listenFd = fd;
+        xTaskCreatePinnedToCore(ServerTask, "async_tcp", 8192, this, 3, NULL, 0);
+        port.store(ntohs(address.sin_port));
+    }
+
+    /**
+     * Порт запущенного сервера (0 - сервер не запущен)
+     */
+    uint16_t HostPort() const { return port.load(); }
+
+    /**
+     * Счетчик выделений памяти текущего потока для HostServedRequest::allocations
+     */
+    void HostCountAllocations(size_t (*counter)()) { allocationCounter = counter; }
+
+    /**
+     * Замер пика кучи задачи сервера для HostServedRequest::peakHeapBytes
+     * @param mark Начало замера: текущие байты кучи потока
+     * @param peak Наибольшие байты кучи потока с начала замера
+     */
+    void HostMeasureHeap(int64_t (*mark)(), int64_t (*peak)()) {
+        heapMark = mark;
+        heapPeak = peak;
+    }
+
+    HostServedRequest HostLastServed() {
+        std::lock_guard<std::mutex> guard(servedLock);
+        return served;
+    }
+
+private:
+    std::vector<AsyncWebHandler *> handlers;
+    ArRequestHandlerFunction notFound;
+    std::atomic<uint16_t> port{0};
+    int listenFd = -1;
+    size_t (*allocationCounter)() = NULL;
+    int64_t (*heapMark)() = NULL;
+    int64_t (*heapPeak)() = NULL;
+    std::mutex servedLock;
+    HostServedRequest served = {};
+
+    /**
+     * Задача сервера: соединения обслуживаются по одному
+     */
+    static void ServerTask(void *parameter) {
+        AsyncWebServer *server = (AsyncWebServer *)parameter;
+        for (;;) {
+            int client = accept(server->listenFd, NULL, NULL);
+            if (client >= 0) {
+                server->Serve(client);
+            }
+        }
+    }
+
+    size_t Allocations() { return allocationCounter != NULL ? allocationCounter() : 0; }
+
+    static bool SendAll(int fd, const void *data, size_t length) {
+        const uint8_t *bytes = (const uint8_t *)data;
+        while (length > 0) {
+            ssize_t sent = ::send(fd, bytes, length, MSG_NOSIGNAL);
+            if (sent <= 0) {
+                return false;
+            }
+            bytes += sent;
+            length -= sent;
+        }
+        return true;
+    }
+
+    static String Decode(const std::string &text) {
+        std::string decoded;
+        for (size_t i = 0; i < text.size(); i++) {
+            if (text[i] == '+') {
+                decoded += ' ';
+            } else if (text[i] == '%' && i + 2 < text.size() && isxdigit(text[i + 1]) && isxdigit(text[i + 2])) {
+                decoded += (char)strtol(text.substr(i + 1, 2).c_str(), NULL, 16);
+                i += 2;
+            } else {
+                decoded += text[i];
+            }
+        }
+        return String(decoded);
+    }
+
+    /**
+     * Разбор параметров вида a=1&b=2
+     */
+    static void ParseParams(AsyncWebServerRequest *request, const std::string &text, bool post) {
+        size_t start = 0;
+        while (start < text.size()) {
+            size_t end = text.find('&', start);
+            if (end == std::string::npos) {
+                end = text.size();
+            }
+            std::string pair = text.substr(start, end - start);
+            size_t equals = pair.find('=');
+            if (!pair.empty()) {
+                request->HostAddParam(Decode(pair.substr(0, equals)),
+                                      equals != std::string::npos ? Decode(pair.substr(equals + 1)) : String(), post);
+            }
+            start = end + 1;
+        }
+    }
+
+    static WebRequestMethodComposite ParseMethod(const std::string &name) {
+        const char *names[] = {"GET", "POST", "DELETE", "PUT", "PATCH", "HEAD", "OPTIONS"};
+        for (int i = 0; i < 7; i++) {
+            if (name == names[i]) {
+                return 1 << i;
+            }
+        }
+        return 0;
+    }
+
+    static const char *Reason(int code) {
+        switch (code) {
+            case 200: return "OK";
+            case 202: return "Accepted";
+            case 304: return "Not Modified";
+            case 400: return "Bad Request";
+            case 404: return "Not Found";
+            case 412: return "Precondition Failed";
+            case 413: return "Payload Too Large";
+            case 500: return "Internal Server Error";
+            case 503: return "Service Unavailable";
+            default: return "";
+        }
+    }
+
+    /**
+     * Обслуживание одного соединения: запрос, ответ, закрытие
+     */
+    void Serve(int fd) {
+        std::string raw;
+        char buffer[HOST_HTTP_SEGMENT];
+        size_t headerEnd;
+        while ((headerEnd = raw.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0 || raw.size() > 16384) {
+                close(fd);
+                return;
+            }
+            raw.append(buffer, received);
+        }
+
+        AsyncWebServerRequest *request = new AsyncWebServerRequest();
+        size_t lineEnd = raw.find("\r\n");
+        std::string line = raw.substr(0, lineEnd);
+        size_t space = line.find(' ');
+        size_t target = line.find(' ', space + 1);
+        request->HostSetMethod(ParseMethod(line.substr(0, space)));
+        std::string path = line.substr(space + 1, target - space - 1);
+        size_t query = path.find('?');
+        request->HostSetUrl(Decode(path.substr(0, query)));
+        if (query != std::string::npos) {
+            ParseParams(request, path.substr(query + 1), false);
+        }
+
+        size_t contentLength = 0;
+        String contentType;
+        for (size_t start = lineEnd + 2; start < headerEnd;) {
+            size_t end = raw.find("\r\n", start);
+            std::string header = raw.substr(start, end - start);
+            size_t colon = header.find(':');
+            if (colon != std::string::npos) {
+                size_t value = header.find_first_not_of(' ', colon + 1);
+                String name(header.substr(0, colon));
+                String text(value != std::string::npos ? header.substr(value) : std::string());
+                request->HostAddHeader(name, text);
+                if (name.equalsIgnoreCase("Content-Length")) {
+                    contentLength = text.toInt();
+                } else if (name.equalsIgnoreCase("Content-Type")) {
+                    contentType = text;
+                }
+            }
+            start = end + 2;
+        }
+        std::string body = raw.substr(headerEnd + 4);
+        while (body.size() < contentLength) {
+            ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                break;
+            }
+            body.append(buffer, received);
+        }
+        body.resize(std::min(body.size(), contentLength));
+
+        AsyncWebHandler *handler = NULL;
+        for (AsyncWebHandler *candidate : handlers) {
+            if (candidate->canHandle(request)) {
+                handler = candidate;
+                break;
+            }
+        }
+
+        size_t allocationsBefore = Allocations();
+        int64_t heapBefore = heapMark != NULL ? heapMark() : 0;
+        int64_t started = esp_timer_get_time();
+        if (contentType.startsWith("application/x-www-form-urlencoded")) {
+            ParseParams(request, body, true);
+        } else if (handler != NULL) {
+            for (size_t index = 0; index < body.size(); index += HOST_HTTP_SEGMENT) {
+                size_t part = std::min((size_t)HOST_HTTP_SEGMENT, body.size() - index);
+                handler->handleBody(request, (uint8_t *)&body[index], part, index, body.size());
+            }
+        }
+        if (handler != NULL) {
+            handler->handleRequest(request);
+        } else if (notFound) {
+            notFound(request);
+        } else {
+            request->send(404);
+        }
+        uint32_t handlerUs = (uint32_t)(esp_timer_get_time() - started);
+        if (request->response == NULL) {
+            request->send(500, "text/plain", "No response");
+        }
+
+        size_t bodyBytes = Respond(fd, request->method(), request->response);
+        int code = request->response->code;
+        if (request->disconnectHandler) {
+            request->disconnectHandler();
+        }
+        delete request;
+        size_t allocations = Allocations() - allocationsBefore;
+        size_t peakHeap = heapPeak != NULL ? (size_t)std::max(heapPeak() - heapBefore, (int64_t)0) : 0;
+        {
+            std::lock_guard<std::mutex> guard(servedLock);
+            served = {served.sequence + 1, code, bodyBytes, handlerUs, allocations, peakHeap};
+        }
+        close(fd);
+    }
+
+    /**
+     * Дописывание строки заголовка ответа в буфер (лишнее отбрасывается)
+     */
+    template <size_t size, typename... Args>
+    static void Append(char (&head)[size], size_t &used, const char *format, Args... args) {
+        int written = snprintf(head + used, size - used, format, args...);
+        used = std::min(used + std::max(written, 0), size - 1);
+    }
+
+    /**
+     * Отправка ответа без выделений памяти
+     * @return Длина отправленного тела
+     */
+    size_t Respond(int fd, WebRequestMethodComposite method, AsyncWebServerResponse *response) {
+        char head[1024];
+        size_t used = 0;
+        long length = response->contentLength();
+        Append(head, used, "HTTP/1.1 %d %s\r\n", response->code, Reason(response->code));
+        if (response->contentType.length() > 0) {
+            Append(head, used, "Content-Type: %s\r\n", response->contentType.c_str());
+        }
+        if (length >= 0) {
+            Append(head, used, "Content-Length: %ld\r\n", length);
+        } else {
+            Append(head, used, "Transfer-Encoding: chunked\r\n");
+        }
+        for (const std::pair<String, String> &header : response->headers) {
+            Append(head, used, "%s: %s\r\n", header.first.c_str(), header.second.c_str());
+        }
+        Append(head, used, "Connection: close\r\n\r\n");
+        if (!SendAll(fd, head, used) || method == HTTP_HEAD) {
+            return 0;
+        }
+
+        // Место под заголовок куска "XXX\r\n" и окончание "\r\n"
+        uint8_t chunk[8 + HOST_HTTP_SEGMENT + 2];
+        uint8_t *data = chunk + 8;
+        size_t sent = 0;
+        for (;;) {
+            size_t part = response->fill(data, HOST_HTTP_SEGMENT, sent);
+            if (part == RESPONSE_TRY_AGAIN) {
+                vTaskDelay(1);
+                continue;
+            }
+            if (length >= 0) {
+                if (part == 0 || !SendAll(fd, data, part)) {
+                    return sent;
+                }
+            } else {
+                char size[8];
+                int sizeLength = snprintf(size, sizeof(size), "%zx\r\n", part);
+                uint8_t *start = data - sizeLength;
+                memcpy(start, size, sizeLength);
+                data[part] = '\r';
+                data[part + 1] = '\n';
+                if (!SendAll(fd, start, sizeLength + part + 2) || part == 0) {
+                    return sent;
+                }
+            }
+            sent += part;
+        }
+    }
+};
+
+#endif
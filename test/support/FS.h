@@ -0,0 +1,195 @@
+#ifndef HOST_FS_H
+#define HOST_FS_H
+
+/**
+ * Файловая система в памяти вместо LittleFS
+ * Тест может читать и портить содержимое файлов (files), ограничивать запись
+ * (writeLimit - обрыв питания посреди записи) и считать обращения к файлам
+ */
+#include <Arduino.h>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+};
+
+typedef std::vector<uint8_t> HostFileData;
+
+/**
+ * Счетчики обращений к файлам
+ */
+struct HostFsCounters {
+    uint32_t opens;
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t seeks;
+    uint64_t bytesRead;
+    uint64_t bytesWritten;
+};
+
+class File {
+public:
+    File() {}
+
+    operator bool() const { return data != NULL || directory; }
+
+    size_t size() const { return data != NULL ? data->size() : 0; }
+    size_t position() const { return offset; }
+    const char *name() const { return fileName.c_str(); }
+    bool isDirectory() const { return directory; }
+
+    bool seek(uint32_t position, SeekMode mode = SeekSet) {
+        if (data == NULL) {
+            return false;
+        }
+        counters->seeks++;
+        size_t base = mode == SeekSet ? 0 : (mode == SeekCur ? offset : data->size());
+        if (base + position > data->size()) {
+            return false;
+        }
+        offset = base + position;
+        return true;
+    }
+
+    size_t read(uint8_t *buffer, size_t length) {
+        if (data == NULL || offset >= data->size()) {
+            return 0;
+        }
+        counters->reads++;
+        length = std::min(length, data->size() - offset);
+        memcpy(buffer, data->data() + offset, length);
+        offset += length;
+        counters->bytesRead += length;
+        return length;
+    }
+
+    size_t write(const uint8_t *buffer, size_t length) {
+        if (data == NULL || !writable) {
+            return 0;
+        }
+        counters->writes++;
+        // Ограничение записи: остаток после исчерпания лимита не записывается
+        if (length > *writeLimit) {
+            length = *writeLimit;
+        }
+        *writeLimit -= length;
+        if (append) {
+            offset = data->size();
+        }
+        if (offset + length > data->size()) {
+            data->resize(offset + length);
+        }
+        memcpy(data->data() + offset, buffer, length);
+        offset += length;
+        counters->bytesWritten += length;
+        return length;
+    }
+
+    void flush() {}
+
+    void close() {
+        data.reset();
+        directory = false;
+    }
+
+    File openNextFile() {
+        if (!directory || next >= entries.size()) {
+            return File();
+        }
+        return entries[next++];
+    }
+
+private:
+    friend class HostFs;
+
+    std::shared_ptr<HostFileData> data;
+    std::string fileName;
+    size_t offset = 0;
+    bool writable = false;
+    bool append = false;
+    bool directory = false;
+    std::vector<File> entries;
+    size_t next = 0;
+    HostFsCounters *counters = NULL;
+    size_t *writeLimit = NULL;
+};
+
+/**
+ * Файловая система: плоский список файлов с полными путями и множество каталогов
+ */
+class HostFs {
+public:
+    std::map<std::string, std::shared_ptr<HostFileData>> files;
+    std::set<std::string> directories;
+    HostFsCounters counters = {};
+    size_t writeLimit = SIZE_MAX;
+
+    bool begin(bool formatOnFail = false) { return true; }
+
+    /**
+     * Удаление всех файлов и сброс счетчиков и ограничения записи
+     */
+    void format() {
+        files.clear();
+        directories.clear();
+        counters = {};
+        writeLimit = SIZE_MAX;
+    }
+
+    bool mkdir(const char *path) {
+        directories.insert(path);
+        return true;
+    }
+
+    bool exists(const char *path) {
+        return files.count(path) > 0 || directories.count(path) > 0;
+    }
+
+    bool remove(const char *path) {
+        return files.erase(path) > 0;
+    }
+
+    File open(const char *path, const char *mode = "r") {
+        File file;
+        counters.opens++;
+        file.counters = &counters;
+        file.writeLimit = &writeLimit;
+        if (directories.count(path) > 0) {
+            std::string prefix = std::string(path) + "/";
+            file.directory = true;
+            for (auto &entry : files) {
+                if (entry.first.compare(0, prefix.size(), prefix) == 0 &&
+                    entry.first.find('/', prefix.size()) == std::string::npos) {
+                    file.entries.push_back(open(entry.first.c_str(), "r"));
+                }
+            }
+            return file;
+        }
+        auto found = files.find(path);
+        if (mode[0] == 'r' && found == files.end()) {
+            return File();
+        }
+        if (found == files.end() || mode[0] == 'w') {
+            files[path] = std::make_shared<HostFileData>();
+        }
+        const char *slash = strrchr(path, '/');
+        file.fileName = slash != NULL ? slash + 1 : path;
+        file.data = files[path];
+        file.writable = mode[0] != 'r' || mode[1] == '+';
+        file.append = mode[0] == 'a';
+        return file;
+    }
+
+    File open(const String &path, const char *mode = "r") { return open(path.c_str(), mode); }
+};
+
+namespace fs {
+typedef HostFs FS;
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+/**
+ * Замена FastLED: кадр, выведенный show, копируется, тест читает его через HostFrame
+ */
+#include <Arduino.h>
+#include <vector>
+
+struct CRGB {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+
+    CRGB() {}
+    CRGB(uint8_t r, uint8_t g, uint8_t b) : r(r), g(g), b(b) {}
+    CRGB(uint32_t code) : r((code >> 16) & 0xFF), g((code >> 8) & 0xFF), b(code & 0xFF) {}
+
+    bool operator==(const CRGB &other) const { return r == other.r && g == other.g && b == other.b; }
+    bool operator!=(const CRGB &other) const { return !(*this == other); }
+};
+
+enum EOrder { RGB = 0012, RBG = 0021, GRB = 0102, GBR = 0120, BRG = 0201, BGR = 0210 };
+
+// Типы лент: только имена для addLeds
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class SK6812 {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812B {};
+template <uint8_t DATA_PIN, EOrder RGB_ORDER> class WS2812 {};
+
+class CFastLED {
+public:
+    template <template <uint8_t, EOrder> class CHIPSET, uint8_t DATA_PIN, EOrder RGB_ORDER>
+    CFastLED &addLeds(CRGB *leds, int count) {
+        this->leds = leds;
+        this->count = count;
+        return *this;
+    }
+
+    void setBrightness(uint8_t value) { brightness = value; }
+    uint8_t getBrightness() const { return brightness; }
+
+    void show() {
+        std::lock_guard<std::mutex> guard(lock);
+        frame.assign(leds, leds + count);
+        frames++;
+    }
+
+    /**
+     * Последний выведенный кадр
+     * @param shown Количество выведенных кадров с начала программы
+     */
+    std::vector<CRGB> HostFrame(uint32_t *shown = NULL) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (shown != NULL) {
+            *shown = frames;
+        }
+        return frame;
+    }
+
+private:
+    CRGB *leds = NULL;
+    int count = 0;
+    uint8_t brightness = 255;
+    std::mutex lock;
+    std::vector<CRGB> frame;
+    uint32_t frames = 0;
+};
+
+inline CFastLED FastLED;
+
+#endif
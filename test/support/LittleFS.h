@@ -0,0 +1,21 @@
+#ifndef HOST_LITTLEFS_H
+#define HOST_LITTLEFS_H
+
+#include "FS.h"
+
+class LittleFSFS : public HostFs {
+public:
+    size_t totalBytes() { return 1536 * 1024; }
+
+    size_t usedBytes() {
+        size_t used = 0;
+        for (auto &entry : files) {
+            used += entry.second->size();
+        }
+        return used;
+    }
+};
+
+inline LittleFSFS LittleFS;
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef HOST_PREFERENCES_H
+#define HOST_PREFERENCES_H
+
+/**
+ * Замена Preferences (NVS): записи хранятся в памяти процесса, пространства имен общие
+ * для всех объектов, как в настоящем NVS. Только двоичные записи - ими пользуются модули.
+ * Обращения из разных задач упорядочены блокировкой, как в NVS
+ */
+#include <Arduino.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+    bool begin(const char *name, bool readOnly = false) {
+        space = name;
+        this->readOnly = readOnly;
+        return true;
+    }
+
+    void end() {}
+
+    size_t putBytes(const char *key, const void *value, size_t length) {
+        if (readOnly) {
+            return 0;
+        }
+        const uint8_t *bytes = (const uint8_t *)value;
+        std::lock_guard<std::mutex> guard(Lock());
+        Storage()[space][key].assign(bytes, bytes + length);
+        return length;
+    }
+
+    size_t getBytesLength(const char *key) {
+        std::lock_guard<std::mutex> guard(Lock());
+        const std::vector<uint8_t> *record = Find(key);
+        return record != NULL ? record->size() : 0;
+    }
+
+    size_t getBytes(const char *key, void *buffer, size_t maxLength) {
+        std::lock_guard<std::mutex> guard(Lock());
+        const std::vector<uint8_t> *record = Find(key);
+        if (record == NULL || record->size() > maxLength) {
+            return 0;
+        }
+        memcpy(buffer, record->data(), record->size());
+        return record->size();
+    }
+
+    bool remove(const char *key) {
+        std::lock_guard<std::mutex> guard(Lock());
+        return !readOnly && Storage()[space].erase(key) > 0;
+    }
+
+    /**
+     * Удаление всех записей всех пространств имен (между тестами)
+     */
+    static void HostClear() {
+        std::lock_guard<std::mutex> guard(Lock());
+        Storage().clear();
+    }
+
+private:
+    typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Records;
+
+    static std::mutex &Lock() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    static Records &Storage() {
+        static Records records;
+        return records;
+    }
+
+    const std::vector<uint8_t> *Find(const char *key) {
+        Records::iterator names = Storage().find(space);
+        if (names == Storage().end()) {
+            return NULL;
+        }
+        std::map<std::string, std::vector<uint8_t>>::iterator record = names->second.find(key);
+        return record != names->second.end() ? &record->second : NULL;
+    }
+
+    std::string space;
+    bool readOnly = false;
+};
+
+#endif
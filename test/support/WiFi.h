@@ -0,0 +1,96 @@
+#ifndef HOST_WIFI_H
+#define HOST_WIFI_H
+
+/**
+ * Замена WiFi: точка доступа только запоминает настройки
+ * Тест задает число подключенных станций и может сорвать запуск точки доступа
+ */
+#include <Arduino.h>
+
+typedef enum {
+    WIFI_POWER_19_5dBm = 78,
+    WIFI_POWER_19dBm = 76,
+    WIFI_POWER_18_5dBm = 74,
+    WIFI_POWER_17dBm = 68,
+    WIFI_POWER_15dBm = 60,
+    WIFI_POWER_13dBm = 52,
+    WIFI_POWER_11dBm = 44,
+    WIFI_POWER_8_5dBm = 34,
+    WIFI_POWER_7dBm = 28,
+    WIFI_POWER_5dBm = 20,
+    WIFI_POWER_2dBm = 8,
+    WIFI_POWER_MINUS_1dBm = -4
+} wifi_power_t;
+
+class IPAddress {
+public:
+    IPAddress() : bytes{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : bytes{a, b, c, d} {}
+
+    /**
+     * Разбор адреса "a.b.c.d"
+     */
+    bool fromString(const char *text) {
+        unsigned parts[4];
+        char tail;
+        if (sscanf(text, "%u.%u.%u.%u%c", &parts[0], &parts[1], &parts[2], &parts[3], &tail) != 4) {
+            return false;
+        }
+        for (int i = 0; i < 4; i++) {
+            if (parts[i] > 255) {
+                return false;
+            }
+            bytes[i] = parts[i];
+        }
+        return true;
+    }
+
+    uint8_t operator[](int index) const { return bytes[index]; }
+    uint8_t &operator[](int index) { return bytes[index]; }
+
+    String toString() const {
+        char text[16];
+        snprintf(text, sizeof(text), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3]);
+        return String(text);
+    }
+
+private:
+    uint8_t bytes[4];
+};
+
+class WiFiClass {
+public:
+    bool softAP(const char *ssid, const char *password = NULL, int channel = 1, int hidden = 0, int maxStations = 4) {
+        return !failSoftAp.load();
+    }
+
+    IPAddress softAPIP() { return IPAddress(192, 168, 4, 1); }
+
+    uint8_t softAPgetStationNum() { return stations.load(); }
+
+    bool setTxPower(wifi_power_t power) {
+        txPower.store(power);
+        return true;
+    }
+
+    wifi_power_t getTxPower() { return txPower.load(); }
+
+    /**
+     * Подключенные к точке доступа станции
+     */
+    void HostSetStations(uint8_t count) { stations.store(count); }
+
+    /**
+     * Следующие запуски точки доступа завершатся ошибкой
+     */
+    void HostFailSoftAp(bool fail) { failSoftAp.store(fail); }
+
+private:
+    std::atomic<uint8_t> stations{0};
+    std::atomic<wifi_power_t> txPower{WIFI_POWER_19_5dBm};
+    std::atomic<bool> failSoftAp{false};
+};
+
+inline WiFiClass WiFi;
+
+#endif
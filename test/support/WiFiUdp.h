@@ -0,0 +1,53 @@
+#ifndef HOST_WIFI_UDP_H
+#define HOST_WIFI_UDP_H
+
+/**
+ * Замена WiFiUDP: пакет отправляется настоящим сокетом UDP (в тестах - на 127.0.0.1)
+ */
+#include <WiFi.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+class WiFiUDP {
+public:
+    ~WiFiUDP() {
+        if (socketFd >= 0) {
+            close(socketFd);
+        }
+    }
+
+    int beginPacket(IPAddress address, uint16_t port) {
+        memset(&destination, 0, sizeof(destination));
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(port);
+        destination.sin_addr.s_addr = htonl(((uint32_t)address[0] << 24) | ((uint32_t)address[1] << 16) |
+                                            ((uint32_t)address[2] << 8) | address[3]);
+        packet.clear();
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t length) {
+        packet.insert(packet.end(), data, data + length);
+        return length;
+    }
+
+    size_t write(uint8_t value) { return write(&value, 1); }
+
+    int endPacket() {
+        if (socketFd < 0) {
+            socketFd = socket(AF_INET, SOCK_DGRAM, 0);
+        }
+        return socketFd >= 0 && sendto(socketFd, packet.data(), packet.size(), 0, (const sockaddr *)&destination,
+                                       sizeof(destination)) == (ssize_t)packet.size();
+    }
+
+private:
+    int socketFd = -1;
+    sockaddr_in destination = {};
+    std::vector<uint8_t> packet;
+};
+
+#endif
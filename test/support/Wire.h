@@ -0,0 +1,111 @@
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+/**
+ * Шина I2C: транзакции передаются моделям микросхем, подключенным через HostAttach
+ * Адрес без модели не отвечает (NACK), как на плате без датчика
+ */
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+/**
+ * Модель микросхемы на шине
+ */
+class HostI2cDevice {
+public:
+    virtual ~HostI2cDevice() {}
+
+    /**
+     * Запись: все байты одной транзакции
+     */
+    virtual void write(const uint8_t *data, size_t length) = 0;
+
+    /**
+     * Чтение length байт
+     * @return Количество прочитанных байт
+     */
+    virtual size_t read(uint8_t *data, size_t length) = 0;
+};
+
+class TwoWire {
+public:
+    bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { return true; }
+    bool setClock(uint32_t frequency) { return true; }
+
+    void beginTransmission(int address) {
+        txAddress = address;
+        tx.clear();
+    }
+
+    size_t write(uint8_t value) {
+        tx.push_back(value);
+        return 1;
+    }
+
+    size_t write(const uint8_t *data, size_t length) {
+        tx.insert(tx.end(), data, data + length);
+        return length;
+    }
+
+    /**
+     * @return 0 - успешно, 2 - адрес не ответил
+     */
+    uint8_t endTransmission(bool stop = true) {
+        std::lock_guard<std::mutex> guard(lock);
+        HostI2cDevice *device = Find(txAddress);
+        if (device == NULL) {
+            return 2;
+        }
+        if (!tx.empty()) {
+            device->write(tx.data(), tx.size());
+        }
+        return 0;
+    }
+
+    uint8_t requestFrom(int address, int length, int stop = 1) {
+        std::lock_guard<std::mutex> guard(lock);
+        rx.clear();
+        rxIndex = 0;
+        HostI2cDevice *device = Find(address);
+        if (device == NULL || length <= 0) {
+            return 0;
+        }
+        rx.resize(length);
+        rx.resize(device->read(rx.data(), length));
+        return rx.size();
+    }
+
+    int available() { return rx.size() - rxIndex; }
+
+    int read() { return rxIndex < rx.size() ? rx[rxIndex++] : -1; }
+
+    /**
+     * Подключение модели микросхемы (NULL - отключение: датчик перестает отвечать)
+     */
+    void HostAttach(uint8_t address, HostI2cDevice *device) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (device != NULL) {
+            devices[address] = device;
+        } else {
+            devices.erase(address);
+        }
+    }
+
+private:
+    std::mutex lock;
+    std::map<uint8_t, HostI2cDevice *> devices;
+    int txAddress = 0;
+    std::vector<uint8_t> tx;
+    std::vector<uint8_t> rx;
+    size_t rxIndex = 0;
+
+    HostI2cDevice *Find(int address) {
+        std::map<uint8_t, HostI2cDevice *>::iterator device = devices.find(address);
+        return device != devices.end() ? device->second : NULL;
+    }
+};
+
+inline TwoWire Wire;
+
+#endif
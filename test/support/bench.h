@@ -0,0 +1,192 @@
+#ifndef HOST_BENCH_H
+#define HOST_BENCH_H
+
+/**
+ * Замеры для тестов на компьютере: время операций с перцентилями, счетчик выделений памяти
+ * и пик занятой кучи
+ * Результаты печатаются строками "BENCH <имя>: ...", их видно в pio test -e native -v
+ *
+ * Счетчик выделений подменяет глобальный operator new (с glibc - и malloc), поэтому включается
+ * только в одном файле программы: #define BENCH_COUNT_ALLOCATIONS перед #include "bench.h".
+ * Выделения считаются отдельно по потокам: замер не видит выделений других задач
+ */
+#include <Arduino.h>
+#include <new>
+#include <vector>
+
+/**
+ * Текущее время, нс
+ */
+inline uint64_t BenchNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * Длительности отдельных операций
+ */
+struct BenchSamples {
+    std::vector<uint64_t> ns;
+};
+
+/**
+ * Подготовка к замеру: память под длительности выделяется заранее, а не во время замера
+ */
+inline void BenchBegin(BenchSamples &samples, size_t count) {
+    samples.ns.clear();
+    samples.ns.reserve(count);
+}
+
+inline void BenchRecord(BenchSamples &samples, uint64_t ns) {
+    samples.ns.push_back(ns);
+}
+
+/**
+ * Итог замера
+ */
+struct BenchSummary {
+    size_t count;
+    double mean;   // нс
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+};
+
+inline BenchSummary BenchSummarize(BenchSamples &samples) {
+    BenchSummary summary = {};
+    summary.count = samples.ns.size();
+    if (summary.count == 0) {
+        return summary;
+    }
+    std::sort(samples.ns.begin(), samples.ns.end());
+    double total = 0;
+    for (uint64_t ns : samples.ns) {
+        total += ns;
+    }
+    summary.mean = total / summary.count;
+    summary.p50 = samples.ns[(summary.count - 1) / 2];
+    summary.p99 = samples.ns[(summary.count - 1) * 99 / 100];
+    summary.max = samples.ns.back();
+    return summary;
+}
+
+/**
+ * Печать итога замера
+ * @return Итог
+ */
+inline BenchSummary BenchReport(const char *name, BenchSamples &samples) {
+    BenchSummary summary = BenchSummarize(samples);
+    printf("BENCH %s: n=%zu mean=%.0f ns p50=%llu ns p99=%llu ns max=%llu ns\n", name, summary.count,
+           summary.mean, (unsigned long long)summary.p50, (unsigned long long)summary.p99,
+           (unsigned long long)summary.max);
+    return summary;
+}
+
+/**
+ * Печать пропускной способности
+ * @param operations Количество операций
+ * @param ns Общая длительность
+ */
+inline void BenchReportRate(const char *name, uint64_t operations, uint64_t ns) {
+    printf("BENCH %s: %llu ops in %.3f ms, %.0f ops/s\n", name, (unsigned long long)operations, ns / 1e6,
+           ns > 0 ? operations * 1e9 / ns : 0.0);
+}
+
+// Количество выделений памяти текущим потоком с его начала
+inline thread_local size_t benchAllocations = 0;
+// Байты кучи, выделенные текущим потоком за вычетом освобожденных им (только с glibc),
+// и их наибольшее значение с BenchHeapMark
+inline thread_local int64_t benchHeapBytes = 0;
+inline thread_local int64_t benchHeapPeak = 0;
+
+/**
+ * Начало замера пика кучи текущего потока
+ * @return Байты кучи потока в начале замера: пик замера - benchHeapPeak минус это значение
+ */
+inline int64_t BenchHeapMark() {
+    benchHeapPeak = benchHeapBytes;
+    return benchHeapBytes;
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+#ifdef __GLIBC__
+// glibc: подменяются и malloc/calloc/realloc/free (буферы тел запросов), operator new выделяет через malloc
+// Занятые байты - фактические размеры блоков (malloc_usable_size)
+#include <malloc.h>
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+void __libc_free(void *pointer);
+
+static void *BenchHeapTake(void *pointer) {
+    if (pointer != NULL) {
+        benchHeapBytes += malloc_usable_size(pointer);
+        benchHeapPeak = max(benchHeapPeak, benchHeapBytes);
+    }
+    return pointer;
+}
+
+void *malloc(size_t size) {
+    benchAllocations++;
+    return BenchHeapTake(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size) {
+    benchAllocations++;
+    return BenchHeapTake(__libc_calloc(count, size));
+}
+
+void *realloc(void *pointer, size_t size) {
+    benchAllocations++;
+    size_t previous = pointer != NULL ? malloc_usable_size(pointer) : 0;
+    void *moved = __libc_realloc(pointer, size);
+    if (moved != NULL || size == 0) {
+        benchHeapBytes -= previous;
+    }
+    return BenchHeapTake(moved);
+}
+
+void free(void *pointer) {
+    if (pointer != NULL) {
+        benchHeapBytes -= malloc_usable_size(pointer);
+    }
+    __libc_free(pointer);
+}
+}
+#endif
+
+void *operator new(size_t size) {
+#ifndef __GLIBC__
+    benchAllocations++;
+#endif
+    void *pointer = malloc(size > 0 ? size : 1);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+#endif
+
+#endif
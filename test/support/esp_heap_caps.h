@@ -0,0 +1,16 @@
+#ifndef HOST_ESP_HEAP_CAPS_H
+#define HOST_ESP_HEAP_CAPS_H
+
+/**
+ * Сведения о куче: в тестах - постоянные значения порядка кучи ESP32
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+
+inline size_t heap_caps_get_free_size(uint32_t caps) { return 200000; }
+inline size_t heap_caps_get_minimum_free_size(uint32_t caps) { return 150000; }
+inline size_t heap_caps_get_largest_free_block(uint32_t caps) { return 110000; }
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <Arduino.h>
+#include <vector>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum {
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_EXT,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_INT_WDT,
+    ESP_RST_TASK_WDT,
+    ESP_RST_WDT,
+    ESP_RST_DEEPSLEEP,
+    ESP_RST_BROWNOUT,
+    ESP_RST_SDIO,
+} esp_reset_reason_t;
+
+/**
+ * На компьютере программа всегда запускается как после включения питания
+ */
+inline esp_reset_reason_t esp_reset_reason() {
+    return ESP_RST_POWERON;
+}
+
+typedef void (*shutdown_handler_t)(void);
+
+inline std::vector<shutdown_handler_t> &HostShutdownHandlers() {
+    static std::vector<shutdown_handler_t> handlers;
+    return handlers;
+}
+
+inline esp_err_t esp_register_shutdown_handler(shutdown_handler_t handler) {
+    HostShutdownHandlers().push_back(handler);
+    return ESP_OK;
+}
+
+/**
+ * Программный перезапуск для тестов: вызываются зарегистрированные обработчики
+ */
+inline void HostRestart() {
+    for (shutdown_handler_t handler : HostShutdownHandlers()) {
+        handler();
+    }
+}
+
+#endif
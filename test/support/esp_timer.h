@@ -0,0 +1,10 @@
+#ifndef HOST_ESP_TIMER_H
+#define HOST_ESP_TIMER_H
+
+#include <Arduino.h>
+
+inline int64_t esp_timer_get_time() {
+    return (int64_t)HostMicros();
+}
+
+#endif
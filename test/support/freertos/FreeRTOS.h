@@ -0,0 +1,32 @@
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+/**
+ * Замена FreeRTOS для сборки на компьютере
+ * Задачи - потоки, тик - миллисекунда, критическая секция - рекурсивный мьютекс
+ * (на ESP32 вложенный вход в секцию того же ядра тоже допустим)
+ */
+#include <stdint.h>
+#include <mutex>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define portNUM_PROCESSORS 2
+
+typedef struct {
+    std::recursive_mutex mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {}
+#define portENTER_CRITICAL(mux) ((mux)->mutex.lock())
+#define portEXIT_CRITICAL(mux) ((mux)->mutex.unlock())
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef HOST_FREERTOS_QUEUE_H
+#define HOST_FREERTOS_QUEUE_H
+
+/**
+ * Очереди FreeRTOS: элементы копируются, как в настоящей очереди
+ * HostQueuesHold задерживает получателей всех очередей: тест ставит серию команд,
+ * и задача забирает ее целиком за одно пробуждение
+ */
+#include "task.h"
+#include <deque>
+#include <string.h>
+
+struct HostQueue {
+    size_t itemSize;
+    size_t capacity;
+    std::deque<std::vector<uint8_t>> items;
+    std::mutex mutex;
+    std::condition_variable changed;
+};
+
+typedef HostQueue *QueueHandle_t;
+
+/**
+ * Состояние задержки получателей: все очереди и их условные переменные
+ */
+struct HostQueueHold {
+    std::mutex mutex;
+    bool held = false;
+    std::vector<HostQueue *> queues;
+};
+
+inline HostQueueHold &HostQueueHoldState() {
+    static HostQueueHold hold;
+    return hold;
+}
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    HostQueue *queue = new HostQueue();
+    queue->itemSize = itemSize;
+    queue->capacity = length;
+    std::lock_guard<std::mutex> guard(HostQueueHoldState().mutex);
+    HostQueueHoldState().queues.push_back(queue);
+    return queue;
+}
+
+inline bool HostQueuesHeld() {
+    std::lock_guard<std::mutex> guard(HostQueueHoldState().mutex);
+    return HostQueueHoldState().held;
+}
+
+/**
+ * Задержка получателей всех очередей (отправка продолжает работать)
+ * @param held true - получатели ждут, false - забирают накопленное
+ */
+inline void HostQueuesHold(bool held) {
+    std::vector<HostQueue *> queues;
+    {
+        std::lock_guard<std::mutex> guard(HostQueueHoldState().mutex);
+        HostQueueHoldState().held = held;
+        queues = HostQueueHoldState().queues;
+    }
+    for (HostQueue *queue : queues) {
+        std::lock_guard<std::mutex> guard(queue->mutex);
+        queue->changed.notify_all();
+    }
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!HostWait(lock, queue->changed, ticks, [queue] { return queue->items.size() < queue->capacity; })) {
+        return pdFALSE;
+    }
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+#define xQueueSendToBack xQueueSend
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    if (!HostWait(lock, queue->changed, ticks, [queue] { return !queue->items.empty() && !HostQueuesHeld(); })) {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    queue->changed.notify_all();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    std::lock_guard<std::mutex> guard(queue->mutex);
+    return queue->items.size();
+}
+
+#endif
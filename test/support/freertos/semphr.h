@@ -0,0 +1,49 @@
+#ifndef HOST_SEMPHR_H
+#define HOST_SEMPHR_H
+
+/**
+ * Семафоры FreeRTOS: мьютекс - двоичный семафор, созданный свободным
+ * (наследование приоритета не моделируется)
+ */
+#include "task.h"
+
+struct HostSemaphore {
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t count;
+};
+
+typedef HostSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateBinary() {
+    HostSemaphore *semaphore = new HostSemaphore();
+    semaphore->count = 0;
+    return semaphore;
+}
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex() {
+    HostSemaphore *semaphore = xSemaphoreCreateBinary();
+    semaphore->count = 1;
+    return semaphore;
+}
+
+inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks) {
+    std::unique_lock<std::mutex> lock(semaphore->mutex);
+    if (!HostWait(lock, semaphore->changed, ticks, [semaphore] { return semaphore->count > 0; })) {
+        return pdFALSE;
+    }
+    semaphore->count--;
+    return pdTRUE;
+}
+
+inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    std::lock_guard<std::mutex> guard(semaphore->mutex);
+    if (semaphore->count > 0) {
+        return pdFALSE;
+    }
+    semaphore->count++;
+    semaphore->changed.notify_all();
+    return pdTRUE;
+}
+
+#endif
@@ -0,0 +1,156 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+/**
+ * Задачи FreeRTOS поверх потоков
+ * Задача - отсоединенный поток; возврат из функции задачи (после vTaskDelete(NULL)) завершает поток.
+ * Поток, не созданный через xTaskCreatePinnedToCore (тест, основной цикл), работает на ядре 1,
+ * как loopTask в Arduino. Приоритеты не учитываются
+ */
+#include "FreeRTOS.h"
+#include <chrono>
+#include <condition_variable>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef void (*TaskFunction_t)(void *);
+
+/**
+ * Задача: имя, ядро и счетчик уведомлений
+ */
+struct HostTask {
+    std::string name;
+    uint32_t stackDepth;
+    BaseType_t core;
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint32_t notifications = 0;
+};
+
+typedef HostTask *TaskHandle_t;
+
+/**
+ * Все созданные задачи (для xTaskGetHandle)
+ */
+inline std::vector<HostTask *> &HostTasks() {
+    static std::vector<HostTask *> tasks;
+    return tasks;
+}
+
+inline std::mutex &HostTasksLock() {
+    static std::mutex lock;
+    return lock;
+}
+
+// Задача текущего потока (NULL - поток не создан через xTaskCreatePinnedToCore)
+inline thread_local HostTask *hostCurrentTask = NULL;
+
+/**
+ * Ожидание условия с таймаутом в тиках FreeRTOS (portMAX_DELAY - без ограничения)
+ * @return true, если условие выполнено
+ */
+template <typename Predicate>
+inline bool HostWait(std::unique_lock<std::mutex> &lock, std::condition_variable &changed, TickType_t ticks,
+                     Predicate ready) {
+    if (ticks == portMAX_DELAY) {
+        changed.wait(lock, ready);
+        return true;
+    }
+    return changed.wait_for(lock, std::chrono::milliseconds(ticks), ready);
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackDepth,
+                                          void *parameter, UBaseType_t priority, TaskHandle_t *handle,
+                                          BaseType_t core) {
+    HostTask *task = new HostTask();
+    task->name = name;
+    task->stackDepth = stackDepth;
+    task->core = core;
+    {
+        std::lock_guard<std::mutex> guard(HostTasksLock());
+        HostTasks().push_back(task);
+    }
+    if (handle != NULL) {
+        *handle = task;
+    }
+    std::thread([task, function, parameter] {
+        hostCurrentTask = task;
+        function(parameter);
+    }).detach();
+    return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stackDepth, void *parameter,
+                              UBaseType_t priority, TaskHandle_t *handle) {
+    return xTaskCreatePinnedToCore(function, name, stackDepth, parameter, priority, handle, 0);
+}
+
+/**
+ * Удаление текущей задачи: поток завершается возвратом из функции задачи
+ */
+inline void vTaskDelete(TaskHandle_t task) {}
+
+inline BaseType_t xPortGetCoreID() {
+    return hostCurrentTask != NULL ? hostCurrentTask->core : 1;
+}
+
+inline TickType_t xTaskGetTickCount() {
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return (TickType_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count();
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline void vTaskDelayUntil(TickType_t *previousWake, TickType_t increment) {
+    *previousWake += increment;
+    int32_t remaining = (int32_t)(*previousWake - xTaskGetTickCount());
+    if (remaining > 0) {
+        vTaskDelay(remaining);
+    }
+}
+
+inline TaskHandle_t xTaskGetHandle(const char *name) {
+    std::lock_guard<std::mutex> guard(HostTasksLock());
+    for (HostTask *task : HostTasks()) {
+        if (task->name == name) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Глубина стека потока не измеряется: запас - весь стек задачи
+ */
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+    return task != NULL ? task->stackDepth : 0;
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+    {
+        std::lock_guard<std::mutex> guard(task->mutex);
+        task->notifications++;
+    }
+    task->changed.notify_all();
+    return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks) {
+    HostTask *task = hostCurrentTask;
+    if (task == NULL) {
+        return 0;
+    }
+    std::unique_lock<std::mutex> lock(task->mutex);
+    HostWait(lock, task->changed, ticks, [task] { return task->notifications > 0; });
+    uint32_t value = task->notifications;
+    if (value > 0) {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+#endif
@@ -0,0 +1,125 @@
+#ifndef HOST_SENSOR_CHIPS_H
+#define HOST_SENSOR_CHIPS_H
+
+/**
+ * Модели датчиков на шине I2C (Wire.h) для тестов прошивки целиком
+ * BME280: регистры и калибровка из примера документации производителя (BST-BME280-DS002),
+ * измерение в принудительном режиме заканчивается сразу. BH1750: команды режима и чтение отсчета
+ */
+#include <Wire.h>
+
+class HostBme280 : public HostI2cDevice {
+public:
+    // Коды АЦП по умолчанию: 25.08 °C, 1006.5 гПа, 56.2 %
+    std::atomic<int32_t> adcTemperature{519888};
+    std::atomic<int32_t> adcPressure{415148};
+    std::atomic<int32_t> adcHumidity{30000};
+
+    HostBme280() {
+        memset(registers, 0, sizeof(registers));
+        registers[0xD0] = 0x60;  // Идентификатор микросхемы
+        const uint16_t tp[12] = {27504, 26435, (uint16_t)-1000, 36477, (uint16_t)-10685, 3024, 2855, 140,
+                                 (uint16_t)-7, 15500, (uint16_t)-14600, 6000};
+        for (int i = 0; i < 12; i++) {
+            registers[0x88 + i * 2] = tp[i] & 0xFF;
+            registers[0x89 + i * 2] = tp[i] >> 8;
+        }
+        // dig_H1 = 75, dig_H2 = 370, dig_H3 = 0, dig_H4 = 313, dig_H5 = 50, dig_H6 = 30
+        registers[0xA1] = 75;
+        registers[0xE1] = 370 & 0xFF;
+        registers[0xE2] = 370 >> 8;
+        registers[0xE3] = 0;
+        registers[0xE4] = 313 >> 4;
+        registers[0xE5] = (313 & 0x0F) | ((50 & 0x0F) << 4);
+        registers[0xE6] = 50 >> 4;
+        registers[0xE7] = 30;
+        // Данные до первого измерения: величины не измерены
+        registers[0xF7] = 0x80;
+        registers[0xFA] = 0x80;
+        registers[0xFD] = 0x80;
+    }
+
+    void write(const uint8_t *data, size_t length) override {
+        std::lock_guard<std::mutex> guard(lock);
+        pointer = data[0];
+        for (size_t i = 1; i < length; i++) {
+            registers[pointer] = data[i];
+            if (pointer == 0xF4 && (data[i] & 0x03) != 0) {
+                Measure();
+            }
+            pointer++;
+        }
+    }
+
+    size_t read(uint8_t *data, size_t length) override {
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < length; i++) {
+            data[i] = registers[pointer++];
+        }
+        return length;
+    }
+
+    /**
+     * Количество измерений с начала программы
+     */
+    uint32_t HostMeasurements() {
+        std::lock_guard<std::mutex> guard(lock);
+        return measurements;
+    }
+
+private:
+    std::mutex lock;
+    uint8_t registers[256];
+    uint8_t pointer = 0;
+    uint32_t measurements = 0;
+
+    /**
+     * Результат измерения в регистрах данных; величина с передискретизацией 0 не измеряется
+     */
+    void Measure() {
+        uint8_t ctrl = registers[0xF4];
+        uint32_t pressure = (ctrl >> 2) & 0x07 ? adcPressure.load() : 0x80000;
+        uint32_t temperature = ctrl >> 5 ? adcTemperature.load() : 0x80000;
+        uint32_t humidity = registers[0xF2] & 0x07 ? adcHumidity.load() : 0x8000;
+        registers[0xF7] = pressure >> 12;
+        registers[0xF8] = pressure >> 4;
+        registers[0xF9] = (pressure & 0x0F) << 4;
+        registers[0xFA] = temperature >> 12;
+        registers[0xFB] = temperature >> 4;
+        registers[0xFC] = (temperature & 0x0F) << 4;
+        registers[0xFD] = humidity >> 8;
+        registers[0xFE] = humidity & 0xFF;
+        registers[0xF4] &= ~0x03;  // Датчик возвращается в спящий режим
+        measurements++;
+    }
+};
+
+class HostBh1750 : public HostI2cDevice {
+public:
+    std::atomic<float> lux{12000};
+
+    void write(const uint8_t *data, size_t length) override {
+        mode.store(data[0]);
+    }
+
+    size_t read(uint8_t *data, size_t length) override {
+        if (length < 2) {
+            return 0;
+        }
+        float counts = lux.load() * 1.2f;
+        uint16_t raw = counts > 65535 ? 65535 : (uint16_t)counts;
+        data[0] = raw >> 8;
+        data[1] = raw & 0xFF;
+        return 2;
+    }
+
+    /**
+     * Последняя команда режима
+     */
+    uint8_t HostMode() const { return mode.load(); }
+
+private:
+    std::atomic<uint8_t> mode{0};
+};
+
+#endif
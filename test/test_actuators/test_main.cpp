@@ -0,0 +1,171 @@
+/**
+ * Очередь команд устройств: серия команд применяется одной публикацией
+ * и дает то же состояние, что и команды по одной в порядке поступления;
+ * пакет с истекшим ожиданием отменяется и не применяется позже
+ */
+#include <unity.h>
+#include <unistd.h>
+#include "actuators.h"
+#include "led.h"
+
+static const int lightPin = 18;
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * Ожидание публикации новой версии состояния задачей устройств
+ */
+static bool WaitVersion(uint32_t version, ActuatorState &state) {
+    for (int i = 0; i < 500; i++) {
+        ActuatorsGetState(state);
+        if (state.version >= version) {
+            return true;
+        }
+        delay(2);
+    }
+    return false;
+}
+
+/**
+ * Постановка серии команд, которую задача устройств заберет за одно пробуждение
+ * @return Состояние после применения серии
+ */
+static ActuatorState ApplySeries(const ActuatorId ids[], const int32_t values[], int count) {
+    ActuatorState state;
+    ActuatorsGetState(state);
+    uint32_t version = state.version;
+    HostQueuesHold(true);
+    for (int i = 0; i < count; i++) {
+        TEST_ASSERT_TRUE(ActuatorSet(ids[i], values[i]));
+    }
+    HostQueuesHold(false);
+    TEST_ASSERT_TRUE(WaitVersion(version + 1, state));
+    TEST_ASSERT_EQUAL_UINT32(version + 1, state.version);  // Одна публикация на серию
+    return state;
+}
+
+static uint8_t LedTargetBrightness() {
+    LedState led;
+    LedGetTarget(led);
+    return led.brightness;
+}
+
+static void test_light_off_then_brightness_keeps_brightness() {
+    const ActuatorId on[] = {ACTUATOR_LIGHT};
+    const int32_t onValues[] = {1};
+    ApplySeries(on, onValues, 1);
+
+    const ActuatorId ids[] = {ACTUATOR_LIGHT, ACTUATOR_BRIGHTNESS};
+    const int32_t values[] = {0, 40};
+    ActuatorState state = ApplySeries(ids, values, 2);
+    TEST_ASSERT_FALSE(state.light);
+    TEST_ASSERT_EQUAL_UINT8(40, state.brightness);
+    TEST_ASSERT_EQUAL_UINT8(LOW, HostPinLevel(lightPin));
+    TEST_ASSERT_EQUAL_UINT8(map(40, 0, 100, 0, 255), LedTargetBrightness());
+}
+
+static void test_brightness_then_light_on_gives_full_brightness() {
+    const ActuatorId off[] = {ACTUATOR_LIGHT};
+    const int32_t offValues[] = {0};
+    ApplySeries(off, offValues, 1);
+
+    const ActuatorId ids[] = {ACTUATOR_BRIGHTNESS, ACTUATOR_LIGHT};
+    const int32_t values[] = {40, 1};
+    ActuatorState state = ApplySeries(ids, values, 2);
+    TEST_ASSERT_TRUE(state.light);
+    TEST_ASSERT_EQUAL_UINT8(100, state.brightness);
+    TEST_ASSERT_EQUAL_UINT8(HIGH, HostPinLevel(lightPin));
+    TEST_ASSERT_EQUAL_UINT8(255, LedTargetBrightness());
+}
+
+static void test_replaced_command_moves_to_its_new_place() {
+    ActuatorStats before;
+    ActuatorsGetStats(before);
+
+    // Последнее включение - после яркости: полная яркость
+    const ActuatorId first[] = {ACTUATOR_LIGHT, ACTUATOR_BRIGHTNESS, ACTUATOR_LIGHT};
+    const int32_t firstValues[] = {1, 40, 1};
+    TEST_ASSERT_EQUAL_UINT8(100, ApplySeries(first, firstValues, 3).brightness);
+
+    // Последняя яркость - после включения: она и остается
+    const ActuatorId second[] = {ACTUATOR_BRIGHTNESS, ACTUATOR_LIGHT, ACTUATOR_BRIGHTNESS};
+    const int32_t secondValues[] = {40, 1, 60};
+    ActuatorState state = ApplySeries(second, secondValues, 3);
+    TEST_ASSERT_TRUE(state.light);
+    TEST_ASSERT_EQUAL_UINT8(60, state.brightness);
+    TEST_ASSERT_EQUAL_UINT8(map(60, 0, 100, 0, 255), LedTargetBrightness());
+
+    ActuatorStats after;
+    ActuatorsGetStats(after);
+    TEST_ASSERT_EQUAL_UINT32(before.coalesced + 2, after.coalesced);
+}
+
+static void test_batch_applies_with_one_version() {
+    ActuatorState before;
+    ActuatorsGetState(before);
+    ActuatorBatch batch = {};
+    batch.set[ACTUATOR_PUMP] = true;
+    batch.value[ACTUATOR_PUMP] = 1;
+    batch.set[ACTUATOR_WINDOW] = true;
+    batch.value[ACTUATOR_WINDOW] = 45;
+    ActuatorState result;
+    TEST_ASSERT_EQUAL_INT(ACTUATOR_BATCH_APPLIED, ActuatorApplyBatch(batch, before.version, result));
+    TEST_ASSERT_EQUAL_UINT32(before.version + 1, result.version);
+    TEST_ASSERT_TRUE(result.pump);
+    TEST_ASSERT_EQUAL_UINT8(45, result.windowTarget);
+    TEST_ASSERT_EQUAL_UINT8(HIGH, HostPinLevel(17));
+
+    // Устаревшая версия: ничего не меняется
+    batch.value[ACTUATOR_PUMP] = 0;
+    TEST_ASSERT_EQUAL_INT(ACTUATOR_BATCH_CONFLICT, ActuatorApplyBatch(batch, before.version, result));
+    TEST_ASSERT_TRUE(result.pump);
+}
+
+static void test_timed_out_batch_is_never_applied() {
+    ActuatorState before;
+    ActuatorsGetState(before);
+    ActuatorBatch batch = {};
+    batch.set[ACTUATOR_WIND] = true;
+    batch.value[ACTUATOR_WIND] = !before.wind;
+
+    // Задача устройств не забирает команды: ожидание истекает, пакет остается в очереди
+    HostQueuesHold(true);
+    ActuatorState result;
+    uint32_t started = millis();
+    ActuatorBatchResult outcome = ActuatorApplyBatch(batch, -1, result);
+    uint32_t waited = millis() - started;
+    HostQueuesHold(false);
+    TEST_ASSERT_EQUAL_INT(ACTUATOR_BATCH_BUSY, outcome);
+    TEST_ASSERT_TRUE(waited >= ACTUATOR_BATCH_TIMEOUT_MS && waited < ACTUATOR_BATCH_TIMEOUT_MS + 100);
+
+    // Задача получает отмененный пакет после ответа и пропускает его
+    const ActuatorId ids[] = {ACTUATOR_BRIGHTNESS};
+    const int32_t values[] = {before.brightness};
+    ActuatorState after = ApplySeries(ids, values, 1);
+    TEST_ASSERT_EQUAL(before.wind, after.wind);
+    TEST_ASSERT_EQUAL_UINT8(before.wind ? HIGH : LOW, HostPinLevel(16));
+
+    // Следующий пакет применяется как обычно
+    TEST_ASSERT_EQUAL_INT(ACTUATOR_BATCH_APPLIED, ActuatorApplyBatch(batch, -1, result));
+    TEST_ASSERT_EQUAL(!before.wind, result.wind);
+}
+
+int main(int argc, char **argv) {
+    Serial.HostMute(true);
+    LedBegin(CRGB(255, 255, 255), 0);
+    ActuatorState initial = {};
+    ActuatorsBegin(initial);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_light_off_then_brightness_keeps_brightness);
+    RUN_TEST(test_brightness_then_light_on_gives_full_brightness);
+    RUN_TEST(test_replaced_command_moves_to_its_new_place);
+    RUN_TEST(test_batch_applies_with_one_version);
+    RUN_TEST(test_timed_out_batch_is_never_applied);
+    // Задачи устройств и ленты работают до конца программы: выход без деструкторов статических объектов
+    int failures = UNITY_END();
+    fflush(stdout);
+    _exit(failures);
+}
@@ -0,0 +1,271 @@
+/**
+ * Регулятор климата: реле с минимальными временами, выключение без показаний,
+ * ограничение работы насоса, блокировка насоса при пустом баке и прогон суточного хода показаний
+ */
+#include <unity.h>
+#include <math.h>
+#include "bench.h"
+#include "climate.h"
+
+#define T0 100000
+
+static ClimateSettings settings;
+static ClimateState state;
+
+void setUp() {
+    settings = ClimateDefaultSettings();
+    ClimateInit(state, false, false, 0, T0);
+}
+
+void tearDown() {}
+
+static ClimateCommand Tick(float temperature, float humidity, uint32_t nowMs, bool valid = true) {
+    return ClimateTick(state, settings, temperature, humidity, valid, nowMs);
+}
+
+static void test_relays_respect_minimum_times() {
+    uint32_t now = T0 + settings.minOffMs;
+    ClimateCommand command = Tick(35.0f, 50.0f, now);
+    TEST_ASSERT_TRUE(command.changed[CLIMATE_FAN]);
+    TEST_ASSERT_TRUE(command.fan);
+
+    // Температура упала, но минимальное время включенного состояния не прошло
+    command = Tick(20.0f, 50.0f, now + settings.minOnMs - 1);
+    TEST_ASSERT_FALSE(command.changed[CLIMATE_FAN]);
+    TEST_ASSERT_TRUE(command.fan);
+    command = Tick(20.0f, 50.0f, now + settings.minOnMs);
+    TEST_ASSERT_TRUE(command.changed[CLIMATE_FAN]);
+    TEST_ASSERT_FALSE(command.fan);
+}
+
+static void test_invalid_readings_turn_relays_off() {
+    uint32_t now = T0 + settings.minOffMs;
+    ClimateCommand command = Tick(35.0f, 30.0f, now);
+    TEST_ASSERT_TRUE(command.fan);
+    TEST_ASSERT_TRUE(command.pump);
+    TEST_ASSERT_EQUAL_UINT8(CLIMATE_WINDOW_OPEN_ANGLE, command.windowAngle);
+
+    // Датчик пропал: реле выключаются после минимального времени, форточка остается
+    now += settings.minOnMs;
+    command = Tick(NAN, NAN, now, false);
+    TEST_ASSERT_TRUE(command.changed[CLIMATE_FAN]);
+    TEST_ASSERT_TRUE(command.changed[CLIMATE_PUMP]);
+    TEST_ASSERT_FALSE(command.fan);
+    TEST_ASSERT_FALSE(command.pump);
+    TEST_ASSERT_FALSE(command.changed[CLIMATE_WINDOW]);
+    TEST_ASSERT_EQUAL_UINT8(CLIMATE_WINDOW_OPEN_ANGLE, command.windowAngle);
+
+    // Показание NaN при valid тоже считается недостоверным
+    command = Tick(NAN, 30.0f, now + settings.minOffMs * 2);
+    TEST_ASSERT_FALSE(command.pump);
+}
+
+static void test_invalid_readings_keep_manual_relays() {
+    ClimateManualOverride(state, settings, CLIMATE_PUMP, 1, T0);
+    ClimateCommand command = Tick(NAN, NAN, T0 + settings.minOnMs, false);
+    TEST_ASSERT_FALSE(command.changed[CLIMATE_PUMP]);
+    TEST_ASSERT_TRUE(command.pump);
+}
+
+static void test_pump_is_cut_off_after_max_on_time() {
+    uint32_t now = T0 + settings.minOffMs;
+    TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, now).pump);
+    uint32_t started = now;
+
+    // Влажность не растет (пустой бак): насос выключается через maxPumpOnMs
+    for (now = started; now - started < settings.maxPumpOnMs; now += CLIMATE_TICK_MS) {
+        TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, now).pump);
+    }
+    ClimateCommand command = Tick(22.0f, 30.0f, now);
+    TEST_ASSERT_TRUE(command.changed[CLIMATE_PUMP]);
+    TEST_ASSERT_FALSE(command.pump);
+
+    // Повторно - не раньше минимального времени выключенного состояния
+    uint32_t stopped = now;
+    TEST_ASSERT_FALSE(Tick(22.0f, 30.0f, stopped + settings.minOffMs - 1).pump);
+    TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, stopped + settings.minOffMs).pump);
+}
+
+static void test_pump_without_limit_keeps_running() {
+    settings.maxPumpOnMs = 0;
+    uint32_t now = T0 + settings.minOffMs;
+    TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, now).pump);
+    TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, now + 24UL * 3600 * 1000).pump);
+}
+/**
+ * Работа насоса до выключения по maxPumpOnMs и пауза minOffMs
+ * @param humidity Влажность в начале работы
+ * @param rise Рост влажности за работу
+ * @return true, если насос включался
+ */
+static bool PumpCycle(uint32_t &now, float humidity, float rise) {
+    now += settings.minOffMs;
+    if (!Tick(22.0f, humidity, now).pump) {
+        return false;
+    }
+    uint32_t started = now;
+    for (; now - started <= settings.maxPumpOnMs; now += CLIMATE_TICK_MS) {
+        Tick(22.0f, humidity + rise * (now - started) / settings.maxPumpOnMs, now);
+    }
+    TEST_ASSERT_FALSE(state.pump.on);
+    return true;
+}
+
+static void test_dry_cutoffs_latch_pump_fault() {
+    uint32_t now = T0;
+    for (int i = 0; i < CLIMATE_PUMP_FAULT_CUTOFFS; i++) {
+        TEST_ASSERT_FALSE(state.pumpFault);
+        TEST_ASSERT_TRUE(PumpCycle(now, 30.0f, 0.2f));
+    }
+    TEST_ASSERT_TRUE(state.pumpFault);
+
+    // Блокировка не снимается сама: насос не включается и через сутки
+    for (int i = 0; i < 24; i++) {
+        now += 3600UL * 1000;
+        TEST_ASSERT_FALSE(Tick(22.0f, 30.0f, now).pump);
+    }
+
+    // Сброс пользователем возвращает насос регулятору
+    ClimateResetPumpFault(state);
+    TEST_ASSERT_TRUE(Tick(22.0f, 30.0f, now + CLIMATE_TICK_MS).pump);
+}
+
+static void test_cutoffs_with_rising_humidity_are_not_dry() {
+    // Влажность растет, но медленно: насос выключается по времени, блокировки нет
+    uint32_t now = T0;
+    for (int i = 0; i < CLIMATE_PUMP_FAULT_CUTOFFS * 2; i++) {
+        TEST_ASSERT_TRUE(PumpCycle(now, 20.0f + i, 2.0f));
+    }
+    TEST_ASSERT_FALSE(state.pumpFault);
+
+    // Сухие выключения считаются только подряд
+    for (int i = 0; i < CLIMATE_PUMP_FAULT_CUTOFFS - 1; i++) {
+        PumpCycle(now, 30.0f, 0.0f);
+    }
+    PumpCycle(now, 30.0f, 2.0f);
+    for (int i = 0; i < CLIMATE_PUMP_FAULT_CUTOFFS - 1; i++) {
+        PumpCycle(now, 30.0f, 0.0f);
+    }
+    TEST_ASSERT_FALSE(state.pumpFault);
+}
+
+static void test_user_pump_command_clears_fault() {
+    uint32_t now = T0;
+    for (int i = 0; i < CLIMATE_PUMP_FAULT_CUTOFFS; i++) {
+        PumpCycle(now, 30.0f, 0.0f);
+    }
+    TEST_ASSERT_TRUE(state.pumpFault);
+    ClimateManualOverride(state, settings, CLIMATE_PUMP, 1, now);
+    TEST_ASSERT_FALSE(state.pumpFault);
+}
+
+/**
+ * Суточный ход показаний теплицы с шумом датчика и пропаданиями связи
+ * Влажность падает днем и растет от работы насоса; на третьи сутки бак пуст и насос ее не поднимает,
+ * в начале четвертых суток пользователь наполняет бак и сбрасывает блокировку насоса
+ */
+struct GreenhouseTrace {
+    float humidity;
+    uint32_t seed;
+};
+
+static float Noise(GreenhouseTrace &trace) {
+    trace.seed = trace.seed * 1103515245 + 12345;
+    return ((trace.seed >> 16) & 0x7FFF) / 32767.0f - 0.5f;
+}
+
+static void test_bench_week_trace() {
+    const uint32_t days = 7;
+    const uint32_t ticks = days * 24 * 3600 * (1000 / CLIMATE_TICK_MS);
+    GreenhouseTrace trace = {60.0f, 1};
+    uint32_t switches[CLIMATE_ACTUATOR_COUNT] = {};
+    uint32_t pumpOnSince = 0;
+    uint32_t longestPumpRun = 0;
+    uint32_t cutoffs = 0;
+    uint32_t dryDayCutoffs = 0;
+    uint32_t faultDays = 0;
+    uint32_t invalidTicks = 0;
+    uint32_t shortestRelayPeriod = UINT32_MAX;
+    uint32_t fanChangedAt = T0;
+    bool pumpOn = false;
+
+    BenchSamples samples;
+    BenchBegin(samples, ticks);
+    uint64_t started = BenchNowNs();
+    for (uint32_t i = 0; i < ticks; i++) {
+        uint32_t now = T0 + i * CLIMATE_TICK_MS;
+        float hour = fmodf(i * (CLIMATE_TICK_MS / 1000.0f) / 3600.0f, 24.0f);
+        float temperature = 22.0f + 9.0f * sinf((hour - 8.0f) * (float)M_PI / 12.0f) + Noise(trace);
+        // Насос поднимает влажность, днем она падает сильнее
+        uint32_t day = i / (24 * 3600);
+        bool tankEmpty = day == 2;
+        if (i % (24 * 3600) == 0) {
+            faultDays += state.pumpFault ? 1 : 0;
+            ClimateResetPumpFault(state);
+        }
+        trace.humidity += (pumpOn && !tankEmpty ? 0.006f : 0.0f) - 0.002f - (temperature > 25.0f ? 0.002f : 0.0f);
+        trace.humidity = trace.humidity < 20.0f ? 20.0f : (trace.humidity > 95.0f ? 95.0f : trace.humidity);
+        // Раз в сутки датчик пропадает на 10 минут
+        bool valid = (i % (24 * 3600)) >= 600;
+        invalidTicks += valid ? 0 : 1;
+
+        uint64_t tickStarted = BenchNowNs();
+        ClimateCommand command = ClimateTick(state, settings, temperature, trace.humidity + Noise(trace), valid, now);
+        BenchRecord(samples, BenchNowNs() - tickStarted);
+
+        for (int a = 0; a < CLIMATE_ACTUATOR_COUNT; a++) {
+            switches[a] += command.changed[a] ? 1 : 0;
+        }
+        if (command.changed[CLIMATE_FAN]) {
+            shortestRelayPeriod = std::min(shortestRelayPeriod, now - fanChangedAt);
+            fanChangedAt = now;
+        }
+        if (!command.pump && pumpOn && now - pumpOnSince >= settings.maxPumpOnMs) {
+            cutoffs++;
+            dryDayCutoffs += tankEmpty ? 1 : 0;
+        }
+        if (command.pump && !pumpOn) {
+            pumpOnSince = now;
+        }
+        if (command.pump) {
+            longestPumpRun = std::max(longestPumpRun, now - pumpOnSince);
+        }
+        pumpOn = command.pump;
+        if (!valid) {
+            TEST_ASSERT_FALSE(command.changed[CLIMATE_WINDOW]);
+        }
+    }
+    uint64_t elapsed = BenchNowNs() - started;
+    faultDays += state.pumpFault ? 1 : 0;
+
+    BenchReport("climate tick", samples);
+    BenchReportRate("climate week trace (ticks)", ticks, elapsed);
+    printf("BENCH climate week switches: fan %u, pump %u, window %u; longest pump run %u s, %u cutoffs; "
+           "shortest fan period %u s; %u ticks without readings\n",
+           switches[CLIMATE_FAN], switches[CLIMATE_PUMP], switches[CLIMATE_WINDOW], longestPumpRun / 1000,
+           cutoffs, shortestRelayPeriod / 1000, invalidTicks);
+    printf("BENCH climate week empty tank: %u cutoffs before the pump fault latched; fault on %u of %u days\n",
+           dryDayCutoffs, faultDays, days);
+
+    TEST_ASSERT_TRUE(switches[CLIMATE_PUMP] > 0);
+    TEST_ASSERT_TRUE(cutoffs > 0);
+    // Пустой бак блокирует насос после CLIMATE_PUMP_FAULT_CUTOFFS выключений, в другие дни блокировки нет
+    TEST_ASSERT_EQUAL_UINT32(CLIMATE_PUMP_FAULT_CUTOFFS, dryDayCutoffs);
+    TEST_ASSERT_EQUAL_UINT32(1, faultDays);
+    TEST_ASSERT_TRUE(longestPumpRun <= settings.maxPumpOnMs);
+    TEST_ASSERT_TRUE(shortestRelayPeriod >= std::min(settings.minOnMs, settings.minOffMs));
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_relays_respect_minimum_times);
+    RUN_TEST(test_invalid_readings_turn_relays_off);
+    RUN_TEST(test_invalid_readings_keep_manual_relays);
+    RUN_TEST(test_pump_is_cut_off_after_max_on_time);
+    RUN_TEST(test_pump_without_limit_keeps_running);
+    RUN_TEST(test_dry_cutoffs_latch_pump_fault);
+    RUN_TEST(test_cutoffs_with_rising_humidity_are_not_dry);
+    RUN_TEST(test_user_pump_command_clears_fault);
+    RUN_TEST(test_bench_week_trace);
+    return UNITY_END();
+}
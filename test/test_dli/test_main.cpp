@@ -0,0 +1,146 @@
+/**
+ * Досветка по DLI: уступка ленты пользователю и прогон шести суток дневного хода освещенности
+ * Датчик видит естественный свет и свет ленты; свет ленты считается по той же модели
+ * гаммы, что и в dli.cpp (led_gamma.h)
+ */
+#include <unity.h>
+#include <math.h>
+#include "bench.h"
+#include "dli.h"
+#include "led_gamma.h"
+
+#define GAMMA 2.2f
+#define DAY0 20000
+
+static DliSettings settings;
+static DliState state;
+static uint8_t level;     // Яркость ленты, %
+static uint32_t nowMs;
+
+void setUp() {
+    settings = DliDefaultSettings();
+    settings.enabled = true;
+    settings.ledPpfd = 300.0f;
+    DliInit(state, GAMMA);
+    level = 0;
+    nowMs = 0;
+}
+
+void tearDown() {}
+
+static DliCommand Tick(float lux, int32_t secondOfDay, uint32_t day, bool held = false, bool valid = true) {
+    DliInputs inputs = {lux, valid, secondOfDay, day, level, held, nowMs};
+    nowMs += 1000;
+    DliCommand command = DliTick(state, settings, inputs);
+    if (command.changed) {
+        level = command.brightness;
+    }
+    return command;
+}
+
+static void test_yields_to_held_light_and_turns_off_once() {
+    for (int i = 0; i < 600; i++) {
+        Tick(100, 8 * 3600 + i, DAY0);
+    }
+    TEST_ASSERT_TRUE(state.driving);
+    TEST_ASSERT_TRUE(level > 0);
+
+    // Лентой управляет пользователь: регулятор не трогает ее и потом продолжает с ее яркости
+    level = 80;
+    for (int i = 0; i < 5; i++) {
+        TEST_ASSERT_FALSE(Tick(100, 9 * 3600 + i, DAY0, true).changed);
+    }
+    TEST_ASSERT_FALSE(state.driving);
+    Tick(100, 9 * 3600 + 10, DAY0);
+    TEST_ASSERT_TRUE(abs((int)level - 80) <= 1);
+
+    // Выключение регулятора гасит включенную им ленту один раз
+    settings.enabled = false;
+    DliCommand command = Tick(100, 9 * 3600 + 11, DAY0);
+    TEST_ASSERT_TRUE(command.changed);
+    TEST_ASSERT_EQUAL_UINT8(0, level);
+    TEST_ASSERT_FALSE(Tick(100, 9 * 3600 + 12, DAY0).changed);
+}
+
+/**
+ * Генератор облачности и пропусков показаний
+ */
+static uint32_t seed = 1;
+
+static float Uniform() {
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) & 0xFFFF) / 65535.0f;
+}
+
+static void test_bench_daylight_trace() {
+    // Пики естественной освещенности по суткам, лк: ясно, пасмурно, ясно, хмуро, переменно
+    const float peaks[] = {30000, 8000, 30000, 3000, 20000, 20000};
+    const int days = sizeof(peaks) / sizeof(peaks[0]);
+    const float photoperiodHours = (settings.endMinute - settings.startMinute) / 60.0f;
+    float totalLedHours = 0;
+    seed = 1;
+    BenchSamples samples;
+    BenchBegin(samples, days * 86400);
+
+    for (int day = 0; day < days; day++) {
+        double naturalDli = 0;
+        double ledHours = 0;   // Работа ленты в часах полной яркости
+        float cloud = 1;
+        uint32_t changes = 0;
+        int worstMinuteStep = 0;
+        uint8_t minuteLevel = level;
+        for (int32_t second = 0; second < 86400; second++) {
+            float natural = 0;
+            if (second > 6 * 3600 && second < 20 * 3600) {
+                natural = peaks[day] * sinf((float)M_PI * (second - 6 * 3600) / (14 * 3600.0f));
+            }
+            if (second % 600 == 0) {
+                cloud = 0.5f + 0.5f * Uniform();
+            }
+            natural *= cloud;
+            naturalDli += natural * settings.luxToPpfd / 1e6;
+            float ledFraction = LedGammaLevel(255, level * 255 / 100) / 255.0f;
+            float lux = natural + settings.ledPpfd * ledFraction / settings.luxToPpfd;
+            bool valid = Uniform() >= 0.002f;  // Датчик изредка не отвечает
+
+            uint64_t started = BenchNowNs();
+            DliCommand command = Tick(lux, second, DAY0 + day, false, valid);
+            BenchRecord(samples, BenchNowNs() - started);
+
+            changes += command.changed ? 1 : 0;
+            ledHours += ledFraction / 3600.0;
+            if (second % 60 == 59) {
+                worstMinuteStep = std::max(worstMinuteStep, abs((int)level - (int)minuteLevel));
+                minuteLevel = level;
+            }
+        }
+        // Первый такт следующих суток переносит накопление в yesterday
+        Tick(0, 0, DAY0 + day + 1);
+        totalLedHours += ledHours;
+        printf("BENCH dli day %d (peak %.0f lx): natural %.2f, total %.2f of %.1f mol/m2; LED %.2f full-brightness h, "
+               "%u level changes, worst step %d %%/min\n",
+               day, peaks[day], naturalDli, state.yesterday, settings.target, ledHours, changes, worstMinuteStep);
+
+        // Цель достигается каждые сутки, а лента не светит дольше светового дня
+        TEST_ASSERT_TRUE(state.yesterday >= settings.target * 0.99f);
+        TEST_ASSERT_TRUE(ledHours <= photoperiodHours);
+        // Плавность: не быстрее заданной скорости (плюс включение с минимальной яркости)
+        TEST_ASSERT_TRUE(worstMinuteStep <= settings.rampPerMinute + settings.minBrightness + 1);
+        // Когда профиль естественного света известен, ясный день не пересвечивается
+        if (day > 0 && naturalDli < settings.target) {
+            TEST_ASSERT_TRUE(state.yesterday <= settings.target + 2.0f);
+        }
+    }
+
+    BenchReport("dli tick", samples);
+    printf("BENCH dli %d days: LED %.1f full-brightness h vs %.1f h for a fixed %.0f h photoperiod\n", days,
+           totalLedHours, days * photoperiodHours, photoperiodHours);
+    TEST_ASSERT_TRUE(totalLedHours < days * photoperiodHours / 2);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_yields_to_held_light_and_turns_off_once);
+    RUN_TEST(test_bench_daylight_trace);
+    return UNITY_END();
+}
@@ -0,0 +1,194 @@
+/**
+ * Фильтр показаний: отбраковка, медиана, ограничение скорости и прогон зашумленных суток
+ * Настройки прогона - те же, что по умолчанию в sensors.cpp (filterConfigs)
+ */
+#include <unity.h>
+#include <math.h>
+#include <vector>
+#include "bench.h"
+#include "filter.h"
+
+static Filter filter;
+
+void setUp() {
+    filter = {};
+    FilterReset(filter);
+}
+
+void tearDown() {}
+
+static void test_rejects_invalid_and_keeps_output() {
+    FilterConfig config = {0, 100, 0, 1, 1};
+    TEST_ASSERT_TRUE(FilterUpdate(filter, config, 50, 0));
+    TEST_ASSERT_FALSE(FilterUpdate(filter, config, NAN, 1000));
+    TEST_ASSERT_FALSE(FilterUpdate(filter, config, 150, 2000));
+    TEST_ASSERT_EQUAL_FLOAT(50, filter.output);
+    TEST_ASSERT_EQUAL_UINT32(2, filter.rejected);
+}
+
+static void test_output_expires_after_reject_run() {
+    FilterConfig config = {0, 100, 0, 1, 1};
+    FilterUpdate(filter, config, 50, 0);
+    for (int i = 0; i < FILTER_MAX_REJECTS - 1; i++) {
+        FilterUpdate(filter, config, NAN, 1000 * (i + 1));
+    }
+    TEST_ASSERT_FALSE(isnan(filter.output));
+    FilterUpdate(filter, config, NAN, 1000 * FILTER_MAX_REJECTS);
+    TEST_ASSERT_TRUE(isnan(filter.output));
+}
+
+static void test_median_removes_single_spike() {
+    FilterConfig config = {0, 65535, 0, 5, 1};
+    const float readings[] = {100, 101, 99, 5000, 100, 102, 98};
+    for (size_t i = 0; i < sizeof(readings) / sizeof(readings[0]); i++) {
+        FilterUpdate(filter, config, readings[i], i * 1000);
+        TEST_ASSERT_TRUE(filter.output < 110);
+    }
+}
+
+static void test_rate_limit() {
+    FilterConfig config = {-40, 85, 2, 1, 1};
+    FilterUpdate(filter, config, 20, 0);
+    FilterUpdate(filter, config, 30, 1000);
+    TEST_ASSERT_EQUAL_FLOAT(22, filter.output);
+    FilterUpdate(filter, config, 30, 3000);
+    TEST_ASSERT_EQUAL_FLOAT(26, filter.output);
+}
+
+/**
+ * Генератор шума: равномерный и приближенно нормальный (сумма четырех равномерных)
+ */
+static uint32_t seed = 1;
+
+static float Uniform() {
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) & 0xFFFF) / 65535.0f;
+}
+
+static float Gaussian() {
+    return (Uniform() + Uniform() + Uniform() + Uniform() - 2.0f) * 1.732f;
+}
+
+/**
+ * Величина для прогона: истинный суточный ход, шум датчика, доля выбросов и пропусков
+ */
+struct ReplayMetric {
+    const char *name;
+    FilterConfig config;
+    float base;
+    float amplitude;
+    float noise;      // СКО шума
+    float spike;      // Размах выброса
+    float step;       // Ступенька для замера задержки
+};
+
+/**
+ * Время, за которое выход проходит 90% ступеньки, в показаниях (период 1 с)
+ */
+static uint32_t StepLatency(const ReplayMetric &metric) {
+    Filter stepFilter = {};
+    FilterReset(stepFilter);
+    for (uint32_t i = 0; i < 60; i++) {
+        FilterUpdate(stepFilter, metric.config, metric.base, i * 1000);
+    }
+    float target = metric.base + 0.9f * metric.step;
+    for (uint32_t i = 0; i < 600; i++) {
+        FilterUpdate(stepFilter, metric.config, metric.base + metric.step, (60 + i) * 1000);
+        if (stepFilter.output >= target) {
+            return i + 1;
+        }
+    }
+    return UINT32_MAX;
+}
+
+static void test_bench_replay_noisy_day() {
+    const ReplayMetric metrics[] = {
+        {"temperature", {-40, 85, 2, 3, 0.5f}, 22, 8, 0.15f, 30, 3},
+        {"humidity", {0, 100, 5, 3, 0.5f}, 60, 20, 1.5f, 60, 10},
+        {"pressure", {300, 1100, 1, 3, 0.3f}, 1005, 3, 0.2f, 400, 2},
+        {"lux", {0, 65535, 0, 5, 0.5f}, 15000, 15000, 400, 40000, 5000},
+    };
+    const uint32_t samples = 24 * 3600;
+
+    for (const ReplayMetric &metric : metrics) {
+        Filter replay = {};
+        FilterReset(replay);
+        seed = 7;
+        double rawError = 0;
+        double filteredError = 0;
+        std::vector<float> errors;  // Модули ошибок выхода
+        errors.reserve(samples);
+        uint32_t compared = 0;
+        uint32_t spikes = 0;
+        BenchSamples timing;
+        BenchBegin(timing, samples);
+        for (uint32_t i = 0; i < samples; i++) {
+            float truth = metric.base + metric.amplitude * sinf(i * 2.0f * (float)M_PI / samples);
+            float reading = truth + metric.noise * Gaussian();
+            float chance = Uniform();
+            if (chance < 0.005f) {
+                reading = NAN;              // Датчик не ответил
+            } else if (chance < 0.015f) {
+                reading += metric.spike;    // Помеха на шине, блик
+                spikes++;
+            }
+            uint64_t started = BenchNowNs();
+            FilterUpdate(replay, metric.config, reading, i * 1000);
+            BenchRecord(timing, BenchNowNs() - started);
+
+            if (!isnan(reading) && !isnan(replay.output) && i >= 60) {
+                float raw = reading - truth;
+                float filtered = replay.output - truth;
+                rawError += raw * raw;
+                filteredError += filtered * filtered;
+                errors.push_back(fabsf(filtered));
+                compared++;
+            }
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "filter %s update (median %u)", metric.name, metric.config.median);
+        BenchSummary summary = BenchReport(name, timing);
+        uint32_t latency = StepLatency(metric);
+        float rawRms = sqrtf(rawError / compared);
+        float filteredRms = sqrtf(filteredError / compared);
+        std::sort(errors.begin(), errors.end());
+        float p999 = errors[errors.size() * 999 / 1000];
+        printf("BENCH filter %s: rms error %.3f raw -> %.3f filtered, p99.9 %.3f, worst %.3f, %u spikes of %.0f, "
+               "%u rejected, 90%% step latency %u samples\n",
+               metric.name, rawRms, filteredRms, p999, errors.back(), spikes, metric.spike, replay.rejected, latency);
+
+        // Одиночные выбросы гасит медиана; проходят только серии выбросов длиннее половины окна
+        TEST_ASSERT_TRUE(filteredRms < rawRms / 2);
+        TEST_ASSERT_TRUE(p999 < metric.spike / 10);
+        TEST_ASSERT_TRUE(latency <= 10);
+        TEST_ASSERT_TRUE(summary.p50 < 10000);
+    }
+}
+
+static void test_bench_update_cost_by_window() {
+    for (uint8_t median = 1; median <= FILTER_MEDIAN_MAX; median += 2) {
+        FilterConfig config = {0, 65535, 0, median, 0.5f};
+        Filter timed = {};
+        FilterReset(timed);
+        seed = 3;
+        const uint32_t count = 1000000;
+        uint64_t started = BenchNowNs();
+        for (uint32_t i = 0; i < count; i++) {
+            FilterUpdate(timed, config, 1000 + 500 * Uniform(), i * 1000);
+        }
+        char name[48];
+        snprintf(name, sizeof(name), "filter updates (median %u)", median);
+        BenchReportRate(name, count, BenchNowNs() - started);
+    }
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rejects_invalid_and_keeps_output);
+    RUN_TEST(test_output_expires_after_reject_run);
+    RUN_TEST(test_median_removes_single_spike);
+    RUN_TEST(test_rate_limit);
+    RUN_TEST(test_bench_replay_noisy_day);
+    RUN_TEST(test_bench_update_cost_by_window);
+    return UNITY_END();
+}
@@ -0,0 +1,271 @@
+/**
+ * Прошивка целиком: setup() и loop() на заменах оборудования из test/support,
+ * запросы к маршрутам через HTTP-сервер на 127.0.0.1
+ * Замеры по маршрутам: запросы в секунду, p50/p99 времени ответа клиенту,
+ * выделения памяти и пик кучи задачи сервера на запрос
+ */
+#define BENCH_COUNT_ALLOCATIONS
+#include <unity.h>
+#include <ESPAsyncWebServer.h>
+#include <Wire.h>
+#include <string>
+#include <thread>
+#include "bench.h"
+#include "sensor_chips.h"
+#include "page_gz.h"
+
+#define BENCH_REQUESTS 300
+
+extern AsyncWebServer server;
+void setup();
+void loop();
+
+static HostBme280 bme;
+static HostBh1750 lightChip;
+
+/**
+ * Ответ сервера (тело Transfer-Encoding: chunked уже собрано)
+ */
+struct Reply {
+    int code;
+    std::string headers;
+    std::string body;
+};
+
+static std::string DecodeChunked(const std::string &data) {
+    std::string body;
+    size_t position = 0;
+    for (;;) {
+        size_t lineEnd = data.find("\r\n", position);
+        if (lineEnd == std::string::npos) {
+            return body;
+        }
+        size_t size = strtoul(data.substr(position, lineEnd - position).c_str(), NULL, 16);
+        if (size == 0) {
+            return body;
+        }
+        body += data.substr(lineEnd + 2, size);
+        position = lineEnd + 2 + size + 2;
+    }
+}
+
+/**
+ * Запрос к серверу: соединение на каждый запрос, ответ читается до закрытия соединения
+ * @param headers Дополнительные строки заголовка, каждая с \r\n
+ */
+static Reply Request(const char *method, const char *target, const char *headers = "", const std::string &body = "") {
+    Reply reply = {0, "", ""};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(server.HostPort());
+    if (connect(fd, (sockaddr *)&address, sizeof(address)) != 0) {
+        close(fd);
+        return reply;
+    }
+    char head[512];
+    int length = snprintf(head, sizeof(head), "%s %s HTTP/1.1\r\nHost: 192.168.4.1\r\n%sContent-Length: %zu\r\n\r\n",
+                          method, target, headers, body.size());
+    std::string message = std::string(head, length) + body;
+    send(fd, message.data(), message.size(), MSG_NOSIGNAL);
+
+    std::string raw;
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        raw.append(buffer, received);
+    }
+    close(fd);
+
+    size_t headerEnd = raw.find("\r\n\r\n");
+    if (raw.compare(0, 9, "HTTP/1.1 ") != 0 || headerEnd == std::string::npos) {
+        return reply;
+    }
+    reply.code = atoi(raw.c_str() + 9);
+    reply.headers = raw.substr(0, headerEnd + 2);
+    reply.body = raw.substr(headerEnd + 4);
+    if (reply.headers.find("Transfer-Encoding: chunked\r\n") != std::string::npos) {
+        reply.body = DecodeChunked(reply.body);
+    }
+    return reply;
+}
+
+static Reply Get(const char *target, const char *headers = "") {
+    return Request("GET", target, headers);
+}
+
+static Reply PostForm(const char *target, const char *form) {
+    return Request("POST", target, "Content-Type: application/x-www-form-urlencoded\r\n", form);
+}
+
+/**
+ * Число после "key": в ответе JSON (NAN - поля нет или оно null)
+ */
+static float JsonNumber(const std::string &body, const char *key) {
+    std::string field = std::string("\"") + key + "\":";
+    size_t position = body.find(field);
+    if (position == std::string::npos) {
+        return NAN;
+    }
+    const char *start = body.c_str() + position + field.size();
+    char *end;
+    float value = strtof(start, &end);
+    return end != start ? value : NAN;
+}
+
+static bool Contains(const std::string &text, const char *part) {
+    return text.find(part) != std::string::npos;
+}
+
+/**
+ * Ожидание условия, которое выполняют задачи прошивки
+ */
+template <typename Predicate>
+static bool WaitFor(Predicate ready, uint32_t timeoutMs = 5000) {
+    for (uint32_t waited = 0; waited < timeoutMs; waited += 10) {
+        if (ready()) {
+            return true;
+        }
+        delay(10);
+    }
+    return ready();
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_page_is_sent_gzipped_cached_and_revalidated_by_etag() {
+    TEST_ASSERT_TRUE(server.HostPort() != 0);
+    Reply page = Get("/");
+    TEST_ASSERT_EQUAL_INT(200, page.code);
+    TEST_ASSERT_TRUE(Contains(page.headers, "Content-Encoding: gzip\r\n"));
+    TEST_ASSERT_EQUAL_UINT32(PAGE_GZ_LENGTH, page.body.size());
+    TEST_ASSERT_TRUE(memcmp(PAGE_GZ, page.body.data(), PAGE_GZ_LENGTH) == 0);
+    // Повторные открытия - из кэша браузера без запроса к устройству
+    TEST_ASSERT_TRUE(Contains(page.headers, "Cache-Control: max-age="));
+
+    std::string ifNoneMatch = std::string("If-None-Match: ") + PAGE_GZ_ETAG + "\r\n";
+    Reply cached = Get("/", ifNoneMatch.c_str());
+    TEST_ASSERT_EQUAL_INT(304, cached.code);
+    TEST_ASSERT_EQUAL_UINT32(0, cached.body.size());
+    TEST_ASSERT_TRUE(Contains(cached.headers, "Cache-Control: max-age="));
+}
+
+static void test_sensor_data_reports_mocked_chips() {
+    TEST_ASSERT_TRUE(WaitFor([] {
+        Reply data = Get("/sensor/data");
+        return Contains(data.body, "\"bme280\":true") && Contains(data.body, "\"bh1750\":true");
+    }));
+    Reply data = Get("/sensor/data");
+    TEST_ASSERT_EQUAL_INT(200, data.code);
+    TEST_ASSERT_TRUE(Contains(data.headers, "Content-Type: application/json\r\n"));
+    TEST_ASSERT_FLOAT_WITHIN(0.2f, 25.1f, JsonNumber(data.body, "temperature"));
+    TEST_ASSERT_FLOAT_WITHIN(1.0f, 56.2f, JsonNumber(data.body, "humidity"));
+    TEST_ASSERT_FLOAT_WITHIN(2.0f, 1006.5f, JsonNumber(data.body, "pressure"));
+    TEST_ASSERT_FLOAT_WITHIN(50.0f, 12000.0f, JsonNumber(data.body, "lux"));
+}
+
+static void test_sensor_config_error_changes_nothing() {
+    float period = JsonNumber(Get("/sensor/config").body, "period");
+    TEST_ASSERT_FALSE(isnan(period));
+
+    TEST_ASSERT_EQUAL_INT(400, PostForm("/sensor/config", "period=1").code);
+    TEST_ASSERT_EQUAL_INT(400, PostForm("/sensor/config", "period=5000&profile=greenhouse").code);
+    TEST_ASSERT_EQUAL_INT(400, PostForm("/sensor/config", "period=5000&metric=wind").code);
+    TEST_ASSERT_EQUAL_FLOAT(period, JsonNumber(Get("/sensor/config").body, "period"));
+}
+
+static void test_control_routes_switch_relays() {
+    TEST_ASSERT_EQUAL_INT(200, Get("/wind/on").code);
+    TEST_ASSERT_TRUE(WaitFor([] { return HostPinLevel(16) == HIGH; }));
+    TEST_ASSERT_TRUE(Contains(Get("/api/state").body, "\"wind\":true"));
+
+    TEST_ASSERT_EQUAL_INT(200, Get("/wind/off").code);
+    TEST_ASSERT_TRUE(WaitFor([] { return HostPinLevel(16) == LOW; }));
+    TEST_ASSERT_TRUE(Contains(Get("/api/state").body, "\"wind\":false"));
+}
+
+static void test_pump_fault_is_reported_and_reset() {
+    TEST_ASSERT_TRUE(Contains(Get("/api/state").body, "\"pump_fault\":false"));
+    Reply climate = PostForm("/climate", "pump_fault=0");
+    TEST_ASSERT_EQUAL_INT(200, climate.code);
+    TEST_ASSERT_TRUE(Contains(climate.body, "\"pump_fault\":false"));
+}
+
+static void test_bad_requests_are_rejected() {
+    TEST_ASSERT_EQUAL_INT(404, Get("/no/such/route").code);
+    TEST_ASSERT_EQUAL_INT(400, Get("/history?metric=wind").code);
+    TEST_ASSERT_EQUAL_INT(400, Request("PATCH", "/api/state", "Content-Type: application/json\r\n", "{\"pump\":").code);
+}
+
+/**
+ * Замер маршрута: запросы подряд по одному соединению на запрос
+ */
+static void BenchRoute(const char *target) {
+    BenchSamples samples;
+    BenchBegin(samples, BENCH_REQUESTS);
+    size_t allocations = 0;
+    size_t bodyBytes = 0;
+    size_t peakHeap = 0;
+    uint64_t started = BenchNowNs();
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        uint64_t sent = BenchNowNs();
+        Reply reply = Get(target);
+        BenchRecord(samples, BenchNowNs() - sent);
+        TEST_ASSERT_EQUAL_INT(200, reply.code);
+        // Соединение закрывается после учета запроса, поэтому последний учтенный запрос - этот
+        HostServedRequest served = server.HostLastServed();
+        TEST_ASSERT_EQUAL_UINT32(reply.body.size(), served.bodyBytes);
+        allocations += served.allocations;
+        bodyBytes += served.bodyBytes;
+        peakHeap = max(peakHeap, served.peakHeapBytes);
+    }
+    uint64_t elapsed = BenchNowNs() - started;
+
+    char name[64];
+    snprintf(name, sizeof(name), "http GET %s", target);
+    BenchReport(name, samples);
+    BenchReportRate(name, BENCH_REQUESTS, elapsed);
+    printf("BENCH %s: %.1f allocations per request, peak heap %zu bytes, %zu body bytes\n", name,
+           (double)allocations / BENCH_REQUESTS, peakHeap, bodyBytes / BENCH_REQUESTS);
+}
+
+static void test_bench_endpoints() {
+    const char *targets[] = {
+        "/", "/sensor/data", "/sensor/config", "/api/state", "/actuators", "/climate", "/dli", "/rules",
+        "/schedule", "/time", "/power", "/boot", "/push", "/log/info", "/metrics",
+        "/history?metric=temperature&res=raw", "/pump/off", "/light/brightness/?value=40",
+    };
+    for (const char *target : targets) {
+        BenchRoute(target);
+    }
+}
+
+int main(int argc, char **argv) {
+    Wire.HostAttach(0x77, &bme);
+    Wire.HostAttach(0x23, &lightChip);
+    Serial.HostMute(true);
+    setup();
+    server.HostCountAllocations([] { return benchAllocations; });
+    server.HostMeasureHeap(BenchHeapMark, [] { return benchHeapPeak; });
+    std::thread([] {
+        for (;;) {
+            loop();
+        }
+    }).detach();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_page_is_sent_gzipped_cached_and_revalidated_by_etag);
+    RUN_TEST(test_sensor_data_reports_mocked_chips);
+    RUN_TEST(test_sensor_config_error_changes_nothing);
+    RUN_TEST(test_control_routes_switch_relays);
+    RUN_TEST(test_pump_fault_is_reported_and_reset);
+    RUN_TEST(test_bad_requests_are_rejected);
+    RUN_TEST(test_bench_endpoints);
+    // Задачи прошивки работают до конца программы: выход без деструкторов статических объектов
+    int failures = UNITY_END();
+    fflush(stdout);
+    _exit(failures);
+}
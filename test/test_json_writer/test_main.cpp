@@ -0,0 +1,177 @@
+/**
+ * Запись JSON: точная запись чисел, буферы ответов и выделения памяти на GET
+ */
+#define BENCH_COUNT_ALLOCATIONS
+#include <unity.h>
+#include <math.h>
+#include <ESPAsyncWebServer.h>
+#include "bench.h"
+#include "json_writer.h"
+
+void setUp() {}
+
+void tearDown() {}
+
+static String FormatExact(float value) {
+    char text[24];
+    size_t length = JsonFormatFloatExact(text, value);
+    return String(std::string(text, length));
+}
+
+static void test_exact_float_is_shortest_for_typical_thresholds() {
+    TEST_ASSERT_EQUAL_STRING("2000", FormatExact(2000.0f).c_str());
+    TEST_ASSERT_EQUAL_STRING("0.05", FormatExact(0.05f).c_str());
+    TEST_ASSERT_EQUAL_STRING("1003.25", FormatExact(1003.25f).c_str());
+    TEST_ASSERT_EQUAL_STRING("-5.5", FormatExact(-5.5f).c_str());
+    TEST_ASSERT_EQUAL_STRING("12.345", FormatExact(12.345f).c_str());
+}
+
+static void test_exact_float_round_trips() {
+    const float special[] = {1e-7f, 3.4e38f, -3.4e38f, 1.17549435e-38f, 16777217.0f, 0.1f, 99.999f};
+    for (float value : special) {
+        TEST_ASSERT_EQUAL_FLOAT(value, strtof(FormatExact(value).c_str(), NULL));
+        TEST_ASSERT_TRUE(strtof(FormatExact(value).c_str(), NULL) == value);
+    }
+    uint32_t seed = 1;
+    for (int i = 0; i < 100000; i++) {
+        seed = seed * 1103515245 + 12345;
+        float value = ((int32_t)seed >> 8) / 1024.0f / (1 + seed % 1000);
+        TEST_ASSERT_TRUE(strtof(FormatExact(value).c_str(), NULL) == value);
+    }
+}
+
+static void test_writer_exact_float_field() {
+    char buffer[64];
+    JsonWriter json;
+    JsonWriterBegin(json, buffer, sizeof(buffer));
+    JsonWriterObject(json);
+    JsonWriterFloat(json, "rounded", 0.05f, 1);
+    JsonWriterFloatExact(json, "value", 0.05f);
+    JsonWriterFloatExact(json, "missing", NAN);
+    JsonWriterEnd(json);
+    TEST_ASSERT_TRUE(JsonWriterFinish(json));
+    TEST_ASSERT_EQUAL_STRING("{\"rounded\":0.1,\"value\":0.05,\"missing\":null}", buffer);
+}
+
+/**
+ * Тело, похожее на ответ /sensor/data
+ */
+static void WriteSensorData(JsonWriter &json, uint32_t i) {
+    JsonWriterObject(json);
+    JsonWriterFloat(json, "temperature", 21.5f + i % 10, 1);
+    JsonWriterFloat(json, "humidity", 55.25f, 1);
+    JsonWriterFloat(json, "pressure", 1003.4f, 1);
+    JsonWriterUint(json, "lux", 12000 + i);
+    JsonWriterBool(json, "valid", true);
+    JsonWriterString(json, "profile", "weather");
+    JsonWriterArray(json, "relays");
+    for (int relay = 0; relay < 3; relay++) {
+        JsonWriterObject(json);
+        JsonWriterString(json, "name", relay == 0 ? "pump" : (relay == 1 ? "fan" : "window"));
+        JsonWriterBool(json, "on", relay == 1);
+        JsonWriterEnd(json);
+    }
+    JsonWriterEnd(json);
+    JsonWriterEnd(json);
+}
+
+static void test_slot_is_held_until_response_is_deleted() {
+    AsyncWebServerRequest *requests[JSON_RESPONSE_SLOTS];
+    for (int i = 0; i < JSON_RESPONSE_SLOTS; i++) {
+        requests[i] = new AsyncWebServerRequest();
+        JsonWriter json;
+        JsonWriterBeginResponse(json);
+        WriteSensorData(json, i);
+        JsonWriterSend(requests[i], 200, json);
+        TEST_ASSERT_EQUAL_INT(200, requests[i]->response->code);
+    }
+    TEST_ASSERT_EQUAL_UINT8(JSON_RESPONSE_SLOTS, JsonWriterBusyResponses());
+
+    // Все буферы отправляются: новый ответ получает 503, тела отправляемых не затираются
+    AsyncWebServerRequest *extra = new AsyncWebServerRequest();
+    JsonWriter json;
+    JsonWriterBeginResponse(json);
+    WriteSensorData(json, 99);
+    JsonWriterSend(extra, 200, json);
+    TEST_ASSERT_EQUAL_INT(503, extra->response->code);
+    HostFinishRequest(extra);
+    TEST_ASSERT_TRUE(requests[0]->response->body().indexOf("\"lux\":12000,") >= 0);
+
+    // Завершение одного запроса освобождает ровно один буфер
+    HostFinishRequest(requests[0]);
+    TEST_ASSERT_EQUAL_UINT8(JSON_RESPONSE_SLOTS - 1, JsonWriterBusyResponses());
+    AsyncWebServerRequest *next = new AsyncWebServerRequest();
+    JsonWriterBeginResponse(json);
+    WriteSensorData(json, 7);
+    JsonWriterSend(next, 200, json);
+    TEST_ASSERT_EQUAL_INT(200, next->response->code);
+    TEST_ASSERT_TRUE(requests[1]->response->body().indexOf("\"lux\":12001,") >= 0);
+
+    HostFinishRequest(next);
+    for (int i = 1; i < JSON_RESPONSE_SLOTS; i++) {
+        HostFinishRequest(requests[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT8(0, JsonWriterBusyResponses());
+}
+
+static void test_overflow_releases_slot_at_once() {
+    AsyncWebServerRequest *request = new AsyncWebServerRequest();
+    JsonWriter json;
+    JsonWriterBeginResponse(json);
+    JsonWriterArray(json);
+    for (int i = 0; i < JSON_RESPONSE_MAX; i++) {
+        JsonWriterUint(json, NULL, i);
+    }
+    JsonWriterEnd(json);
+    JsonWriterSend(request, 200, json);
+    TEST_ASSERT_EQUAL_INT(500, request->response->code);
+    TEST_ASSERT_EQUAL_UINT8(0, JsonWriterBusyResponses());
+    HostFinishRequest(request);
+}
+
+/**
+ * Выделения памяти на GET: запись тела не выделяет ничего, отправка - только объект
+ * ответа библиотеки и его поля, тело в ответ не копируется
+ */
+static void test_bench_get_response_allocations() {
+    const uint32_t count = 10000;
+    size_t writeAllocations = 0;
+    size_t sendAllocations = 0;
+    BenchSamples timing;
+    BenchBegin(timing, count);
+    for (uint32_t i = 0; i < count; i++) {
+        AsyncWebServerRequest *request = new AsyncWebServerRequest();
+        JsonWriter json;
+        size_t before = benchAllocations;
+        uint64_t started = BenchNowNs();
+        JsonWriterBeginResponse(json);
+        WriteSensorData(json, i);
+        BenchRecord(timing, BenchNowNs() - started);
+        writeAllocations += benchAllocations - before;
+
+        before = benchAllocations;
+        JsonWriterSend(request, 200, json, "\"1\"");
+        sendAllocations += benchAllocations - before;
+        AsyncProgmemResponse *response = dynamic_cast<AsyncProgmemResponse *>(request->response);
+        TEST_ASSERT_NOT_NULL(response);
+        TEST_ASSERT_TRUE((const char *)response->content == json.buffer);
+        HostFinishRequest(request);
+    }
+    BenchReport("json GET body write", timing);
+    printf("BENCH json GET allocations per response: body write %.2f, send %.2f (response object, "
+           "content type and ETag strings of the host stub)\n",
+           (double)writeAllocations / count, (double)sendAllocations / count);
+    TEST_ASSERT_EQUAL_UINT32(0, writeAllocations);
+    TEST_ASSERT_EQUAL_UINT8(0, JsonWriterBusyResponses());
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_exact_float_is_shortest_for_typical_thresholds);
+    RUN_TEST(test_exact_float_round_trips);
+    RUN_TEST(test_writer_exact_float_field);
+    RUN_TEST(test_slot_is_held_until_response_is_deleted);
+    RUN_TEST(test_overflow_releases_slot_at_once);
+    RUN_TEST(test_bench_get_response_allocations);
+    return UNITY_END();
+}
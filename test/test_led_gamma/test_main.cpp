@@ -0,0 +1,128 @@
+/**
+ * Гамма-коррекция ленты: одна коррекция произведения цвета и яркости по таблице
+ * Для сравнения - прежний вывод: таблица гаммы для каналов и для общей яркости,
+ * затем масштабирование FastLED (scale8), и точный расчет через powf
+ */
+#include <unity.h>
+#include <math.h>
+#include "bench.h"
+#include "led_gamma.h"
+
+static uint8_t gammaTable[256];
+
+void setUp() {
+    LedGammaSetup(LED_GAMMA);
+    for (int i = 0; i < 256; i++) {
+        gammaTable[i] = (uint8_t)(powf(i / 255.0f, LED_GAMMA) * 255.0f + 0.5f);
+    }
+}
+
+void tearDown() {}
+
+static uint8_t DoubleGammaLevel(uint8_t channel, uint8_t brightness) {
+    return ((uint32_t)gammaTable[channel] * (1 + gammaTable[brightness])) >> 8;
+}
+
+static void test_limits() {
+    TEST_ASSERT_EQUAL_UINT8(0, LedGammaLevel(0, 255));
+    TEST_ASSERT_EQUAL_UINT8(0, LedGammaLevel(255, 0));
+    TEST_ASSERT_EQUAL_UINT8(255, LedGammaLevel(255, 255));
+    TEST_ASSERT_EQUAL_UINT8(1, LedGammaLevel(1, 1));
+}
+
+static void test_brightness_scales_like_color() {
+    // Цвет 128 на полной яркости и белый на яркости 128 дают одинаковый свет
+    TEST_ASSERT_EQUAL_UINT8(LedGammaLevel(128, 255), LedGammaLevel(255, 128));
+    for (int channel = 1; channel < 256; channel++) {
+        uint8_t previous = 0;
+        for (int brightness = 1; brightness < 256; brightness++) {
+            uint8_t level = LedGammaLevel(channel, brightness);
+            TEST_ASSERT_TRUE(level >= 1);
+            TEST_ASSERT_TRUE(level >= previous);
+            previous = level;
+        }
+    }
+}
+
+static void test_double_gamma_darkened_dim_states() {
+    // Сколько включенных состояний (канал и яркость не нули) давали ШИМ 0 при двойной коррекции
+    uint32_t dark = 0;
+    uint32_t dimmest = 0;  // Наименьшая яркость, при которой белый канал светится
+    for (int channel = 1; channel < 256; channel++) {
+        for (int brightness = 1; brightness < 256; brightness++) {
+            if (DoubleGammaLevel(channel, brightness) == 0) {
+                dark++;
+            }
+        }
+    }
+    while (DoubleGammaLevel(255, ++dimmest) == 0) {
+    }
+    printf("BENCH led double gamma: %u of %u lit states gave PWM 0; white lit from brightness %u/255 "
+           "(%u%% of slider)\n", dark, 255 * 255, dimmest, (dimmest * 100 + 254) / 255);
+    TEST_ASSERT_TRUE(dark > 0);
+}
+
+/**
+ * Точный расчет: powf для каждого канала
+ */
+static uint8_t ExactLevel(uint8_t channel, uint8_t brightness, float gamma) {
+    uint32_t perceived = (uint32_t)channel * brightness;
+    if (perceived == 0) {
+        return 0;
+    }
+    uint32_t level = (uint32_t)(powf(perceived / 65025.0f, gamma) * 255.0f + 0.5f);
+    return level > 0 ? level : 1;
+}
+
+static void test_table_matches_exact_curve() {
+    uint32_t differ = 0;
+    for (int channel = 0; channel < 256; channel++) {
+        for (int brightness = 0; brightness < 256; brightness++) {
+            int difference = abs((int)LedGammaLevel(channel, brightness) -
+                                 (int)ExactLevel(channel, brightness, LED_GAMMA));
+            TEST_ASSERT_TRUE(difference <= 1);
+            differ += difference;
+        }
+    }
+    printf("BENCH led gamma table: %u of %u states differ from powf by 1 PWM step\n", differ, 256 * 256);
+}
+
+static void test_table_is_rebuilt_for_new_gamma() {
+    LedGammaSetup(1.0f);
+    TEST_ASSERT_EQUAL_UINT8(128, LedGammaLevel(255, 128));
+    TEST_ASSERT_EQUAL_UINT8(64, LedGammaLevel(128, 128));
+    LedGammaSetup(LED_GAMMA);
+    TEST_ASSERT_EQUAL_UINT8(ExactLevel(255, 128, LED_GAMMA), LedGammaLevel(255, 128));
+}
+
+static void test_bench_frame_levels() {
+    // Каналы кадра при плавном переходе: три канала на каждую из 256 ступеней яркости
+    const int frames = 2000;
+    volatile uint32_t sink = 0;
+    uint64_t started = BenchNowNs();
+    for (int frame = 0; frame < frames; frame++) {
+        uint8_t brightness = frame & 0xFF;
+        sink += LedGammaLevel(255, brightness) + LedGammaLevel(128, brightness) + LedGammaLevel(32, brightness);
+    }
+    uint64_t table = BenchNowNs() - started;
+    started = BenchNowNs();
+    for (int frame = 0; frame < frames; frame++) {
+        uint8_t brightness = frame & 0xFF;
+        sink += ExactLevel(255, brightness, LED_GAMMA) + ExactLevel(128, brightness, LED_GAMMA) +
+                ExactLevel(32, brightness, LED_GAMMA);
+    }
+    uint64_t exact = BenchNowNs() - started;
+    BenchReportRate("led gamma frame (table)", frames, table);
+    BenchReportRate("led gamma frame (powf)", frames, exact);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_limits);
+    RUN_TEST(test_brightness_scales_like_color);
+    RUN_TEST(test_double_gamma_darkened_dim_states);
+    RUN_TEST(test_table_matches_exact_curve);
+    RUN_TEST(test_table_is_rebuilt_for_new_gamma);
+    RUN_TEST(test_bench_frame_levels);
+    return UNITY_END();
+}
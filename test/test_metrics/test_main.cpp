@@ -0,0 +1,138 @@
+/**
+ * Выдача метрик Prometheus: все строки целые и помещаются в буфер строки с запасом
+ */
+#include <unity.h>
+#include <ESPAsyncWebServer.h>
+#include <vector>
+#include "metrics.h"
+
+// Размер буфера строки в metrics.cpp (METRICS_LINE_MAX)
+#define LINE_MAX 160
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * Вся выдача фрагментами заданного размера, по строкам
+ */
+static std::vector<std::string> StreamLines(size_t chunk) {
+    MetricsStream stream = {};
+    stream.wifiStations = 3;
+    stream.websocketClients = 2;
+    std::string text;
+    uint8_t buffer[1436];
+    for (;;) {
+        size_t length = MetricsStreamChunk(stream, buffer, chunk);
+        TEST_ASSERT_TRUE(length != RESPONSE_TRY_AGAIN);
+        if (length == 0) {
+            break;
+        }
+        text.append((const char *)buffer, length);
+    }
+    std::vector<std::string> lines;
+    size_t start = 0;
+    for (size_t end; (end = text.find('\n', start)) != std::string::npos; start = end + 1) {
+        lines.push_back(text.substr(start, end - start + 1));
+    }
+    TEST_ASSERT_EQUAL_UINT32(text.size(), start); // Текст кончается целой строкой
+    return lines;
+}
+
+static void test_every_line_is_complete() {
+    for (int timing = 0; timing < METRICS_TIMING_COUNT; timing++) {
+        MetricsObserve((MetricsTiming)timing, 1200 * (timing + 1));
+    }
+    MetricsIncrement(METRICS_ERRORS_BH1750);
+
+    std::vector<std::string> lines = StreamLines(200);
+    uint32_t help = 0;
+    uint32_t histogram = 0;
+    for (const std::string &line : lines) {
+        help += line.compare(0, 7, "# HELP ") == 0 ? 1 : 0;
+        bool histogramLine = line.find("_bucket{") != std::string::npos || line.find("_sum") != std::string::npos ||
+                             line.find("_count") != std::string::npos;
+        histogram += histogramLine ? 1 : 0;
+        if (line[0] != '#') {
+            // Имя с метками, пробел, значение
+            size_t space = line.rfind(' ');
+            TEST_ASSERT_TRUE(space != std::string::npos && space + 2 < line.size());
+            TEST_ASSERT_EQUAL(std::count(line.begin(), line.end(), '{'), std::count(line.begin(), line.end(), '}'));
+        }
+    }
+    // Ни одна строка гистограмм не пропущена: интервалы с +Inf, _sum и _count для каждой величины
+    TEST_ASSERT_EQUAL_UINT32(METRICS_TIMING_COUNT * (12 + 1 + 2), histogram);
+    TEST_ASSERT_EQUAL_UINT32(11, help);
+}
+
+static void test_longest_line_fits_with_largest_values() {
+    std::vector<std::string> lines = StreamLines(1436);
+    size_t longest = 0;
+    std::string example;
+    for (const std::string &line : lines) {
+        // Наибольшее значение - 64-битная сумма длительностей (длиннее счетчика uint32 из 10 цифр)
+        size_t length = line.size();
+        if (line[0] != '#') {
+            size_t space = line.rfind(' ');
+            length = space + 1 + strlen("18446744073709.551615") + 1;
+        }
+        if (length > longest) {
+            longest = length;
+            example = line;
+        }
+    }
+    printf("BENCH metrics: %zu lines, longest %zu of %d bytes with largest values: %s", lines.size(), longest,
+           LINE_MAX, example.c_str());
+    TEST_ASSERT_TRUE(longest < LINE_MAX);
+}
+
+static void test_routes_have_own_labels() {
+    std::vector<std::string> lines = StreamLines(1436);
+    const char *routes[] = {"/sensor/data", "/sensor/config", "/dli"};
+    for (const char *route : routes) {
+        std::string label = std::string("{route=\"") + route + "\"";
+        uint32_t count = 0;
+        for (const std::string &line : lines) {
+            count += line.find(label) != std::string::npos ? 1 : 0;
+        }
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(12 + 1 + 2, count, route);
+    }
+}
+
+/**
+ * Значение строки _sum величины с меткой route, мкс
+ */
+static uint64_t SumUs(const char *route) {
+    std::string prefix = std::string("greenhouse_http_request_duration_seconds_sum{route=\"") + route + "\"}";
+    for (const std::string &line : StreamLines(1436)) {
+        if (line.compare(0, prefix.size(), prefix) == 0) {
+            unsigned long long seconds = 0;
+            unsigned micros = 0;
+            TEST_ASSERT_EQUAL_INT(2, sscanf(line.c_str() + prefix.size(), " %llu.%6u", &seconds, &micros));
+            return seconds * 1000000ULL + micros;
+        }
+    }
+    TEST_FAIL_MESSAGE(route);
+    return 0;
+}
+
+static void test_sum_does_not_wrap_after_71_minutes() {
+    uint64_t before = SumUs("/push");
+    // 5000 с обработки - больше 2^32 мкс
+    for (int i = 0; i < 5000; i++) {
+        MetricsObserve(METRICS_ROUTE_PUSH, 1000000);
+    }
+    MetricsObserve(METRICS_ROUTE_PUSH, 7);
+    uint64_t after = SumUs("/push");
+    TEST_ASSERT_TRUE(after > (1ULL << 32));
+    TEST_ASSERT_TRUE(after - before == 5000000007ULL);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_every_line_is_complete);
+    RUN_TEST(test_longest_line_fits_with_largest_values);
+    RUN_TEST(test_routes_have_own_labels);
+    RUN_TEST(test_sum_does_not_wrap_after_71_minutes);
+    return UNITY_END();
+}
@@ -0,0 +1,139 @@
+/**
+ * Управление питанием: setup() без точки доступа, переход в простой и обратно
+ * с паузами основного цикла, оценка тока по режиму и нагрузкам
+ * Время простоя проходится сдвигом millis() (HostAdvanceMillis), а не ожиданием
+ */
+#include <unity.h>
+#include <unistd.h>
+#include "actuators.h"
+#include "led.h"
+#include "power.h"
+
+void setup();
+void loop();
+
+void setUp() {}
+
+void tearDown() {}
+
+/**
+ * Ток, который должна дать модель для текущего состояния устройств и ленты
+ */
+static float ExpectedCurrent(PowerMode mode) {
+    float current = mode == POWER_IDLE ? POWER_CPU_IDLE_MA + POWER_WIFI_IDLE_MA
+                                       : POWER_CPU_ACTIVE_MA + POWER_WIFI_ACTIVE_MA;
+    ActuatorState actuators;
+    ActuatorsGetState(actuators);
+    current += POWER_RELAY_MA * ((actuators.pump ? 1 : 0) + (actuators.wind ? 1 : 0) + (actuators.light ? 1 : 0));
+    LedState led;
+    LedGetTarget(led);
+    uint32_t channels = LedGammaLevel(led.color.r, led.brightness) +
+                        LedGammaLevel(led.color.g, led.brightness) +
+                        LedGammaLevel(led.color.b, led.brightness);
+    return current + POWER_LED_CHANNEL_MA * LED_COUNT * channels / 255.0f;
+}
+
+static void test_setup_without_access_point_starts_active() {
+    // Запуск занял минуту, точка доступа не поднялась: setup() возвращается досрочно
+    HostAdvanceMillis(60000);
+    setup();
+    loop();
+
+    PowerStats stats;
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, stats.mode);
+    TEST_ASSERT_EQUAL_UINT32(POWER_ACTIVE_CPU_MHZ, stats.cpuMhz);
+    TEST_ASSERT_EQUAL_INT(POWER_ACTIVE_TX_POWER, WiFi.getTxPower());
+    // Отсчет простоя и заряда - от setup(), а не от включения
+    TEST_ASSERT_TRUE(stats.sinceActivityMs < 1000);
+    TEST_ASSERT_TRUE(stats.activeMs < 1000);
+    TEST_ASSERT_EQUAL_UINT32(POWER_ACTIVE_LOOP_MS, PowerLoopDelayMs());
+}
+
+static void test_idle_timeout_lowers_power_and_activity_restores_it() {
+    HostAdvanceMillis(POWER_IDLE_TIMEOUT_MS - 1000);
+    PowerLoop(0, 0);
+    PowerStats stats;
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, stats.mode);
+
+    HostAdvanceMillis(1000);
+    PowerLoop(0, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_IDLE, stats.mode);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.transitions);
+    TEST_ASSERT_EQUAL_UINT32(POWER_IDLE_CPU_MHZ, stats.cpuMhz);
+    TEST_ASSERT_EQUAL_INT(POWER_IDLE_TX_POWER, WiFi.getTxPower());
+    TEST_ASSERT_EQUAL_UINT32(POWER_IDLE_LOOP_MS, PowerLoopDelayMs());
+
+    // Подключение к точке доступа - активность
+    PowerLoop(1, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, stats.mode);
+    TEST_ASSERT_EQUAL_UINT32(POWER_ACTIVE_CPU_MHZ, stats.cpuMhz);
+    TEST_ASSERT_EQUAL_UINT32(POWER_ACTIVE_LOOP_MS, PowerLoopDelayMs());
+
+    // Запрос к серверу - тоже
+    HostAdvanceMillis(POWER_IDLE_TIMEOUT_MS);
+    PowerLoop(1, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_IDLE, stats.mode);
+    PowerActivity();
+    PowerLoop(1, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_ACTIVE, stats.mode);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.transitions);
+}
+
+static void test_current_estimate_follows_mode_and_loads() {
+    PowerLoop(0, 0);
+    PowerStats stats;
+    PowerGetStats(stats);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, ExpectedCurrent(POWER_ACTIVE), stats.currentMa);
+
+    // Каждое включенное реле добавляет POWER_RELAY_MA
+    float before = stats.currentMa;
+    ActuatorState state;
+    ActuatorsGetState(state);
+    TEST_ASSERT_FALSE(state.pump);
+    TEST_ASSERT_TRUE(ActuatorSet(ACTUATOR_PUMP, 1));
+    for (int i = 0; i < 500 && !state.pump; i++) {
+        delay(2);
+        ActuatorsGetState(state);
+    }
+    TEST_ASSERT_TRUE(state.pump);
+    PowerLoop(0, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, before + POWER_RELAY_MA, stats.currentMa);
+
+    // В простое - ток процессора и передатчика на сниженных настройках
+    HostAdvanceMillis(POWER_IDLE_TIMEOUT_MS);
+    PowerLoop(0, 0);
+    PowerGetStats(stats);
+    TEST_ASSERT_EQUAL_INT(POWER_IDLE, stats.mode);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, ExpectedCurrent(POWER_IDLE), stats.currentMa);
+    TEST_ASSERT_FLOAT_WITHIN(0.01f,
+                             before + POWER_RELAY_MA - (POWER_CPU_ACTIVE_MA + POWER_WIFI_ACTIVE_MA) +
+                                 POWER_CPU_IDLE_MA + POWER_WIFI_IDLE_MA,
+                             stats.currentMa);
+
+    // Заряд - интеграл тока по тактам, средний ток - между простоем и полным режимом
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, stats.averageMa * (stats.activeMs + stats.idleMs) / 3600000.0f,
+                             stats.chargeMah);
+    TEST_ASSERT_TRUE(stats.averageMa > ExpectedCurrent(POWER_IDLE) - POWER_RELAY_MA);
+    TEST_ASSERT_TRUE(stats.averageMa < ExpectedCurrent(POWER_ACTIVE) + POWER_RELAY_MA);
+}
+
+int main(int argc, char **argv) {
+    Serial.HostMute(true);
+    WiFi.HostFailSoftAp(true);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_setup_without_access_point_starts_active);
+    RUN_TEST(test_idle_timeout_lowers_power_and_activity_restores_it);
+    RUN_TEST(test_current_estimate_follows_mode_and_loads);
+    // Задачи прошивки работают до конца программы: выход без деструкторов статических объектов
+    int failures = UNITY_END();
+    fflush(stdout);
+    _exit(failures);
+}
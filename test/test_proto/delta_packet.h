@@ -0,0 +1,20 @@
+#ifndef TEST_DELTA_PACKET_H
+#define TEST_DELTA_PACKET_H
+
+/**
+ * Пакет PROTO_DELTA, который ProtoEncodeDelta собирает из измерений deltaRecords (test_main.cpp):
+ * узел 0xA1B2C3D4, пакет 7, три измерения, в последнем показаний нет
+ * Тот же пакет разбирает tools/test_collector.py: байты читаются из этого файла
+ */
+#include <stdint.h>
+
+static const uint8_t DELTA_PACKET[] = {
+    0x47, 0x48, 0x01, 0x04, 0x3B, 0x00, 0xD4, 0xC3, 0xB2, 0xA1, 0x07, 0x00,
+    0x00, 0x00, 0x03, 0xD0, 0x0F, 0x80, 0xC4, 0x9F, 0xD5, 0x0C, 0xAB, 0x02,
+    0xE8, 0x57, 0xA2, 0x9D, 0x01, 0x80, 0xBE, 0x92, 0x01, 0x32, 0x3C, 0x28,
+    0x02, 0x04, 0x14, 0x27, 0x02, 0x8F, 0x4E, 0x01, 0x14, 0x00, 0x04, 0x08,
+    0xE7, 0xFD, 0x03, 0xBE, 0xA8, 0x07, 0xDA, 0xE2, 0x06, 0xF1, 0xEF, 0x91,
+    0x01, 0x27, 0x00, 0xA0, 0x01,
+};
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * Двоичный протокол: пакет PROTO_DELTA с известными измерениями совпадает с эталоном
+ * delta_packet.h, по которому проверяется разбор в tools/collector.py
+ */
+#include <unity.h>
+#include "proto.h"
+#include "delta_packet.h"
+
+// Температура со знаком и отсутствующие показания - как их записывает ProtoPushLoop
+#define TEMPERATURE(value) ((uint32_t)(int32_t)(int16_t)(value))
+
+static const uint32_t deltaRecords[][DELTA_FIELD_COUNT] = {
+    {1000, 1700000000, TEMPERATURE(-150), 5620, 10065, 1200000,
+     PROTO_FLAG_BME280 | PROTO_FLAG_BH1750 | PROTO_FLAG_PUMP, 30, 20},
+    {1001, 1700000002, TEMPERATURE(-140), 5600, 10066, 1195000, PROTO_FLAG_BME280 | PROTO_FLAG_BH1750, 40, 20},
+    {1003, 1700000006, TEMPERATURE(PROTO_NO_TEMPERATURE), PROTO_NO_HUMIDITY, PROTO_NO_PRESSURE, PROTO_NO_LUX,
+     PROTO_FLAG_LIGHT, 40, 100},
+};
+
+void setUp() {}
+
+void tearDown() {}
+
+static void test_delta_packet_matches_reference() {
+    uint8_t buffer[PROTO_PUSH_MAX_BYTES];
+    size_t length = ProtoEncodeDelta(buffer, sizeof(buffer), 0xA1B2C3D4, 7, deltaRecords, 3);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(DELTA_PACKET), length);
+    TEST_ASSERT_EQUAL_MEMORY(DELTA_PACKET, buffer, sizeof(DELTA_PACKET));
+}
+
+static void test_delta_packet_layout() {
+    // Заголовок: длина данных, узел и номер пакета little-endian, количество измерений
+    TEST_ASSERT_EQUAL_UINT32(sizeof(DELTA_PACKET) - PROTO_HEADER_SIZE, DELTA_PACKET[4] | DELTA_PACKET[5] << 8);
+    TEST_ASSERT_EQUAL_UINT8(PROTO_DELTA, DELTA_PACKET[3]);
+    TEST_ASSERT_EQUAL_UINT8(0xD4, DELTA_PACKET[6]);
+    TEST_ASSERT_EQUAL_UINT8(0x07, DELTA_PACKET[10]);
+    TEST_ASSERT_EQUAL_UINT8(3, DELTA_PACKET[14]);
+    // Первое измерение - от нуля: номер 1000 в zigzag-varint - 2000 = 0xD0 0x0F
+    TEST_ASSERT_EQUAL_UINT8(0xD0, DELTA_PACKET[15]);
+    TEST_ASSERT_EQUAL_UINT8(0x0F, DELTA_PACKET[16]);
+    // Второе - разностями: номер +1, время +2, температура +10 (0,1 °C)
+    const uint8_t second[] = {0x02, 0x04, 0x14};
+    TEST_ASSERT_EQUAL_MEMORY(second, DELTA_PACKET + 36, sizeof(second));
+}
+
+static void test_delta_packet_that_does_not_fit_is_empty() {
+    uint8_t buffer[sizeof(DELTA_PACKET) - 1];
+    TEST_ASSERT_EQUAL_UINT32(0, ProtoEncodeDelta(buffer, sizeof(buffer), 0xA1B2C3D4, 7, deltaRecords, 3));
+    uint8_t empty[PROTO_HEADER_SIZE + 9];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(empty), ProtoEncodeDelta(empty, sizeof(empty), 1, 0, deltaRecords, 0));
+    TEST_ASSERT_EQUAL_UINT8(0, empty[PROTO_HEADER_SIZE + 8]);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_delta_packet_matches_reference);
+    RUN_TEST(test_delta_packet_layout);
+    RUN_TEST(test_delta_packet_that_does_not_fit_is_empty);
+    return UNITY_END();
+}
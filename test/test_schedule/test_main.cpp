@@ -0,0 +1,216 @@
+/**
+ * Расписание: загрузка таблицы из NVS и колесо таймеров на тысячах заданий
+ * Таблица кладется в NVS (test/support/Preferences.h) в том виде, в котором ее сохраняет
+ * ScheduleCompile, и загружается через ScheduleBegin. Состояние колеса сверяется
+ * с прямым расчетом по каждому заданию, такт колеса сравнивается с полным просмотром заданий
+ */
+#include <unity.h>
+#include <Preferences.h>
+#include <vector>
+#include "bench.h"
+#include "schedule.h"
+
+#define DAY 86400
+#define T0 (20000UL * DAY)  // Местная полночь
+
+/**
+ * Таблица в NVS: формат, количество заданий и занятые элементы (как ScheduleTable в schedule.cpp)
+ */
+struct StoredTable {
+    uint32_t format;
+    uint32_t count;
+    ScheduleJob jobs[SCHEDULE_MAX_JOBS];
+};
+
+#define STORED_FORMAT 1  // SCHEDULE_FORMAT
+
+static StoredTable stored;
+
+void setUp() {
+    Preferences::HostClear();
+    ScheduleClear();
+    stored = {STORED_FORMAT, 0, {}};
+}
+
+void tearDown() {}
+
+static void Store(uint32_t format) {
+    stored.format = format;
+    Preferences preferences;
+    preferences.begin("schedule", false);
+    preferences.putBytes("table", &stored, offsetof(StoredTable, jobs) + stored.count * sizeof(ScheduleJob));
+    preferences.end();
+}
+
+/**
+ * Прямой расчет: действует ли задание в момент local
+ */
+static bool JobActive(const ScheduleJob &job, uint32_t local) {
+    uint32_t phase = (local % job.every + job.every - job.at % job.every) % job.every;
+    return phase < job.duration;
+}
+
+static void test_begin_loads_stored_table() {
+    stored.jobs[stored.count++] = {1, 6 * 3600, DAY, 60, SCHEDULE_PUMP};
+    stored.jobs[stored.count++] = {80, 6 * 3600, DAY, 16 * 3600, SCHEDULE_LIGHT};
+    Store(STORED_FORMAT);
+    TEST_ASSERT_TRUE(ScheduleBegin());
+
+    ScheduleOutputs outputs;
+    ScheduleLoop(T0 + 6 * 3600 - 1, 0);
+    ScheduleGetOutputs(outputs);
+    TEST_ASSERT_FALSE(outputs.set[SCHEDULE_PUMP]);
+    TEST_ASSERT_FALSE(outputs.set[SCHEDULE_LIGHT]);
+
+    ScheduleLoop(T0 + 6 * 3600, 0);
+    ScheduleGetOutputs(outputs);
+    TEST_ASSERT_TRUE(outputs.set[SCHEDULE_PUMP]);
+    TEST_ASSERT_EQUAL_INT32(80, outputs.value[SCHEDULE_LIGHT]);
+
+    ScheduleLoop(T0 + 6 * 3600 + 60, 0);
+    ScheduleGetOutputs(outputs);
+    TEST_ASSERT_FALSE(outputs.set[SCHEDULE_PUMP]);
+    TEST_ASSERT_TRUE(outputs.set[SCHEDULE_LIGHT]);
+}
+
+static void test_begin_rejects_other_format() {
+    stored.jobs[stored.count++] = {1, 0, DAY, 60, SCHEDULE_PUMP};
+    Store(STORED_FORMAT + 1);
+    TEST_ASSERT_FALSE(ScheduleBegin());
+}
+
+/**
+ * Генератор заданий и скачков часов
+ */
+static uint32_t seed = 1;
+
+static uint32_t Random(uint32_t range) {
+    seed = seed * 1103515245 + 12345;
+    return (seed >> 8) % range;
+}
+
+/**
+ * Сверка выходов с прямым расчетом: устройство удерживается, пока действует хотя бы одно
+ * его задание, а значение - одного из действующих заданий
+ * @return Количество расхождений
+ */
+static uint32_t CountMismatches(uint32_t local) {
+    ScheduleOutputs outputs;
+    ScheduleGetOutputs(outputs);
+    bool set[SCHEDULE_ACTUATOR_COUNT] = {};
+    bool valueFound[SCHEDULE_ACTUATOR_COUNT] = {};
+    for (uint32_t i = 0; i < stored.count; i++) {
+        const ScheduleJob &job = stored.jobs[i];
+        if (JobActive(job, local)) {
+            set[job.actuator] = true;
+            valueFound[job.actuator] |= outputs.value[job.actuator] == job.value;
+        }
+    }
+    uint32_t mismatches = 0;
+    for (int a = 0; a < SCHEDULE_ACTUATOR_COUNT; a++) {
+        mismatches += outputs.set[a] != set[a] || (set[a] && !valueFound[a]) ? 1 : 0;
+    }
+    return mismatches;
+}
+
+static void test_bench_thousands_of_jobs() {
+    // Периоды - делители суток и целые сутки до недели
+    const uint32_t periods[] = {60, 120, 300, 600, 900, 1800, 3600, 7200, 14400, 21600, 43200, DAY,
+                                2 * DAY, 7 * DAY};
+    const uint32_t periodCount = sizeof(periods) / sizeof(periods[0]);
+    seed = 1;
+    for (uint32_t i = 0; i < SCHEDULE_MAX_JOBS; i++) {
+        ScheduleJob &job = stored.jobs[i];
+        job.every = periods[Random(periodCount)];
+        job.duration = 1 + Random(job.every - 1);
+        job.at = Random(1440) * 60;
+        job.actuator = i % SCHEDULE_ACTUATOR_COUNT;
+        job.value = i;  // По значению видно, какое задание удерживает устройство
+    }
+    stored.count = SCHEDULE_MAX_JOBS;
+    Store(STORED_FORMAT);
+    TEST_ASSERT_TRUE(ScheduleBegin());
+
+    // Двое суток по секундам; изредка часы догоняют отставание или переводятся назад
+    const uint32_t steps = 2 * DAY;
+    uint32_t now = T0 + 5 * 3600;
+    uint32_t mismatches = 0;
+    uint32_t checks = 0;
+    uint32_t jumps = 0;
+    BenchSamples ticks;
+    BenchBegin(ticks, steps);
+    ScheduleLoop(now, 0);
+    ScheduleStats before;
+    ScheduleGetStats(before);
+    for (uint32_t i = 0; i < steps; i++) {
+        uint32_t event = Random(2000);
+        bool jump = event < 2;
+        if (event == 0) {
+            now -= 1 + Random(5000);
+        } else if (event == 1) {
+            now += 1 + Random(SCHEDULE_MAX_CATCHUP_S);
+        } else {
+            now++;
+        }
+        uint64_t started = BenchNowNs();
+        ScheduleLoop(now, 0);
+        uint64_t elapsed = BenchNowNs() - started;
+        if (jump) {
+            jumps++;
+        } else {
+            BenchRecord(ticks, elapsed);
+        }
+        if (jump || i % 16 == 0) {
+            mismatches += CountMismatches(now);
+            checks++;
+        }
+    }
+    ScheduleStats after;
+    ScheduleGetStats(after);
+
+    // Перестройка колеса по текущему времени (смена часового пояса)
+    BenchSamples rebuilds;
+    BenchBegin(rebuilds, 200);
+    for (int i = 0; i < 200; i++) {
+        uint64_t started = BenchNowNs();
+        ScheduleLoop(now - (i % 2) * 60, i % 2);
+        BenchRecord(rebuilds, BenchNowNs() - started);
+    }
+    mismatches += CountMismatches(now);
+
+    // То, что колесо заменяет: каждую секунду проверять все задания
+    BenchSamples scans;
+    BenchBegin(scans, 2000);
+    uint32_t activeSum = 0;
+    for (uint32_t i = 0; i < 2000; i++) {
+        uint64_t started = BenchNowNs();
+        for (uint32_t job = 0; job < stored.count; job++) {
+            activeSum += JobActive(stored.jobs[job], now + i) ? 1 : 0;
+        }
+        BenchRecord(scans, BenchNowNs() - started);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "schedule tick (%u jobs)", SCHEDULE_MAX_JOBS);
+    BenchSummary tick = BenchReport(name, ticks);
+    snprintf(name, sizeof(name), "schedule rebuild (%u jobs)", SCHEDULE_MAX_JOBS);
+    BenchReport(name, rebuilds);
+    snprintf(name, sizeof(name), "schedule full scan (%u jobs)", SCHEDULE_MAX_JOBS);
+    BenchSummary scan = BenchReport(name, scans);
+    printf("BENCH schedule %u simulated s: %u timers fired, %u cascaded, %u rebuilds (%u clock jumps); "
+           "%u mismatches in %u checks; tick p50 %.1fx faster than full scan (%u active)\n",
+           steps, after.fired - before.fired, after.cascaded - before.cascaded, after.rebuilds - before.rebuilds,
+           jumps, mismatches, checks, (double)scan.p50 / (tick.p50 > 0 ? tick.p50 : 1), activeSum);
+
+    TEST_ASSERT_EQUAL_UINT32(0, mismatches);
+    TEST_ASSERT_TRUE(after.fired > before.fired);
+    TEST_ASSERT_TRUE(tick.p50 < scan.p50);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_begin_loads_stored_table);
+    RUN_TEST(test_begin_rejects_other_format);
+    RUN_TEST(test_bench_thousands_of_jobs);
+    return UNITY_END();
+}
@@ -0,0 +1,268 @@
+/**
+ * Журнал показаний: восстановление после обрыва записи и скорость дописывания и чтения
+ * Файловая система - в памяти (test/support/FS.h): тест портит файлы так же,
+ * как их оставляет обрыв питания, и перезапускает журнал через TelemetryLogBegin
+ */
+#include <unity.h>
+#include <LittleFS.h>
+#include <esp_system.h>
+#include <ESPAsyncWebServer.h>
+#include "bench.h"
+#include "telemetry_log.h"
+
+#define RECORD_SIZE 16
+#define FIRST_TIME 1000020  // Кратно LOG_INTERVAL_S
+
+static uint32_t clockTime;   // Время следующего измерения по программным часам
+static uint32_t appended;    // Записей, закрытых накопителем (последний интервал еще открыт)
+static bool intervalOpen;    // У накопителя журнала есть открытый интервал
+
+void setUp() {
+    LittleFS.format();
+    TelemetryLogBegin();
+    clockTime = FIRST_TIME;
+    appended = 0;
+    intervalOpen = false;
+}
+
+void tearDown() {}
+
+/**
+ * Измерения по одному на интервал; значение освещенности - номер записи
+ * Запись попадает в буфер, когда начинается следующий интервал
+ */
+static void Measure(uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t index = (clockTime - FIRST_TIME) / LOG_INTERVAL_S;
+        float values[HISTORY_METRIC_COUNT] = {20.0f + index % 10, 50.0f, 1000.0f, (float)(index % 1000)};
+        bool valid[HISTORY_METRIC_COUNT] = {true, true, true, true};
+        if (intervalOpen) {
+            appended++;
+        }
+        intervalOpen = true;
+        TelemetryLogAdd(clockTime, values, valid);
+        clockTime += LOG_INTERVAL_S;
+    }
+}
+
+/**
+ * Перезапуск: буфер в памяти теряется, журнал восстанавливается с флеш
+ */
+static TelemetryLogStats Reboot() {
+    TelemetryLogBegin();
+    intervalOpen = false;
+    TelemetryLogStats stats;
+    TelemetryLogGetStats(stats);
+    return stats;
+}
+
+static TelemetryLogStats Stats() {
+    TelemetryLogStats stats;
+    TelemetryLogGetStats(stats);
+    return stats;
+}
+
+static HostFileData &LastSegment() {
+    return *LittleFS.files.rbegin()->second;
+}
+
+static uint32_t RecordTime(uint32_t index) {
+    return FIRST_TIME + index * LOG_INTERVAL_S;
+}
+
+/**
+ * Количество строк CSV за интервал (без заголовка)
+ */
+static uint32_t StreamLines(uint32_t from, uint32_t to, size_t chunk) {
+    TelemetryLogStream stream = {from, to, false, false};
+    static uint8_t buffer[4096];
+    uint32_t lines = 0;
+    bool header = true;
+    while (!stream.finished) {
+        size_t length = TelemetryLogStreamChunk(stream, buffer, chunk);
+        TEST_ASSERT_TRUE(length != RESPONSE_TRY_AGAIN);
+        for (size_t i = 0; i < length; i++) {
+            if (buffer[i] == '\n') {
+                if (header) {
+                    header = false;
+                } else {
+                    lines++;
+                }
+            }
+        }
+    }
+    return lines;
+}
+
+static void test_pending_records_are_lost_without_flush() {
+    Measure(41); // 40 записей: два пакета на флеш, 8 в буфере
+    TEST_ASSERT_EQUAL_UINT32(40, appended);
+    TEST_ASSERT_EQUAL_UINT32(8, Stats().pending);
+    TEST_ASSERT_EQUAL_UINT32(2 * LOG_BATCH_RECORDS, Reboot().records);
+}
+
+static void test_old_pending_records_are_flushed_by_age() {
+    Measure(4);
+    TEST_ASSERT_EQUAL_UINT32(3, Stats().pending);
+    TelemetryLogLoop(5000);
+    TelemetryLogLoop(5000 + LOG_FLUSH_MAX_AGE_MS - 1);
+    TEST_ASSERT_EQUAL_UINT32(3, Stats().pending);
+    TelemetryLogLoop(5000 + LOG_FLUSH_MAX_AGE_MS);
+    TEST_ASSERT_EQUAL_UINT32(0, Stats().pending);
+    TEST_ASSERT_EQUAL_UINT32(3, Stats().records);
+
+    // Возраст следующего пакета отсчитывается заново
+    Measure(1);
+    TelemetryLogLoop(5000 + LOG_FLUSH_MAX_AGE_MS + 1);
+    TelemetryLogLoop(5000 + 2 * LOG_FLUSH_MAX_AGE_MS);
+    TEST_ASSERT_EQUAL_UINT32(1, Stats().pending);
+    TelemetryLogLoop(5000 + 2 * LOG_FLUSH_MAX_AGE_MS + 1);
+    TEST_ASSERT_EQUAL_UINT32(0, Stats().pending);
+    TEST_ASSERT_EQUAL_UINT32(4, Reboot().records);
+}
+
+static void test_restart_flushes_pending_records() {
+    Measure(6);
+    TEST_ASSERT_EQUAL_UINT32(5, Stats().pending);
+    HostRestart();
+    TEST_ASSERT_EQUAL_UINT32(5, Reboot().records);
+}
+
+static void test_torn_record_at_tail_is_dropped() {
+    Measure(21);
+    TelemetryLogFlush();
+    // Обрыв посреди записи последней записи: на флеш ее первые 9 байт
+    HostFileData &segment = LastSegment();
+    segment.resize(segment.size() - 7);
+
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(19, stats.records);
+    TEST_ASSERT_EQUAL_UINT32(RecordTime(18), TelemetryLogLastTime());
+
+    // Сегмент с поврежденным хвостом закрыт, новые записи идут в следующий
+    clockTime = RecordTime(25);
+    Measure(4);
+    TelemetryLogFlush();
+    TEST_ASSERT_EQUAL_UINT32(2, Stats().segments);
+    TEST_ASSERT_EQUAL_UINT32(22, Reboot().records);
+    TEST_ASSERT_EQUAL_UINT32(22, StreamLines(0, UINT32_MAX, 1024));
+}
+
+static void test_short_write_seals_segment() {
+    Measure(17);
+    TelemetryLogFlush();
+    // Питание пропало посреди пакета: записаны 5 записей и 3 байта шестой
+    LittleFS.writeLimit = 5 * RECORD_SIZE + 3;
+    Measure(LOG_BATCH_RECORDS);
+    TEST_ASSERT_EQUAL_UINT32(16 + 5, Stats().records);
+    LittleFS.writeLimit = SIZE_MAX;
+
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(21, stats.records);
+    TEST_ASSERT_EQUAL_UINT32(RecordTime(20), TelemetryLogLastTime());
+    float sum;
+    TEST_ASSERT_EQUAL_UINT32(21, TelemetryLogSum(HISTORY_LUX, 0, UINT32_MAX, sum));
+    TEST_ASSERT_FLOAT_WITHIN(0.01f, 20 * 21 / 2, sum);
+}
+
+static void test_corrupted_tail_records_are_discarded() {
+    Measure(33);
+    TelemetryLogFlush();
+    // Недописанные страницы флеш читаются как 0xFF
+    HostFileData &segment = LastSegment();
+    memset(segment.data() + segment.size() - 3 * RECORD_SIZE, 0xFF, 3 * RECORD_SIZE);
+
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(29, stats.records);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.discarded);
+    TEST_ASSERT_EQUAL_UINT32(29, StreamLines(RecordTime(0), RecordTime(100), 256));
+}
+
+static void test_segment_with_bad_first_record_is_removed() {
+    Measure(LOG_SEGMENT_RECORDS + 11); // Полный сегмент и 10 записей во втором
+    TelemetryLogFlush();
+    TEST_ASSERT_EQUAL_UINT32(2, Stats().segments);
+    LastSegment()[0] ^= 0x01;
+
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(1, stats.segments);
+    TEST_ASSERT_EQUAL_UINT32(LOG_SEGMENT_RECORDS, stats.records);
+    TEST_ASSERT_EQUAL_UINT32(1, (uint32_t)LittleFS.files.size());
+}
+
+static void test_recovery_reads_only_segment_ends() {
+    Measure(LOG_MAX_SEGMENTS * LOG_SEGMENT_RECORDS + 1);
+    TelemetryLogFlush();
+    TEST_ASSERT_EQUAL_UINT32(LOG_MAX_SEGMENTS, Stats().segments);
+
+    LittleFS.counters = {};
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(LOG_MAX_SEGMENTS * LOG_SEGMENT_RECORDS, stats.records);
+    // Первая и последняя запись каждого сегмента и одна лишняя проверка последней
+    TEST_ASSERT_LESS_OR_EQUAL(3 * LOG_MAX_SEGMENTS, LittleFS.counters.reads);
+    printf("BENCH log recovery: %u segments, %u records, %u reads, %llu bytes read, %u ms\n",
+           (unsigned)stats.segments, (unsigned)stats.records, (unsigned)LittleFS.counters.reads,
+           (unsigned long long)LittleFS.counters.bytesRead, (unsigned)stats.recoveryMs);
+}
+
+static void test_rotation_keeps_newest_segments() {
+    Measure((LOG_MAX_SEGMENTS + 3) * LOG_SEGMENT_RECORDS + 1);
+    TelemetryLogFlush();
+    TelemetryLogStats stats = Reboot();
+    TEST_ASSERT_EQUAL_UINT32(LOG_MAX_SEGMENTS, stats.segments);
+    TEST_ASSERT_EQUAL_UINT32(LOG_MAX_SEGMENTS, (uint32_t)LittleFS.files.size());
+    TEST_ASSERT_EQUAL_UINT32(RecordTime(appended - 1), TelemetryLogLastTime());
+    TEST_ASSERT_EQUAL_UINT32(0, StreamLines(0, RecordTime(3 * LOG_SEGMENT_RECORDS - 1), 1024));
+}
+
+static void test_bench_append_and_query() {
+    const uint32_t records = 4 * LOG_MAX_SEGMENTS * LOG_SEGMENT_RECORDS; // С ротацией
+    uint64_t started = BenchNowNs();
+    Measure(records + 1);
+    uint64_t appendNs = BenchNowNs() - started;
+    TelemetryLogStats stats = Stats();
+    BenchReportRate("log append (with flush and rotation)", records, appendNs);
+    printf("BENCH log flushes: %u batches of %u records, %llu bytes written\n", (unsigned)stats.flushes,
+           LOG_BATCH_RECORDS, (unsigned long long)LittleFS.counters.bytesWritten);
+    TEST_ASSERT_EQUAL_UINT32(records / LOG_BATCH_RECORDS, stats.flushes);
+
+    // Сумма за час в случайном месте журнала: двоичный поиск по сегменту и 60 записей
+    uint32_t kept = LOG_MAX_SEGMENTS * LOG_SEGMENT_RECORDS;
+    uint32_t first = records - kept;
+    BenchSamples samples;
+    BenchBegin(samples, 2000);
+    srand(1);
+    uint64_t reads = LittleFS.counters.reads;
+    for (int i = 0; i < 2000; i++) {
+        uint32_t from = RecordTime(first + rand() % (kept - 60));
+        float sum;
+        uint64_t queryStarted = BenchNowNs();
+        uint32_t count = TelemetryLogSum(HISTORY_LUX, from, from + 59 * LOG_INTERVAL_S, sum);
+        BenchRecord(samples, BenchNowNs() - queryStarted);
+        TEST_ASSERT_EQUAL_UINT32(60, count);
+    }
+    BenchReport("log sum over 1 hour", samples);
+    printf("BENCH log sum reads: %.1f file reads per query\n", (LittleFS.counters.reads - reads) / 2000.0);
+
+    // Выдача всего журнала в CSV фрагментами размера сегмента TCP
+    started = BenchNowNs();
+    uint32_t lines = StreamLines(0, UINT32_MAX, 1436);
+    uint64_t streamNs = BenchNowNs() - started;
+    TEST_ASSERT_EQUAL_UINT32(kept, lines);
+    BenchReportRate("log CSV stream (records)", lines, streamNs);
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pending_records_are_lost_without_flush);
+    RUN_TEST(test_old_pending_records_are_flushed_by_age);
+    RUN_TEST(test_restart_flushes_pending_records);
+    RUN_TEST(test_torn_record_at_tail_is_dropped);
+    RUN_TEST(test_short_write_seals_segment);
+    RUN_TEST(test_corrupted_tail_records_are_discarded);
+    RUN_TEST(test_segment_with_bad_first_record_is_removed);
+    RUN_TEST(test_recovery_reads_only_segment_ends);
+    RUN_TEST(test_rotation_keeps_newest_segments);
+    RUN_TEST(test_bench_append_and_query);
+    return UNITY_END();
+}
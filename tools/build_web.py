@@ -0,0 +1,77 @@
+"""
+Сборка веб-интерфейса перед компиляцией прошивки (extra_scripts = pre:...)
+
+Минифицирует web/index.html, сжимает его gzip и записывает результат
+в src/page_gz.h в виде массива байт с ETag по хешу содержимого.
+ETag подставляется и в саму страницу вместо %PAGE_ETAG%: по нему страница, открытая
+из кэша, узнает в фоне, что прошивка обновилась.
+Можно запускать и вручную: python tools/build_web.py
+"""
+import gzip
+import hashlib
+import os
+import re
+
+try:
+    Import("env")  # noqa: F821 - определяется PlatformIO
+    PROJECT_DIR = env.subst("$PROJECT_DIR")  # noqa: F821
+except NameError:
+    PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+SOURCE = os.path.join(PROJECT_DIR, "web", "index.html")
+TARGET = os.path.join(PROJECT_DIR, "src", "page_gz.h")
+
+
+def minify(html):
+    """Консервативная минификация: комментарии и отступы, без переписывания кода"""
+    html = re.sub(r"<!--.*?-->", "", html, flags=re.S)      # HTML-комментарии
+    html = re.sub(r"/\*.*?\*/", "", html, flags=re.S)       # CSS-комментарии
+    lines = []
+    for line in html.splitlines():
+        line = line.strip()
+        if not line or line.startswith("//"):              # Пустые строки и JS-комментарии
+            continue
+        lines.append(line)
+    return "\n".join(lines) + "\n"
+
+
+def render_header(data, etag):
+    body = ",".join(str(b) for b in data)
+    return (
+        "// Сгенерировано tools/build_web.py из web/index.html, не редактировать\n"
+        "#ifndef PAGE_GZ_H\n"
+        "#define PAGE_GZ_H\n\n"
+        "#include <Arduino.h>\n\n"
+        f'#define PAGE_GZ_ETAG "\\"{etag}\\""\n'
+        f"#define PAGE_GZ_LENGTH {len(data)}\n\n"
+        f"const uint8_t PAGE_GZ[] PROGMEM = {{{body}}};\n\n"
+        "#endif\n"
+    )
+
+
+def build():
+    with open(SOURCE, encoding="utf-8") as f:
+        raw = f.read()
+    minified = minify(raw).encode("utf-8")
+    # ETag - по странице до подстановки, иначе он зависел бы сам от себя
+    etag = hashlib.sha256(minified).hexdigest()[:16]
+    minified = minified.replace(b"%PAGE_ETAG%", etag.encode("ascii"))
+    # mtime=0 - одинаковый вход дает одинаковый архив
+    packed = gzip.compress(minified, compresslevel=9, mtime=0)
+
+    header = render_header(packed, etag)
+    old = None
+    if os.path.exists(TARGET):
+        with open(TARGET, encoding="utf-8") as f:
+            old = f.read()
+    if header != old:
+        with open(TARGET, "w", encoding="utf-8") as f:
+            f.write(header)
+
+    print(
+        "web/index.html: %d bytes raw, %d minified, %d gzip, ETag %s"
+        % (len(raw.encode("utf-8")), len(minified), len(packed), etag)
+    )
+
+
+build()
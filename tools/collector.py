@@ -0,0 +1,463 @@
+"""
+Сборщик телеметрии в двоичном протоколе (src/proto.h) и его нагрузочная проверка
+
+Подкоманды:
+  listen   - прием пакетов PROTO_DELTA по UDP, счетчики по узлам и потерянные пакеты
+  simulate - отправка пакетов от N условных узлов на сборщик
+  bench    - прием и отправка от N узлов на loopback в одном процессе, пропускная способность приема
+  fetch    - HTTP-запрос к устройству с Accept: application/x-greenhouse и разбор кадров
+
+Примеры:
+  python tools/collector.py listen --port 5683
+  python tools/collector.py simulate --nodes 200 --rate 1 --duration 60
+  python tools/collector.py bench --nodes 500 --duration 10
+  python tools/collector.py fetch http://192.168.4.1/sensor/data
+  python tools/collector.py fetch "http://192.168.4.1/history?metric=temperature&res=minute"
+"""
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.request
+
+VERSION = 1
+MEDIA_TYPE = "application/x-greenhouse"
+HEADER = struct.Struct("<2sBBH")
+
+SAMPLE, STATE, HISTORY, DELTA = 1, 2, 3, 4
+
+NO_TEMPERATURE = -32768
+NO_HUMIDITY = 0xFFFF
+NO_PRESSURE = 0xFFFF
+NO_LUX = 0xFFFFFFFF
+
+FLAG_PUMP, FLAG_WIND, FLAG_LIGHT, FLAG_BME280, FLAG_BH1750 = 0x01, 0x02, 0x04, 0x08, 0x10
+
+# Поля измерения в пакете PROTO_DELTA (порядок ProtoDeltaField)
+DELTA_FIELDS = ("sequence", "time", "temperature", "humidity", "pressure", "lux",
+                "flags", "window", "brightness")
+HISTORY_METRICS = ("temperature", "humidity", "pressure", "lux")
+HISTORY_SCALE = (100, 100, 10, 100)
+HISTORY_RESOLUTIONS = ("raw", "minute", "hour")
+
+MAX_PACKET = 512  # PROTO_PUSH_MAX_BYTES
+
+
+class ProtoError(ValueError):
+    pass
+
+
+# --- Кодирование и разбор ---------------------------------------------------
+
+def put_varint(out, value):
+    value &= 0xFFFFFFFF
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+
+def put_zigzag(out, value):
+    value &= 0xFFFFFFFF
+    signed = value - (1 << 32) if value & 0x80000000 else value
+    put_varint(out, ((signed << 1) ^ (signed >> 31)) & 0xFFFFFFFF)
+
+
+def get_varint(data, pos):
+    result = shift = 0
+    while True:
+        if pos >= len(data) or shift > 28:
+            raise ProtoError("truncated varint")
+        byte = data[pos]
+        pos += 1
+        result |= (byte & 0x7F) << shift
+        if byte < 0x80:
+            return result & 0xFFFFFFFF, pos
+        shift += 7
+
+
+def get_zigzag(data, pos):
+    value, pos = get_varint(data, pos)
+    return (value >> 1) ^ -(value & 1), pos
+
+
+def frame(frame_type, payload):
+    return HEADER.pack(b"GH", VERSION, frame_type, len(payload)) + bytes(payload)
+
+
+def split_frames(data):
+    """Разбор потока кадров: (тип, данные) для каждого кадра"""
+    pos = 0
+    while pos < len(data):
+        if len(data) - pos < HEADER.size:
+            raise ProtoError("truncated header")
+        magic, version, frame_type, length = HEADER.unpack_from(data, pos)
+        if magic != b"GH":
+            raise ProtoError("bad magic at %d" % pos)
+        if version != VERSION:
+            raise ProtoError("unsupported version %d" % version)
+        pos += HEADER.size
+        if len(data) - pos < length:
+            raise ProtoError("truncated frame")
+        yield frame_type, data[pos:pos + length]
+        pos += length
+
+
+def decode_actuators(payload, pos):
+    flags, angle, target, brightness, r, g, b, version = struct.unpack_from("<7BI", payload, pos)
+    return {
+        "pump": bool(flags & FLAG_PUMP),
+        "wind": bool(flags & FLAG_WIND),
+        "light": bool(flags & FLAG_LIGHT),
+        "window_angle": angle,
+        "window_target": target,
+        "brightness": brightness,
+        "color": "#%02X%02X%02X" % (r, g, b),
+        "version": version,
+    }, flags
+
+
+def decode_values(temperature, humidity, pressure, lux):
+    return {
+        "temperature": None if temperature == NO_TEMPERATURE else temperature / 100,
+        "humidity": None if humidity == NO_HUMIDITY else humidity / 100,
+        "pressure": None if pressure == NO_PRESSURE else pressure / 10,
+        "lux": None if lux == NO_LUX else lux / 100,
+    }
+
+
+def decode_sample(payload):
+    sequence, when, temperature, humidity, pressure, lux = struct.unpack_from("<IIhHHI", payload)
+    result = {"sequence": sequence, "time": when}
+    result.update(decode_values(temperature, humidity, pressure, lux))
+    actuators, flags = decode_actuators(payload, 18)
+    result["bme280"] = bool(flags & FLAG_BME280)
+    result["bh1750"] = bool(flags & FLAG_BH1750)
+    result["actuators"] = actuators
+    return result
+
+
+def decode_history(payload):
+    metric, resolution, count = struct.unpack_from("<BBH", payload)
+    scale = HISTORY_SCALE[metric]
+    pos, when, avg, points = 4, 0, 0, []
+    for _ in range(count):
+        delta, pos = get_varint(payload, pos)
+        change, pos = get_zigzag(payload, pos)
+        below, pos = get_varint(payload, pos)
+        above, pos = get_varint(payload, pos)
+        when = (when + delta) & 0xFFFFFFFF
+        avg += change
+        points.append({"time": when, "avg": avg / scale, "min": (avg - below) / scale,
+                       "max": (avg + above) / scale})
+    return {"metric": HISTORY_METRICS[metric], "res": HISTORY_RESOLUTIONS[resolution], "points": points}
+
+
+def put_delta_record(out, fields, previous):
+    """Измерение пакета PROTO_DELTA: разности полей с предыдущим измерением (previous заменяется)"""
+    for index, value in enumerate(fields):
+        put_zigzag(out, value - previous[index])
+        previous[index] = value
+
+
+def encode_delta(node, number, records):
+    """Пакет PROTO_DELTA из полей измерений в порядке DELTA_FIELDS (как ProtoEncodeDelta)"""
+    body = bytearray(struct.pack("<IIB", node, number, len(records)))
+    previous = [0] * len(DELTA_FIELDS)
+    for fields in records:
+        put_delta_record(body, fields, previous)
+    return frame(DELTA, body)
+
+
+def decode_delta(payload):
+    """Пакет PROTO_DELTA: (узел, номер пакета, список измерений)"""
+    node, number, count = struct.unpack_from("<IIB", payload)
+    pos, previous, records = 9, [0] * len(DELTA_FIELDS), []
+    for _ in range(count):
+        record = {}
+        for index, name in enumerate(DELTA_FIELDS):
+            change, pos = get_zigzag(payload, pos)
+            previous[index] = (previous[index] + change) & 0xFFFFFFFF
+            record[name] = previous[index]
+        temperature = record["temperature"]
+        if temperature & 0x80000000:
+            temperature -= 1 << 32
+        record.update(decode_values(temperature, record["humidity"], record["pressure"], record["lux"]))
+        records.append(record)
+    if pos != len(payload):
+        raise ProtoError("trailing bytes in delta packet")
+    return node, number, records
+
+
+# --- Условный узел ----------------------------------------------------------
+
+class SimulatedNode:
+    """Узел с правдоподобными медленно меняющимися показаниями; пакеты - как у ProtoPushLoop"""
+
+    def __init__(self, node, batch, seed=None):
+        self.node = node
+        self.batch = batch
+        self.random = random.Random(node if seed is None else seed)
+        self.sequence = 0
+        self.packet = 0
+        self.time = 1700000000 + self.random.randrange(3600)
+        self.temperature = self.random.uniform(18, 28)
+        self.humidity = self.random.uniform(40, 80)
+        self.pressure = self.random.uniform(990, 1030)
+        self.lux = self.random.uniform(0, 20000)
+
+    def _fields(self):
+        self.sequence += 1
+        self.time += 2
+        self.temperature += self.random.gauss(0, 0.05)
+        self.humidity = min(max(self.humidity + self.random.gauss(0, 0.2), 0), 100)
+        self.pressure += self.random.gauss(0, 0.05)
+        self.lux = max(self.lux + self.random.gauss(0, 50), 0)
+        flags = FLAG_BME280 | FLAG_BH1750 | (FLAG_PUMP if self.random.random() < 0.05 else 0)
+        return [self.sequence, self.time, round(self.temperature * 100) & 0xFFFFFFFF,
+                round(self.humidity * 100), round(self.pressure * 10), round(self.lux * 100),
+                flags, 30, 20]
+
+    def next_packet(self):
+        body = bytearray(struct.pack("<IIB", self.node, self.packet, 0))
+        self.packet = (self.packet + 1) & 0xFFFFFFFF
+        previous = [0] * len(DELTA_FIELDS)
+        count = 0
+        while count < self.batch and HEADER.size + len(body) + 5 * len(DELTA_FIELDS) <= MAX_PACKET:
+            put_delta_record(body, self._fields(), previous)
+            count += 1
+        body[8] = count
+        return frame(DELTA, body)
+
+
+# --- Прием ------------------------------------------------------------------
+
+class Collector:
+    """Счетчики приема: пакеты, измерения, байты и потерянные пакеты по номерам"""
+
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.nodes = {}  # узел -> [пакетов, измерений, следующий номер, потеряно]
+        self.packets = self.samples = self.bytes = self.errors = 0
+
+    def ingest(self, data):
+        try:
+            frames = list(split_frames(data))
+            if len(frames) != 1 or frames[0][0] != DELTA:
+                raise ProtoError("expected one delta frame")
+            node, number, records = decode_delta(frames[0][1])
+        except (ProtoError, struct.error):
+            with self.lock:
+                self.errors += 1
+            return None
+        with self.lock:
+            state = self.nodes.get(node)
+            if state is None:
+                state = self.nodes[node] = [0, 0, number, 0]
+            gap = (number - state[2]) & 0xFFFFFFFF
+            if gap < 0x80000000:  # Пакеты с меньшим номером (перестановка, повтор) потерями не считаются
+                state[3] += gap
+                state[2] = (number + 1) & 0xFFFFFFFF
+            state[0] += 1
+            state[1] += len(records)
+            self.packets += 1
+            self.samples += len(records)
+            self.bytes += len(data)
+        return node, number, records
+
+    def totals(self):
+        with self.lock:
+            lost = sum(state[3] for state in self.nodes.values())
+            return self.packets, self.samples, self.bytes, self.errors, len(self.nodes), lost
+
+
+def open_receiver(host, port):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 << 20)
+    sock.bind((host, port))
+    sock.settimeout(0.2)
+    return sock
+
+
+def receive(sock, collector, stop, verbose=False):
+    """Прием до остановки; после stop дочитывается очередь сокета"""
+    while True:
+        try:
+            data, _ = sock.recvfrom(2048)
+        except socket.timeout:
+            if stop.is_set():
+                return
+            continue
+        result = collector.ingest(data)
+        if verbose and result is not None:
+            node, number, records = result
+            last = records[-1] if records else {}
+            print("node %08X packet %u: %d samples, t=%s, %s °C, %s %%, %s lx" % (
+                node, number, len(records), last.get("time"), last.get("temperature"),
+                last.get("humidity"), last.get("lux")))
+
+
+def report(collector, elapsed):
+    packets, samples, size, errors, nodes, lost = collector.totals()
+    elapsed = max(elapsed, 1e-9)
+    print("%d nodes, %d packets (%.0f/s), %d samples (%.0f/s), %.1f KiB/s, %d lost, %d bad" % (
+        nodes, packets, packets / elapsed, samples, samples / elapsed, size / elapsed / 1024, lost, errors))
+
+
+# --- Подкоманды -------------------------------------------------------------
+
+def command_listen(args):
+    collector = Collector()
+    stop = threading.Event()
+    sock = open_receiver(args.host, args.port)
+    print("listening on %s:%d" % (args.host, args.port))
+    started = time.monotonic()
+    thread = threading.Thread(target=receive, args=(sock, collector, stop, not args.quiet), daemon=True)
+    thread.start()
+    try:
+        while True:
+            time.sleep(args.interval)
+            report(collector, time.monotonic() - started)
+    except KeyboardInterrupt:
+        pass
+    stop.set()
+    thread.join()
+
+
+def send_nodes(nodes, target, rate, deadline, sent, drop=0.0):
+    """Отправка пакетов от группы узлов; rate - пакетов в секунду на узел (0 - без ограничения)"""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_SNDBUF, 1 << 20)
+    interval = 1.0 / rate if rate > 0 else 0
+    next_round = time.monotonic()
+    count = 0
+    while time.monotonic() < deadline:
+        for node in nodes:
+            data = node.next_packet()
+            if drop and node.random.random() < drop:
+                continue  # Имитация потери: номер пакета пропускается
+            try:
+                sock.sendto(data, target)
+                count += 1
+            except OSError:
+                time.sleep(0.001)  # Переполнен буфер отправки
+        if interval:
+            next_round += interval
+            pause = next_round - time.monotonic()
+            if pause > 0:
+                time.sleep(pause)
+    sent.append(count)
+    sock.close()
+
+
+def start_senders(args, target, deadline, sent):
+    nodes = [SimulatedNode(args.first_node + index, args.batch) for index in range(args.nodes)]
+    threads = []
+    for index in range(args.threads):
+        group = nodes[index::args.threads]
+        thread = threading.Thread(target=send_nodes, args=(group, target, args.rate, deadline, sent, args.drop),
+                                  daemon=True)
+        thread.start()
+        threads.append(thread)
+    return threads
+
+
+def command_simulate(args):
+    sent = []
+    deadline = time.monotonic() + args.duration
+    for thread in start_senders(args, (args.host, args.port), deadline, sent):
+        thread.join()
+    print("%d nodes sent %d packets in %.1f s" % (args.nodes, sum(sent), args.duration))
+
+
+def command_bench(args):
+    collector = Collector()
+    stop = threading.Event()
+    sock = open_receiver("127.0.0.1", 0)
+    target = sock.getsockname()
+    receiver = threading.Thread(target=receive, args=(sock, collector, stop), daemon=True)
+    receiver.start()
+
+    sent = []
+    started = time.monotonic()
+    senders = start_senders(args, target, started + args.duration, sent)
+    for thread in senders:
+        thread.join()
+    stop.set()
+    receiver.join()
+    elapsed = time.monotonic() - started
+
+    total = sum(sent)
+    packets = collector.totals()[0]
+    print("sent %d packets, received %d (%.1f%%)" % (total, packets, 100.0 * packets / max(total, 1)))
+    report(collector, elapsed)
+
+
+def command_fetch(args):
+    request = urllib.request.Request(args.url, headers={"Accept": MEDIA_TYPE})
+    with urllib.request.urlopen(request, timeout=args.timeout) as response:
+        content_type = response.headers.get("Content-Type", "")
+        data = response.read()
+    if not content_type.startswith(MEDIA_TYPE):
+        sys.exit("unexpected Content-Type: %s" % content_type)
+    points = 0
+    for frame_type, payload in split_frames(data):
+        if frame_type == SAMPLE:
+            print(decode_sample(payload))
+        elif frame_type == STATE:
+            print(decode_actuators(payload, 0)[0])
+        elif frame_type == HISTORY:
+            history = decode_history(payload)
+            points += len(history["points"])
+            for point in history["points"]:
+                print("%s %s %u %.2f %.2f %.2f" % (history["metric"], history["res"], point["time"],
+                                                   point["avg"], point["min"], point["max"]))
+        else:
+            print("frame type %d, %d bytes" % (frame_type, len(payload)))
+    print("%d bytes%s" % (len(data), ", %d points" % points if points else ""), file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Greenhouse binary telemetry collector")
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    listen = commands.add_parser("listen", help="receive delta packets")
+    listen.add_argument("--host", default="0.0.0.0")
+    listen.add_argument("--port", type=int, default=5683)
+    listen.add_argument("--interval", type=float, default=10, help="report period, s")
+    listen.add_argument("--quiet", action="store_true", help="do not print every packet")
+    listen.set_defaults(handler=command_listen)
+
+    for name, handler in (("simulate", command_simulate), ("bench", command_bench)):
+        sub = commands.add_parser(name, help="simulated nodes" if name == "simulate" else "loopback ingest benchmark")
+        if name == "simulate":
+            sub.add_argument("--host", default="127.0.0.1")
+            sub.add_argument("--port", type=int, default=5683)
+        sub.add_argument("--nodes", type=int, default=200)
+        sub.add_argument("--first-node", type=lambda text: int(text, 0), default=0x1000)
+        sub.add_argument("--batch", type=int, default=8, help="samples per packet")
+        sub.add_argument("--rate", type=float, default=1 if name == "simulate" else 0,
+                         help="packets per second per node, 0 - as fast as possible")
+        sub.add_argument("--duration", type=float, default=10, help="s")
+        sub.add_argument("--threads", type=int, default=4)
+        sub.add_argument("--drop", type=float, default=0, help="fraction of packets to skip (loss check)")
+        sub.set_defaults(handler=handler)
+
+    fetch = commands.add_parser("fetch", help="GET with binary Accept and decode")
+    fetch.add_argument("url")
+    fetch.add_argument("--timeout", type=float, default=10)
+    fetch.set_defaults(handler=command_fetch)
+
+    args = parser.parse_args()
+    if getattr(args, "threads", 1) < 1 or getattr(args, "nodes", 1) < 1:
+        parser.error("--nodes and --threads must be positive")
+    if not 1 <= getattr(args, "batch", 1) <= 64:
+        parser.error("--batch must be 1..64")
+    args.handler(args)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,279 @@
+"""
+Замер загрузки главной страницы: байты на проводе, время до показа данных и куча устройства
+
+Страница отдается так же, как в прошивке: массив из src/page_gz.h с Content-Encoding: gzip,
+ETag и Cache-Control: max-age, на совпавший If-None-Match - 304. Показания страница получает
+запросом /sensor/data, поэтому время до интерактивности - это ответ страницы, ее распаковка
+и ответ /sensor/data. Сценарии:
+  первое открытие        - страница целиком и данные;
+  сверка (304)           - открытие после истечения max-age или перезагрузкой: 304 и данные;
+  из кэша (max-age)      - обычное повторное открытие: страница из кэша браузера, только данные
+                           (фоновая сверка версии идет после показа данных и не учитывается).
+Для сравнения можно отдать старую страницу src/page.h из указанной ревизии: без сжатия,
+со значениями, подставленными на устройстве, - одним запросом.
+
+Канал устройства эмулируется на loopback: перед ответом - два RTT (установка TCP-соединения
+и запрос; веб-сервер закрывает соединение после ответа), передача - порциями по MSS с заданной
+скоростью. Разбор страницы и выполнение скриптов браузером не учитываются.
+С --url те же сценарии выполняются на настоящем устройстве, а до и после каждого сценария
+читаются датчики кучи из /metrics: свободная куча, ее минимум с запуска и наибольший блок.
+Минимум с запуска не сбрасывается, поэтому пик кучи на запрос виден точно, только если сценарий
+опустил минимум ниже прежнего ("peak" - свободная куча до сценария минус новый минимум);
+иначе известна лишь верхняя граница ("<=..."). Точнее всего - сразу после перезапуска.
+В эмуляции куча не измеряется: пик кучи прошивки на запрос по маршрутам печатает test_http.
+
+Примеры:
+  python tools/build_web.py && python tools/page_bench.py
+  python tools/page_bench.py --baseline-rev 0935e65 --rate 1000 --rtt 40
+  python tools/page_bench.py --url http://192.168.4.1 --runs 50
+"""
+import argparse
+import gzip
+import os
+import re
+import socket
+import socketserver
+import statistics
+import subprocess
+import threading
+import time
+import urllib.parse
+
+PROJECT_DIR = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+PAGE_GZ = os.path.join(PROJECT_DIR, "src", "page_gz.h")
+
+MSS = 1460
+
+# Cache-Control страницы (PAGE_CACHE_CONTROL в src/main.cpp)
+PAGE_CACHE_CONTROL = "max-age=604800"
+
+# Датчики кучи в /metrics
+HEAP_GAUGES = ("greenhouse_heap_free_bytes", "greenhouse_heap_min_free_bytes",
+               "greenhouse_heap_largest_free_block_bytes")
+
+# Ответ /sensor/data такого же размера и состава, как у прошивки (BuildStateJson)
+SAMPLE_STATE = (
+    b'{"temperature":23.4,"humidity":61.2,"pressure":1003.5,"lux":1520.0,"age":412,"bus_us":2150,'
+    b'"filter_us":38,"raw":{"temperature":23.4,"humidity":61.3,"pressure":1003.5,"lux":1523.0},'
+    b'"bme280":true,"bh1750":true,"pump":false,"wind":true,"window":true,"window_angle":40,'
+    b'"window_target":40,"light":true,"brightness":80,"color":"#FF8000"}'
+)
+
+# Значения для подстановки в старый шаблон
+SAMPLE_PLACEHOLDERS = {
+    "%TEMPERATURE%": "23.4", "%HUMIDITY%": "61.2", "%PRESSURE%": "1003.5", "%LUX%": "1520.0",
+    "%WINDOW_STATE%": "checked", "%PUMP_STATE%": "", "%WIND_STATE%": "checked",
+    "%LIGHT_STATE%": "checked", "%BRIGHTNESS%": "80",
+}
+
+
+def read_page_gz():
+    """Массив и ETag из src/page_gz.h"""
+    with open(PAGE_GZ, encoding="utf-8") as f:
+        text = f.read()
+    etag = re.search(r'#define PAGE_GZ_ETAG "(.*)"', text).group(1).replace('\\"', '"')
+    body = bytes(int(b) for b in re.search(r"\{([0-9,]+)\}", text).group(1).split(","))
+    return body, etag
+
+
+def read_baseline(revision):
+    """Старая страница из src/page.h с подставленными значениями, как ее отдавал обработчик /"""
+    source = subprocess.run(["git", "-C", PROJECT_DIR, "show", f"{revision}:src/page.h"],
+                            check=True, capture_output=True).stdout.decode("utf-8")
+    page = source.split('R"rawliteral(', 1)[1].split(')rawliteral"', 1)[0]
+    for placeholder, value in SAMPLE_PLACEHOLDERS.items():
+        page = page.replace(placeholder, value)
+    return page.encode("utf-8")
+
+
+# --- Эмуляция устройства ---------------------------------------------------
+
+class DeviceHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        request = b""
+        while b"\r\n\r\n" not in request:
+            chunk = self.request.recv(4096)
+            if not chunk:
+                return
+            request += chunk
+        lines = request.decode("latin-1").split("\r\n")
+        path = lines[0].split(" ")[1]
+        headers = {line.split(":", 1)[0].lower(): line.split(":", 1)[1].strip()
+                   for line in lines[1:] if ":" in line}
+        status, extra, body = self.server.route(path, headers)
+
+        link = self.server.link
+        time.sleep(2 * link["rtt"])
+        head = f"HTTP/1.1 {status}\r\nContent-Length: {len(body)}\r\nConnection: close\r\n{extra}\r\n"
+        data = head.encode("latin-1") + body
+        for offset in range(0, len(data), MSS):
+            chunk = data[offset:offset + MSS]
+            time.sleep(len(chunk) / link["rate"])
+            self.request.sendall(chunk)
+
+
+class Device(socketserver.ThreadingTCPServer):
+    daemon_threads = True
+    allow_reuse_address = True
+
+    def __init__(self, link, page, etag, baseline):
+        super().__init__(("127.0.0.1", 0), DeviceHandler)
+        self.link = link
+        self.page = page
+        self.etag = etag
+        self.baseline = baseline
+
+    def route(self, path, headers):
+        if path == "/":
+            if self.etag in headers.get("if-none-match", ""):
+                return "304 Not Modified", f"ETag: {self.etag}\r\nCache-Control: {PAGE_CACHE_CONTROL}\r\n", b""
+            return ("200 OK", "Content-Type: text/html\r\nContent-Encoding: gzip\r\n"
+                    f"Cache-Control: {PAGE_CACHE_CONTROL}\r\nETag: {self.etag}\r\n", self.page)
+        if path == "/sensor/data":
+            return "200 OK", "Content-Type: application/json\r\n", SAMPLE_STATE
+        if path == "/baseline" and self.baseline is not None:
+            return "200 OK", "Content-Type: text/html\r\n", self.baseline
+        return "404 Not Found", "", b"Not found"
+
+
+# --- Клиент ----------------------------------------------------------------
+
+def get(host, port, path, headers=None):
+    """
+    HTTP-запрос с чтением ответа до закрытия соединения
+    Возвращает (код, заголовки, тело, байт принято)
+    """
+    request = f"GET {path} HTTP/1.1\r\nHost: {host}\r\nAccept-Encoding: gzip\r\nConnection: close\r\n"
+    for name, value in (headers or {}).items():
+        request += f"{name}: {value}\r\n"
+    with socket.create_connection((host, port), timeout=30) as sock:
+        sock.sendall((request + "\r\n").encode("latin-1"))
+        data = b""
+        while True:
+            chunk = sock.recv(65536)
+            if not chunk:
+                break
+            data += chunk
+    head, _, body = data.partition(b"\r\n\r\n")
+    lines = head.decode("latin-1").split("\r\n")
+    fields = {line.split(":", 1)[0].lower(): line.split(":", 1)[1].strip()
+              for line in lines[1:] if ":" in line}
+    return int(lines[0].split(" ")[1]), fields, body, len(data)
+
+
+def load_data(host, port):
+    """Первые показания страницы; возвращает байт принято"""
+    status, _, body, received = get(host, port, "/sensor/data")
+    if status != 200 or not body.startswith(b"{"):
+        raise RuntimeError(f"/sensor/data: {status}")
+    return received
+
+
+def load_gzip_page(host, port, etag=None):
+    """Страница (или 304) и первые показания; возвращает (запросов, байт, заголовки страницы)"""
+    status, fields, body, received = get(host, port, "/", {"If-None-Match": etag} if etag else None)
+    if status == 200:
+        html = gzip.decompress(body) if fields.get("content-encoding") == "gzip" else body
+        assert b"/sensor/data" in html, "страница не запрашивает /sensor/data"
+        # Страница из кэша сверяет по этому значению свою версию с устройством
+        assert fields.get("etag", "").encode() in html, "в странице нет ее ETag"
+    elif status != 304:
+        raise RuntimeError(f"/: {status}")
+    return 2, received + load_data(host, port), fields
+
+
+def load_cached_page(host, port):
+    """Страница из кэша браузера: только первые показания"""
+    return 1, load_data(host, port), None
+
+
+def load_baseline(host, port):
+    status, _, body, received = get(host, port, "/baseline")
+    if status != 200:
+        raise RuntimeError(f"/baseline: {status}")
+    return 1, received, None
+
+
+def read_heap(host, port):
+    """Датчики кучи устройства из /metrics: {имя: байты}"""
+    status, _, body, _ = get(host, port, "/metrics")
+    if status != 200:
+        raise RuntimeError(f"/metrics: {status}")
+    heap = {}
+    for line in body.decode("utf-8").splitlines():
+        name, _, value = line.partition(" ")
+        if name in HEAP_GAUGES:
+            heap[name] = int(float(value))
+    return heap
+
+
+def heap_columns(before, after):
+    """Пик кучи на запрос, изменение свободной кучи и наибольшего блока за сценарий"""
+    free, low, block = HEAP_GAUGES
+    if after[low] < before[low]:
+        peak = f"{before[free] - after[low]}"
+    else:
+        peak = f"<={before[free] - before[low]}"
+    return f"{peak:>10}{after[free] - before[free]:>+10}{after[block] - before[block]:>+10}"
+
+
+def measure(name, runs, load, heap=None):
+    """Сценарий: runs загрузок; heap - чтение датчиков кучи до и после (None - без них)"""
+    before = heap() if heap else None
+    times = []
+    requests = received = 0
+    for _ in range(runs):
+        started = time.perf_counter()
+        requests, received, _ = load()
+        times.append((time.perf_counter() - started) * 1000)
+    times.sort()
+    p90 = times[min(len(times) - 1, int(len(times) * 0.9))]
+    row = f"{name:<26}{requests:>9}{received:>9}{statistics.median(times):>12.1f}{p90:>10.1f}"
+    if heap:
+        row += heap_columns(before, heap())
+    print(row)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Main page load benchmark")
+    parser.add_argument("--rate", type=float, default=2000, help="link rate, kbit/s")
+    parser.add_argument("--rtt", type=float, default=30, help="round-trip time, ms")
+    parser.add_argument("--runs", type=int, default=20)
+    parser.add_argument("--baseline-rev", help="git revision with the old src/page.h template")
+    parser.add_argument("--url", help="measure a real device instead of the loopback emulation")
+    args = parser.parse_args()
+
+    if args.url:
+        target = urllib.parse.urlsplit(args.url)
+        host, port = target.hostname, target.port or 80
+        print(f"device {host}:{port}, {args.runs} runs")
+        baseline = None
+    else:
+        page, etag = read_page_gz()
+        baseline = read_baseline(args.baseline_rev) if args.baseline_rev else None
+        link = {"rate": args.rate * 1000 / 8, "rtt": args.rtt / 1000}
+        device = Device(link, page, etag, baseline)
+        threading.Thread(target=device.serve_forever, daemon=True).start()
+        host, port = device.server_address
+        print(f"loopback link {args.rate:g} kbit/s, RTT {args.rtt:g} ms, {args.runs} runs; "
+              f"page {len(page)} bytes gzip")
+
+    heap = (lambda: read_heap(host, port)) if args.url else None
+    _, _, fields = load_gzip_page(host, port)
+    etag = fields.get("etag")
+    cached = "max-age=" in fields.get("cache-control", "") and "max-age=0" not in fields["cache-control"]
+    header = f"{'scenario':<26}{'requests':>9}{'bytes':>9}{'median ms':>12}{'p90 ms':>10}"
+    if heap:
+        header += f"{'peak heap':>10}{'free':>10}{'block':>10}"
+    print(header)
+    measure("gzip, first load", args.runs, lambda: load_gzip_page(host, port), heap)
+    if etag:
+        measure("gzip, revalidated (304)", args.runs, lambda: load_gzip_page(host, port, etag), heap)
+    if cached:
+        measure("gzip, cached (max-age)", args.runs, lambda: load_cached_page(host, port), heap)
+    if baseline is not None:
+        measure(f"template ({args.baseline_rev})", args.runs, lambda: load_baseline(host, port))
+
+
+if __name__ == "__main__":
+    main()
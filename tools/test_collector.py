@@ -0,0 +1,95 @@
+"""
+Проверка разбора пакетов сборщиком на эталонном пакете PROTO_DELTA
+Эталон - байты из test/test_proto/delta_packet.h, которые test_proto сверяет с ProtoEncodeDelta
+
+Запуск:
+  python -m unittest tools/test_collector.py
+"""
+import os
+import re
+import sys
+import unittest
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import collector  # noqa: E402
+
+PACKET_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir,
+                             "test", "test_proto", "delta_packet.h")
+
+NODE, NUMBER = 0xA1B2C3D4, 7
+
+# Поля измерений deltaRecords из test/test_proto/test_main.cpp (температура - int16, расширенное до 32 бит)
+RECORDS = [
+    [1000, 1700000000, -150 & 0xFFFFFFFF, 5620, 10065, 1200000,
+     collector.FLAG_BME280 | collector.FLAG_BH1750 | collector.FLAG_PUMP, 30, 20],
+    [1001, 1700000002, -140 & 0xFFFFFFFF, 5600, 10066, 1195000, collector.FLAG_BME280 | collector.FLAG_BH1750, 40, 20],
+    [1003, 1700000006, collector.NO_TEMPERATURE & 0xFFFFFFFF, collector.NO_HUMIDITY, collector.NO_PRESSURE,
+     collector.NO_LUX, collector.FLAG_LIGHT, 40, 100],
+]
+
+
+def load_packet():
+    with open(PACKET_HEADER, encoding="utf-8") as source:
+        text = source.read()
+    body = text[text.index("DELTA_PACKET[] = {"):text.index("};")]
+    return bytes(int(byte, 16) for byte in re.findall(r"0x([0-9A-Fa-f]{2})", body))
+
+
+class DeltaPacketTest(unittest.TestCase):
+    def setUp(self):
+        self.packet = load_packet()
+
+    def test_decodes_reference_packet(self):
+        frames = list(collector.split_frames(self.packet))
+        self.assertEqual(1, len(frames))
+        frame_type, payload = frames[0]
+        self.assertEqual(collector.DELTA, frame_type)
+        node, number, records = collector.decode_delta(payload)
+        self.assertEqual((NODE, NUMBER, 3), (node, number, len(records)))
+
+        first, second, third = records
+        self.assertEqual((1000, 1700000000), (first["sequence"], first["time"]))
+        self.assertEqual((-1.5, 56.2, 1006.5, 12000.0),
+                         (first["temperature"], first["humidity"], first["pressure"], first["lux"]))
+        self.assertEqual((0x19, 30, 20), (first["flags"], first["window"], first["brightness"]))
+        self.assertEqual((1001, 1700000002, -1.4, 56.0, 1006.6, 11950.0, 40),
+                         (second["sequence"], second["time"], second["temperature"], second["humidity"],
+                          second["pressure"], second["lux"], second["window"]))
+        # Отсутствующие показания после разностей с настоящими значениями
+        self.assertEqual((1003, 1700000006), (third["sequence"], third["time"]))
+        self.assertEqual((None, None, None, None),
+                         (third["temperature"], third["humidity"], third["pressure"], third["lux"]))
+        self.assertEqual((collector.FLAG_LIGHT, 100), (third["flags"], third["brightness"]))
+
+    def test_encodes_same_bytes_as_firmware(self):
+        self.assertEqual(self.packet, collector.encode_delta(NODE, NUMBER, RECORDS))
+
+    def test_round_trip(self):
+        packet = collector.encode_delta(NODE, NUMBER + 1, RECORDS)
+        _, payload = next(collector.split_frames(packet))
+        node, number, records = collector.decode_delta(payload)
+        self.assertEqual((NODE, NUMBER + 1), (node, number))
+        self.assertEqual([1000, 1001, 1003], [record["sequence"] for record in records])
+        self.assertEqual([30, 40, 40], [record["window"] for record in records])
+
+    def test_simulated_node_packets_decode(self):
+        node = collector.SimulatedNode(0x1000, batch=8, seed=1)
+        for expected_number in range(3):
+            _, payload = next(collector.split_frames(node.next_packet()))
+            number, records = collector.decode_delta(payload)[1:]
+            self.assertEqual(expected_number, number)
+            self.assertEqual(8, len(records))
+            self.assertEqual(list(range(expected_number * 8 + 1, expected_number * 8 + 9)),
+                             [record["sequence"] for record in records])
+
+    def test_collector_counts_records_and_lost_packets(self):
+        sink = collector.Collector()
+        sink.ingest(self.packet)
+        sink.ingest(collector.encode_delta(NODE, NUMBER + 2, RECORDS[:1]))
+        sink.ingest(self.packet[:-1])
+        packets, samples, _, errors, nodes, lost = sink.totals()
+        self.assertEqual((2, 4, 1, 1, 1), (packets, samples, errors, nodes, lost))
+
+
+if __name__ == "__main__":
+    unittest.main()